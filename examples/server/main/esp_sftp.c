@@ -0,0 +1,1030 @@
+/*
+ * esp_sftp.c - In-process SFTP v3 server (draft-ietf-secsh-filexfer-02).
+ *
+ * Client bytes are queued in a circular buffer the size of the channel
+ * window and parsed from there one request at a time, in the order they
+ * arrived. The window is handed back only for bytes that have been worked
+ * through, so requests waiting in the queue still count against it and a
+ * client that pipelines requests cannot overrun the queue.
+ *
+ * WRITE data is not buffered as a whole request: once the request header is
+ * parsed, the data is written to the file piece by piece as it arrives. A
+ * READ reply is sent as a DATA header followed by the file data, read in
+ * SFTP_CHUNK pieces while the channel has room. Requests queued behind it
+ * wait, and the client keeps its next reads in flight meanwhile, so the link
+ * is not idle for a round trip per chunk. Other replies are small and are
+ * built in the chunk buffer.
+ *
+ * Handles are indexes into a small per-channel table, sent as 4 bytes.
+ */
+
+#include "includes.h"
+#include "session.h"
+#include "channel.h"
+#include "circbuffer.h"
+#include "dbutil.h"
+#include "chan_inproc.h"
+#include "esp_sftp.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define SFTP_REQ_MAX      1024  /* largest request, WRITE data excluded  */
+#define SFTP_CHUNK        2048  /* file I/O and reply buffer            */
+#define SFTP_READ_MAX     32768 /* largest DATA reply                   */
+#define SFTP_POLL_BUDGET  8192  /* READ data sent per call              */
+#define SFTP_HANDLES      4
+#define SFTP_PATH_MAX     256
+#define SFTP_ROOT_MAX     64
+
+#define SSH_FXP_INIT      1
+#define SSH_FXP_VERSION   2
+#define SSH_FXP_OPEN      3
+#define SSH_FXP_CLOSE     4
+#define SSH_FXP_READ      5
+#define SSH_FXP_WRITE     6
+#define SSH_FXP_LSTAT     7
+#define SSH_FXP_FSTAT     8
+#define SSH_FXP_SETSTAT   9
+#define SSH_FXP_FSETSTAT  10
+#define SSH_FXP_OPENDIR   11
+#define SSH_FXP_READDIR   12
+#define SSH_FXP_REMOVE    13
+#define SSH_FXP_MKDIR     14
+#define SSH_FXP_RMDIR     15
+#define SSH_FXP_REALPATH  16
+#define SSH_FXP_STAT      17
+#define SSH_FXP_RENAME    18
+#define SSH_FXP_STATUS    101
+#define SSH_FXP_HANDLE    102
+#define SSH_FXP_DATA      103
+#define SSH_FXP_NAME      104
+#define SSH_FXP_ATTRS     105
+
+#define SSH_FX_OK                 0
+#define SSH_FX_EOF                1
+#define SSH_FX_NO_SUCH_FILE       2
+#define SSH_FX_PERMISSION_DENIED  3
+#define SSH_FX_FAILURE            4
+#define SSH_FX_BAD_MESSAGE        5
+#define SSH_FX_OP_UNSUPPORTED     8
+
+#define SSH_FILEXFER_ATTR_SIZE         0x01
+#define SSH_FILEXFER_ATTR_UIDGID       0x02
+#define SSH_FILEXFER_ATTR_PERMISSIONS  0x04
+#define SSH_FILEXFER_ATTR_ACMODTIME    0x08
+#define SSH_FILEXFER_ATTR_EXTENDED     0x80000000
+
+#define SSH_FXF_READ      0x01
+#define SSH_FXF_WRITE     0x02
+#define SSH_FXF_APPEND    0x04
+#define SSH_FXF_CREAT     0x08
+#define SSH_FXF_TRUNC     0x10
+#define SSH_FXF_EXCL      0x20
+
+/* WRITE up to its data: length, type, id, handle (4 bytes), offset, data length */
+#define SFTP_WRITE_HDR    (4 + 1 + 4 + 4 + 4 + 8 + 4)
+/* DATA reply up to its data: length, type, id, data length */
+#define SFTP_DATA_HDR     (4 + 1 + 4 + 4)
+
+struct sftp_handle {
+	int fd;                         /* open file, or -1  */
+	DIR *dir;                       /* open directory    */
+	char path[SFTP_PATH_MAX];       /* VFS path of a directory */
+};
+
+struct esp_sftp {
+	struct Channel *channel;
+	circbuffer *in;                 /* client bytes not dealt with yet */
+	int initialised;
+	int failed;
+	/* WRITE whose data is still arriving */
+	uint32_t write_left;
+	uint32_t write_id;
+	int write_fd;
+	int write_status;
+	/* DATA reply being sent */
+	uint32_t read_left;
+	int read_fd;
+	struct sftp_handle handles[SFTP_HANDLES];
+	unsigned char req[SFTP_REQ_MAX];
+	unsigned char chunk[SFTP_CHUNK];
+};
+
+/* Bounds-checked reader over one request. */
+struct sftp_reader {
+	const unsigned char *p;
+	unsigned int left;
+	int bad;
+};
+
+static char sftp_root[SFTP_ROOT_MAX];
+static unsigned long stat_read, stat_written;
+
+esp_err_t esp_sftp_set_root(const char *vfs_path)
+{
+	size_t len = strlen(vfs_path);
+
+	/* "/" would make every client path start with "//" */
+	while (len > 0 && vfs_path[len - 1] == '/') {
+		len--;
+	}
+	if (len >= sizeof(sftp_root)) {
+		return ESP_ERR_INVALID_ARG;
+	}
+	memcpy(sftp_root, vfs_path, len);
+	sftp_root[len] = '\0';
+	if (len == 0) {
+		strcpy(sftp_root, "/");
+	}
+	return ESP_OK;
+}
+
+void esp_sftp_get_stats(unsigned long *bytes_read, unsigned long *bytes_written)
+{
+	*bytes_read = stat_read;
+	*bytes_written = stat_written;
+}
+
+/* ------------------------------------------------------------------ */
+/*  Encoding                                                          */
+/* ------------------------------------------------------------------ */
+
+static void put32(unsigned char *p, uint32_t v)
+{
+	p[0] = (unsigned char)(v >> 24);
+	p[1] = (unsigned char)(v >> 16);
+	p[2] = (unsigned char)(v >> 8);
+	p[3] = (unsigned char)v;
+}
+
+static uint32_t get32(const unsigned char *p)
+{
+	return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16)
+		| ((uint32_t)p[2] << 8) | p[3];
+}
+
+static uint32_t rd_u32(struct sftp_reader *r)
+{
+	uint32_t v;
+
+	if (r->left < 4) {
+		r->bad = 1;
+		return 0;
+	}
+	v = get32(r->p);
+	r->p += 4;
+	r->left -= 4;
+	return v;
+}
+
+static uint64_t rd_u64(struct sftp_reader *r)
+{
+	uint64_t hi = rd_u32(r);
+
+	return (hi << 32) | rd_u32(r);
+}
+
+/* String contents (not terminated) and length, or NULL. */
+static const unsigned char *rd_str(struct sftp_reader *r, uint32_t *len)
+{
+	const unsigned char *s;
+
+	*len = rd_u32(r);
+	if (r->bad || *len > r->left) {
+		r->bad = 1;
+		return NULL;
+	}
+	s = r->p;
+	r->p += *len;
+	r->left -= *len;
+	return s;
+}
+
+/* Reply being built in sftp->chunk; the length field is filled in by reply_send(). */
+struct sftp_reply {
+	unsigned char *buf;
+	unsigned int len;
+	unsigned int size;
+	int overflow;
+};
+
+static void reply_begin(struct esp_sftp *sftp, struct sftp_reply *out, int type, uint32_t id)
+{
+	out->buf = sftp->chunk;
+	out->size = sizeof(sftp->chunk);
+	out->overflow = 0;
+	out->buf[4] = (unsigned char)type;
+	put32(out->buf + 5, id);
+	out->len = 9;
+}
+
+static void reply_u32(struct sftp_reply *out, uint32_t v)
+{
+	if (out->len + 4 > out->size) {
+		out->overflow = 1;
+		return;
+	}
+	put32(out->buf + out->len, v);
+	out->len += 4;
+}
+
+static void reply_u64(struct sftp_reply *out, uint64_t v)
+{
+	reply_u32(out, (uint32_t)(v >> 32));
+	reply_u32(out, (uint32_t)v);
+}
+
+static void reply_str(struct sftp_reply *out, const void *s, unsigned int len)
+{
+	if (out->len + 4 + len > out->size) {
+		out->overflow = 1;
+		return;
+	}
+	put32(out->buf + out->len, len);
+	memcpy(out->buf + out->len + 4, s, len);
+	out->len += 4 + len;
+}
+
+static void reply_attrs(struct sftp_reply *out, const struct stat *st)
+{
+	reply_u32(out, SSH_FILEXFER_ATTR_SIZE | SSH_FILEXFER_ATTR_PERMISSIONS
+		| SSH_FILEXFER_ATTR_ACMODTIME);
+	reply_u64(out, (uint64_t)st->st_size);
+	reply_u32(out, (uint32_t)st->st_mode);
+	reply_u32(out, (uint32_t)st->st_atime);
+	reply_u32(out, (uint32_t)st->st_mtime);
+}
+
+static void reply_send(struct esp_sftp *sftp, struct sftp_reply *out)
+{
+	put32(out->buf, out->len - 4);
+	chan_inproc_send(sftp->channel, out->buf, out->len);
+}
+
+static void send_status(struct esp_sftp *sftp, uint32_t id, uint32_t code)
+{
+	static const char *const messages[] = {
+		"Success", "End of file", "No such file", "Permission denied",
+		"Failure", "Bad message", "No connection", "Connection lost",
+		"Operation unsupported"
+	};
+	struct sftp_reply out;
+
+	reply_begin(sftp, &out, SSH_FXP_STATUS, id);
+	reply_u32(&out, code);
+	reply_str(&out, messages[code], strlen(messages[code]));
+	reply_str(&out, "", 0);
+	reply_send(sftp, &out);
+}
+
+static uint32_t errno_status(int err)
+{
+	switch (err) {
+	case ENOENT:
+	case ENOTDIR:
+		return SSH_FX_NO_SUCH_FILE;
+	case EACCES:
+	case EPERM:
+	case EROFS:
+		return SSH_FX_PERMISSION_DENIED;
+	case ENOSYS:
+	case ENOTSUP:
+		return SSH_FX_OP_UNSUPPORTED;
+	default:
+		return SSH_FX_FAILURE;
+	}
+}
+
+/* ------------------------------------------------------------------ */
+/*  Paths and handles                                                 */
+/* ------------------------------------------------------------------ */
+
+/*
+ * Resolve a client path: "." and ".." are applied, relative paths start at
+ * "/", and nothing climbs above "/". `client` gets the result as the client
+ * sees it, `vfs` the same path below the root. Returns 0 if too long.
+ */
+static int resolve_path(const unsigned char *s, uint32_t len,
+	char *client, char *vfs)
+{
+	size_t clen = 0, rlen;
+	uint32_t i = 0;
+
+	while (i < len) {
+		uint32_t start, n;
+
+		while (i < len && s[i] == '/') i++;
+		start = i;
+		while (i < len && s[i] != '/') i++;
+		n = i - start;
+
+		if (n == 0 || (n == 1 && s[start] == '.')) {
+			continue;
+		}
+		if (n == 2 && s[start] == '.' && s[start + 1] == '.') {
+			while (clen > 0 && client[--clen] != '/')
+				;
+			continue;
+		}
+		if (clen + 1 + n >= SFTP_PATH_MAX || memchr(s + start, '\0', n) != NULL) {
+			return 0;
+		}
+		client[clen] = '/';
+		memcpy(client + clen + 1, s + start, n);
+		clen += 1 + n;
+	}
+	if (clen == 0) {
+		client[clen++] = '/';
+	}
+	client[clen] = '\0';
+
+	rlen = strcmp(sftp_root, "/") == 0 ? 0 : strlen(sftp_root);
+	if (rlen + clen >= SFTP_PATH_MAX) {
+		return 0;
+	}
+	memcpy(vfs, sftp_root, rlen);
+	/* the root itself keeps no trailing slash, unless it is "/" */
+	if (rlen > 0 && clen == 1) {
+		vfs[rlen] = '\0';
+	} else {
+		memcpy(vfs + rlen, client, clen + 1);
+	}
+	return 1;
+}
+
+/* Next path argument of the request as a VFS path. */
+static int rd_path(struct sftp_reader *r, char *vfs)
+{
+	char client[SFTP_PATH_MAX];
+	const unsigned char *s;
+	uint32_t len;
+
+	s = rd_str(r, &len);
+	return s != NULL && resolve_path(s, len, client, vfs);
+}
+
+static struct sftp_handle *rd_handle(struct esp_sftp *sftp, struct sftp_reader *r)
+{
+	const unsigned char *s;
+	uint32_t len, idx;
+
+	s = rd_str(r, &len);
+	if (s == NULL || len != 4) {
+		return NULL;
+	}
+	idx = get32(s);
+	if (idx >= SFTP_HANDLES
+			|| (sftp->handles[idx].fd < 0 && sftp->handles[idx].dir == NULL)) {
+		return NULL;
+	}
+	return &sftp->handles[idx];
+}
+
+static struct sftp_handle *handle_alloc(struct esp_sftp *sftp)
+{
+	int i;
+
+	for (i = 0; i < SFTP_HANDLES; i++) {
+		if (sftp->handles[i].fd < 0 && sftp->handles[i].dir == NULL) {
+			return &sftp->handles[i];
+		}
+	}
+	return NULL;
+}
+
+static void handle_close(struct sftp_handle *h)
+{
+	if (h->fd >= 0) {
+		close(h->fd);
+		h->fd = -1;
+	}
+	if (h->dir != NULL) {
+		closedir(h->dir);
+		h->dir = NULL;
+	}
+}
+
+static void send_handle(struct esp_sftp *sftp, uint32_t id, const struct sftp_handle *h)
+{
+	struct sftp_reply out;
+	unsigned char idx[4];
+
+	put32(idx, (uint32_t)(h - sftp->handles));
+	reply_begin(sftp, &out, SSH_FXP_HANDLE, id);
+	reply_str(&out, idx, sizeof(idx));
+	reply_send(sftp, &out);
+}
+
+/* "ls -l" style line for READDIR. */
+static int long_name(char *buf, size_t size, const char *name, const struct stat *st)
+{
+	char mode[11], date[16];
+	struct tm tm;
+	time_t mtime = st->st_mtime;
+
+	mode[0] = S_ISDIR(st->st_mode) ? 'd' : '-';
+	mode[1] = (st->st_mode & S_IRUSR) ? 'r' : '-';
+	mode[2] = (st->st_mode & S_IWUSR) ? 'w' : '-';
+	mode[3] = (st->st_mode & S_IXUSR) ? 'x' : '-';
+	mode[4] = (st->st_mode & S_IRGRP) ? 'r' : '-';
+	mode[5] = (st->st_mode & S_IWGRP) ? 'w' : '-';
+	mode[6] = (st->st_mode & S_IXGRP) ? 'x' : '-';
+	mode[7] = (st->st_mode & S_IROTH) ? 'r' : '-';
+	mode[8] = (st->st_mode & S_IWOTH) ? 'w' : '-';
+	mode[9] = (st->st_mode & S_IXOTH) ? 'x' : '-';
+	mode[10] = '\0';
+	gmtime_r(&mtime, &tm);
+	strftime(date, sizeof(date), "%b %e %H:%M", &tm);
+
+	return snprintf(buf, size, "%s    1 0        0        %8llu %s %s",
+		mode, (unsigned long long)st->st_size, date, name);
+}
+
+/* ------------------------------------------------------------------ */
+/*  Requests                                                          */
+/* ------------------------------------------------------------------ */
+
+/* Input bytes up to `len` are done with: drop them and hand the window back. */
+static void in_consume(struct esp_sftp *sftp, unsigned int len)
+{
+	cbuf_incrread(sftp->in, len);
+	chan_inproc_consumed(sftp->channel, len);
+}
+
+/* Copy `len` queued bytes starting `off` bytes in, across the wrap. */
+static void in_peek(const struct esp_sftp *sftp, unsigned int off,
+	unsigned char *dst, unsigned int len)
+{
+	unsigned char *p1, *p2;
+	unsigned int len1, len2, n;
+
+	cbuf_readptrs(sftp->in, &p1, &len1, &p2, &len2);
+	if (off < len1) {
+		n = MIN(len, len1 - off);
+		memcpy(dst, p1 + off, n);
+		dst += n;
+		len -= n;
+		off = 0;
+	} else {
+		off -= len1;
+	}
+	if (len > 0) {
+		memcpy(dst, p2 + off, len);
+	}
+}
+
+static void do_open(struct esp_sftp *sftp, uint32_t id, struct sftp_reader *r)
+{
+	char path[SFTP_PATH_MAX];
+	struct sftp_handle *h;
+	uint32_t pflags;
+	int flags;
+
+	if (!rd_path(r, path)) {
+		send_status(sftp, id, SSH_FX_BAD_MESSAGE);
+		return;
+	}
+	pflags = rd_u32(r);
+	h = handle_alloc(sftp);
+	if (h == NULL) {
+		send_status(sftp, id, SSH_FX_FAILURE);
+		return;
+	}
+
+	if ((pflags & SSH_FXF_READ) && (pflags & SSH_FXF_WRITE)) {
+		flags = O_RDWR;
+	} else if (pflags & SSH_FXF_WRITE) {
+		flags = O_WRONLY;
+	} else {
+		flags = O_RDONLY;
+	}
+	if (pflags & SSH_FXF_APPEND) flags |= O_APPEND;
+	if (pflags & SSH_FXF_CREAT)  flags |= O_CREAT;
+	if (pflags & SSH_FXF_TRUNC)  flags |= O_TRUNC;
+	if (pflags & SSH_FXF_EXCL)   flags |= O_EXCL;
+
+	h->fd = open(path, flags, 0644);
+	if (h->fd < 0) {
+		send_status(sftp, id, errno_status(errno));
+		return;
+	}
+	send_handle(sftp, id, h);
+}
+
+static void do_opendir(struct esp_sftp *sftp, uint32_t id, struct sftp_reader *r)
+{
+	char path[SFTP_PATH_MAX];
+	struct sftp_handle *h;
+
+	if (!rd_path(r, path)) {
+		send_status(sftp, id, SSH_FX_BAD_MESSAGE);
+		return;
+	}
+	h = handle_alloc(sftp);
+	if (h == NULL) {
+		send_status(sftp, id, SSH_FX_FAILURE);
+		return;
+	}
+	h->dir = opendir(path);
+	if (h->dir == NULL) {
+		send_status(sftp, id, errno_status(errno));
+		return;
+	}
+	strcpy(h->path, path);
+	send_handle(sftp, id, h);
+}
+
+/* As many entries as fit one reply; an entry that does not fit is read again next time. */
+static void do_readdir(struct esp_sftp *sftp, uint32_t id, struct sftp_handle *h)
+{
+	char path[SFTP_PATH_MAX], line[SFTP_PATH_MAX + 64];
+	struct sftp_reply out;
+	struct dirent *de;
+	struct stat st;
+	uint32_t count = 0;
+	unsigned int count_pos;
+
+	reply_begin(sftp, &out, SSH_FXP_NAME, id);
+	count_pos = out.len;
+	reply_u32(&out, 0);
+
+	for (;;) {
+		long pos = telldir(h->dir);
+		unsigned int mark = out.len;
+		int n;
+
+		de = readdir(h->dir);
+		if (de == NULL) {
+			break;
+		}
+		n = snprintf(path, sizeof(path), "%s/%s", h->path, de->d_name);
+		if (n < 0 || n >= (int)sizeof(path) || stat(path, &st) != 0) {
+			memset(&st, 0, sizeof(st));
+		}
+		n = long_name(line, sizeof(line), de->d_name, &st);
+		reply_str(&out, de->d_name, strlen(de->d_name));
+		reply_str(&out, line, MIN((unsigned int)n, sizeof(line) - 1));
+		reply_attrs(&out, &st);
+		if (out.overflow) {
+			out.len = mark;
+			seekdir(h->dir, pos);
+			break;
+		}
+		count++;
+	}
+
+	if (count == 0) {
+		send_status(sftp, id, SSH_FX_EOF);
+		return;
+	}
+	put32(out.buf + count_pos, count);
+	reply_send(sftp, &out);
+}
+
+static void do_stat(struct esp_sftp *sftp, uint32_t id, struct sftp_reader *r)
+{
+	char path[SFTP_PATH_MAX];
+	struct sftp_reply out;
+	struct stat st;
+
+	if (!rd_path(r, path)) {
+		send_status(sftp, id, SSH_FX_BAD_MESSAGE);
+		return;
+	}
+	if (stat(path, &st) != 0) {
+		send_status(sftp, id, errno_status(errno));
+		return;
+	}
+	reply_begin(sftp, &out, SSH_FXP_ATTRS, id);
+	reply_attrs(&out, &st);
+	reply_send(sftp, &out);
+}
+
+static void do_fstat(struct esp_sftp *sftp, uint32_t id, struct sftp_handle *h)
+{
+	struct sftp_reply out;
+	struct stat st;
+	int ret;
+
+	ret = h->fd >= 0 ? fstat(h->fd, &st) : stat(h->path, &st);
+	if (ret != 0) {
+		send_status(sftp, id, errno_status(errno));
+		return;
+	}
+	reply_begin(sftp, &out, SSH_FXP_ATTRS, id);
+	reply_attrs(&out, &st);
+	reply_send(sftp, &out);
+}
+
+/* Only a size change is applied; owners, modes and times are accepted and ignored. */
+static void do_setstat(struct esp_sftp *sftp, uint32_t id, struct sftp_reader *r,
+	const char *path, int fd)
+{
+	uint32_t flags = rd_u32(r);
+	int ret = 0;
+
+	if (flags & SSH_FILEXFER_ATTR_SIZE) {
+		off_t size = (off_t)rd_u64(r);
+
+		if (r->bad) {
+			send_status(sftp, id, SSH_FX_BAD_MESSAGE);
+			return;
+		}
+		ret = fd >= 0 ? ftruncate(fd, size) : truncate(path, size);
+	}
+	send_status(sftp, id, ret == 0 ? SSH_FX_OK : errno_status(errno));
+}
+
+static void do_realpath(struct esp_sftp *sftp, uint32_t id, struct sftp_reader *r)
+{
+	char client[SFTP_PATH_MAX], vfs[SFTP_PATH_MAX];
+	struct sftp_reply out;
+	const unsigned char *s;
+	uint32_t len;
+
+	s = rd_str(r, &len);
+	if (s == NULL || !resolve_path(s, len, client, vfs)) {
+		send_status(sftp, id, SSH_FX_BAD_MESSAGE);
+		return;
+	}
+	reply_begin(sftp, &out, SSH_FXP_NAME, id);
+	reply_u32(&out, 1);
+	reply_str(&out, client, strlen(client));
+	reply_str(&out, client, strlen(client));
+	reply_u32(&out, 0);
+	reply_send(sftp, &out);
+}
+
+/* First chunk of a DATA reply; the rest goes out from read_more(). */
+static void do_read(struct esp_sftp *sftp, uint32_t id, struct sftp_handle *h,
+	uint64_t offset, uint32_t len)
+{
+	unsigned char *data = sftp->chunk + SFTP_DATA_HDR;
+	uint32_t total = MIN(len, SFTP_READ_MAX);
+	struct stat st;
+	ssize_t n;
+
+	if (h->fd < 0) {
+		send_status(sftp, id, SSH_FX_FAILURE);
+		return;
+	}
+	if (lseek(h->fd, (off_t)offset, SEEK_SET) < 0) {
+		send_status(sftp, id, errno_status(errno));
+		return;
+	}
+	n = read(h->fd, data, MIN(total, sizeof(sftp->chunk) - SFTP_DATA_HDR));
+	if (n < 0) {
+		send_status(sftp, id, errno_status(errno));
+		return;
+	}
+	if (n == 0) {
+		send_status(sftp, id, SSH_FX_EOF);
+		return;
+	}
+
+	/* the reply length goes first: announce what the file holds from here */
+	if (fstat(h->fd, &st) == 0 && S_ISREG(st.st_mode)) {
+		uint64_t avail = (uint64_t)st.st_size > offset ? (uint64_t)st.st_size - offset : 0;
+
+		total = (uint32_t)MIN((uint64_t)total, MAX(avail, (uint64_t)n));
+	} else {
+		total = (uint32_t)n;
+	}
+
+	put32(sftp->chunk, 1 + 4 + 4 + total);
+	sftp->chunk[4] = SSH_FXP_DATA;
+	put32(sftp->chunk + 5, id);
+	put32(sftp->chunk + 9, total);
+	chan_inproc_send(sftp->channel, sftp->chunk, SFTP_DATA_HDR + (unsigned int)n);
+	stat_read += (unsigned long)n;
+
+	sftp->read_left = total - (uint32_t)n;
+	sftp->read_fd = h->fd;
+}
+
+/* Rest of the DATA reply, while the channel has room. Returns 0 if it has to wait. */
+static int read_more(struct esp_sftp *sftp, unsigned int *budget)
+{
+	while (sftp->read_left > 0) {
+		unsigned int want = MIN(sftp->read_left, sizeof(sftp->chunk));
+		ssize_t n;
+
+		if (*budget == 0 || chan_inproc_room(sftp->channel) < want) {
+			return 0;
+		}
+		n = read(sftp->read_fd, sftp->chunk, want);
+		if (n <= 0) {
+			/* the file shrank after the length was sent: pad */
+			memset(sftp->chunk, 0, want);
+			n = (ssize_t)want;
+		}
+		chan_inproc_send(sftp->channel, sftp->chunk, (unsigned int)n);
+		stat_read += (unsigned long)n;
+		sftp->read_left -= (uint32_t)n;
+		*budget -= MIN(*budget, (unsigned int)n);
+	}
+	return 1;
+}
+
+/* WRITE data from the queue into the file. Returns 0 if more has to arrive. */
+static int write_more(struct esp_sftp *sftp)
+{
+	unsigned char *p1, *p2;
+	unsigned int len1, len2, n;
+
+	while (sftp->write_left > 0) {
+		cbuf_readptrs(sftp->in, &p1, &len1, &p2, &len2);
+		n = MIN(sftp->write_left, len1);
+		if (n == 0) {
+			return 0;
+		}
+		if (sftp->write_status == SSH_FX_OK) {
+			ssize_t w = write(sftp->write_fd, p1, n);
+
+			if (w != (ssize_t)n) {
+				sftp->write_status = w < 0 ? errno_status(errno) : SSH_FX_FAILURE;
+			} else {
+				stat_written += n;
+			}
+		}
+		in_consume(sftp, n);
+		sftp->write_left -= n;
+	}
+	send_status(sftp, sftp->write_id, sftp->write_status);
+	return 1;
+}
+
+/* WRITE header is queued: check it and start taking the data. */
+static void start_write(struct esp_sftp *sftp, uint32_t pktlen)
+{
+	unsigned char hdr[SFTP_WRITE_HDR];
+	struct sftp_reader r;
+	struct sftp_handle *h;
+	uint64_t offset;
+	uint32_t datalen;
+
+	in_peek(sftp, 0, hdr, sizeof(hdr));
+	r.p = hdr + 5;
+	r.left = sizeof(hdr) - 5;
+	r.bad = 0;
+	sftp->write_id = rd_u32(&r);
+	h = rd_handle(sftp, &r);
+	offset = rd_u64(&r);
+	datalen = rd_u32(&r);
+	in_consume(sftp, sizeof(hdr));
+
+	/* whatever the header says, the rest of the packet is the data */
+	sftp->write_left = pktlen - (SFTP_WRITE_HDR - 4);
+	sftp->write_status = SSH_FX_OK;
+	if (datalen != sftp->write_left) {
+		sftp->write_status = SSH_FX_BAD_MESSAGE;
+	} else if (h == NULL || h->fd < 0) {
+		sftp->write_status = SSH_FX_FAILURE;
+	} else if (lseek(h->fd, (off_t)offset, SEEK_SET) < 0) {
+		sftp->write_status = errno_status(errno);
+	} else {
+		sftp->write_fd = h->fd;
+	}
+}
+
+static void handle_request(struct esp_sftp *sftp, unsigned char *req, uint32_t len)
+{
+	struct sftp_reader r = { req + 1, len - 1, 0 };
+	struct sftp_handle *h;
+	char path[SFTP_PATH_MAX], path2[SFTP_PATH_MAX];
+	uint32_t id;
+	int ret;
+
+	if (req[0] == SSH_FXP_INIT) {
+		struct sftp_reply out;
+
+		/* VERSION has no request id: the 3 takes its place */
+		reply_begin(sftp, &out, SSH_FXP_VERSION, 3);
+		reply_send(sftp, &out);
+		sftp->initialised = 1;
+		return;
+	}
+
+	id = rd_u32(&r);
+	if (!sftp->initialised) {
+		send_status(sftp, id, SSH_FX_FAILURE);
+		return;
+	}
+
+	switch (req[0]) {
+	case SSH_FXP_OPEN:
+		do_open(sftp, id, &r);
+		return;
+	case SSH_FXP_OPENDIR:
+		do_opendir(sftp, id, &r);
+		return;
+	case SSH_FXP_REALPATH:
+		do_realpath(sftp, id, &r);
+		return;
+	case SSH_FXP_STAT:
+	case SSH_FXP_LSTAT:
+		do_stat(sftp, id, &r);
+		return;
+
+	case SSH_FXP_CLOSE:
+	case SSH_FXP_READ:
+	case SSH_FXP_READDIR:
+	case SSH_FXP_FSTAT:
+	case SSH_FXP_FSETSTAT:
+		h = rd_handle(sftp, &r);
+		if (h == NULL) {
+			send_status(sftp, id, SSH_FX_FAILURE);
+			return;
+		}
+		if (req[0] == SSH_FXP_CLOSE) {
+			handle_close(h);
+			send_status(sftp, id, SSH_FX_OK);
+		} else if (req[0] == SSH_FXP_READ) {
+			uint64_t offset = rd_u64(&r);
+			uint32_t n = rd_u32(&r);
+
+			if (r.bad) {
+				send_status(sftp, id, SSH_FX_BAD_MESSAGE);
+			} else {
+				do_read(sftp, id, h, offset, n);
+			}
+		} else if (req[0] == SSH_FXP_READDIR) {
+			if (h->dir == NULL) {
+				send_status(sftp, id, SSH_FX_FAILURE);
+			} else {
+				do_readdir(sftp, id, h);
+			}
+		} else if (req[0] == SSH_FXP_FSTAT) {
+			do_fstat(sftp, id, h);
+		} else {
+			do_setstat(sftp, id, &r, h->path, h->fd);
+		}
+		return;
+
+	case SSH_FXP_SETSTAT:
+	case SSH_FXP_REMOVE:
+	case SSH_FXP_MKDIR:
+	case SSH_FXP_RMDIR:
+		if (!rd_path(&r, path)) {
+			send_status(sftp, id, SSH_FX_BAD_MESSAGE);
+			return;
+		}
+		if (req[0] == SSH_FXP_SETSTAT) {
+			do_setstat(sftp, id, &r, path, -1);
+			return;
+		}
+		if (req[0] == SSH_FXP_REMOVE) {
+			ret = unlink(path);
+		} else if (req[0] == SSH_FXP_MKDIR) {
+			ret = mkdir(path, 0755);
+		} else {
+			ret = rmdir(path);
+		}
+		send_status(sftp, id, ret == 0 ? SSH_FX_OK : errno_status(errno));
+		return;
+
+	case SSH_FXP_RENAME:
+		if (!rd_path(&r, path) || !rd_path(&r, path2)) {
+			send_status(sftp, id, SSH_FX_BAD_MESSAGE);
+			return;
+		}
+		ret = rename(path, path2);
+		send_status(sftp, id, ret == 0 ? SSH_FX_OK : errno_status(errno));
+		return;
+
+	default:
+		/* READLINK, SYMLINK, EXTENDED */
+		send_status(sftp, id, SSH_FX_OP_UNSUPPORTED);
+		return;
+	}
+}
+
+/* Work through the queue until it is empty or a reply has to wait for room. */
+static void sftp_process(struct esp_sftp *sftp)
+{
+	unsigned int budget = SFTP_POLL_BUDGET;
+	unsigned char hdr[9];
+	uint32_t pktlen;
+
+	while (!sftp->failed) {
+		if (sftp->read_left > 0 && !read_more(sftp, &budget)) {
+			return;
+		}
+		if (sftp->write_left > 0 && !write_more(sftp)) {
+			return;
+		}
+
+		/* any request may need a full reply buffer */
+		if (chan_inproc_room(sftp->channel) < SFTP_CHUNK
+				|| cbuf_getused(sftp->in) < sizeof(hdr)) {
+			return;
+		}
+		in_peek(sftp, 0, hdr, sizeof(hdr));
+		pktlen = get32(hdr);
+
+		if (hdr[4] == SSH_FXP_WRITE) {
+			if (pktlen < SFTP_WRITE_HDR - 4) {
+				sftp->failed = 1;
+				return;
+			}
+			if (cbuf_getused(sftp->in) < SFTP_WRITE_HDR) {
+				return;
+			}
+			start_write(sftp, pktlen);
+			continue;
+		}
+
+		/* every request has a type and an id (INIT: version) */
+		if (pktlen < 5 || pktlen > SFTP_REQ_MAX - 4) {
+			dropbear_log(LOG_WARNING, "SFTP: bad request length %u",
+				(unsigned int)pktlen);
+			sftp->failed = 1;
+			return;
+		}
+		if (cbuf_getused(sftp->in) < pktlen + 4) {
+			return;
+		}
+		in_peek(sftp, 4, sftp->req, pktlen);
+		in_consume(sftp, pktlen + 4);
+		handle_request(sftp, sftp->req, pktlen);
+	}
+}
+
+/* ------------------------------------------------------------------ */
+/*  Channel interface                                                 */
+/* ------------------------------------------------------------------ */
+
+struct esp_sftp *esp_sftp_new(struct Channel *channel)
+{
+	struct esp_sftp *sftp;
+	int i;
+
+	if (sftp_root[0] == '\0') {
+		dropbear_log(LOG_WARNING, "SFTP: no root set (esp_sftp_set_root)");
+		return NULL;
+	}
+
+	sftp = (struct esp_sftp *)m_malloc(sizeof(*sftp));
+	memset(sftp, 0, sizeof(*sftp));
+	sftp->channel = channel;
+	/*
+	 * The client may send its whole window before any of it is answered,
+	 * and the window never grows past what it is now (chan_inproc_attach()).
+	 */
+	sftp->in = cbuf_new(MAX(channel->recvwindow, SFTP_REQ_MAX));
+	sftp->write_fd = -1;
+	sftp->read_fd = -1;
+	for (i = 0; i < SFTP_HANDLES; i++) {
+		sftp->handles[i].fd = -1;
+	}
+	return sftp;
+}
+
+void esp_sftp_free(struct esp_sftp *sftp)
+{
+	int i;
+
+	if (sftp == NULL) return;
+	for (i = 0; i < SFTP_HANDLES; i++) {
+		handle_close(&sftp->handles[i]);
+	}
+	cbuf_free(sftp->in);
+	m_free(sftp);
+}
+
+void esp_sftp_recv(struct esp_sftp *sftp, const unsigned char *data, unsigned int len)
+{
+	while (len > 0 && !sftp->failed) {
+		unsigned int n = MIN(len, cbuf_writelen(sftp->in));
+
+		if (n == 0) {
+			/* the client sent more than its window */
+			dropbear_log(LOG_WARNING, "SFTP: request queue full");
+			sftp->failed = 1;
+			return;
+		}
+		memcpy(cbuf_writeptr(sftp->in, n), data, n);
+		cbuf_incrwrite(sftp->in, n);
+		data += n;
+		len -= n;
+		sftp_process(sftp);
+	}
+}
+
+int esp_sftp_poll(struct esp_sftp *sftp)
+{
+	sftp_process(sftp);
+	if (sftp->failed) {
+		return 1;
+	}
+	/* client is done and every request has been answered */
+	return sftp->channel->recv_eof && sftp->read_left == 0 && sftp->write_left == 0
+		&& cbuf_getused(sftp->in) == 0;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+/*
+ * esp_sftp - SFTP (version 3) server for the "sftp" subsystem.
+ *
+ * Runs in the session task as an in-process channel endpoint (see
+ * port/chan_inproc.h); there is no sftp-server process. Files are served
+ * through the VFS, so anything mounted there (SPIFFS, FAT, LittleFS, or
+ * host directories on the Linux target) can be transferred. Client paths
+ * are resolved below the root set with esp_sftp_set_root(); ".." never
+ * leaves it.
+ *
+ * File data moves in SFTP_CHUNK pieces in both directions and whole files
+ * are never held in memory. Requests are queued and answered in order, so
+ * a client may keep many reads outstanding.
+ */
+
+#include "includes.h"
+#include "channel.h"
+#include "esp_err.h"
+
+struct esp_sftp;
+
+/*
+ * Serve files below `vfs_path` (e.g. "/spiffs"). Until this is called the
+ * "sftp" subsystem is refused. The string is copied. ESP_ERR_INVALID_ARG if
+ * it is longer than 63 characters; the root is then left as it was.
+ */
+esp_err_t esp_sftp_set_root(const char *vfs_path);
+
+/* State for one "sftp" subsystem channel, or NULL (no root set). */
+struct esp_sftp *esp_sftp_new(struct Channel *channel);
+void esp_sftp_free(struct esp_sftp *sftp);
+
+/* Client data, from the channel's chan_inproc recv() callback (defer_window). */
+void esp_sftp_recv(struct esp_sftp *sftp, const unsigned char *data, unsigned int len);
+
+/*
+ * Continue queued requests and replies. Call once per loop iteration.
+ * Returns nonzero once the channel should be closed: the client sent EOF and
+ * everything has been answered, or the request stream was malformed.
+ */
+int esp_sftp_poll(struct esp_sftp *sftp);
+
+/* File bytes sent to and received from SFTP clients since boot. */
+void esp_sftp_get_stats(unsigned long *bytes_read, unsigned long *bytes_written);
@@ -3,9 +3,27 @@
  *
  * Instead of fork()+exec() a real shell, this provides a simple interactive
  * command loop over the SSH channel (similar to the libssh example).
- * Runs in the main task context (no separate FreeRTOS task).
+ * Runs in the session task. The channel is an in-process endpoint (see
+ * port/chan_inproc.h): client input arrives straight from the decrypted
+ * packet and output goes straight into SSH_MSG_CHANNEL_DATA packets.
  *
- * Supported commands: help, hello, uptime, heap, reset, exit
+ * Built-in commands: help, hello, uptime, heap, stats, reset, update, exit.
+ * More can be added with shell_cmd_register() (see shell_cmd.h); commands
+ * registered with esp_console are imported as SHELL_CMD_ASYNC, and other
+ * lines naming no registered command go to esp_console_run(). Those, and
+ * SHELL_CMD_ASYNC commands, run on a worker task so that the session task
+ * is never blocked by them.
+ *
+ * An "exec" request runs its command once, with no banner or prompt, and
+ * closes the channel with the command's exit-status. SHELL_CMD_STDIN
+ * commands also get the client's data (see shell_read()). The "sftp"
+ * subsystem is served in-process by esp_sftp.c.
+ *
+ * Every session channel has its own EspShellSess, so a client may run up to
+ * CONFIG_DROPBEAR_MAX_SESSION_CHANNELS shells and exec commands side by side
+ * over one connection (e.g. OpenSSH ControlMaster). Dropbear visits each
+ * channel once per loop iteration; each visit sends at most a bounded amount
+ * of a channel's output, so a chatty command cannot hold up the others.
  *
  * Overrides the weak stubs in idf_stubs.c for:
  *   svrchansess, svr_chansessinitialise, svr_chansess_checksignal
@@ -16,58 +34,237 @@
 #include "channel.h"
 #include "chansession.h"
 #include "dbutil.h"
+#include "buffer.h"
+#include "packet.h"
+#include "ssh.h"
+#include "chan_inproc.h"
+#include "esp_sftp.h"
+#include "esp_update.h"
+#include "fwd_inproc.h"
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/stream_buffer.h"
 #include "esp_system.h"
 #include "esp_log.h"
+#include "esp_vfs_eventfd.h"
 #include "mem_stats.h"
 
+#include "shell_cmd.h"
+
+#include <sys/socket.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+
 #if ENABLE_MEMORY_STATS
 #include "esp_heap_caps.h"
 #include <inttypes.h>
 #include <stdlib.h>
+#if CONFIG_DROPBEAR_SESSION_ARENA
+#include "dbmalloc_arena.h"
+#endif
+#if CONFIG_DROPBEAR_HMAC_CACHE
+#include "hmac_cache.h"
+#endif
+#if CONFIG_DROPBEAR_GCM_GHASH_TABLE
+#include "ghash_table.h"
+#endif
+#if CONFIG_DROPBEAR_KEX_PREGEN
+#include "kex_pregen.h"
+#endif
+#include "writev_lwip.h"
+#if CONFIG_DROPBEAR_NETCONN_NOCOPY
+#include "netconn_lwip.h"
+#endif
+#include "session_pool.h"
+#include "admission.h"
 #endif
 
-#include <sys/socket.h>
-#include <sys/select.h>
-#include <fcntl.h>
-#include <errno.h>
+/*
+ * Shell output is collected in EspShellSess.out and handed to the channel
+ * in one piece, so an echoed character, the command's output and the next
+ * prompt share one SSH packet. The buffer is flushed once the input that
+ * produced it has been handled. If more client data is already waiting on
+ * the socket (a paste), it is held for up to SHELL_FLUSH_HOLD_MS more so the
+ * following echo joins it.
+ */
+#define SHELL_OUT_SIZE       512
+#define SHELL_FLUSH_HOLD_MS  20
+
+/*
+ * Commands flagged SHELL_CMD_ASYNC, and lines passed on to esp_console, run
+ * on a worker task. The session task meanwhile keeps serving the connection
+ * (keepalives, window adjusts, rekeying). The worker's output goes through
+ * a bounded stream buffer. The session task only moves it to the channel
+ * once the channel has sent what it had, so a slow client stalls the worker
+ * instead of filling memory. An eventfd in the session's select() set wakes
+ * the session task when output arrives or the command ends. Ctrl-C cancels:
+ * the rest of the output is dropped, the prompt comes back, and the worker
+ * frees the job once the handler returns.
+ */
+#define SHELL_JOB_STACK_SIZE 4096
+#define SHELL_JOB_PRIORITY   (tskIDLE_PRIORITY + 2)
+#define SHELL_JOB_QUEUE_SIZE 1024
+#define SHELL_JOB_WAIT_MS    100
+/*
+ * One eventfd per job: every session channel may run one, and a cancelled
+ * job keeps its eventfd until its handler returns. Past that a command is
+ * refused rather than run on the session task.
+ */
+#define SHELL_JOB_MAX_FDS    (CONFIG_DROPBEAR_MAX_SESSIONS * CONFIG_DROPBEAR_MAX_SESSION_CHANNELS \
+                              + CONFIG_DROPBEAR_MAX_SESSIONS)
+
+/*
+ * An exec'd SHELL_CMD_STDIN command reads the client's data through another
+ * stream buffer. Session channels open with a window no larger than it, and
+ * the window is handed back only as the worker reads, so the client sends
+ * as fast as the command takes the data and the buffer never overflows.
+ * shell_stdin_recv() runs under the session pool lock and never waits.
+ */
+#define SHELL_JOB_STDIN_SIZE 8192
+/* Worker output moved to the channel per loop iteration (fairness between channels). */
+#define SHELL_JOB_POLL_BUDGET (2 * SHELL_OUT_SIZE)
 
-#include "socketpair.h"
+struct shell_job;
 
 /* ------------------------------------------------------------------ */
 /*  Per-session state (stored in channel->typedata)                   */
 /* ------------------------------------------------------------------ */
 struct EspShellSess {
-	int  chan_fd;           /* Dropbear side of the socket pair    */
-	int  shell_fd;          /* shell side (read client input here) */
+	struct Channel *channel;
+	int  started;           /* 1 after "shell" or "exec" request   */
 	int  done;              /* set to 1 when shell should close    */
 	int  banner_sent;       /* 1 after welcome message              */
+	int  streaming;         /* running a SHELL_CMD_STREAMING command */
+	int  exec;              /* "exec" request: run cmd, then exit  */
+	int  exec_started;
+	int  exec_finished;     /* exit_status is set                  */
+	int  exit_status;
 	char cmd[128];
 	int  cmd_len;
+	char out[SHELL_OUT_SIZE];       /* output not yet sent           */
+	unsigned int out_len;
+	TickType_t out_since;           /* tick of the oldest byte in out */
+	struct shell_job *job;          /* running async command, or the job
+	                                   a worker's view belongs to       */
+	struct esp_sftp *sftp;          /* "sftp" subsystem, or NULL      */
 };
 
+struct shell_job {
+	struct EspShellSess view;       /* what the handler writes to: no channel */
+	StreamBufferHandle_t out;       /* worker -> session task        */
+	StreamBufferHandle_t in;        /* client data -> worker, or NULL */
+	size_t in_fed;                  /* session task: bytes put into in */
+	size_t in_acked;                /* session task: window handed back */
+	volatile int in_eof;            /* client sent EOF, in holds the rest */
+	int event_fd;                   /* worker -> session task wakeup */
+	volatile int cancel;
+	int finished;                   /* under job_lock                */
+	int refs;                       /* under job_lock: worker, session */
+	const shell_cmd_t *cmd;         /* NULL: pass line to esp_console */
+	int status;                     /* handler result, once finished */
+	char line[sizeof(((struct EspShellSess *)0)->cmd)];
+};
+
+static portMUX_TYPE job_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static void shell_job_put(struct shell_job *job, const char *p, unsigned int len);
+
 /* ------------------------------------------------------------------ */
-/*  Socket pair (from espressif/sock_utils)                            */
+/*  Helpers                                                           */
 /* ------------------------------------------------------------------ */
-static int make_socket_pair(int sv[2])
+static void shell_flush(struct EspShellSess *sess)
 {
-	return socketpair(AF_UNIX, SOCK_STREAM, 0, sv);
+	if (sess->channel != NULL && sess->out_len > 0) {
+		chan_inproc_send(sess->channel, sess->out, sess->out_len);
+		sess->out_len = 0;
+	}
 }
 
-/* ------------------------------------------------------------------ */
-/*  Helpers                                                           */
-/* ------------------------------------------------------------------ */
-static void shell_write(int fd, const char *s)
+void shell_put(struct EspShellSess *sess, const void *data, unsigned int len)
 {
-	int len = (int)strlen(s);
+	const char *p = (const char *)data;
+
+	if (sess->channel == NULL) {
+		shell_job_put(sess->job, p, len);
+		return;
+	}
+
 	while (len > 0) {
-		int n = write(fd, s, len);
-		if (n <= 0) break;
-		s   += n;
+		unsigned int n;
+
+		if (sess->out_len == sizeof(sess->out)) {
+			shell_flush(sess);
+		}
+		if (sess->out_len == 0) {
+			sess->out_since = xTaskGetTickCount();
+		}
+		n = MIN(len, sizeof(sess->out) - sess->out_len);
+		memcpy(sess->out + sess->out_len, p, n);
+		sess->out_len += n;
+		p   += n;
 		len -= n;
 	}
+	if (sess->streaming) {
+		shell_flush(sess);
+	}
+}
+
+void shell_write(struct EspShellSess *sess, const char *s)
+{
+	shell_put(sess, s, (unsigned int)strlen(s));
+}
+
+void shell_printf(struct EspShellSess *sess, const char *fmt, ...)
+{
+	char line[128];
+	va_list ap;
+	int n;
+
+	va_start(ap, fmt);
+	n = vsnprintf(line, sizeof(line), fmt, ap);
+	va_end(ap);
+	if (n > 0) {
+		shell_put(sess, line, MIN((unsigned int)n, sizeof(line) - 1));
+	}
+}
+
+int shell_cancelled(struct EspShellSess *sess)
+{
+	return sess->job != NULL && sess->job->cancel;
+}
+
+static void shell_job_signal(struct shell_job *job);
+
+int shell_read(struct EspShellSess *sess, void *buf, size_t len)
+{
+	struct shell_job *job = sess->job;
+	size_t n;
+
+	if (job == NULL || job->in == NULL) return -1;
+
+	while (!job->cancel) {
+		n = xStreamBufferReceive(job->in, buf, len, pdMS_TO_TICKS(SHELL_JOB_WAIT_MS));
+		if (n > 0) {
+			/* the session task hands the window back */
+			shell_job_signal(job);
+			return (int)n;
+		}
+		if (job->in_eof && xStreamBufferIsEmpty(job->in)) {
+			return 0;
+		}
+	}
+	return -1;
+}
+
+/* More client data already queued on the socket, i.e. the next loop pass will read it. */
+static int shell_input_waiting(void)
+{
+	char c;
+
+	return recv(ses.sock_in, &c, 1, MSG_PEEK | MSG_DONTWAIT) > 0;
 }
 
 #if ENABLE_MEMORY_STATS
@@ -75,14 +272,14 @@ static const char *TAG = "esp_shell";
 
 /**
  * Print stack high-water marks for all running tasks and heap summary
- * (same as libssh example). Writes to both ESP log and the shell fd.
+ * (same as libssh example). Writes to both ESP log and the shell.
  */
-static void print_all_task_stats(int fd)
+static void print_all_task_stats(struct EspShellSess *sess)
 {
 	UBaseType_t num_tasks = uxTaskGetNumberOfTasks();
 	TaskStatus_t *task_array = malloc(num_tasks * sizeof(TaskStatus_t));
 	if (task_array == NULL) {
-		shell_write(fd, "Failed to allocate task status array\r\n");
+		shell_write(sess, "Failed to allocate task status array\r\n");
 		return;
 	}
 
@@ -92,12 +289,12 @@ static void print_all_task_stats(int fd)
 	(void)snprintf(line, sizeof(line),
 		"\r\n%-20s %5s %10s %5s\r\n", "Task", "State", "Stack HWM", "Prio");
 	ESP_LOGI(TAG, "%s", line);
-	shell_write(fd, line);
+	shell_write(sess, line);
 
 	(void)snprintf(line, sizeof(line),
 		"%-20s %5s %10s %5s\r\n", "----", "-----", "---------", "----");
 	ESP_LOGI(TAG, "%s", line);
-	shell_write(fd, line);
+	shell_write(sess, line);
 
 	for (UBaseType_t i = 0; i < actual; i++) {
 		const char *state;
@@ -116,7 +313,7 @@ static void print_all_task_stats(int fd)
 			(unsigned)task_array[i].usStackHighWaterMark,
 			(unsigned)task_array[i].uxCurrentPriority);
 		ESP_LOGI(TAG, "%s", line);
-		shell_write(fd, line);
+		shell_write(sess, line);
 	}
 
 	(void)snprintf(line, sizeof(line),
@@ -125,126 +322,652 @@ static void print_all_task_stats(int fd)
 		esp_get_minimum_free_heap_size(),
 		heap_caps_get_free_size(MALLOC_CAP_INTERNAL));
 	ESP_LOGI(TAG, "%s", line);
-	shell_write(fd, line);
+	shell_write(sess, line);
+
+#if CONFIG_DROPBEAR_SESSION_ARENA
+	if (session_arena_current() != NULL) {
+		session_arena_stats_t st;
+
+		session_arena_get_stats(session_arena_current(), &st);
+		(void)snprintf(line, sizeof(line),
+			"Session arena: %zu used | %zu peak | %zu size | %u overflows\r\n",
+			st.used, st.high_water, st.size, st.overflows);
+		ESP_LOGI(TAG, "%s", line);
+		shell_write(sess, line);
+#if CONFIG_DROPBEAR_PACKET_POOL
+		(void)snprintf(line, sizeof(line),
+			"Packet slots: %u hits | %u misses\r\n",
+			st.pool_hits, st.pool_misses);
+		ESP_LOGI(TAG, "%s", line);
+		shell_write(sess, line);
+#endif
+	}
+#endif
+#if CONFIG_DROPBEAR_HMAC_CACHE
+	{
+		unsigned long hits, misses;
+
+		hmac_cache_get_stats(&hits, &misses);
+		(void)snprintf(line, sizeof(line),
+			"HMAC key cache: %lu hits | %lu misses\r\n", hits, misses);
+		ESP_LOGI(TAG, "%s", line);
+		shell_write(sess, line);
+	}
+#endif
+#if CONFIG_DROPBEAR_GCM_GHASH_TABLE
+	{
+		unsigned long hits, misses;
+
+		ghash_table_get_stats(&hits, &misses);
+		(void)snprintf(line, sizeof(line),
+			"GHASH tables: %lu hits | %lu misses\r\n", hits, misses);
+		ESP_LOGI(TAG, "%s", line);
+		shell_write(sess, line);
+	}
+#endif
+#if CONFIG_DROPBEAR_KEX_PREGEN
+	{
+		unsigned long hits, misses;
+
+		kex_pregen_get_stats(&hits, &misses);
+		(void)snprintf(line, sizeof(line),
+			"KEX key pool: %lu pregenerated | %lu inline\r\n", hits, misses);
+		ESP_LOGI(TAG, "%s", line);
+		shell_write(sess, line);
+	}
+#endif
+	{
+		unsigned long calls, buffers;
+
+		writev_get_stats(&calls, &buffers);
+		(void)snprintf(line, sizeof(line),
+			"Packet writes: %lu writev calls | %lu packets\r\n", calls, buffers);
+		ESP_LOGI(TAG, "%s", line);
+		shell_write(sess, line);
+	}
+#if CONFIG_DROPBEAR_NETCONN_NOCOPY
+	{
+		unsigned long nocopy, copied, resets;
+
+		netconn_lwip_get_stats(&nocopy, &copied, &resets);
+		(void)snprintf(line, sizeof(line),
+			"NOCOPY writes: %lu bytes | %lu copied | %lu reset at close\r\n",
+			nocopy, copied, resets);
+		ESP_LOGI(TAG, "%s", line);
+		shell_write(sess, line);
+	}
+#endif
+	{
+		unsigned long packets, bytes;
+
+		chan_inproc_get_stats(&packets, &bytes);
+		(void)snprintf(line, sizeof(line),
+			"In-process channels: %lu data packets | %lu bytes\r\n", packets, bytes);
+		ESP_LOGI(TAG, "%s", line);
+		shell_write(sess, line);
+	}
+	{
+		unsigned long bytes_read, bytes_written;
+
+		esp_sftp_get_stats(&bytes_read, &bytes_written);
+		(void)snprintf(line, sizeof(line),
+			"SFTP: %lu bytes read | %lu bytes written\r\n", bytes_read, bytes_written);
+		ESP_LOGI(TAG, "%s", line);
+		shell_write(sess, line);
+	}
+	(void)snprintf(line, sizeof(line),
+		"In-process forwards: %lu connections\r\n", fwd_inproc_get_count());
+	ESP_LOGI(TAG, "%s", line);
+	shell_write(sess, line);
+	{
+		session_pool_stats_t pool_stats;
+
+		session_pool_get_stats(&pool_stats);
+		(void)snprintf(line, sizeof(line),
+			"Sessions: %u active | closed: %lu evicted, %lu keepalive, %lu idle"
+			" | min heap %u\r\n",
+			session_pool_active(), pool_stats.evicted, pool_stats.keepalive_timeouts,
+			pool_stats.idle_timeouts, (unsigned)pool_stats.min_free_heap);
+		ESP_LOGI(TAG, "%s", line);
+		shell_write(sess, line);
+	}
+	{
+		admission_stats_t adm_stats;
+
+		admission_get_stats(&adm_stats);
+		(void)snprintf(line, sizeof(line),
+			"Admission: %lu admitted | refused: %lu rate, %lu blocked, %lu busy, %lu heap\r\n",
+			adm_stats.admitted, adm_stats.refused[ADMISSION_RATE],
+			adm_stats.refused[ADMISSION_BLOCKED], adm_stats.refused[ADMISSION_BUSY],
+			adm_stats.refused[ADMISSION_HEAP]);
+		ESP_LOGI(TAG, "%s", line);
+		shell_write(sess, line);
+	}
 
 	free(task_array);
 }
 #endif
 
 /* ------------------------------------------------------------------ */
-/*  Shell I/O – runs in main task when shell_fd is readable             */
+/*  Built-in commands                                                 */
 /* ------------------------------------------------------------------ */
-static void shell_process_input(struct EspShellSess *sess)
+static int cmd_hello(struct EspShellSess *sess, int argc, char **argv)
+{
+	shell_write(sess, "Hello, world!\r\n");
+	return 0;
+}
+
+static int cmd_uptime(struct EspShellSess *sess, int argc, char **argv)
+{
+	shell_printf(sess, "Uptime: %lu ms\r\n",
+		(unsigned long)(xTaskGetTickCount() * portTICK_PERIOD_MS));
+	return 0;
+}
+
+static int cmd_heap(struct EspShellSess *sess, int argc, char **argv)
+{
+	shell_printf(sess, "Free heap: %lu bytes\r\n",
+		(unsigned long)esp_get_free_heap_size());
+	return 0;
+}
+
+#if ENABLE_MEMORY_STATS
+static int cmd_stats(struct EspShellSess *sess, int argc, char **argv)
 {
-	int fd = sess->shell_fd;
-	char buf[256];
-	int n, i;
+	print_all_task_stats(sess);
+	return 0;
+}
+#endif
 
-	if (fd < 0 || sess->done) return;
+static int cmd_reset(struct EspShellSess *sess, int argc, char **argv)
+{
+	shell_write(sess, "Resetting ESP32...\r\n");
+	/* give the session task time to send it */
+	vTaskDelay(pdMS_TO_TICKS(500));
+	esp_restart();
+	return 0;
+}
 
-	/* Send banner once */
-	if (!sess->banner_sent) {
-		shell_write(fd, "\r\n=== ESP32 Dropbear Shell ===\r\n");
-		shell_write(fd, "Type 'help' for available commands.\r\n");
-		shell_write(fd, "esp32> ");
-		sess->banner_sent = 1;
+static int cmd_exit(struct EspShellSess *sess, int argc, char **argv)
+{
+	shell_write(sess, "Goodbye!\r\n");
+	/* exec: the channel closes with exit-status once the command returns */
+	if (sess->exec) {
+		return 0;
 	}
+	shell_flush(sess);
+	sess->done = 1;
+	chan_inproc_close(sess->channel);
+	return 0;
+}
 
-	n = read(fd, buf, sizeof(buf) - 1);
-	if (n <= 0) {
-		if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK))
-			sess->done = 1;
+/* Lists the registry only, esp_console imports included; never blocks. */
+static int cmd_help(struct EspShellSess *sess, int argc, char **argv)
+{
+	size_t i;
+
+	shell_write(sess, "Available commands:\r\n");
+	for (i = 0; i < shell_cmd_count(); i++) {
+		const shell_cmd_t *cmd = shell_cmd_at(i);
+		const char *help = cmd->help != NULL ? cmd->help : "";
+
+		/* esp_console help texts may run on over several lines */
+		shell_printf(sess, "  %-7s - %.*s\r\n", cmd->command,
+			(int)strcspn(help, "\n"), help);
+	}
+	return 0;
+}
+
+static const shell_cmd_t builtin_cmds[] = {
+	{ "hello",  "print greeting",             cmd_hello,  0 },
+	{ "uptime", "show uptime in ms",          cmd_uptime, 0 },
+	{ "heap",   "show free heap",             cmd_heap,   0 },
+#if ENABLE_MEMORY_STATS
+	{ "stats",  "show task and heap stats",   cmd_stats,  0 },
+#endif
+	{ "reset",  "restart ESP32",              cmd_reset,  SHELL_CMD_ASYNC },
+	{ "update", "firmware update from stdin", esp_update_cmd, SHELL_CMD_STDIN },
+	{ "exit",   "close session",              cmd_exit,   0 },
+	{ "help",   "this message",               cmd_help,   0 },
+};
+
+/* Once, on the first channel: commands registered by the application win. */
+static void shell_register_builtins(void)
+{
+	static int registered;
+	esp_vfs_eventfd_config_t eventfd_config = ESP_VFS_EVENTD_CONFIG_DEFAULT();
+	size_t i;
+
+	if (registered) return;
+	/* ESP_ERR_INVALID_STATE if the app did it */
+	eventfd_config.max_fds = SHELL_JOB_MAX_FDS;
+	(void)esp_vfs_eventfd_register(&eventfd_config);
+	for (i = 0; i < sizeof(builtin_cmds) / sizeof(builtin_cmds[0]); i++) {
+		if (shell_cmd_find(builtin_cmds[i].command) == NULL) {
+			shell_cmd_register(&builtin_cmds[i]);
+		}
+	}
+	registered = 1;
+}
+
+/* ------------------------------------------------------------------ */
+/*  Async commands (worker task)                                      */
+/* ------------------------------------------------------------------ */
+static void shell_job_signal(struct shell_job *job)
+{
+	uint64_t one = 1;
+
+	(void)write(job->event_fd, &one, sizeof(one));
+}
+
+/* Worker side of shell_put(): blocks while the queue is full, unless cancelled. */
+static void shell_job_put(struct shell_job *job, const char *p, unsigned int len)
+{
+	while (len > 0 && !job->cancel) {
+		size_t n = xStreamBufferSend(job->out, p, len, pdMS_TO_TICKS(SHELL_JOB_WAIT_MS));
+		if (n > 0) {
+			p   += n;
+			len -= (unsigned int)n;
+			shell_job_signal(job);
+		}
+	}
+}
+
+static void shell_job_free(struct shell_job *job)
+{
+	if (job->out != NULL) {
+		vStreamBufferDelete(job->out);
+	}
+	if (job->in != NULL) {
+		vStreamBufferDelete(job->in);
+	}
+	if (job->event_fd >= 0) {
+		close(job->event_fd);
+	}
+	free(job);
+}
+
+/* The worker and the session task each hold a reference; the last one out frees the job. */
+static void shell_job_release(struct shell_job *job)
+{
+	int refs;
+
+	taskENTER_CRITICAL(&job_lock);
+	refs = --job->refs;
+	taskEXIT_CRITICAL(&job_lock);
+	if (refs == 0) {
+		shell_job_free(job);
+	}
+}
+
+static void shell_job_task(void *arg)
+{
+	struct shell_job *job = (struct shell_job *)arg;
+	char line[sizeof(job->line)];
+	char *argv[SHELL_CMD_MAX_ARGS];
+	size_t argc;
+	int ret;
+
+	memcpy(line, job->line, sizeof(line));
+	argc = esp_console_split_argv(line, argv, SHELL_CMD_MAX_ARGS);
+
+	if (job->cmd != NULL) {
+		job->status = job->cmd->func(&job->view, (int)argc, argv);
+	} else if (shell_cmd_run_console(&job->view, job->line, &ret) == ESP_OK) {
+		if (ret != 0) {
+			shell_printf(&job->view, "Command returned %d\r\n", ret);
+		}
+		job->status = ret;
+	} else {
+		shell_printf(&job->view, "Unknown command: %s\r\n"
+			"Type 'help' for available commands.\r\n", argv[0]);
+		job->status = 127;
+	}
+
+	/*
+	 * finished before the wakeup, so the session task sees it when it runs;
+	 * our reference keeps the job (and its eventfd) alive until then.
+	 */
+	taskENTER_CRITICAL(&job_lock);
+	job->finished = 1;
+	taskEXIT_CRITICAL(&job_lock);
+	shell_job_signal(job);
+	shell_job_release(job);
+	vTaskDelete(NULL);
+}
+
+/* Run sess->cmd on a worker. Returns 0 if no worker could be set up. */
+static int shell_job_start(struct EspShellSess *sess, const shell_cmd_t *cmd)
+{
+	struct shell_job *job = calloc(1, sizeof(*job));
+	int want_in = cmd != NULL && (cmd->flags & SHELL_CMD_STDIN) && sess->exec;
+
+	if (job == NULL) {
+		return 0;
+	}
+	job->event_fd = eventfd(0, 0);
+	job->out = xStreamBufferCreate(SHELL_JOB_QUEUE_SIZE, 1);
+	if (want_in) {
+		job->in = xStreamBufferCreate(SHELL_JOB_STDIN_SIZE, 1);
+	}
+	if (job->event_fd < 0 || job->out == NULL || (want_in && job->in == NULL)) {
+		shell_job_free(job);
+		return 0;
+	}
+	job->cmd = cmd;
+	memcpy(job->line, sess->cmd, sess->cmd_len + 1);
+	job->view.started = 1;
+	job->view.job = job;
+	job->refs = 2;
+
+	if (xTaskCreate(shell_job_task, "ssh_cmd", SHELL_JOB_STACK_SIZE, job,
+			SHELL_JOB_PRIORITY, NULL) != pdPASS) {
+		shell_job_free(job);
+		return 0;
+	}
+	sess->job = job;
+	return 1;
+}
+
+/* Stop waiting for the running job; whoever finishes last frees it. */
+static void shell_job_detach(struct EspShellSess *sess)
+{
+	struct shell_job *job = sess->job;
+
+	if (job == NULL) return;
+	sess->job = NULL;
+
+	job->cancel = 1;
+	shell_job_release(job);
+}
+
+/* Session task: move worker output to the channel while the window allows. */
+static void shell_job_poll(struct EspShellSess *sess, const fd_set *readfds)
+{
+	struct shell_job *job = sess->job;
+	uint64_t count;
+	size_t n, moved = 0;
+	int finished;
+
+	if (job == NULL) return;
+
+	if (FD_ISSET(job->event_fd, readfds)) {
+		(void)read(job->event_fd, &count, sizeof(count));
+	}
+
+	taskENTER_CRITICAL(&job_lock);
+	finished = job->finished;
+	taskEXIT_CRITICAL(&job_lock);
+
+	if (job->in != NULL) {
+		size_t taken = job->in_fed - xStreamBufferBytesAvailable(job->in);
+
+		chan_inproc_consumed(sess->channel, (unsigned int)(taken - job->in_acked));
+		job->in_acked = taken;
+		if (sess->channel->recv_eof) {
+			job->in_eof = 1;
+		}
+	}
+
+	while (chan_inproc_pending(sess->channel) == 0 && moved < SHELL_JOB_POLL_BUDGET) {
+		if (sess->out_len == sizeof(sess->out)) {
+			shell_flush(sess);
+		}
+		n = xStreamBufferReceive(job->out, sess->out + sess->out_len,
+			sizeof(sess->out) - sess->out_len, 0);
+		if (n == 0) {
+			break;
+		}
+		sess->out_len += (unsigned int)n;
+		moved += n;
+		shell_flush(sess);
+	}
+	/* budget used up: come back on the next iteration */
+	if (moved >= SHELL_JOB_POLL_BUDGET && !xStreamBufferIsEmpty(job->out)) {
+		shell_job_signal(job);
+	}
+
+	if (finished && xStreamBufferIsEmpty(job->out)) {
+		int status = job->status;
+
+		shell_job_detach(sess);
+		if (sess->exec) {
+			sess->exit_status = status;
+			sess->exec_finished = 1;
+		} else {
+			shell_write(sess, "esp32> ");
+		}
+	}
+}
+
+/* Registered command named by the line in sess->cmd, or NULL. */
+static const shell_cmd_t *shell_line_cmd(const struct EspShellSess *sess)
+{
+	char line[sizeof(sess->cmd)];
+	char *argv[SHELL_CMD_MAX_ARGS];
+
+	memcpy(line, sess->cmd, sess->cmd_len + 1);
+	if (esp_console_split_argv(line, argv, SHELL_CMD_MAX_ARGS) == 0) {
+		return NULL;
+	}
+	return shell_cmd_find(argv[0]);
+}
+
+/*
+ * Run the line in sess->cmd. Returns 1 if it went to a worker; otherwise
+ * the command has finished and *status holds its result.
+ */
+static int shell_run_line(struct EspShellSess *sess, int *status)
+{
+	char line[sizeof(sess->cmd)];
+	char *argv[SHELL_CMD_MAX_ARGS];
+	const shell_cmd_t *cmd;
+	size_t argc;
+
+	/* esp_console_split_argv() splits in place, keep sess->cmd intact */
+	memcpy(line, sess->cmd, sess->cmd_len + 1);
+	argc = esp_console_split_argv(line, argv, SHELL_CMD_MAX_ARGS);
+	*status = 0;
+	if (argc == 0) return 0;
+
+	cmd = shell_cmd_find(argv[0]);
+	if (cmd != NULL && !(cmd->flags & (SHELL_CMD_ASYNC | SHELL_CMD_STDIN))) {
+		sess->streaming = (cmd->flags & SHELL_CMD_STREAMING) != 0;
+		*status = cmd->func(sess, (int)argc, argv);
+		sess->streaming = 0;
+		return 0;
+	}
+
+	/*
+	 * Async commands and esp_console lines. They may block, so without a
+	 * worker they are refused: on the session task they would stall every
+	 * session waiting for the pool lock.
+	 */
+	shell_flush(sess);
+	if (shell_job_start(sess, cmd)) {
+		return 1;
+	}
+	shell_write(sess, "No worker task available, try again\r\n");
+	*status = 1;
+	return 0;
+}
+
+/* RFC 4254 6.10: sent after the last data, before EOF and CLOSE. */
+static void send_exit_status(struct Channel *channel, int status)
+{
+	buf_putbyte(ses.writepayload, SSH_MSG_CHANNEL_REQUEST);
+	buf_putint(ses.writepayload, channel->remotechan);
+	buf_putstring(ses.writepayload, "exit-status", 11);
+	buf_putbyte(ses.writepayload, 0);
+	buf_putint(ses.writepayload, (unsigned int)status);
+	encrypt_packet();
+}
+
+/* ------------------------------------------------------------------ */
+/*  Shell I/O – client data, straight from the decrypted packet       */
+/* ------------------------------------------------------------------ */
+static void shell_recv(struct Channel *channel, const unsigned char *buf,
+	unsigned int n)
+{
+	struct EspShellSess *sess = (struct EspShellSess *)channel->typedata;
+	unsigned int i;
+
+	if (sess == NULL || !sess->started || sess->done) return;
+
+	/* exec: stdin is not read, Ctrl-C cancels a running command */
+	if (sess->exec) {
+		if (sess->job != NULL && memchr(buf, 0x03, n) != NULL) {
+			shell_job_detach(sess);
+			sess->exit_status = 130;
+			sess->exec_finished = 1;
+		}
 		return;
 	}
 
 	for (i = 0; i < n; i++) {
-		unsigned char c = (unsigned char)buf[i];
+		unsigned char c = buf[i];
+
+		/* while a command runs on the worker only Ctrl-C is read */
+		if (sess->job != NULL) {
+			if (c == 0x03) {
+				shell_job_detach(sess);
+				shell_write(sess, "^C\r\nesp32> ");
+			}
+			continue;
+		}
 
 		if (c == '\r' || c == '\n') {
-			shell_write(fd, "\r\n");
+			shell_write(sess, "\r\n");
 			sess->cmd[sess->cmd_len] = '\0';
 
 			if (sess->cmd_len > 0) {
-				if (strcmp(sess->cmd, "exit") == 0) {
-					shell_write(fd, "Goodbye!\r\n");
-					sess->done = 1;
+				int status;
+				int async = shell_run_line(sess, &status);
+
+				if (sess->done) {
 					return;
-				} else if (strcmp(sess->cmd, "reset") == 0) {
-					shell_write(fd, "Resetting ESP32...\r\n");
-					vTaskDelay(pdMS_TO_TICKS(100));
-					esp_restart();
-				} else if (strcmp(sess->cmd, "hello") == 0) {
-					shell_write(fd, "Hello, world!\r\n");
-				} else if (strcmp(sess->cmd, "uptime") == 0) {
-					char tmp[64];
-					snprintf(tmp, sizeof(tmp), "Uptime: %lu ms\r\n",
-						(unsigned long)(xTaskGetTickCount()
-							* portTICK_PERIOD_MS));
-					shell_write(fd, tmp);
-				} else if (strcmp(sess->cmd, "heap") == 0) {
-					char tmp[64];
-					snprintf(tmp, sizeof(tmp),
-						"Free heap: %lu bytes\r\n",
-						(unsigned long)esp_get_free_heap_size());
-					shell_write(fd, tmp);
-#if ENABLE_MEMORY_STATS
-				} else if (strcmp(sess->cmd, "stats") == 0) {
-					print_all_task_stats(fd);
-#endif
-				} else if (strcmp(sess->cmd, "help") == 0) {
-					shell_write(fd,
-						"Available commands:\r\n"
-						"  hello   - print greeting\r\n"
-						"  uptime  - show uptime in ms\r\n"
-						"  heap    - show free heap\r\n"
-#if ENABLE_MEMORY_STATS
-						"  stats   - show task and heap stats\r\n"
-#endif
-						"  reset   - restart ESP32\r\n"
-						"  exit    - close session\r\n"
-						"  help    - this message\r\n");
-				} else {
-					shell_write(fd, "Unknown command: ");
-					shell_write(fd, sess->cmd);
-					shell_write(fd, "\r\nType 'help' for available commands.\r\n");
+				}
+				if (async) {
+					/* prompt follows the command's output */
+					sess->cmd_len = 0;
+					continue;
 				}
 			}
 
 			sess->cmd_len = 0;
-			shell_write(fd, "esp32> ");
+			shell_write(sess, "esp32> ");
 		} else if (c == 0x7f || c == '\b') {
 			if (sess->cmd_len > 0) {
 				sess->cmd_len--;
-				shell_write(fd, "\b \b");
+				shell_write(sess, "\b \b");
 			}
 		} else if (c == 0x03) {
-			shell_write(fd, "^C\r\n");
+			shell_write(sess, "^C\r\n");
 			sess->cmd_len = 0;
-			shell_write(fd, "esp32> ");
+			shell_write(sess, "esp32> ");
 		} else if (c >= 0x20 && sess->cmd_len < (int)sizeof(sess->cmd) - 1) {
 			sess->cmd[sess->cmd_len++] = (char)c;
-			write(fd, &c, 1);
+			shell_put(sess, &c, 1);
 		}
 	}
 }
 
+static const struct chan_inproc_ops shell_ops = {
+	shell_recv, 0
+};
+
+static void sftp_recv(struct Channel *channel, const unsigned char *buf,
+	unsigned int n)
+{
+	struct EspShellSess *sess = (struct EspShellSess *)channel->typedata;
+
+	if (sess != NULL && sess->sftp != NULL && !sess->done) {
+		esp_sftp_recv(sess->sftp, buf, n);
+	}
+}
+
+/* esp_sftp queues requests and hands the window back as it answers them */
+static const struct chan_inproc_ops sftp_ops = {
+	sftp_recv, 1
+};
+
+/*
+ * Client data for an exec'd SHELL_CMD_STDIN command. It is binary, so 0x03
+ * does not cancel; closing the channel does. The window keeps the client
+ * within the stream buffer, so this never waits for the worker. Data that
+ * arrives once the command has returned is dropped.
+ */
+static void shell_stdin_recv(struct Channel *channel, const unsigned char *buf,
+	unsigned int n)
+{
+	struct EspShellSess *sess = (struct EspShellSess *)channel->typedata;
+	struct shell_job *job = sess != NULL ? sess->job : NULL;
+	unsigned int sent = 0;
+
+	if (job != NULL && job->in != NULL) {
+		sent = (unsigned int)xStreamBufferSend(job->in, buf, n, 0);
+		job->in_fed += sent;
+	}
+	chan_inproc_consumed(channel, n - sent);
+}
+
+/* the window is handed back as the worker reads (shell_job_poll) */
+static const struct chan_inproc_ops stdin_ops = {
+	shell_stdin_recv, 1
+};
+
+/* Input is delivered to shell_recv(); only a running async command has an fd. */
 static void esp_set_extra_fds(struct Channel *channel, fd_set *readfds, fd_set *writefds)
 {
 	struct EspShellSess *sess = (struct EspShellSess *)channel->typedata;
 	(void)writefds;
-	if (sess && sess->shell_fd >= 0 && !sess->done) {
-		FD_SET(sess->shell_fd, readfds);
-		ses.maxfd = MAX(ses.maxfd, sess->shell_fd);
+	if (sess && sess->job != NULL) {
+		FD_SET(sess->job->event_fd, readfds);
+		ses.maxfd = MAX(ses.maxfd, sess->job->event_fd);
 	}
 }
 
+/* Every loop iteration: banner once the shell is up, worker output, buffered and kept output. */
 static void esp_handle_extra_io(struct Channel *channel,
 	const fd_set *readfds, const fd_set *writefds)
 {
 	struct EspShellSess *sess = (struct EspShellSess *)channel->typedata;
 	(void)writefds;
-	if (sess && sess->shell_fd >= 0 && FD_ISSET(sess->shell_fd, readfds)) {
-		shell_process_input(sess);
+	if (sess == NULL || !sess->started) return;
+
+	if (sess->sftp != NULL) {
+		chan_inproc_flush(channel);
+		if (!sess->done && esp_sftp_poll(sess->sftp)) {
+			sess->done = 1;
+			chan_inproc_close(channel);
+		}
+		return;
+	}
+
+	if (sess->exec && !sess->exec_started) {
+		sess->exec_started = 1;
+		if (!shell_run_line(sess, &sess->exit_status)) {
+			sess->exec_finished = 1;
+		}
+	} else if (!sess->exec && !sess->banner_sent) {
+		shell_write(sess, "\r\n=== ESP32 Dropbear Shell ===\r\n");
+		shell_write(sess, "Type 'help' for available commands.\r\n");
+		shell_write(sess, "esp32> ");
+		sess->banner_sent = 1;
+	}
+	shell_job_poll(sess, readfds);
+	if (sess->out_len > 0 && (sess->exec_finished || !shell_input_waiting()
+			|| xTaskGetTickCount() - sess->out_since >= pdMS_TO_TICKS(SHELL_FLUSH_HOLD_MS))) {
+		shell_flush(sess);
+	}
+	chan_inproc_flush(channel);
+
+	/* exec done and all output sent: exit-status, then EOF and CLOSE */
+	if (sess->exec_finished && !sess->done && sess->out_len == 0
+			&& chan_inproc_pending(channel) == 0 && ses.dataallowed) {
+		send_exit_status(channel, sess->exit_status);
+		sess->done = 1;
+		chan_inproc_close(channel);
 	}
 }
 
@@ -252,26 +975,57 @@ static void esp_handle_extra_io(struct Channel *channel,
 /*  ChanType callbacks                                                */
 /* ------------------------------------------------------------------ */
 
+/* Open session channels on this connection, the one being opened included. */
+static unsigned int count_session_channels(void)
+{
+	unsigned int i, n = 0;
+
+	for (i = 0; i < ses.chansize; i++) {
+		if (ses.channels[i] != NULL && ses.channels[i]->type == &svrchansess) {
+			n++;
+		}
+	}
+	return n;
+}
+
 static int esp_newchansess(struct Channel *channel)
 {
 	struct EspShellSess *sess;
 
+	if (count_session_channels() > CONFIG_DROPBEAR_MAX_SESSION_CHANNELS) {
+		dropbear_log(LOG_WARNING, "Refusing session channel: %d already open",
+			CONFIG_DROPBEAR_MAX_SESSION_CHANNELS);
+		return SSH_OPEN_RESOURCE_SHORTAGE;
+	}
+
 	sess = (struct EspShellSess *)m_malloc(sizeof(*sess));
-	sess->chan_fd     = -1;
-	sess->shell_fd    = -1;
+	sess->channel     = channel;
+	sess->started     = 0;
 	sess->done        = 0;
 	sess->banner_sent = 0;
 	sess->cmd_len     = 0;
+	sess->out_len     = 0;
+	sess->streaming   = 0;
+	sess->job         = NULL;
+	sess->exec        = 0;
+	sess->exec_started  = 0;
+	sess->exec_finished = 0;
+	sess->exit_status   = 0;
+	sess->sftp          = NULL;
 
 	channel->typedata = sess;
 	channel->prio = DROPBEAR_PRIO_LOWDELAY;
+	/* an exec'd SHELL_CMD_STDIN command or sftp queues up to a window of data */
+	chan_inproc_open_window(channel, SHELL_JOB_STDIN_SIZE);
+	shell_register_builtins();
 	return 0;
 }
 
 static int esp_sesscheckclose(struct Channel *channel)
 {
 	struct EspShellSess *sess = (struct EspShellSess *)channel->typedata;
-	return (sess != NULL && sess->done);
+	return (sess != NULL && sess->done && sess->out_len == 0
+		&& chan_inproc_pending(channel) == 0);
 }
 
 static void esp_chansessionrequest(struct Channel *channel)
@@ -280,6 +1034,7 @@ static void esp_chansessionrequest(struct Channel *channel)
 	char *type = buf_getstring(ses.payload, &typelen);
 	unsigned char wantreply = buf_getbool(ses.payload);
 	int ret = DROPBEAR_FAILURE;
+	const shell_cmd_t *stdin_cmd = NULL;
 
 	struct EspShellSess *sess = (struct EspShellSess *)channel->typedata;
 
@@ -291,29 +1046,45 @@ static void esp_chansessionrequest(struct Channel *channel)
 
 	} else if (strcmp(type, "shell") == 0 || strcmp(type, "exec") == 0) {
 
-		if (sess->shell_fd >= 0) {
-			dropbear_log(LOG_WARNING, "Shell already running");
-			goto out;
-		}
-
-		int sv[2];
-		if (make_socket_pair(sv) < 0) {
-			dropbear_log(LOG_WARNING, "make_socket_pair failed");
+		if (sess->started) {
+			dropbear_log(LOG_WARNING, "Channel already runs a shell or command");
 			goto out;
 		}
 
-		sess->chan_fd  = sv[0];
-		sess->shell_fd = sv[1];
+		if (type[0] == 'e') {
+			unsigned int cmdlen;
+			char *cmd = buf_getstring(ses.payload, &cmdlen);
 
-		channel->readfd   = sv[0];
-		channel->writefd  = sv[0];
-		channel->bidir_fd = 1;
+			if (cmdlen == 0 || cmdlen >= sizeof(sess->cmd)) {
+				m_free(cmd);
+				goto out;
+			}
+			memcpy(sess->cmd, cmd, cmdlen + 1);
+			sess->cmd_len = (int)cmdlen;
+			sess->exec = 1;
+			m_free(cmd);
+			stdin_cmd = shell_line_cmd(sess);
+			if (stdin_cmd != NULL && !(stdin_cmd->flags & SHELL_CMD_STDIN)) {
+				stdin_cmd = NULL;
+			}
+		}
 
-		setnonblocking(sv[0]);
-		setnonblocking(sv[1]);
+		if (chan_inproc_attach(channel, stdin_cmd != NULL ? &stdin_ops : &shell_ops)
+				== DROPBEAR_FAILURE) {
+			dropbear_log(LOG_WARNING, "No free in-process channel slot");
+			goto out;
+		}
+		sess->started = 1;
 
-		ses.maxfd = MAX(ses.maxfd, sv[0]);
-		ses.maxfd = MAX(ses.maxfd, sv[1]);
+		/* the reader must exist before the client's data does */
+		if (stdin_cmd != NULL) {
+			sess->exec_started = 1;
+			if (!shell_job_start(sess, stdin_cmd)) {
+				dropbear_log(LOG_WARNING, "No worker task for '%s'", stdin_cmd->command);
+				sess->exit_status = 1;
+				sess->exec_finished = 1;
+			}
+		}
 
 		dropbear_log(LOG_INFO, "ESP32 shell session started");
 #if ENABLE_MEMORY_STATS
@@ -321,6 +1092,29 @@ static void esp_chansessionrequest(struct Channel *channel)
 #endif
 		ret = DROPBEAR_SUCCESS;
 
+	} else if (strcmp(type, "subsystem") == 0) {
+		char *name = buf_getstring(ses.payload, NULL);
+
+		if (sess->started || strcmp(name, "sftp") != 0) {
+			m_free(name);
+			goto out;
+		}
+		m_free(name);
+
+		sess->sftp = esp_sftp_new(channel);
+		if (sess->sftp == NULL) {
+			goto out;
+		}
+		if (chan_inproc_attach(channel, &sftp_ops) == DROPBEAR_FAILURE) {
+			dropbear_log(LOG_WARNING, "No free in-process channel slot");
+			esp_sftp_free(sess->sftp);
+			sess->sftp = NULL;
+			goto out;
+		}
+		sess->started = 1;
+		dropbear_log(LOG_INFO, "SFTP session started");
+		ret = DROPBEAR_SUCCESS;
+
 	} else if (strcmp(type, "window-change") == 0) {
 		ret = DROPBEAR_SUCCESS;
 
@@ -357,11 +1151,9 @@ static void esp_cleanupchansess(const struct Channel *channel)
 	if (!sess) return;
 
 	sess->done = 1;
-
-	if (sess->shell_fd >= 0) {
-		close(sess->shell_fd);
-		sess->shell_fd = -1;
-	}
+	shell_job_detach(sess);
+	chan_inproc_detach(channel);
+	esp_sftp_free(sess->sftp);
 
 	m_free(sess);
 }
@@ -0,0 +1,105 @@
+/*
+ * esp_status_http.c - Metrics page served on forwarded channels.
+ *
+ * Every request gets the same answer, so only the end of the request
+ * header is looked for; the request line and any body are ignored. The
+ * reply is built once that arrives and fits in the channel's output buffer.
+ * The connection is closed after it (HTTP/1.0).
+ */
+
+#include "includes.h"
+#include "channel.h"
+#include "chan_inproc.h"
+#include "fwd_inproc.h"
+#include "esp_status_http.h"
+#include "esp_sftp.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_system.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/* state of one forwarded connection */
+struct status_conn {
+	unsigned int matched;       /* bytes of "\r\n\r\n" seen so far */
+	int replied;
+};
+
+static int status_open(struct Channel *channel, void **conn)
+{
+	(void)channel;
+	*conn = calloc(1, sizeof(struct status_conn));
+	return *conn == NULL;
+}
+
+static void status_reply(struct Channel *channel)
+{
+	static const char head[] = "HTTP/1.0 200 OK\r\n"
+		"Content-Type: text/plain; version=0.0.4\r\n"
+		"Connection: close\r\n\r\n";
+	unsigned long bytes_read, bytes_written, packets, bytes;
+	char body[384];
+	int n;
+
+	esp_sftp_get_stats(&bytes_read, &bytes_written);
+	chan_inproc_get_stats(&packets, &bytes);
+	n = snprintf(body, sizeof(body),
+		"uptime_ms %lu\n"
+		"heap_free_bytes %lu\n"
+		"heap_min_free_bytes %lu\n"
+		"inproc_data_packets %lu\n"
+		"inproc_data_bytes %lu\n"
+		"inproc_forwards %lu\n"
+		"sftp_read_bytes %lu\n"
+		"sftp_written_bytes %lu\n",
+		(unsigned long)(xTaskGetTickCount() * portTICK_PERIOD_MS),
+		(unsigned long)esp_get_free_heap_size(),
+		(unsigned long)esp_get_minimum_free_heap_size(),
+		packets, bytes, fwd_inproc_get_count(), bytes_read, bytes_written);
+
+	chan_inproc_send(channel, head, sizeof(head) - 1);
+	chan_inproc_send(channel, body, (unsigned int)MIN(n, (int)sizeof(body) - 1));
+	chan_inproc_close(channel);
+}
+
+static void status_recv(void *conn, struct Channel *channel, const unsigned char *data,
+	unsigned int len)
+{
+	static const char end[] = "\r\n\r\n";
+	struct status_conn *c = (struct status_conn *)conn;
+	unsigned int i;
+
+	for (i = 0; i < len && !c->replied; i++) {
+		if (data[i] == (unsigned char)end[c->matched]) {
+			c->matched++;
+		} else {
+			c->matched = data[i] == '\r';
+		}
+		if (c->matched == sizeof(end) - 1) {
+			c->replied = 1;
+			status_reply(channel);
+		}
+	}
+}
+
+/* a client that sends EOF without finishing the header gets no reply */
+static void status_poll(void *conn, struct Channel *channel)
+{
+	struct status_conn *c = (struct status_conn *)conn;
+
+	if (!c->replied && channel->recv_eof) {
+		c->replied = 1;
+		chan_inproc_close(channel);
+	}
+}
+
+static void status_close(void *conn)
+{
+	free(conn);
+}
+
+const struct fwd_inproc_endpoint esp_status_http = {
+	status_open, status_recv, status_poll, status_close
+};
@@ -0,0 +1,14 @@
+#pragma once
+
+/*
+ * esp_status_http - Plain-text device metrics over HTTP, as an in-process
+ * direct-tcpip endpoint (see port/fwd_inproc.h). There is no listening
+ * socket; the page is only reachable through an SSH forward:
+ *
+ *   ssh -p 2222 -L 8080:localhost:8080 user@<device-ip>
+ *   curl http://localhost:8080/
+ */
+
+#include "fwd_inproc.h"
+
+extern const struct fwd_inproc_endpoint esp_status_http;
@@ -0,0 +1,279 @@
+/*
+ * esp_update.c - "update" shell command: stream a firmware image from the
+ * SSH channel into an esp_update_writer_t.
+ *
+ * The command runs on a shell worker task and pulls the image with
+ * shell_read(), so the writer may block on flash for as long as it needs;
+ * the session task keeps the connection alive and the client waits for
+ * window. Nothing is printed while the image is read; the result follows
+ * once it has been written.
+ */
+
+#include "includes.h"
+#include "esp_update.h"
+#include "shell_cmd.h"
+
+#include "esp_log.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <strings.h>
+#include <unistd.h>
+
+#if !CONFIG_IDF_TARGET_LINUX
+#include "esp_ota_ops.h"
+#endif
+
+#define UPDATE_CHUNK      4096
+#define UPDATE_PATH_MAX   128
+
+/* ESP_LOG, not dropbear_log(): this runs on the worker, without the pool lock */
+static const char *TAG = "esp_update";
+
+/* ------------------------------------------------------------------ */
+/*  OTA partition writer                                              */
+/* ------------------------------------------------------------------ */
+#if !CONFIG_IDF_TARGET_LINUX
+struct ota_ctx {
+	const esp_partition_t *part;
+	esp_ota_handle_t handle;
+};
+
+static esp_err_t ota_begin(void *arg, void **ctx)
+{
+	struct ota_ctx *ota;
+	esp_err_t err;
+
+	(void)arg;
+	ota = calloc(1, sizeof(*ota));
+	if (ota == NULL) return ESP_ERR_NO_MEM;
+
+	ota->part = esp_ota_get_next_update_partition(NULL);
+	if (ota->part == NULL) {
+		free(ota);
+		return ESP_ERR_NOT_FOUND;
+	}
+	/* erase as the image arrives rather than the whole partition up front */
+	err = esp_ota_begin(ota->part, OTA_WITH_SEQUENTIAL_WRITES, &ota->handle);
+	if (err != ESP_OK) {
+		free(ota);
+		return err;
+	}
+	*ctx = ota;
+	return ESP_OK;
+}
+
+static esp_err_t ota_write(void *ctx, const void *data, size_t len)
+{
+	struct ota_ctx *ota = (struct ota_ctx *)ctx;
+
+	return esp_ota_write(ota->handle, data, len);
+}
+
+static esp_err_t ota_finish(void *ctx)
+{
+	struct ota_ctx *ota = (struct ota_ctx *)ctx;
+	/* esp_ota_end() validates the image and frees the handle either way */
+	esp_err_t err = esp_ota_end(ota->handle);
+
+	if (err == ESP_OK) {
+		err = esp_ota_set_boot_partition(ota->part);
+	}
+	free(ota);
+	return err;
+}
+
+static void ota_abort(void *ctx)
+{
+	struct ota_ctx *ota = (struct ota_ctx *)ctx;
+
+	(void)esp_ota_abort(ota->handle);
+	free(ota);
+}
+
+const esp_update_writer_t esp_update_ota_writer = {
+	"ota", ota_begin, ota_write, ota_finish, ota_abort
+};
+#endif
+
+/* ------------------------------------------------------------------ */
+/*  File writer                                                       */
+/* ------------------------------------------------------------------ */
+struct file_ctx {
+	int fd;
+	char path[UPDATE_PATH_MAX];
+	char part[UPDATE_PATH_MAX + 5];
+};
+
+static esp_err_t file_begin(void *arg, void **ctx)
+{
+	const char *path = (const char *)arg;
+	struct file_ctx *f;
+
+	if (path == NULL || strlen(path) >= UPDATE_PATH_MAX) return ESP_ERR_INVALID_ARG;
+	f = calloc(1, sizeof(*f));
+	if (f == NULL) return ESP_ERR_NO_MEM;
+
+	strcpy(f->path, path);
+	snprintf(f->part, sizeof(f->part), "%s.part", path);
+	f->fd = open(f->part, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (f->fd < 0) {
+		free(f);
+		return ESP_FAIL;
+	}
+	*ctx = f;
+	return ESP_OK;
+}
+
+static esp_err_t file_write(void *ctx, const void *data, size_t len)
+{
+	struct file_ctx *f = (struct file_ctx *)ctx;
+	const char *p = (const char *)data;
+
+	while (len > 0) {
+		ssize_t n = write(f->fd, p, len);
+
+		if (n < 0 && errno == EINTR) continue;
+		if (n <= 0) return ESP_FAIL;
+		p += n;
+		len -= (size_t)n;
+	}
+	return ESP_OK;
+}
+
+static esp_err_t file_finish(void *ctx)
+{
+	struct file_ctx *f = (struct file_ctx *)ctx;
+	esp_err_t err = ESP_OK;
+
+	if (close(f->fd) != 0 || rename(f->part, f->path) != 0) {
+		(void)unlink(f->part);
+		err = ESP_FAIL;
+	}
+	free(f);
+	return err;
+}
+
+static void file_abort(void *ctx)
+{
+	struct file_ctx *f = (struct file_ctx *)ctx;
+
+	(void)close(f->fd);
+	(void)unlink(f->part);
+	free(f);
+}
+
+const esp_update_writer_t esp_update_file_writer = {
+	"file", file_begin, file_write, file_finish, file_abort
+};
+
+/* ------------------------------------------------------------------ */
+/*  "update" command                                                  */
+/* ------------------------------------------------------------------ */
+#if CONFIG_IDF_TARGET_LINUX
+static const esp_update_writer_t *update_writer = &esp_update_file_writer;
+static void *update_arg = (void *)"firmware.bin";
+#else
+static const esp_update_writer_t *update_writer = &esp_update_ota_writer;
+static void *update_arg;
+#endif
+
+void esp_update_set_writer(const esp_update_writer_t *writer, void *arg)
+{
+	update_writer = writer;
+	update_arg = arg;
+}
+
+static void to_hex(char *out, const unsigned char *in, size_t len)
+{
+	static const char digits[] = "0123456789abcdef";
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		out[2 * i] = digits[in[i] >> 4];
+		out[2 * i + 1] = digits[in[i] & 0x0f];
+	}
+	out[2 * len] = '\0';
+}
+
+int esp_update_cmd(struct EspShellSess *sess, int argc, char **argv)
+{
+	const esp_update_writer_t *writer = update_writer;
+	unsigned char digest[32];
+	char hex[2 * sizeof(digest) + 1];
+	unsigned long total = 0;
+	hash_state hs;
+	void *ctx = NULL;
+	char *buf;
+	esp_err_t err;
+	int n;
+
+	if (argc > 2 || (argc == 2 && strlen(argv[1]) != 2 * sizeof(digest))) {
+		shell_write(sess, "usage: update [sha256-hex] < firmware.bin\r\n");
+		return 1;
+	}
+	if (writer == NULL) {
+		shell_write(sess, "update: no writer configured\r\n");
+		return 1;
+	}
+	buf = malloc(UPDATE_CHUNK);
+	if (buf == NULL) {
+		shell_write(sess, "update: out of memory\r\n");
+		return 1;
+	}
+
+	/* first chunk before begin(): nothing is erased for an empty stdin */
+	n = shell_read(sess, buf, UPDATE_CHUNK);
+	if (n <= 0) {
+		shell_write(sess, n < 0 && !shell_cancelled(sess)
+			? "update: send the image as stdin: ssh <host> update < firmware.bin\r\n"
+			: "update: no data\r\n");
+		free(buf);
+		return 1;
+	}
+	err = writer->begin(update_arg, &ctx);
+	if (err != ESP_OK) {
+		shell_printf(sess, "update: %s writer: %s\r\n", writer->name, esp_err_to_name(err));
+		free(buf);
+		return 1;
+	}
+
+	sha256_init(&hs);
+	while (n > 0) {
+		sha256_process(&hs, (const unsigned char *)buf, (unsigned long)n);
+		err = writer->write(ctx, buf, (size_t)n);
+		if (err != ESP_OK) break;
+		total += (unsigned long)n;
+		n = shell_read(sess, buf, UPDATE_CHUNK);
+	}
+	free(buf);
+	sha256_done(&hs, digest);
+	to_hex(hex, digest, sizeof(digest));
+
+	if (err != ESP_OK || n < 0) {
+		writer->abort(ctx);
+		if (err != ESP_OK) {
+			shell_printf(sess, "update: write failed after %lu bytes: %s\r\n",
+				total, esp_err_to_name(err));
+		}
+		return n < 0 ? 130 : 1;
+	}
+	if (argc == 2 && strcasecmp(argv[1], hex) != 0) {
+		writer->abort(ctx);
+		shell_printf(sess, "update: SHA-256 mismatch, got %s\r\n", hex);
+		return 1;
+	}
+	err = writer->finish(ctx);
+	if (err != ESP_OK) {
+		shell_printf(sess, "update: %lu bytes not accepted: %s\r\n",
+			total, esp_err_to_name(err));
+		return 1;
+	}
+
+	ESP_LOGI(TAG, "Update: %lu bytes written (%s)", total, writer->name);
+	shell_printf(sess, "update: %lu bytes, sha256 %s\r\n", total, hex);
+	shell_write(sess, "update: done, reset to run the new image\r\n");
+	return 0;
+}
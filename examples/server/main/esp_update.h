@@ -0,0 +1,47 @@
+#pragma once
+
+/*
+ * esp_update - Firmware update over SSH: `ssh dev update < firmware.bin`.
+ *
+ * The "update" command is a SHELL_CMD_STDIN command (see shell_cmd.h): the
+ * image is read from the channel in UPDATE_CHUNK pieces and handed to a
+ * writer as it arrives, so it is never held in memory. The channel window
+ * is only handed back as the command reads, so a slow writer (flash erase)
+ * slows the client down instead of filling a buffer. A SHA-256 of the data
+ * is computed on the way; if the client passes the expected digest
+ * (`update <sha256-hex>`) a mismatch aborts the update.
+ *
+ * Writers are pluggable. The default is esp_update_ota_writer (the next OTA
+ * app partition, made the boot partition once the image is complete), or
+ * esp_update_file_writer on the Linux target.
+ */
+
+#include <stddef.h>
+#include "sdkconfig.h"
+#include "esp_err.h"
+
+struct EspShellSess;
+
+typedef struct {
+	const char *name;
+	/* Start an image. `arg` is the one given to esp_update_set_writer(). */
+	esp_err_t (*begin)(void *arg, void **ctx);
+	esp_err_t (*write)(void *ctx, const void *data, size_t len);
+	/* All data written and its digest checked: make the image current. */
+	esp_err_t (*finish)(void *ctx);
+	/* Drop a partial image, e.g. after a failed write(). Not after finish(). */
+	void (*abort)(void *ctx);
+} esp_update_writer_t;
+
+#if !CONFIG_IDF_TARGET_LINUX
+/* Next OTA app partition (esp_ota_*). Needs an OTA partition table. */
+extern const esp_update_writer_t esp_update_ota_writer;
+#endif
+/* File at the path passed as `arg`, written as "<path>.part" and renamed. */
+extern const esp_update_writer_t esp_update_file_writer;
+
+/* Where "update" writes to. Not locked: set it before the server starts. */
+void esp_update_set_writer(const esp_update_writer_t *writer, void *arg);
+
+/* The "update [sha256-hex]" command handler (SHELL_CMD_STDIN). */
+int esp_update_cmd(struct EspShellSess *sess, int argc, char **argv);
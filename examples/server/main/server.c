@@ -21,13 +21,25 @@
 #include "crypto_desc.h"
 #include "dbrandom.h"
 #include "algo.h"
+#include "session_pool.h"
+#include "admission.h"
+#if CONFIG_DROPBEAR_KEX_PREGEN
+#include "kex_pregen.h"
+#endif
+#include "chan_inproc.h"
+#include "fwd_inproc.h"
+#include "esp_status_http.h"
 
 
 #define DEFAULT_PORT "2222"
 
-#if ENABLE_MEMORY_STATS
+#define STRINGIFY_(x) #x
+#define STRINGIFY(x)  STRINGIFY_(x)
+
 static const char *TAG = "dropbear_server";
 
+#if ENABLE_MEMORY_STATS
+
 /**
  * Print heap memory statistics to the console (same as libssh example).
  */
@@ -40,9 +52,21 @@ void print_mem_stats(const char *label)
 		heap_caps_get_free_size(MALLOC_CAP_INTERNAL));
 	ESP_LOGI(TAG, "  Free DRAM:          %zu bytes",
 		heap_caps_get_free_size(MALLOC_CAP_8BIT));
+	ESP_LOGI(TAG, "  Largest free block: %zu bytes",
+		heap_caps_get_largest_free_block(MALLOC_CAP_8BIT));
 	ESP_LOGI(TAG, "  Main task stack HWM: %u words free",
 		(unsigned)uxTaskGetStackHighWaterMark(NULL));
 }
+
+/**
+ * Log each channel window choice (CONFIG_DROPBEAR_ADAPTIVE_WINDOW).
+ */
+static void log_window(const struct Channel *channel, const struct chan_window_info *info)
+{
+	ESP_LOGI(TAG, "Channel %u: window %u (cap %u) | max packet %u | rtt %u us | free heap %u",
+		channel->index, info->window, info->cap, info->maxpacket, info->rtt_us,
+		info->free_heap);
+}
 #endif
 
 /*
@@ -91,9 +115,13 @@ static void dropbear_setup(const char *port)
 		"-F",
 		"-p",
 		(char *)port,
+		"-K",
+		STRINGIFY(CONFIG_DROPBEAR_KEEPALIVE),
+		"-I",
+		STRINGIFY(CONFIG_DROPBEAR_IDLE_TIMEOUT),
 		NULL
 	};
-	int argc = 4;
+	int argc = 8;
 
 	_dropbear_exit = svr_dropbear_exit;
 	_dropbear_log = svr_dropbear_log;
@@ -145,6 +173,42 @@ static size_t listen_sockets(int *socks, size_t sockcount, int *maxfd)
 	return sockpos;
 }
 
+/*
+ * "address:port" of a peer, for the log. The accept loop runs without the
+ * session pool lock, so it must not call Dropbear (getaddrstring(),
+ * dropbear_log(), m_malloc()) while sessions run.
+ */
+static void peer_string(const struct sockaddr_storage *addr, char *buf, size_t len)
+{
+	char host[INET6_ADDRSTRLEN] = "?";
+	unsigned int port = 0;
+
+	if (addr->ss_family == AF_INET) {
+		const struct sockaddr_in *sin = (const struct sockaddr_in *)addr;
+
+		(void)inet_ntop(AF_INET, &sin->sin_addr, host, sizeof(host));
+		port = ntohs(sin->sin_port);
+#if CONFIG_LWIP_IPV6
+	} else if (addr->ss_family == AF_INET6) {
+		const struct sockaddr_in6 *sin6 = (const struct sockaddr_in6 *)addr;
+
+		(void)inet_ntop(AF_INET6, &sin6->sin6_addr, host, sizeof(host));
+		port = ntohs(sin6->sin6_port);
+#endif
+	}
+	(void)snprintf(buf, len, "%s:%u", host, port);
+}
+
+/* RST rather than FIN: lwIP frees the pcb now instead of after TIME_WAIT. */
+static void refuse_connection(int sock)
+{
+	struct linger linger = { .l_onoff = 1, .l_linger = 0 };
+
+	/* fails without LWIP_SO_LINGER; a plain close() is fine then */
+	(void)setsockopt(sock, SOL_SOCKET, SO_LINGER, &linger, sizeof(linger));
+	close(sock);
+}
+
 void init_idf(void)
 {
 	    // Initialize ESP-IDF components
@@ -166,43 +230,94 @@ void app_main(void)
 	print_mem_stats("before dropbear_setup");
 #endif
 	dropbear_setup(DEFAULT_PORT);
+#if CONFIG_DROPBEAR_KEX_PREGEN
+	kex_pregen_init();
+#endif
 #if ENABLE_MEMORY_STATS
 	print_mem_stats("after dropbear_setup");
+	chan_inproc_set_window_hook(log_window);
 #endif
 
+	/* metrics for `ssh -L 8080:localhost:8080`; no socket listens on 8080 */
+	fwd_inproc_register("localhost", 8080, &esp_status_http);
+
 	listensockcount = listen_sockets(listensocks, MAX_LISTEN_ADDR, &maxfd);
 	if (listensockcount == 0) {
 		dropbear_exit("No listening ports available.");
 	}
 
+	admission_config_t admission_config = {
+		.min_free_heap = CONFIG_DROPBEAR_ADMIT_FREE_HEAP,
+		.burst = CONFIG_DROPBEAR_ADMIT_BURST,
+		.refill_ms = CONFIG_DROPBEAR_ADMIT_REFILL_MS,
+		.fail_limit = CONFIG_DROPBEAR_ADMIT_FAIL_LIMIT,
+		.block_secs = CONFIG_DROPBEAR_ADMIT_BLOCK_SECS,
+	};
+	admission_init(&admission_config);
+
+	session_pool_config_t pool_config = {
+		.max_sessions = CONFIG_DROPBEAR_MAX_SESSIONS,
+		.stack_size = CONFIG_DROPBEAR_SESSION_TASK_STACK_SIZE,
+		.priority = CONFIG_DROPBEAR_SESSION_TASK_PRIORITY,
+		.evict_below = CONFIG_DROPBEAR_EVICT_FREE_HEAP,
+		.check_secs = CONFIG_DROPBEAR_SUPERVISOR_PERIOD,
+		.closed = admission_session_closed,
+	};
+	session_pool_init(&pool_config);
+
 	printf("Dropbear SSH server listening on port %s\n", DEFAULT_PORT);
 
 	for (;;) {
-		struct sockaddr_storage remoteaddr;
-		socklen_t remoteaddrlen = sizeof(remoteaddr);
-		int childsock;
-		char *remote_host = NULL;
-		char *remote_port = NULL;
-
-		/* Simple example: block on the first listening socket. */
-		childsock = accept(listensocks[0], (struct sockaddr *)&remoteaddr, &remoteaddrlen);
-		if (childsock < 0) {
+		fd_set readfds;
+		size_t i;
+
+		/* Wait on every listening socket (IPv4 and IPv6). */
+		FD_ZERO(&readfds);
+		for (i = 0; i < listensockcount; i++) {
+			FD_SET(listensocks[i], &readfds);
+		}
+		if (select(maxfd + 1, &readfds, NULL, NULL, NULL) < 0) {
 			continue;
 		}
 
-		getaddrstring(&remoteaddr, &remote_host, &remote_port, 0);
-		dropbear_log(LOG_INFO, "Connection from %s:%s",
-			remote_host ? remote_host : "?",
-			remote_port ? remote_port : "?");
-		m_free(remote_host);
-		m_free(remote_port);
+		for (i = 0; i < listensockcount; i++) {
+			struct sockaddr_storage remoteaddr;
+			socklen_t remoteaddrlen = sizeof(remoteaddr);
+			int childsock;
+			admission_result_t verdict;
+			char peer[INET6_ADDRSTRLEN + 8];
+
+			if (!FD_ISSET(listensocks[i], &readfds)) {
+				continue;
+			}
+
+			childsock = accept(listensocks[i], (struct sockaddr *)&remoteaddr, &remoteaddrlen);
+			if (childsock < 0) {
+				continue;
+			}
+
+			peer_string(&remoteaddr, peer, sizeof(peer));
+
+			/* before the version exchange: a refusal costs no key exchange */
+			verdict = admission_check(&remoteaddr);
+			if (verdict != ADMISSION_OK) {
+				ESP_LOGD(TAG, "Refused %s: %s", peer, admission_reason(verdict));
+				refuse_connection(childsock);
+				continue;
+			}
+
+			if (session_pool_submit(childsock) == DROPBEAR_SUCCESS) {
+				ESP_LOGI(TAG, "Connection from %s (%u active)", peer,
+					session_pool_active());
+			} else {
+				ESP_LOGI(TAG, "Rejected %s, all %d sessions busy", peer,
+					CONFIG_DROPBEAR_MAX_SESSIONS);
+				refuse_connection(childsock);
+			}
 
 #if ENABLE_MEMORY_STATS
-		print_mem_stats("after session accepted");
+			print_mem_stats("after session accepted");
 #endif
-
-		seedrandom();
-		/* svr_session never returns. */
-		svr_session(childsock, -1);
+		}
 	}
 }
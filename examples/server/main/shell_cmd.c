@@ -0,0 +1,181 @@
+/*
+ * shell_cmd.c - Sorted command table for esp_shell.c, plus the esp_console
+ * import and fallback.
+ *
+ * The table is an array of shell_cmd_t kept in strcmp() order by
+ * shell_cmd_register(), so a lookup is a bsearch() over at most
+ * SHELL_CMD_MAX entries. esp_console keeps its commands in a linked list
+ * and offers no way to list them, so they are copied in as they are
+ * registered: __wrap_esp_console_cmd_register() adds an entry that calls
+ * the esp_console function. Lines naming no entry are handed to
+ * esp_console_run(). Either way stdout is pointed at the shell for the
+ * duration of the call. In ESP-IDF, stdout is per task, so only the
+ * calling task's output is redirected.
+ */
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "shell_cmd.h"
+
+static shell_cmd_t cmds[SHELL_CMD_MAX];
+static size_t cmd_count;
+
+static int cmd_compare(const void *key, const void *elem)
+{
+	return strcmp((const char *)key, ((const shell_cmd_t *)elem)->command);
+}
+
+esp_err_t shell_cmd_register(const shell_cmd_t *cmd)
+{
+	size_t lo = 0, hi = cmd_count;
+
+	if (cmd == NULL || cmd->command == NULL || cmd->func == NULL
+			|| strchr(cmd->command, ' ') != NULL) {
+		return ESP_ERR_INVALID_ARG;
+	}
+
+	/* insertion point: first entry not less than cmd->command */
+	while (lo < hi) {
+		size_t mid = (lo + hi) / 2;
+		if (strcmp(cmds[mid].command, cmd->command) < 0) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+
+	if (lo < cmd_count && strcmp(cmds[lo].command, cmd->command) == 0) {
+		cmds[lo] = *cmd;
+		return ESP_OK;
+	}
+	if (cmd_count == SHELL_CMD_MAX) {
+		return ESP_ERR_NO_MEM;
+	}
+
+	memmove(&cmds[lo + 1], &cmds[lo], (cmd_count - lo) * sizeof(cmds[0]));
+	cmds[lo] = *cmd;
+	cmd_count++;
+	return ESP_OK;
+}
+
+const shell_cmd_t *shell_cmd_find(const char *name)
+{
+	return bsearch(name, cmds, cmd_count, sizeof(cmds[0]), cmd_compare);
+}
+
+size_t shell_cmd_count(void)
+{
+	return cmd_count;
+}
+
+const shell_cmd_t *shell_cmd_at(size_t index)
+{
+	return index < cmd_count ? &cmds[index] : NULL;
+}
+
+/* ------------------------------------------------------------------ */
+/*  esp_console import and fallback                                   */
+/* ------------------------------------------------------------------ */
+
+/* stdout of an esp_console command: "\n" becomes "\r\n" for the terminal. */
+static int console_write(void *cookie, const char *data, int len)
+{
+	struct EspShellSess *sess = (struct EspShellSess *)cookie;
+	int start = 0, i;
+
+	for (i = 0; i < len; i++) {
+		if (data[i] == '\n') {
+			shell_put(sess, data + start, (unsigned int)(i - start));
+			shell_put(sess, "\r\n", 2);
+			start = i + 1;
+		}
+	}
+	shell_put(sess, data + start, (unsigned int)(len - start));
+	return len;
+}
+
+/* Point this task's stdout at the shell. NULL if out of memory. */
+static FILE *console_stdout_open(struct EspShellSess *sess, FILE **saved)
+{
+	FILE *out = funopen(sess, NULL, console_write, NULL, NULL);
+
+	if (out != NULL) {
+		*saved = stdout;
+		stdout = out;
+	}
+	return out;
+}
+
+static void console_stdout_close(FILE *out, FILE *saved)
+{
+	fflush(out);
+	stdout = saved;
+	fclose(out);
+}
+
+esp_err_t shell_cmd_run_console(struct EspShellSess *sess, const char *line, int *ret)
+{
+	FILE *out, *saved;
+	esp_err_t err;
+
+	out = console_stdout_open(sess, &saved);
+	if (out == NULL) {
+		return ESP_ERR_NO_MEM;
+	}
+	err = esp_console_run(line, ret);
+	console_stdout_close(out, saved);
+
+	return err;
+}
+
+/* func of an imported esp_console command, run on a worker (SHELL_CMD_ASYNC). */
+static int console_cmd_run(struct EspShellSess *sess, int argc, char **argv)
+{
+	const shell_cmd_t *cmd = shell_cmd_find(argv[0]);
+	FILE *out, *saved;
+	int ret;
+
+	out = console_stdout_open(sess, &saved);
+	if (out == NULL) {
+		shell_write(sess, "Out of memory\r\n");
+		return 1;
+	}
+	ret = cmd->console(argc, argv);
+	console_stdout_close(out, saved);
+
+	if (ret != 0) {
+		shell_printf(sess, "Command returned %d\r\n", ret);
+	}
+	return ret;
+}
+
+esp_err_t __real_esp_console_cmd_register(const esp_console_cmd_t *cmd);
+
+esp_err_t __wrap_esp_console_cmd_register(const esp_console_cmd_t *cmd)
+{
+	const shell_cmd_t *existing;
+	shell_cmd_t entry;
+	esp_err_t err;
+
+	err = __real_esp_console_cmd_register(cmd);
+	if (err != ESP_OK || cmd->func == NULL) {
+		return err;
+	}
+	/* commands registered with shell_cmd_register() win */
+	existing = shell_cmd_find(cmd->command);
+	if (existing != NULL && existing->console == NULL) {
+		return err;
+	}
+
+	entry.command = cmd->command;
+	entry.help = cmd->help;
+	entry.func = console_cmd_run;
+	entry.flags = SHELL_CMD_ASYNC;
+	entry.console = cmd->func;
+	/* table full: the line still reaches esp_console_run() */
+	(void)shell_cmd_register(&entry);
+	return err;
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+/*
+ * shell_cmd - Command registry for the SSH shell (esp_shell.c).
+ *
+ * Commands are kept in one table sorted by name and looked up with
+ * bsearch(), so adding commands does not slow down dispatch. The entry
+ * layout follows esp_console_cmd_t. Register commands before the server
+ * starts accepting connections (e.g. from app_main()); the table is not
+ * locked.
+ *
+ * Commands registered with esp_console_cmd_register() are entered in the
+ * table as well (the component links with
+ * -Wl,--wrap=esp_console_cmd_register), flagged SHELL_CMD_ASYNC, so they
+ * are listed by 'help' and dispatched like any other; their stdout is sent
+ * to the SSH client. A command already registered here under the same name
+ * is kept. Lines that still name no command (esp_console's own "help",
+ * commands with only func_w_context) are passed to esp_console_run(), if
+ * the application has called esp_console_init().
+ */
+
+#include <stddef.h>
+#include "esp_err.h"
+#include "esp_console.h"
+
+struct EspShellSess;
+
+typedef int (*shell_cmd_func_t)(struct EspShellSess *sess, int argc, char **argv);
+
+/* Output is sent as it is written instead of once the command returns. */
+#define SHELL_CMD_STREAMING     0x01
+/*
+ * Runs on a worker task, so the SSH session stays responsive. Output is
+ * streamed with flow control, and Ctrl-C cancels (see shell_cancelled()).
+ */
+#define SHELL_CMD_ASYNC         0x02
+/*
+ * Reads the client's data with shell_read(), e.g. `ssh dev update < fw.bin`.
+ * Only an "exec" request feeds data; implies SHELL_CMD_ASYNC.
+ */
+#define SHELL_CMD_STDIN         0x04
+
+typedef struct {
+	const char *command;        /* name, no spaces; must stay valid       */
+	const char *help;           /* one line for 'help', may be NULL       */
+	shell_cmd_func_t func;
+	unsigned int flags;         /* SHELL_CMD_*                            */
+	esp_console_cmd_func_t console; /* imported esp_console command, or NULL */
+} shell_cmd_t;
+
+#define SHELL_CMD_MAX           64
+#define SHELL_CMD_MAX_ARGS      8
+
+/*
+ * Add `cmd` to the registry (the struct is copied, the strings are not).
+ * A command with the same name is replaced. ESP_ERR_NO_MEM if the table
+ * is full.
+ */
+esp_err_t shell_cmd_register(const shell_cmd_t *cmd);
+
+/* Registered command called `name`, or NULL. */
+const shell_cmd_t *shell_cmd_find(const char *name);
+
+/* Registered commands in name order, for 'help'. */
+size_t shell_cmd_count(void);
+const shell_cmd_t *shell_cmd_at(size_t index);
+
+/*
+ * Run `line` through esp_console_run() with this task's stdout sent to the
+ * shell. ESP_ERR_NOT_FOUND if esp_console does not know the command,
+ * ESP_ERR_INVALID_STATE if esp_console is not initialised.
+ */
+esp_err_t shell_cmd_run_console(struct EspShellSess *sess, const char *line, int *ret);
+
+/* Output helpers for command handlers (esp_shell.c). */
+void shell_write(struct EspShellSess *sess, const char *s);
+void shell_put(struct EspShellSess *sess, const void *data, unsigned int len);
+void shell_printf(struct EspShellSess *sess, const char *fmt, ...)
+	__attribute__((format(printf, 2, 3)));
+
+/* Ctrl-C was pressed. Long-running SHELL_CMD_ASYNC handlers should return. */
+int shell_cancelled(struct EspShellSess *sess);
+
+/*
+ * SHELL_CMD_STDIN handlers: up to `len` bytes of client data, waiting for
+ * them. Returns the byte count, 0 at the client's EOF, or -1 if cancelled or
+ * the command was not started with data (interactive shell).
+ */
+int shell_read(struct EspShellSess *sess, void *buf, size_t len);
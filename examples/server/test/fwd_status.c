@@ -0,0 +1,119 @@
+/*
+ * fwd_status.c - port/fwd_inproc.c with the esp_status_http endpoint.
+ *
+ * Calls the connect_remote() wrapper as svr-tcpfwd.c would for a
+ * direct-tcpip channel. Targets that are not registered, other callbacks
+ * and unparsable ports must reach the real connect_remote(). A registered
+ * target is served in place: open confirmation with the fds left
+ * FD_UNINIT, one reply once the request header is complete, then close.
+ * Cleanup detaches the channel.
+ */
+
+#include "includes.h"
+#include "session.h"
+#include "channel.h"
+#include "netio.h"
+#include "shell_host.h"
+#include "fwd_inproc.h"
+#include "esp_status_http.h"
+
+static unsigned int failures;
+
+#define CHECK(cond) do { \
+	if (!(cond)) { \
+		fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond); \
+		failures++; \
+	} \
+} while (0)
+
+struct dropbear_progress_connection *__wrap_connect_remote(const char *remotehost,
+	const char *remoteport, connect_callback cb, void *cb_data,
+	const char *bind_address, const char *bind_port, enum dropbear_prio prio);
+
+static unsigned int real_connects;
+static int connect_result = 1, connect_sock;
+
+/* Dropbear's: a socket connect in progress */
+struct dropbear_progress_connection *__real_connect_remote(const char *remotehost,
+	const char *remoteport, connect_callback cb, void *cb_data,
+	const char *bind_address, const char *bind_port, enum dropbear_prio prio)
+{
+	(void)remotehost;
+	(void)remoteport;
+	(void)cb;
+	(void)cb_data;
+	(void)bind_address;
+	(void)bind_port;
+	(void)prio;
+	real_connects++;
+	return (struct dropbear_progress_connection *)&real_connects;
+}
+
+void channel_connect_done(int result, int sock, void *user_data, const char *errstring)
+{
+	(void)user_data;
+	(void)errstring;
+	connect_result = result;
+	connect_sock = sock;
+}
+
+static void other_callback(int result, int sock, void *data, const char *errstring)
+{
+	(void)result;
+	(void)sock;
+	(void)data;
+	(void)errstring;
+}
+
+static struct host_chan hc;
+
+static void connect(const char *host, const char *port, connect_callback cb)
+{
+	__wrap_connect_remote(host, port, cb, &hc.channel, NULL, NULL, DROPBEAR_PRIO_NORMAL);
+}
+
+static void recv_str(const char *s)
+{
+	hc.ops->recv(&hc.channel, (const unsigned char *)s, (unsigned int)strlen(s));
+}
+
+int main(void)
+{
+	CHECK(fwd_inproc_register("localhost", 8080, &esp_status_http) == DROPBEAR_SUCCESS);
+	hc.window = ~0u;
+	hc.channel.readfd = hc.channel.writefd = FD_UNINIT;
+
+	connect("example.com", "8080", channel_connect_done);
+	connect("127.0.0.1", "8081", channel_connect_done);
+	connect("::1", "8080x", channel_connect_done);
+	connect("localhost", "8080", other_callback);
+	CHECK(real_connects == 4 && !hc.attached && fwd_inproc_get_count() == 0);
+
+	connect("LocalHost", "8080", channel_connect_done);
+	CHECK(real_connects == 4 && hc.attached);
+	CHECK(connect_result == DROPBEAR_SUCCESS && connect_sock == FD_UNINIT);
+	CHECK(hc.channel.readfd == FD_UNINIT && hc.channel.writefd == FD_UNINIT);
+	CHECK(strcmp(hc.channel.type->name, "direct-tcpip") == 0);
+	CHECK(fwd_inproc_get_count() == 1);
+
+	/* split before the final \n: nothing yet */
+	recv_str("GET / HTTP/1.1\r\nHost: localhost:8080\r\n\r");
+	CHECK(hc.out_len == 0 && !hc.closed);
+	recv_str("\n");
+	hc.out[hc.out_len] = '\0';
+	CHECK(strncmp(hc.out, "HTTP/1.0 200 OK\r\n", 17) == 0);
+	CHECK(strstr(hc.out, "\r\n\r\nuptime_ms ") != NULL);
+	CHECK(strstr(hc.out, "inproc_forwards 1\n") != NULL);
+	CHECK(hc.closed);
+
+	/* once: more input gets no second reply */
+	hc.out_len = 0;
+	recv_str("GET / HTTP/1.1\r\n\r\n");
+	CHECK(hc.out_len == 0);
+
+	hc.channel.type->cleanup(&hc.channel);
+	CHECK(!hc.attached);
+
+	printf("fwd_status: %s\n", failures ? "FAILED" : "ok");
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,100 @@
+/*
+ * buffer.c - Host stand-in for Dropbear's buffer.c: growable, with the
+ * bounds checks ending in dropbear_exit().
+ */
+
+#include "includes.h"
+#include "buffer.h"
+#include "dbutil.h"
+
+static void buf_grow(buffer *buf, unsigned int len)
+{
+	if (buf->len + len > buf->size) {
+		buf->size = (buf->len + len) * 2;
+		buf->data = realloc(buf->data, buf->size);
+	}
+}
+
+void buf_putbyte(buffer *buf, unsigned char val)
+{
+	buf_grow(buf, 1);
+	buf->data[buf->len++] = val;
+}
+
+void buf_putint(buffer *buf, unsigned int val)
+{
+	buf_putbyte(buf, val >> 24);
+	buf_putbyte(buf, val >> 16);
+	buf_putbyte(buf, val >> 8);
+	buf_putbyte(buf, val);
+}
+
+void buf_putstring(buffer *buf, const char *str, unsigned int len)
+{
+	buf_putint(buf, len);
+	buf_grow(buf, len);
+	memcpy(buf->data + buf->len, str, len);
+	buf->len += len;
+}
+
+unsigned int buf_getint(buffer *buf)
+{
+	unsigned int v;
+
+	if (buf->pos + 4 > buf->len) {
+		dropbear_exit("buf_getint past the end");
+	}
+	v = (unsigned int)buf->data[buf->pos] << 24 | buf->data[buf->pos + 1] << 16
+		| buf->data[buf->pos + 2] << 8 | buf->data[buf->pos + 3];
+	buf->pos += 4;
+	return v;
+}
+
+char *buf_getstring(buffer *buf, unsigned int *retlen)
+{
+	unsigned int len = buf_getint(buf);
+	char *s;
+
+	if (buf->pos + len > buf->len) {
+		dropbear_exit("buf_getstring past the end");
+	}
+	s = m_malloc(len + 1);
+	memcpy(s, buf->data + buf->pos, len);
+	buf->pos += len;
+	if (retlen != NULL) {
+		*retlen = len;
+	}
+	return s;
+}
+
+int buf_getbool(buffer *buf)
+{
+	if (buf->pos >= buf->len) {
+		dropbear_exit("buf_getbool past the end");
+	}
+	return buf->data[buf->pos++] != 0;
+}
+
+unsigned char *buf_getptr(const buffer *buf, unsigned int len)
+{
+	if (len > buf->len - buf->pos) {
+		dropbear_exit("buf_getptr past the end");
+	}
+	return buf->data + buf->pos;
+}
+
+void buf_incrpos(buffer *buf, unsigned int incr)
+{
+	if (incr > buf->len - buf->pos) {
+		dropbear_exit("buf_incrpos past the end");
+	}
+	buf->pos += incr;
+}
+
+void buf_setpos(buffer *buf, unsigned int pos)
+{
+	if (pos > buf->len) {
+		dropbear_exit("buf_setpos past the end");
+	}
+	buf->pos = pos;
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+/* Host stand-in for Dropbear's buffer.h: what esp_shell.c and chan_inproc.c use. */
+
+typedef struct buffer {
+	unsigned char *data;
+	unsigned int len;
+	unsigned int pos;
+	unsigned int size;
+} buffer;
+
+void buf_putbyte(buffer *buf, unsigned char val);
+void buf_putint(buffer *buf, unsigned int val);
+void buf_putstring(buffer *buf, const char *str, unsigned int len);
+unsigned int buf_getint(buffer *buf);
+char *buf_getstring(buffer *buf, unsigned int *retlen);
+int buf_getbool(buffer *buf);
+unsigned char *buf_getptr(const buffer *buf, unsigned int len);
+void buf_incrpos(buffer *buf, unsigned int incr);
+void buf_setpos(buffer *buf, unsigned int pos);
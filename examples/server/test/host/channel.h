@@ -0,0 +1,46 @@
+#pragma once
+
+/* Host stand-in for Dropbear's channel.h (the ESP-IDF fork's ChanType). */
+
+#include "buffer.h"
+
+#define FD_UNINIT (-2)
+#define FD_CLOSED (-1)
+
+/* a window adjust goes out once this much has been consumed (needs runopts.h) */
+#define RECV_WINDOWEXTEND (opts.recv_window / 3)
+
+struct Channel;
+
+struct ChanType {
+	const char *name;
+	int (*inithandler)(struct Channel *channel);
+	int (*check_close)(struct Channel *channel);
+	void (*reqhandler)(struct Channel *channel);
+	void (*closehandler)(const struct Channel *channel);
+	void (*cleanup)(const struct Channel *channel);
+	void (*set_extra_fds)(struct Channel *channel, fd_set *readfds, fd_set *writefds);
+	void (*handle_extra_io)(struct Channel *channel, const fd_set *readfds,
+			const fd_set *writefds);
+};
+
+struct Channel {
+	unsigned int index;
+	unsigned int remotechan;
+	unsigned int recvwindow, transwindow;
+	unsigned int recvmaxpacket, transmaxpacket;
+	void *typedata;
+	int readfd, writefd, errfd;
+	int bidir_fd;
+	int sent_close, recv_close;
+	int recv_eof, sent_eof;
+	int prio;
+	const struct ChanType *type;
+};
+
+/* the channel named by the next uint32 in ses.payload */
+struct Channel *getchannel(void);
+void send_msg_channel_success(struct Channel *channel);
+void send_msg_channel_failure(struct Channel *channel);
+/* svr-tcpfwd.c's connect_remote() callback: open confirmation or failure */
+void channel_connect_done(int result, int sock, void *user_data, const char *errstring);
@@ -0,0 +1,5 @@
+#pragma once
+
+/* Host stand-in for Dropbear's chansession.h. */
+
+extern const struct ChanType svrchansess;
@@ -0,0 +1,86 @@
+/*
+ * circbuffer.c - Host stand-in for Dropbear's circbuffer.c, for the tests
+ * that link esp_sftp.c or port/chan_inproc.c. Misuse aborts, as
+ * dropbear_exit() would.
+ */
+
+#include "includes.h"
+#include "dbutil.h"
+#include "circbuffer.h"
+
+circbuffer *cbuf_new(unsigned int size)
+{
+	circbuffer *cbuf = m_malloc(sizeof(*cbuf));
+
+	cbuf->data = m_malloc(size);
+	cbuf->size = size;
+	return cbuf;
+}
+
+void cbuf_free(circbuffer *cbuf)
+{
+	free(cbuf->data);
+	free(cbuf);
+}
+
+unsigned int cbuf_getused(const circbuffer *cbuf)
+{
+	return cbuf->used;
+}
+
+unsigned int cbuf_getavail(const circbuffer *cbuf)
+{
+	return cbuf->size - cbuf->used;
+}
+
+/* contiguous room at the write position */
+unsigned int cbuf_writelen(const circbuffer *cbuf)
+{
+	if (cbuf->used == cbuf->size) {
+		return 0;
+	}
+	if (cbuf->writepos < cbuf->readpos) {
+		return cbuf->readpos - cbuf->writepos;
+	}
+	return cbuf->size - cbuf->writepos;
+}
+
+void cbuf_readptrs(const circbuffer *cbuf, unsigned char **p1, unsigned int *len1,
+	unsigned char **p2, unsigned int *len2)
+{
+	*p1 = &cbuf->data[cbuf->readpos];
+	*len1 = MIN(cbuf->used, cbuf->size - cbuf->readpos);
+	if (*len1 < cbuf->used) {
+		*p2 = cbuf->data;
+		*len2 = cbuf->used - *len1;
+	} else {
+		*p2 = NULL;
+		*len2 = 0;
+	}
+}
+
+unsigned char *cbuf_writeptr(circbuffer *cbuf, unsigned int len)
+{
+	if (len > cbuf_writelen(cbuf)) {
+		dropbear_exit("Bad cbuf write");
+	}
+	return &cbuf->data[cbuf->writepos];
+}
+
+void cbuf_incrwrite(circbuffer *cbuf, unsigned int len)
+{
+	if (len > cbuf_writelen(cbuf)) {
+		dropbear_exit("Bad cbuf write");
+	}
+	cbuf->used += len;
+	cbuf->writepos = (cbuf->writepos + len) % cbuf->size;
+}
+
+void cbuf_incrread(circbuffer *cbuf, unsigned int len)
+{
+	if (len > cbuf->used) {
+		dropbear_exit("Bad cbuf read");
+	}
+	cbuf->used -= len;
+	cbuf->readpos = (cbuf->readpos + len) % cbuf->size;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+/* Host stand-in for Dropbear's circbuffer.h, same interface. */
+
+typedef struct circbuf {
+	unsigned int size;
+	unsigned int readpos;
+	unsigned int writepos;
+	unsigned int used;
+	unsigned char *data;
+} circbuffer;
+
+circbuffer *cbuf_new(unsigned int size);
+void cbuf_free(circbuffer *cbuf);
+
+unsigned int cbuf_getused(const circbuffer *cbuf);
+unsigned int cbuf_getavail(const circbuffer *cbuf);
+unsigned int cbuf_writelen(const circbuffer *cbuf);
+
+void cbuf_readptrs(const circbuffer *cbuf, unsigned char **p1, unsigned int *len1,
+	unsigned char **p2, unsigned int *len2);
+unsigned char *cbuf_writeptr(circbuffer *cbuf, unsigned int len);
+
+void cbuf_incrwrite(circbuffer *cbuf, unsigned int len);
+void cbuf_incrread(circbuffer *cbuf, unsigned int len);
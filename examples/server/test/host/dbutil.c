@@ -0,0 +1,35 @@
+/*
+ * dbutil.c - Host stand-in for Dropbear's dbutil.c: exits abort(), so a
+ * test fails where Dropbear would have dropped the connection.
+ */
+
+#include "includes.h"
+#include "dbutil.h"
+
+void dropbear_exit(const char *format, ...)
+{
+	va_list ap;
+
+	va_start(ap, format);
+	fprintf(stderr, "dropbear_exit: ");
+	vfprintf(stderr, format, ap);
+	fprintf(stderr, "\n");
+	va_end(ap);
+	abort();
+}
+
+void dropbear_log(int priority, const char *format, ...)
+{
+	(void)priority;
+	(void)format;
+}
+
+void *m_malloc(size_t size)
+{
+	void *p = calloc(1, size);
+
+	if (p == NULL) {
+		dropbear_exit("m_malloc failed");
+	}
+	return p;
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+/* Host stand-in for Dropbear's dbutil.h. */
+
+void dropbear_exit(const char *format, ...) ATTRIB_NORETURN;
+void dropbear_log(int priority, const char *format, ...);
+
+void *m_malloc(size_t size);
+#define m_free(x) do { free(x); (x) = NULL; } while (0)
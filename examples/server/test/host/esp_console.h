@@ -0,0 +1,26 @@
+#pragma once
+
+/*
+ * Host stand-in for ESP-IDF's esp_console.h. host/shell_host.c registers
+ * one console command, "ctest", which prints a line and returns 3, with
+ * esp_console_run() only. esp_console_cmd_register() accepts anything; the
+ * tests link with -Wl,--wrap=esp_console_cmd_register like the example.
+ */
+
+#include <stddef.h>
+#include "esp_err.h"
+
+typedef int (*esp_console_cmd_func_t)(int argc, char **argv);
+
+typedef struct {
+	const char *command;
+	const char *help;
+	const char *hint;
+	esp_console_cmd_func_t func;
+	void *argtable;
+} esp_console_cmd_t;
+
+esp_err_t esp_console_cmd_register(const esp_console_cmd_t *cmd);
+
+esp_err_t esp_console_run(const char *cmdline, int *cmd_ret);
+size_t esp_console_split_argv(char *line, char **argv, size_t argv_size);
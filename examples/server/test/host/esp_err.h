@@ -0,0 +1,25 @@
+#pragma once
+
+/* Host stand-in for ESP-IDF's esp_err.h. */
+
+typedef int esp_err_t;
+
+#define ESP_OK                  0
+#define ESP_FAIL                -1
+#define ESP_ERR_NO_MEM          0x101
+#define ESP_ERR_INVALID_ARG     0x102
+#define ESP_ERR_INVALID_STATE   0x103
+#define ESP_ERR_NOT_FOUND       0x105
+
+static inline const char *esp_err_to_name(esp_err_t code)
+{
+	switch (code) {
+	case ESP_OK:                return "ESP_OK";
+	case ESP_FAIL:              return "ESP_FAIL";
+	case ESP_ERR_NO_MEM:        return "ESP_ERR_NO_MEM";
+	case ESP_ERR_INVALID_ARG:   return "ESP_ERR_INVALID_ARG";
+	case ESP_ERR_INVALID_STATE: return "ESP_ERR_INVALID_STATE";
+	case ESP_ERR_NOT_FOUND:     return "ESP_ERR_NOT_FOUND";
+	default:                    return "UNKNOWN ERROR";
+	}
+}
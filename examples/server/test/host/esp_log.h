@@ -0,0 +1,7 @@
+#pragma once
+
+/* Host stand-in for ESP-IDF's esp_log.h. */
+
+#define ESP_LOGI(tag, ...) do { (void)(tag); } while (0)
+#define ESP_LOGW(tag, ...) do { (void)(tag); } while (0)
+#define ESP_LOGE(tag, ...) do { (void)(tag); } while (0)
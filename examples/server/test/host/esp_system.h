@@ -0,0 +1,9 @@
+#pragma once
+
+/* Host stand-in for ESP-IDF's esp_system.h. */
+
+#include <stdint.h>
+
+void esp_restart(void);
+uint32_t esp_get_free_heap_size(void);
+uint32_t esp_get_minimum_free_heap_size(void);
@@ -0,0 +1,7 @@
+#pragma once
+
+/* Host stand-in for ESP-IDF's esp_timer.h; each test supplies the clock. */
+
+#include <stdint.h>
+
+int64_t esp_timer_get_time(void);
@@ -0,0 +1,12 @@
+#pragma once
+
+/* Host stand-in for FreeRTOS.h: 1 tick = 1 ms, tasks are pthreads. */
+
+#include <stdint.h>
+
+typedef uint32_t TickType_t;
+typedef unsigned int UBaseType_t;
+
+#define portTICK_PERIOD_MS  1
+#define pdMS_TO_TICKS(ms)   ((TickType_t)(ms))
+#define pdPASS              1
@@ -0,0 +1,15 @@
+#pragma once
+
+/* Host stand-in for FreeRTOS stream_buffer.h. */
+
+#include <stddef.h>
+#include "freertos/FreeRTOS.h"
+
+typedef struct host_stream_buffer *StreamBufferHandle_t;
+
+StreamBufferHandle_t xStreamBufferCreate(size_t size, size_t trigger);
+void vStreamBufferDelete(StreamBufferHandle_t sb);
+size_t xStreamBufferSend(StreamBufferHandle_t sb, const void *data, size_t len, TickType_t wait);
+size_t xStreamBufferReceive(StreamBufferHandle_t sb, void *data, size_t len, TickType_t wait);
+size_t xStreamBufferBytesAvailable(StreamBufferHandle_t sb);
+int xStreamBufferIsEmpty(StreamBufferHandle_t sb);
@@ -0,0 +1,24 @@
+#pragma once
+
+/* Host stand-in for FreeRTOS task.h; critical sections take one global mutex. */
+
+#include "freertos/FreeRTOS.h"
+
+typedef int portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED 0
+
+void host_critical_enter(void);
+void host_critical_exit(void);
+#define taskENTER_CRITICAL(mux) do { (void)(mux); host_critical_enter(); } while (0)
+#define taskEXIT_CRITICAL(mux)  do { (void)(mux); host_critical_exit(); } while (0)
+
+#define tskIDLE_PRIORITY 0
+
+typedef void (*TaskFunction_t)(void *arg);
+typedef void *TaskHandle_t;
+
+int xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack, void *arg,
+		UBaseType_t prio, TaskHandle_t *handle);
+void vTaskDelete(TaskHandle_t task);
+void vTaskDelay(TickType_t ticks);
+TickType_t xTaskGetTickCount(void);
@@ -0,0 +1,33 @@
+#pragma once
+
+/*
+ * Host stand-in for Dropbear's includes.h, for the esp_shell.c tests: the
+ * system headers and macros the example's channel code uses. See
+ * ../Makefile.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <sys/select.h>
+
+#include "sdkconfig.h"
+#include "tomcrypt.h"
+
+#define DROPBEAR_SUCCESS 0
+#define DROPBEAR_FAILURE -1
+#define ATTRIB_NORETURN __attribute__((noreturn))
+#define TRACE(x)
+
+#define LOG_WARNING 4
+#define LOG_INFO 6
+
+#ifndef MAX
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+#endif
+#ifndef MIN
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#endif
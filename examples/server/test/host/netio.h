@@ -0,0 +1,17 @@
+#pragma once
+
+/* Host stand-in for Dropbear's netio.h: connect_remote() and its callback. */
+
+enum dropbear_prio {
+	DROPBEAR_PRIO_NORMAL = 0,
+	DROPBEAR_PRIO_LOWDELAY,
+	DROPBEAR_PRIO_BULK,
+};
+
+typedef void (*connect_callback)(int result, int sock, void *data, const char *errstring);
+
+struct dropbear_progress_connection;
+
+struct dropbear_progress_connection *connect_remote(const char *remotehost,
+	const char *remoteport, connect_callback cb, void *cb_data,
+	const char *bind_address, const char *bind_port, enum dropbear_prio prio);
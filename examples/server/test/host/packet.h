@@ -0,0 +1,5 @@
+#pragma once
+
+/* Host stand-in for Dropbear's packet.h. */
+
+void encrypt_packet(void);
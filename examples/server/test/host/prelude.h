@@ -0,0 +1,22 @@
+#pragma once
+
+/*
+ * Included ahead of every source (-include in ../Makefile), for what a
+ * quoted #include would otherwise take from ../main or expect from newlib.
+ */
+
+#include <stdio.h>
+
+/* ../main/mem_stats.h: no FreeRTOS task stats on the host */
+#define MAIN_MEM_STATS_H
+#define ENABLE_MEMORY_STATS 0
+
+static inline void print_mem_stats(const char *label)
+{
+	(void)label;
+}
+
+/* newlib's stdio.h; host/shell_host.c builds it on fopencookie() */
+FILE *funopen(const void *cookie, int (*readfn)(void *, char *, int),
+		int (*writefn)(void *, const char *, int),
+		long (*seekfn)(void *, long, int), int (*closefn)(void *));
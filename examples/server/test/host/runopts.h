@@ -0,0 +1,9 @@
+#pragma once
+
+/* Host stand-in for Dropbear's runopts.h: the channel window option. */
+
+typedef struct runopts {
+	unsigned int recv_window;
+} runopts;
+
+extern runopts opts;
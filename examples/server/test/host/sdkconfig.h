@@ -0,0 +1,10 @@
+#pragma once
+
+/* The Kconfig defaults the example code under test depends on. */
+
+#define CONFIG_IDF_TARGET_LINUX 1
+#define CONFIG_DROPBEAR_MAX_SESSIONS 2
+#define CONFIG_DROPBEAR_MAX_SESSION_CHANNELS 4
+#define CONFIG_DROPBEAR_ADAPTIVE_WINDOW 1
+#define CONFIG_DROPBEAR_WINDOW_MAX 65536
+#define CONFIG_DROPBEAR_WINDOW_HEAP_RESERVE 49152
@@ -0,0 +1,19 @@
+#pragma once
+
+/* Host stand-in for Dropbear's session.h: the fields esp_shell.c uses. */
+
+#include "buffer.h"
+#include "channel.h"
+#include "netio.h"
+
+struct sshsession {
+	int sock_in;
+	int maxfd;
+	int dataallowed;
+	buffer *payload;
+	buffer *writepayload;
+	struct Channel **channels;
+	unsigned int chansize;
+};
+
+extern struct sshsession ses;
@@ -0,0 +1,630 @@
+/*
+ * shell_host.c - Dropbear, chan_inproc, FreeRTOS and ESP-IDF stand-ins for
+ * the esp_shell.c tests. Tasks are pthreads, stream buffers are a mutex
+ * and a condition variable, and the channel records what the client would
+ * receive.
+ */
+
+#include <pthread.h>
+#include <time.h>
+#include <sys/socket.h>
+
+#include "includes.h"
+#include "session.h"
+#include "chansession.h"
+#include "dbutil.h"
+#include "packet.h"
+#include "ssh.h"
+#include "chan_inproc.h"
+#include "esp_sftp.h"
+#include "esp_update.h"
+#include "esp_system.h"
+#include "esp_vfs_eventfd.h"
+#include "esp_console.h"
+#include "freertos/task.h"
+#include "freertos/stream_buffer.h"
+#include "shell_host.h"
+
+struct sshsession ses;
+TickType_t host_tick_offset;
+int host_input_waiting;
+unsigned long host_largest_visit;
+
+static struct host_chan chans[HOST_MAX_CHANNELS];
+static struct Channel *channel_table[HOST_MAX_CHANNELS];
+static buffer payload, writepayload;
+
+/* ---- Dropbear ---- */
+
+static struct host_chan *find_remote(unsigned int remotechan)
+{
+	unsigned int i;
+
+	for (i = 0; i < HOST_MAX_CHANNELS; i++) {
+		if (channel_table[i] != NULL && chans[i].channel.remotechan == remotechan) {
+			return &chans[i];
+		}
+	}
+	return NULL;
+}
+
+/* Only channel requests go out through ses.writepayload here: exit-status. */
+void encrypt_packet(void)
+{
+	buffer *buf = ses.writepayload;
+	struct host_chan *hc;
+	char *name;
+
+	buf->pos = 0;
+	if (buf->len > 0 && buf->data[buf->pos++] == SSH_MSG_CHANNEL_REQUEST) {
+		hc = find_remote(buf_getint(buf));
+		name = buf_getstring(buf, NULL);
+		(void)buf_getbool(buf);
+		if (hc != NULL && strcmp(name, "exit-status") == 0) {
+			hc->exit_status = (int)buf_getint(buf);
+			hc->out_at_exit = hc->out_len;
+		}
+		free(name);
+	}
+	buf->len = 0;
+	buf->pos = 0;
+}
+
+void send_msg_channel_success(struct Channel *channel)
+{
+	(void)channel;
+}
+
+void send_msg_channel_failure(struct Channel *channel)
+{
+	(void)channel;
+}
+
+/* esp_shell.c peeks at the session socket; -Drecv=host_recv in the Makefile */
+ssize_t host_recv(int fd, void *buf, size_t len, int flags)
+{
+	(void)fd;
+	(void)buf;
+	(void)len;
+	(void)flags;
+	return host_input_waiting ? 1 : 0;
+}
+
+/* ---- chan_inproc, recording ---- */
+
+static struct host_chan *hc_of(const struct Channel *channel)
+{
+	return (struct host_chan *)channel;
+}
+
+int chan_inproc_attach(struct Channel *channel, const struct chan_inproc_ops *ops)
+{
+	hc_of(channel)->ops = ops;
+	hc_of(channel)->attached = 1;
+	return DROPBEAR_SUCCESS;
+}
+
+void chan_inproc_detach(const struct Channel *channel)
+{
+	hc_of(channel)->attached = 0;
+}
+
+/* `len` bytes at `data` leave for the client */
+static void deliver(struct host_chan *hc, const char *data, unsigned int len)
+{
+	if (len > 0) {
+		hc->window -= len;
+		hc->packets++;
+		if (hc->sink != NULL) {
+			hc->sink(hc, data, len);
+		}
+	}
+}
+
+unsigned int chan_inproc_send(struct Channel *channel, const void *data, unsigned int len)
+{
+	struct host_chan *hc = hc_of(channel);
+	unsigned int now;
+
+	if (len > chan_inproc_room(channel)) {
+		hc->overruns++;
+	}
+	hc->bytes += len;
+	if (hc->sink == NULL) {
+		if (hc->out_len + len > sizeof(hc->out)) {
+			dropbear_exit("host channel output full");
+		}
+		memcpy(hc->out + hc->out_len, data, len);
+		hc->out_len += len;
+	} else if (hc->pending + len > sizeof(hc->out)) {
+		dropbear_exit("host channel output full");
+	}
+
+	if (hc->pending > 0) {
+		/* with a sink, out[] only holds what waits for window */
+		if (hc->sink != NULL) {
+			memcpy(hc->out + hc->pending, data, len);
+		}
+		hc->pending += len;
+		return len;
+	}
+	now = MIN(len, hc->window);
+	deliver(hc, data, now);
+	hc->pending = len - now;
+	if (hc->sink != NULL) {
+		memcpy(hc->out, (const char *)data + now, hc->pending);
+	}
+	return len;
+}
+
+void chan_inproc_flush(struct Channel *channel)
+{
+	struct host_chan *hc = hc_of(channel);
+	unsigned int now = MIN(hc->pending, hc->window);
+
+	if (hc->sink != NULL) {
+		deliver(hc, hc->out, now);
+		memmove(hc->out, hc->out + now, hc->pending - now);
+	} else {
+		deliver(hc, hc->out + hc->out_len - hc->pending, now);
+	}
+	hc->pending -= now;
+}
+
+unsigned int chan_inproc_pending(const struct Channel *channel)
+{
+	return hc_of(channel)->pending;
+}
+
+unsigned int chan_inproc_room(const struct Channel *channel)
+{
+	return hc_of(channel)->window;
+}
+
+void chan_inproc_consumed(struct Channel *channel, unsigned int len)
+{
+	hc_of(channel)->consumed += len;
+}
+
+void chan_inproc_cap_window(struct Channel *channel, unsigned int max)
+{
+	(void)channel;
+	(void)max;
+}
+
+void chan_inproc_open_window(struct Channel *channel, unsigned int max)
+{
+	hc_of(channel)->open_window = max;
+	channel->recvwindow = MIN(channel->recvwindow, max);
+}
+
+void chan_inproc_close(struct Channel *channel)
+{
+	hc_of(channel)->closed = 1;
+}
+
+void chan_inproc_get_stats(unsigned long *packets, unsigned long *bytes)
+{
+	unsigned int i;
+
+	*packets = 0;
+	*bytes = 0;
+	for (i = 0; i < HOST_MAX_CHANNELS; i++) {
+		*packets += chans[i].packets;
+		*bytes += chans[i].bytes;
+	}
+}
+
+/*
+ * ---- esp_sftp.c and esp_update.c, for the tests that do not link them ----
+ */
+
+__attribute__((weak))
+struct esp_sftp *esp_sftp_new(struct Channel *channel)
+{
+	(void)channel;
+	return NULL;
+}
+
+__attribute__((weak))
+void esp_sftp_free(struct esp_sftp *sftp)
+{
+	(void)sftp;
+}
+
+__attribute__((weak))
+void esp_sftp_recv(struct esp_sftp *sftp, const unsigned char *data, unsigned int len)
+{
+	(void)sftp;
+	(void)data;
+	(void)len;
+}
+
+__attribute__((weak))
+int esp_sftp_poll(struct esp_sftp *sftp)
+{
+	(void)sftp;
+	return 0;
+}
+
+__attribute__((weak))
+void esp_sftp_get_stats(unsigned long *bytes_read, unsigned long *bytes_written)
+{
+	*bytes_read = 0;
+	*bytes_written = 0;
+}
+
+__attribute__((weak))
+int esp_update_cmd(struct EspShellSess *sess, int argc, char **argv)
+{
+	(void)sess;
+	(void)argc;
+	(void)argv;
+	return 1;
+}
+
+/* ---- ESP-IDF ---- */
+
+void esp_restart(void)
+{
+	dropbear_exit("esp_restart");
+}
+
+uint32_t esp_get_free_heap_size(void)
+{
+	return 150000;
+}
+
+uint32_t esp_get_minimum_free_heap_size(void)
+{
+	return 120000;
+}
+
+esp_err_t esp_vfs_eventfd_register(const esp_vfs_eventfd_config_t *config)
+{
+	(void)config;
+	return ESP_OK;
+}
+
+/* whitespace only, no quoting */
+size_t esp_console_split_argv(char *line, char **argv, size_t argv_size)
+{
+	size_t argc = 0;
+	char *save, *tok = strtok_r(line, " ", &save);
+
+	while (tok != NULL && argc < argv_size - 1) {
+		argv[argc++] = tok;
+		tok = strtok_r(NULL, " ", &save);
+	}
+	argv[argc] = NULL;
+	return argc;
+}
+
+esp_err_t esp_console_cmd_register(const esp_console_cmd_t *cmd)
+{
+	return cmd->command != NULL ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t esp_console_run(const char *cmdline, int *cmd_ret)
+{
+	if (strcmp(cmdline, "ctest") != 0) {
+		return ESP_ERR_NOT_FOUND;
+	}
+	printf("console ok\n");
+	*cmd_ret = 3;
+	return ESP_OK;
+}
+
+/* newlib's funopen() on glibc's fopencookie(), write-only */
+struct funopen_cookie {
+	void *cookie;
+	int (*writefn)(void *, const char *, int);
+};
+
+static ssize_t cookie_write(void *p, const char *data, size_t len)
+{
+	struct funopen_cookie *c = p;
+
+	return c->writefn(c->cookie, data, (int)len);
+}
+
+static int cookie_close(void *cookie)
+{
+	free(cookie);
+	return 0;
+}
+
+FILE *funopen(const void *cookie, int (*readfn)(void *, char *, int),
+		int (*writefn)(void *, const char *, int),
+		long (*seekfn)(void *, long, int), int (*closefn)(void *))
+{
+	cookie_io_functions_t io = { NULL, cookie_write, NULL, cookie_close };
+	struct funopen_cookie *c = malloc(sizeof(*c));
+
+	(void)readfn;
+	(void)seekfn;
+	(void)closefn;
+	c->cookie = (void *)cookie;
+	c->writefn = writefn;
+	return fopencookie(c, "w", io);
+}
+
+/* ---- FreeRTOS ---- */
+
+static pthread_mutex_t critical = PTHREAD_MUTEX_INITIALIZER;
+
+void host_critical_enter(void)
+{
+	pthread_mutex_lock(&critical);
+}
+
+void host_critical_exit(void)
+{
+	pthread_mutex_unlock(&critical);
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (TickType_t)(ts.tv_sec * 1000 + ts.tv_nsec / 1000000) + host_tick_offset;
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+	usleep(ticks * 1000);
+}
+
+struct task_start {
+	TaskFunction_t fn;
+	void *arg;
+};
+
+static void *task_main(void *p)
+{
+	struct task_start start = *(struct task_start *)p;
+
+	free(p);
+	start.fn(start.arg);
+	return NULL;
+}
+
+int xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack, void *arg,
+		UBaseType_t prio, TaskHandle_t *handle)
+{
+	struct task_start *start = malloc(sizeof(*start));
+	pthread_t thread;
+
+	(void)name;
+	(void)stack;
+	(void)prio;
+	(void)handle;
+	start->fn = fn;
+	start->arg = arg;
+	if (pthread_create(&thread, NULL, task_main, start) != 0) {
+		free(start);
+		return 0;
+	}
+	pthread_detach(thread);
+	return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+	(void)task;
+	pthread_exit(NULL);
+}
+
+struct host_stream_buffer {
+	pthread_mutex_t lock;
+	pthread_cond_t changed;
+	size_t size, len;
+	unsigned char *data;
+};
+
+StreamBufferHandle_t xStreamBufferCreate(size_t size, size_t trigger)
+{
+	struct host_stream_buffer *sb = calloc(1, sizeof(*sb));
+
+	(void)trigger;
+	pthread_mutex_init(&sb->lock, NULL);
+	pthread_cond_init(&sb->changed, NULL);
+	sb->size = size;
+	sb->data = malloc(size);
+	return sb;
+}
+
+void vStreamBufferDelete(StreamBufferHandle_t sb)
+{
+	pthread_mutex_destroy(&sb->lock);
+	pthread_cond_destroy(&sb->changed);
+	free(sb->data);
+	free(sb);
+}
+
+static void wait_changed(StreamBufferHandle_t sb, TickType_t wait)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	ts.tv_nsec += (long)wait * 1000000L;
+	ts.tv_sec += ts.tv_nsec / 1000000000L;
+	ts.tv_nsec %= 1000000000L;
+	pthread_cond_timedwait(&sb->changed, &sb->lock, &ts);
+}
+
+size_t xStreamBufferSend(StreamBufferHandle_t sb, const void *data, size_t len, TickType_t wait)
+{
+	size_t n;
+
+	pthread_mutex_lock(&sb->lock);
+	if (sb->len == sb->size && wait > 0) {
+		wait_changed(sb, wait);
+	}
+	n = MIN(len, sb->size - sb->len);
+	memcpy(sb->data + sb->len, data, n);
+	sb->len += n;
+	if (n > 0) {
+		pthread_cond_broadcast(&sb->changed);
+	}
+	pthread_mutex_unlock(&sb->lock);
+	return n;
+}
+
+size_t xStreamBufferReceive(StreamBufferHandle_t sb, void *data, size_t len, TickType_t wait)
+{
+	size_t n;
+
+	pthread_mutex_lock(&sb->lock);
+	if (sb->len == 0 && wait > 0) {
+		wait_changed(sb, wait);
+	}
+	n = MIN(len, sb->len);
+	memcpy(data, sb->data, n);
+	memmove(sb->data, sb->data + n, sb->len - n);
+	sb->len -= n;
+	if (n > 0) {
+		pthread_cond_broadcast(&sb->changed);
+	}
+	pthread_mutex_unlock(&sb->lock);
+	return n;
+}
+
+size_t xStreamBufferBytesAvailable(StreamBufferHandle_t sb)
+{
+	size_t n;
+
+	pthread_mutex_lock(&sb->lock);
+	n = sb->len;
+	pthread_mutex_unlock(&sb->lock);
+	return n;
+}
+
+int xStreamBufferIsEmpty(StreamBufferHandle_t sb)
+{
+	return xStreamBufferBytesAvailable(sb) == 0;
+}
+
+/* ---- the session task ---- */
+
+struct host_chan *host_channel_open(void)
+{
+	static unsigned int next_remote = 100;
+	struct host_chan *hc = NULL;
+	unsigned int i;
+
+	ses.channels = channel_table;
+	ses.chansize = HOST_MAX_CHANNELS;
+	ses.payload = &payload;
+	ses.writepayload = &writepayload;
+	ses.dataallowed = 1;
+	for (i = 0; i < HOST_MAX_CHANNELS; i++) {
+		if (channel_table[i] == NULL) {
+			hc = &chans[i];
+			break;
+		}
+	}
+	if (hc == NULL) {
+		return NULL;
+	}
+	memset(hc, 0, sizeof(*hc));
+	hc->channel.index = i;
+	hc->channel.remotechan = next_remote++;
+	hc->channel.type = &svrchansess;
+	hc->window = ~0u;
+	hc->channel.recvwindow = HOST_RECV_WINDOW;
+	hc->exit_status = -1;
+	/* Dropbear puts the channel in the table before calling inithandler */
+	channel_table[i] = &hc->channel;
+	if (svrchansess.inithandler(&hc->channel) != 0) {
+		channel_table[i] = NULL;
+		return NULL;
+	}
+	return hc;
+}
+
+int host_request(struct host_chan *hc, const char *type, const char *arg)
+{
+	int before = hc->attached;
+
+	payload.len = 0;
+	payload.pos = 0;
+	buf_putstring(&payload, type, (unsigned int)strlen(type));
+	buf_putbyte(&payload, 1);
+	if (arg != NULL) {
+		buf_putstring(&payload, arg, (unsigned int)strlen(arg));
+	}
+	svrchansess.reqhandler(&hc->channel);
+	return !before && hc->attached;
+}
+
+void host_send(struct host_chan *hc, const char *data)
+{
+	host_send_data(hc, data, (unsigned int)strlen(data));
+}
+
+void host_send_data(struct host_chan *hc, const void *data, unsigned int len)
+{
+	if (hc->attached) {
+		hc->ops->recv(&hc->channel, data, len);
+	}
+}
+
+void host_channel_cleanup(struct host_chan *hc)
+{
+	svrchansess.closehandler(&hc->channel);
+	svrchansess.cleanup(&hc->channel);
+	channel_table[hc->channel.index] = NULL;
+}
+
+void host_window_adjust(struct host_chan *hc, unsigned int len)
+{
+	hc->window += len;
+}
+
+void host_loop_once(unsigned int timeout_ms)
+{
+	struct timeval tv = { 0, (long)timeout_ms * 1000 };
+	fd_set readfds;
+	unsigned int i;
+
+	FD_ZERO(&readfds);
+	ses.maxfd = 0;
+	for (i = 0; i < HOST_MAX_CHANNELS; i++) {
+		if (channel_table[i] != NULL) {
+			svrchansess.set_extra_fds(channel_table[i], &readfds, NULL);
+		}
+	}
+	if (select(ses.maxfd + 1, &readfds, NULL, NULL, &tv) < 0) {
+		FD_ZERO(&readfds);
+	}
+	for (i = 0; i < HOST_MAX_CHANNELS; i++) {
+		if (channel_table[i] != NULL) {
+			struct host_chan *hc = &chans[i];
+			unsigned long before = hc->bytes;
+
+			svrchansess.handle_extra_io(channel_table[i], &readfds, NULL);
+			host_largest_visit = MAX(host_largest_visit, hc->bytes - before);
+		}
+	}
+}
+
+void host_loop(unsigned int ms)
+{
+	TickType_t end = xTaskGetTickCount() + ms;
+
+	while ((int32_t)(xTaskGetTickCount() - end) < 0) {
+		host_loop_once(5);
+	}
+}
+
+int host_loop_until(int (*done)(void), unsigned int ms)
+{
+	TickType_t end = xTaskGetTickCount() + ms;
+
+	while (!done() && (int32_t)(xTaskGetTickCount() - end) < 0) {
+		host_loop_once(5);
+	}
+	return done();
+}
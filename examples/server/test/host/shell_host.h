@@ -0,0 +1,65 @@
+#pragma once
+
+/*
+ * shell_host - What the esp_shell.c tests drive and observe: a recording
+ * chan_inproc (the client's window, data packets, exit-status), channel
+ * open and request helpers, and the session task's select() loop.
+ */
+
+#include "includes.h"
+#include "channel.h"
+#include "freertos/FreeRTOS.h"
+#include "chan_inproc.h"
+
+#define HOST_MAX_CHANNELS  8
+#define HOST_OUT_SIZE      (256 * 1024)
+
+struct host_chan {
+	struct Channel channel;         /* first: the tests' Channel pointers */
+	const struct chan_inproc_ops *ops;
+	int attached;
+	int closed;
+	unsigned long packets;          /* SSH_MSG_CHANNEL_DATA sent */
+	unsigned long bytes;            /* payload handed to chan_inproc_send() */
+	unsigned int window;            /* client window left */
+	unsigned int pending;           /* kept until the window allows */
+	unsigned int open_window;       /* chan_inproc_open_window() limit */
+	int exit_status;                /* -1 until exit-status was sent */
+	size_t out_at_exit;             /* out_len when exit-status was sent */
+	unsigned long consumed;         /* client data the endpoint is done with */
+	unsigned long overruns;         /* sends larger than chan_inproc_room() */
+	/* if set, delivered output goes here instead of out[] */
+	void (*sink)(struct host_chan *hc, const void *data, unsigned int len);
+	size_t out_len;
+	char out[HOST_OUT_SIZE];        /* everything sent, in order */
+};
+
+/* Dropbear's DEFAULT_RECV_WINDOW: a channel's window before the endpoint lowers it */
+#define HOST_RECV_WINDOW   24576
+
+/* Added to the tick count; tests move time forward with it. */
+extern TickType_t host_tick_offset;
+/* What a MSG_PEEK recv() on the session socket reports (more input queued). */
+extern int host_input_waiting;
+
+/* Open a session channel the way Dropbear would. Returns NULL if refused. */
+struct host_chan *host_channel_open(void);
+/* "shell", "exec" (with `arg`) or "subsystem"; returns 1 on success. */
+int host_request(struct host_chan *hc, const char *type, const char *arg);
+/* Client data, as chan_inproc hands it to the endpoint's recv(). */
+void host_send(struct host_chan *hc, const char *data);
+void host_send_data(struct host_chan *hc, const void *data, unsigned int len);
+/* Close and clean up as Dropbear does once check_close() says so. */
+void host_channel_cleanup(struct host_chan *hc);
+/* The client grants more window. */
+void host_window_adjust(struct host_chan *hc, unsigned int len);
+
+/* One session loop pass over every open channel: select(), then handle_extra_io(). */
+void host_loop_once(unsigned int timeout_ms);
+/* Passes until `ms` have gone by. */
+void host_loop(unsigned int ms);
+/* Passes until `done` returns nonzero or `ms` have gone by; returns its result. */
+int host_loop_until(int (*done)(void), unsigned int ms);
+
+/* Most bytes handed to chan_inproc_send() in one channel visit so far. */
+extern unsigned long host_largest_visit;
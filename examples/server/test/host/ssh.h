@@ -0,0 +1,10 @@
+#pragma once
+
+/* Host stand-in for Dropbear's ssh.h. */
+
+#define SSH_MSG_CHANNEL_WINDOW_ADJUST  93
+#define SSH_MSG_CHANNEL_DATA           94
+#define SSH_MSG_CHANNEL_REQUEST        98
+#define SSH_MSG_CHANNEL_SUCCESS        99
+#define SSH_MSG_CHANNEL_FAILURE        100
+#define SSH_OPEN_RESOURCE_SHORTAGE     4
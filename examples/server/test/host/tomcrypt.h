@@ -0,0 +1,28 @@
+#pragma once
+
+/*
+ * Host stand-in for libtomcrypt's SHA-256 interface, as Dropbear's
+ * includes.h provides it (esp_update.c), on OpenSSL: link with -lcrypto.
+ */
+
+#define OPENSSL_SUPPRESS_DEPRECATED
+#include <openssl/sha.h>
+
+typedef union {
+	SHA256_CTX sha256;
+} hash_state;
+
+static inline int sha256_init(hash_state *md)
+{
+	return SHA256_Init(&md->sha256) == 1 ? 0 : -1;
+}
+
+static inline int sha256_process(hash_state *md, const unsigned char *in, unsigned long inlen)
+{
+	return SHA256_Update(&md->sha256, in, inlen) == 1 ? 0 : -1;
+}
+
+static inline int sha256_done(hash_state *md, unsigned char *out)
+{
+	return SHA256_Final(out, &md->sha256) == 1 ? 0 : -1;
+}
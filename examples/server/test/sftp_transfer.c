@@ -0,0 +1,356 @@
+/*
+ * sftp_transfer.c - esp_sftp.c against the OpenSSH sftp client.
+ *
+ * Run without arguments, this starts `sftp -b <batch> -D "<self> serve ..."`
+ * for each row of the footprint table. In "serve" mode it is the server end:
+ * client bytes come from stdin, at most a window's worth ahead of what
+ * esp_sftp has dealt with, and replies go to stdout. The channel takes
+ * LINK_PER_PASS bytes per loop pass, like a link the session task drains
+ * once per select(). Checks that uploads and downloads are byte-identical,
+ * that directory and rename requests work, and that pipelined requests up
+ * to the window are all answered. Prints the largest request queue and the
+ * number of sends larger than chan_inproc_room(), which must stay 0.
+ *
+ * Without an sftp client only the pipelining check runs.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "includes.h"
+#include "dbutil.h"
+#include "shell_host.h"
+#include "esp_sftp.h"
+
+#define LINK_PER_PASS   3000
+#define FILE_SIZE       (3 * 1024 * 1024)
+#define SFTP_WINDOW     8192    /* SHELL_JOB_STDIN_SIZE: the window sftp opens with */
+
+#define SSH_FXP_INIT      1
+#define SSH_FXP_REALPATH  16
+#define SSH_FXP_NAME      104
+
+static unsigned int failures;
+
+#define CHECK(cond) do { \
+	if (!(cond)) { \
+		fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond); \
+		failures++; \
+	} \
+} while (0)
+
+static unsigned long sent, largest_queue;
+
+static void queue_seen(const struct host_chan *hc)
+{
+	largest_queue = MAX(largest_queue, sent - hc->consumed);
+}
+
+/* ---- serve mode: the sftp-server end ---- */
+
+static void to_stdout(struct host_chan *hc, const void *data, unsigned int len)
+{
+	const char *p = data;
+	ssize_t n;
+
+	(void)hc;
+	while (len > 0) {
+		n = write(STDOUT_FILENO, p, len);
+		if (n <= 0) {
+			dropbear_exit("stdout: %s", strerror(errno));
+		}
+		p += n;
+		len -= (unsigned int)n;
+	}
+}
+
+static int serve(const char *root, const char *stats_path)
+{
+	unsigned char buf[SFTP_WINDOW];
+	struct host_chan *hc;
+	FILE *stats;
+	int eof = 0;
+
+	CHECK(esp_sftp_set_root(root) == ESP_OK);
+	hc = host_channel_open();
+	CHECK(hc != NULL && host_request(hc, "subsystem", "sftp"));
+	if (hc == NULL || !hc->attached) {
+		return 1;
+	}
+	CHECK(hc->channel.recvwindow == SFTP_WINDOW);
+	hc->sink = to_stdout;
+
+	while (!hc->closed || hc->pending > 0) {
+		unsigned long allowed = hc->channel.recvwindow - (sent - hc->consumed);
+		struct timeval tv = { 0, 1000 };
+		fd_set readfds;
+		ssize_t n;
+
+		hc->window = LINK_PER_PASS;
+		FD_ZERO(&readfds);
+		if (!eof && allowed > 0) {
+			FD_SET(STDIN_FILENO, &readfds);
+		}
+		if (hc->pending > 0) {
+			tv.tv_usec = 0;
+		}
+		if (select(STDIN_FILENO + 1, &readfds, NULL, NULL, &tv) > 0
+				&& FD_ISSET(STDIN_FILENO, &readfds)) {
+			n = read(STDIN_FILENO, buf, allowed);
+			if (n > 0) {
+				sent += (unsigned long)n;
+				host_send_data(hc, buf, (unsigned int)n);
+				queue_seen(hc);
+			} else {
+				eof = 1;
+				hc->channel.recv_eof = 1;
+			}
+		}
+		host_loop_once(0);
+	}
+
+	stats = fopen(stats_path, "w");
+	if (stats != NULL) {
+		fprintf(stats, "%lu %lu\n", largest_queue, hc->overruns);
+		fclose(stats);
+	}
+	host_channel_cleanup(hc);
+	return failures ? 1 : 0;
+}
+
+/* ---- test mode ---- */
+
+static char self[PATH_MAX], base[] = "/tmp/sftp_transfer.XXXXXX";
+
+static void path(char *out, const char *name)
+{
+	snprintf(out, PATH_MAX, "%s/%s", base, name);
+}
+
+static void write_file(const char *name, unsigned long size, unsigned int seed)
+{
+	char p[PATH_MAX];
+	FILE *f;
+	unsigned long i;
+
+	path(p, name);
+	f = fopen(p, "wb");
+	srand(seed);
+	for (i = 0; f != NULL && i < size; i++) {
+		fputc(rand() & 0xff, f);
+	}
+	CHECK(f != NULL && fclose(f) == 0);
+}
+
+static int same_file(const char *a, const char *b)
+{
+	char pa[PATH_MAX], pb[PATH_MAX];
+	FILE *fa, *fb;
+	int ca, cb, same = 0;
+
+	path(pa, a);
+	path(pb, b);
+	fa = fopen(pa, "rb");
+	fb = fopen(pb, "rb");
+	if (fa != NULL && fb != NULL) {
+		do {
+			ca = fgetc(fa);
+			cb = fgetc(fb);
+		} while (ca == cb && ca != EOF);
+		same = ca == cb;
+	}
+	if (fa != NULL) fclose(fa);
+	if (fb != NULL) fclose(fb);
+	return same;
+}
+
+static int exists(const char *name)
+{
+	char p[PATH_MAX];
+	struct stat st;
+
+	path(p, name);
+	return stat(p, &st) == 0;
+}
+
+/* Run one sftp batch (local paths relative to base) against a fresh server. */
+static int run_sftp(const char *batch, unsigned long *queue, unsigned long *overruns)
+{
+	char batch_path[PATH_MAX], stats_path[PATH_MAX], root[PATH_MAX], cmd[3 * PATH_MAX + 16];
+	FILE *f;
+	pid_t pid;
+	int status = -1, null;
+
+	path(batch_path, "batch");
+	path(stats_path, "stats");
+	path(root, "root");
+	f = fopen(batch_path, "w");
+	if (f == NULL) {
+		return -1;
+	}
+	fputs(batch, f);
+	fclose(f);
+	unlink(stats_path);
+	snprintf(cmd, sizeof(cmd), "%s serve %s %s", self, root, stats_path);
+
+	pid = fork();
+	if (pid == 0) {
+		/* local paths in the batch are relative to base; the listing is noise */
+		null = open("/dev/null", O_WRONLY);
+		if (chdir(base) != 0 || null < 0 || dup2(null, STDOUT_FILENO) < 0) {
+			_exit(126);
+		}
+		execlp("sftp", "sftp", "-q", "-b", batch_path, "-D", cmd, (char *)NULL);
+		_exit(127);
+	}
+	if (pid < 0 || waitpid(pid, &status, 0) != pid || !WIFEXITED(status)) {
+		return -1;
+	}
+	f = fopen(stats_path, "r");
+	*queue = 0;
+	*overruns = ~0ul;
+	if (f != NULL) {
+		if (fscanf(f, "%lu %lu", queue, overruns) != 2) {
+			*overruns = ~0ul;
+		}
+		fclose(f);
+	}
+	return WEXITSTATUS(status);
+}
+
+static void transfers(void)
+{
+	unsigned long queue, overruns;
+
+	write_file("big.bin", FILE_SIZE, 1);
+	write_file("tree/a.bin", 5000, 2);
+	write_file("tree/sub/b.bin", 70000, 3);
+
+	CHECK(run_sftp("put big.bin /big.bin\n", &queue, &overruns) == 0);
+	CHECK(same_file("big.bin", "root/big.bin"));
+	CHECK(queue <= SFTP_WINDOW && overruns == 0);
+	printf("  put 3 MB: %s, largest queue %lu B, %lu sends beyond room\n",
+		same_file("big.bin", "root/big.bin") ? "identical" : "DIFFERENT", queue, overruns);
+
+	CHECK(run_sftp("get /big.bin get1.bin\nget /big.bin get2.bin\n", &queue, &overruns) == 0);
+	CHECK(same_file("big.bin", "get1.bin") && same_file("big.bin", "get2.bin"));
+	CHECK(queue <= SFTP_WINDOW && overruns == 0);
+	printf("  get 3 MB twice: %s, largest queue %lu B, %lu sends beyond room\n",
+		same_file("big.bin", "get2.bin") ? "identical" : "DIFFERENT", queue, overruns);
+
+	CHECK(run_sftp("mkdir /d\n"
+		"rename /big.bin /d/big.bin\n"
+		"ls -l /d\n"
+		"put -R tree /tree\n"
+		"get -R /tree tree2\n"
+		"rm /d/big.bin\n"
+		"rmdir /d\n", &queue, &overruns) == 0);
+	CHECK(same_file("tree/a.bin", "root/tree/a.bin"));
+	CHECK(same_file("tree/sub/b.bin", "tree2/sub/b.bin"));
+	CHECK(!exists("root/d") && !exists("root/big.bin"));
+	CHECK(overruns == 0);
+	printf("  ls -l, rename, mkdir, rmdir, rm, put -R, get -R: %lu sends beyond room\n",
+		overruns);
+}
+
+static unsigned char *put32(unsigned char *p, uint32_t v)
+{
+	p[0] = (unsigned char)(v >> 24);
+	p[1] = (unsigned char)(v >> 16);
+	p[2] = (unsigned char)(v >> 8);
+	p[3] = (unsigned char)v;
+	return p + 4;
+}
+
+/* The client sends its whole window of requests before reading any reply. */
+static void pipelined(void)
+{
+	unsigned char req[SFTP_WINDOW], *p = req;
+	unsigned int len, requests = 0, replies = 0;
+	char root[PATH_MAX];
+	struct host_chan *hc;
+	size_t pos;
+
+	path(root, "root");
+	CHECK(esp_sftp_set_root(root) == ESP_OK);
+	hc = host_channel_open();
+	CHECK(hc != NULL && host_request(hc, "subsystem", "sftp"));
+	if (hc == NULL || !hc->attached) {
+		return;
+	}
+
+	p = put32(p, 5);
+	*p++ = SSH_FXP_INIT;
+	p = put32(p, 3);
+	/* REALPATH "." (14 bytes) until the window is full */
+	while ((unsigned int)(p - req) + 14 <= hc->channel.recvwindow) {
+		p = put32(p, 10);
+		*p++ = SSH_FXP_REALPATH;
+		p = put32(p, requests++);
+		p = put32(p, 1);
+		*p++ = '.';
+	}
+	len = (unsigned int)(p - req);
+
+	/* nothing leaves until the first loop pass */
+	hc->window = 0;
+	sent = len;
+	largest_queue = 0;
+	host_send_data(hc, req, len);
+	queue_seen(hc);
+
+	hc->channel.recv_eof = 1;
+	while (!hc->closed || hc->pending > 0) {
+		hc->window = LINK_PER_PASS;
+		host_loop_once(0);
+	}
+
+	for (pos = 0; pos + 5 <= hc->out_len; ) {
+		const unsigned char *p = (const unsigned char *)hc->out + pos;
+		size_t plen = (size_t)p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3];
+
+		replies += p[4] == SSH_FXP_NAME;
+		pos += 4 + plen;
+	}
+	CHECK(pos == hc->out_len);
+	CHECK(replies == requests && hc->consumed == len);
+	CHECK(hc->overruns == 0);
+	printf("  %u pipelined REALPATHs, %u B at once: %u replies, largest queue %lu B, "
+		"%lu sends beyond room\n", requests, len, replies, largest_queue, hc->overruns);
+	host_channel_cleanup(hc);
+}
+
+int main(int argc, char **argv)
+{
+	char p[PATH_MAX + 16];
+
+	if (argc == 4 && strcmp(argv[1], "serve") == 0) {
+		return serve(argv[2], argv[3]);
+	}
+
+	if (realpath("/proc/self/exe", self) == NULL || mkdtemp(base) == NULL) {
+		perror("sftp_transfer");
+		return 1;
+	}
+	path(p, "root");
+	CHECK(mkdir(p, 0700) == 0);
+	path(p, "tree");
+	CHECK(mkdir(p, 0700) == 0);
+	path(p, "tree/sub");
+	CHECK(mkdir(p, 0700) == 0);
+
+	pipelined();
+	if (system("command -v sftp >/dev/null 2>&1") == 0) {
+		transfers();
+	} else {
+		printf("  no sftp client: transfers skipped\n");
+	}
+
+	snprintf(p, sizeof(p), "rm -rf %s", base);
+	CHECK(system(p) == 0);
+	printf("sftp_transfer: %s\n", failures ? "FAILED" : "ok");
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,139 @@
+/*
+ * shell_channels.c - several esp_shell.c channels on one connection.
+ *
+ * Up to CONFIG_DROPBEAR_MAX_SESSION_CHANNELS session channels open, each
+ * with its own shell; the next one is refused, and a freed slot can be
+ * reused. Two shells streaming from async commands at once take turns: no
+ * single channel visit hands more than SHELL_JOB_QUEUE_SIZE bytes to the
+ * channel, and both get all of their output. Prints the heap one shell
+ * holds, for the footprint table, and checks that closing returns it.
+ */
+
+#include "includes.h"
+#include "shell_host.h"
+#include "shell_cmd.h"
+
+#define SHELL_JOB_QUEUE_SIZE  1024   /* esp_shell.c: worker output per visit */
+#define LINES                 200
+
+static unsigned int failures;
+
+#define CHECK(cond) do { \
+	if (!(cond)) { \
+		fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond); \
+		failures++; \
+	} \
+} while (0)
+
+static int cmd_lines(struct EspShellSess *sess, int argc, char **argv)
+{
+	int i;
+
+	(void)argc;
+	(void)argv;
+	for (i = 0; i < LINES && !shell_cancelled(sess); i++) {
+		shell_printf(sess, "line %03d ............................................\r\n", i);
+	}
+	return 0;
+}
+
+static const shell_cmd_t lines_cmd = { "lines", NULL, cmd_lines, SHELL_CMD_ASYNC };
+
+static struct host_chan *streams[2];
+
+static unsigned int count(const struct host_chan *hc, const char *s)
+{
+	unsigned int n = 0;
+	size_t i, len = strlen(s);
+
+	for (i = 0; i + len <= hc->out_len; i++) {
+		n += memcmp(hc->out + i, s, len) == 0;
+	}
+	return n;
+}
+
+static int streams_done(void)
+{
+	return count(streams[0], "esp32> ") == 2 && count(streams[1], "esp32> ") == 2;
+}
+
+static void channel_limit(void)
+{
+	struct host_chan *hc[CONFIG_DROPBEAR_MAX_SESSION_CHANNELS];
+	unsigned int i;
+
+	for (i = 0; i < CONFIG_DROPBEAR_MAX_SESSION_CHANNELS; i++) {
+		hc[i] = host_channel_open();
+		CHECK(hc[i] != NULL && host_request(hc[i], "shell", NULL));
+	}
+	CHECK(host_channel_open() == NULL);
+
+	host_channel_cleanup(hc[0]);
+	hc[0] = host_channel_open();
+	CHECK(hc[0] != NULL);
+	for (i = 0; i < CONFIG_DROPBEAR_MAX_SESSION_CHANNELS; i++) {
+		if (hc[i] != NULL) {
+			host_channel_cleanup(hc[i]);
+		}
+	}
+}
+
+/* ASan's allocator; GCC does not ship sanitizer/allocator_interface.h */
+size_t __sanitizer_get_current_allocated_bytes(void);
+
+/* host_chan is static: the heap counted is the shell's own */
+static void shell_heap(void)
+{
+	size_t base = __sanitizer_get_current_allocated_bytes();
+	size_t opened, prompt, after;
+	struct host_chan *hc = host_channel_open();
+
+	CHECK(hc != NULL);
+	opened = __sanitizer_get_current_allocated_bytes() - base;
+	CHECK(host_request(hc, "shell", NULL));
+	host_send(hc, "uptime\r");
+	host_loop_once(0);
+	CHECK(strstr(hc->out, "esp32> ") != NULL);
+	prompt = __sanitizer_get_current_allocated_bytes() - base;
+	host_channel_cleanup(hc);
+	after = __sanitizer_get_current_allocated_bytes() - base;
+	CHECK(after == 0);
+	printf("  one shell: %zu B heap open, %zu B at the prompt, %zu B after close\n",
+		opened, prompt, after);
+}
+
+static void two_streams(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < 2; i++) {
+		streams[i] = host_channel_open();
+		CHECK(streams[i] != NULL && host_request(streams[i], "shell", NULL));
+	}
+	host_loop_once(0);
+	host_largest_visit = 0;
+	for (i = 0; i < 2; i++) {
+		host_send(streams[i], "lines\r");
+	}
+	CHECK(host_loop_until(streams_done, 5000));
+	for (i = 0; i < 2; i++) {
+		CHECK(count(streams[i], "line ") == LINES);
+		CHECK(strstr(streams[i]->out, "line 199") != NULL);
+	}
+	CHECK(host_largest_visit <= SHELL_JOB_QUEUE_SIZE);
+	printf("  2 channels x %u lines: %lu + %lu B, largest visit %lu B\n", LINES,
+		streams[0]->bytes, streams[1]->bytes, host_largest_visit);
+	for (i = 0; i < 2; i++) {
+		host_channel_cleanup(streams[i]);
+	}
+}
+
+int main(void)
+{
+	shell_cmd_register(&lines_cmd);
+	channel_limit();
+	shell_heap();
+	two_streams();
+	printf("shell_channels: %s\n", failures ? "FAILED" : "ok");
+	return failures ? 1 : 0;
+}
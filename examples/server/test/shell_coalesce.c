@@ -0,0 +1,143 @@
+/*
+ * shell_coalesce.c - esp_shell.c output coalescing.
+ *
+ * Feeds a 1 KB block of commands as one packet, as 64 B packets (apart, or
+ * back to back) and typed, and checks that the output leaves in packets of
+ * up to SHELL_OUT_SIZE bytes with one flush per input packet, not one
+ * packet per write; queued input is flushed only when it fills the buffer. Typed input must still be echoed
+ * right away, with Enter costing one packet; output held for queued input
+ * goes out after SHELL_FLUSH_HOLD_MS at the latest.
+ */
+
+#include "includes.h"
+#include "shell_host.h"
+
+#define SHELL_OUT_SIZE       512   /* esp_shell.c */
+#define SHELL_FLUSH_HOLD_MS  20
+
+static unsigned int failures;
+
+#define CHECK(cond) do { \
+	if (!(cond)) { \
+		fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond); \
+		failures++; \
+	} \
+} while (0)
+
+static char block[1025];
+static unsigned int block_cmds;
+
+static void make_block(void)
+{
+	static const char *const cmds[] = { "uptime\r", "heap\r", "hello\r" };
+	size_t len = 0, n;
+
+	while (1) {
+		n = strlen(cmds[block_cmds % 3]);
+		if (len + n > 1024) {
+			break;
+		}
+		memcpy(block + len, cmds[block_cmds % 3], n);
+		len += n;
+		block_cmds++;
+	}
+	/* pad with backspaced characters up to 1 KB */
+	while (len < 1024) {
+		block[len] = len % 2 ? 0x7f : 'x';
+		len++;
+	}
+	block[len] = '\0';
+}
+
+static struct host_chan *open_shell(void)
+{
+	struct host_chan *hc = host_channel_open();
+
+	CHECK(hc != NULL && host_request(hc, "shell", NULL));
+	host_loop_once(0);
+	CHECK(hc->packets == 1 && strstr(hc->out, "esp32> ") != NULL);
+	hc->packets = 0;
+	hc->bytes = 0;
+	hc->out_len = 0;
+	return hc;
+}
+
+static unsigned int count(const struct host_chan *hc, const char *s)
+{
+	unsigned int n = 0;
+	size_t i, len = strlen(s);
+
+	for (i = 0; i + len <= hc->out_len; i++) {
+		n += memcmp(hc->out + i, s, len) == 0;
+	}
+	return n;
+}
+
+/* `chunk` bytes per client packet; with `queued`, the next one is already waiting */
+static void run_block(unsigned int chunk, int queued)
+{
+	struct host_chan *hc = open_shell();
+	unsigned int off, inputs = 1024 / chunk;
+	char part[1025];
+
+	for (off = 0; off < 1024; off += chunk) {
+		memcpy(part, block + off, chunk);
+		part[chunk] = '\0';
+		host_input_waiting = queued && off + chunk < 1024;
+		host_send(hc, part);
+		host_loop_once(0);
+	}
+	host_input_waiting = 0;
+	host_loop_once(0);
+
+	CHECK(count(hc, "esp32> ") == block_cmds);
+	CHECK(count(hc, "Hello, world!") == block_cmds / 3);
+	/* full buffers, plus one flush per input packet unless more was queued */
+	CHECK(hc->packets <= (hc->bytes + SHELL_OUT_SIZE - 1) / SHELL_OUT_SIZE
+		+ (queued ? 1 : inputs));
+	printf("  %4u B per packet%s: %u commands, %lu output bytes in %lu packets\n", chunk,
+		queued ? ", back to back" : "", block_cmds, hc->bytes, hc->packets);
+	host_channel_cleanup(hc);
+}
+
+static void typed(void)
+{
+	struct host_chan *hc = open_shell();
+	const char *line = "hello\r";
+	char c[2] = { 0, 0 };
+	unsigned long before;
+
+	for (; *line != '\0'; line++) {
+		before = hc->packets;
+		c[0] = *line;
+		host_send(hc, c);
+		host_loop_once(0);
+		CHECK(hc->packets == before + 1);
+	}
+	/* Enter: line break, output and prompt in one packet */
+	CHECK(strstr(hc->out, "hello\r\nHello, world!\r\nesp32> ") != NULL);
+
+	/* more input queued: held, then sent once the hold time is up */
+	host_input_waiting = 1;
+	before = hc->packets;
+	host_send(hc, "h");
+	host_loop_once(0);
+	CHECK(hc->packets == before);
+	host_tick_offset += SHELL_FLUSH_HOLD_MS;
+	host_loop_once(0);
+	CHECK(hc->packets == before + 1);
+	host_input_waiting = 0;
+	host_channel_cleanup(hc);
+}
+
+int main(void)
+{
+	make_block();
+	run_block(1024, 0);
+	run_block(64, 0);
+	run_block(64, 1);
+	run_block(1, 0);
+	typed();
+	printf("shell_coalesce: %s\n", failures ? "FAILED" : "ok");
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,162 @@
+/*
+ * shell_exec.c - esp_shell.c "exec" requests.
+ *
+ * An exec runs its command once, with no banner or prompt, and ends with
+ * exit-status after the last byte of output, then EOF and CLOSE. Checks the
+ * status for a built-in, an esp_console command, an unknown command and an
+ * async command cancelled with Ctrl-C, and that exit-status waits for the
+ * client's window. A command registered with esp_console_cmd_register()
+ * must be in the registry as SHELL_CMD_ASYNC, listed by 'help' and get its
+ * arguments and stdout. Prints the packets and payload of `heap` run as exec
+ * and piped into a shell, for the footprint table.
+ */
+
+#include "includes.h"
+#include "shell_host.h"
+#include "freertos/task.h"
+#include "shell_cmd.h"
+
+static unsigned int failures;
+
+#define CHECK(cond) do { \
+	if (!(cond)) { \
+		fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond); \
+		failures++; \
+	} \
+} while (0)
+
+static struct host_chan *current;
+
+static int exited(void)
+{
+	return current->exit_status >= 0 && current->closed;
+}
+
+static int cmd_spin(struct EspShellSess *sess, int argc, char **argv)
+{
+	(void)argc;
+	(void)argv;
+	shell_write(sess, "spinning\r\n");
+	while (!shell_cancelled(sess)) {
+		vTaskDelay(pdMS_TO_TICKS(1));
+	}
+	return 0;
+}
+
+static const shell_cmd_t spin_cmd = { "spin", NULL, cmd_spin, SHELL_CMD_ASYNC };
+
+static int console_args(int argc, char **argv)
+{
+	int i;
+
+	printf("args");
+	for (i = 1; i < argc; i++) {
+		printf(" %s", argv[i]);
+	}
+	printf("\n");
+	return argc;
+}
+
+static void register_console(void)
+{
+	const esp_console_cmd_t cmd = {
+		.command = "cargs",
+		.help = "print arguments\nreturns argc",
+		.func = console_args,
+	};
+	const shell_cmd_t *found;
+
+	CHECK(esp_console_cmd_register(&cmd) == ESP_OK);
+	found = shell_cmd_find("cargs");
+	CHECK(found != NULL && (found->flags & SHELL_CMD_ASYNC) && found->console == console_args);
+}
+
+/* Run `cmd` as an exec request; the channel is left for the caller to clean up. */
+static struct host_chan *exec(const char *cmd)
+{
+	struct host_chan *hc = host_channel_open();
+
+	CHECK(hc != NULL && host_request(hc, "exec", cmd));
+	current = hc;
+	return hc;
+}
+
+static void exec_status(const char *cmd, int status, const char *out)
+{
+	struct host_chan *hc = exec(cmd);
+
+	CHECK(host_loop_until(exited, 1000));
+	CHECK(hc->exit_status == status);
+	CHECK(hc->out_at_exit == hc->out_len);
+	CHECK(out == NULL || strstr(hc->out, out) != NULL);
+	CHECK(strstr(hc->out, "esp32> ") == NULL && strstr(hc->out, "===") == NULL);
+	host_channel_cleanup(hc);
+}
+
+static void exec_heap(void)
+{
+	struct host_chan *hc = exec("heap");
+
+	CHECK(host_loop_until(exited, 1000));
+	CHECK(hc->exit_status == 0 && hc->packets == 1);
+	CHECK(strncmp(hc->out, "Free heap: ", 11) == 0);
+	printf("  exec heap: %lu packets, %lu B\n", hc->packets, hc->bytes);
+	host_channel_cleanup(hc);
+}
+
+/* what scripts did before: a shell with "heap" and "exit" piped in */
+static void piped_heap(void)
+{
+	struct host_chan *hc = host_channel_open();
+
+	CHECK(hc != NULL && host_request(hc, "shell", NULL));
+	host_send(hc, "heap\nexit\n");
+	current = hc;
+	host_loop_until(exited, 200);
+	CHECK(hc->closed && hc->exit_status == -1);
+	printf("  shell + piped heap/exit: %lu packets, %lu B\n", hc->packets, hc->bytes);
+	host_channel_cleanup(hc);
+}
+
+static void exec_window(void)
+{
+	struct host_chan *hc = host_channel_open();
+
+	hc->window = 0;
+	CHECK(host_request(hc, "exec", "heap"));
+	current = hc;
+	host_loop(20);
+	CHECK(hc->packets == 0 && hc->exit_status == -1 && !hc->closed);
+	host_window_adjust(hc, 4096);
+	CHECK(host_loop_until(exited, 1000));
+	CHECK(hc->exit_status == 0 && hc->packets == 1);
+	host_channel_cleanup(hc);
+}
+
+static void exec_cancel(void)
+{
+	struct host_chan *hc = exec("spin");
+
+	host_loop(20);
+	CHECK(strstr(hc->out, "spinning") != NULL && hc->exit_status == -1);
+	host_send(hc, "\x03");
+	CHECK(host_loop_until(exited, 1000));
+	CHECK(hc->exit_status == 130);
+	host_channel_cleanup(hc);
+}
+
+int main(void)
+{
+	shell_cmd_register(&spin_cmd);
+	exec_heap();
+	piped_heap();
+	exec_status("ctest", 3, "console ok");
+	register_console();
+	exec_status("cargs a b", 3, "args a b\r\nCommand returned 3");
+	exec_status("help", 0, "  cargs   - print arguments\r\n");
+	exec_status("nosuch", 127, "Unknown command: nosuch");
+	exec_window();
+	exec_cancel();
+	printf("shell_exec: %s\n", failures ? "FAILED" : "ok");
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,104 @@
+#!/usr/bin/env python3
+"""Open many SSH sessions to the example server in parallel and time them.
+
+Every session runs one exec command (default "hello") with password
+authentication and checks its output. The report gives sessions per
+second and the per-session time from connect to exit. Uses the OpenSSH
+client only; the password is passed through SSH_ASKPASS (OpenSSH 8.4+).
+
+With more parallel clients than CONFIG_DROPBEAR_MAX_SESSIONS, the extra
+connections are refused (reset) and count as failures. Admission control
+(CONFIG_DROPBEAR_ADMIT_BURST / _REFILL_MS) also refuses connections that
+arrive faster than its rate; raise those for a throughput run.
+
+Usage: ssh_load.py HOST [-p PORT] [-c PARALLEL] [-n SESSIONS]
+                        [-u USER] [--password PASSWORD]
+                        [--command CMD] [--expect TEXT]
+
+Exits nonzero if any session failed.
+"""
+
+import argparse
+import os
+import statistics
+import subprocess
+import sys
+import tempfile
+import time
+from concurrent.futures import ThreadPoolExecutor
+
+
+def run_session(args, env):
+    cmd = [
+        args.ssh, "-p", str(args.port),
+        "-o", "StrictHostKeyChecking=no",
+        "-o", "UserKnownHostsFile=/dev/null",
+        "-o", "LogLevel=ERROR",
+        "-o", "PreferredAuthentications=password",
+        "-o", "PubkeyAuthentication=no",
+        "-o", "ControlMaster=no",
+        "-o", "ControlPath=none",
+        "-o", "ConnectTimeout=%d" % args.timeout,
+        "%s@%s" % (args.user, args.host),
+        args.command,
+    ]
+    start = time.monotonic()
+    try:
+        res = subprocess.run(cmd, env=env, stdin=subprocess.DEVNULL,
+                             capture_output=True, timeout=args.timeout * 2)
+    except subprocess.TimeoutExpired:
+        return False, time.monotonic() - start, "timeout"
+    elapsed = time.monotonic() - start
+    out = res.stdout.decode(errors="replace")
+    if res.returncode != 0:
+        err = res.stderr.decode(errors="replace").strip().splitlines()
+        return False, elapsed, "exit %d: %s" % (res.returncode, err[-1] if err else "")
+    if args.expect not in out:
+        return False, elapsed, "unexpected output %r" % out[:60]
+    return True, elapsed, ""
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("host")
+    ap.add_argument("-p", "--port", type=int, default=2222)
+    ap.add_argument("-c", "--parallel", type=int, default=4)
+    ap.add_argument("-n", "--sessions", type=int, default=40)
+    ap.add_argument("-u", "--user", default="user")
+    ap.add_argument("--password", default="password")
+    ap.add_argument("--command", default="hello")
+    ap.add_argument("--expect", default="Hello, world!")
+    ap.add_argument("--timeout", type=int, default=30)
+    ap.add_argument("--ssh", default="ssh")
+    args = ap.parse_args()
+
+    with tempfile.NamedTemporaryFile("w", suffix=".sh", delete=False) as f:
+        f.write("#!/bin/sh\nprintf '%%s\\n' '%s'\n" % args.password.replace("'", "'\\''"))
+        askpass = f.name
+    os.chmod(askpass, 0o700)
+    env = dict(os.environ, SSH_ASKPASS=askpass, SSH_ASKPASS_REQUIRE="force",
+               DISPLAY=os.environ.get("DISPLAY", ":0"))
+
+    try:
+        start = time.monotonic()
+        with ThreadPoolExecutor(max_workers=args.parallel) as pool:
+            results = list(pool.map(lambda _: run_session(args, env),
+                                    range(args.sessions)))
+        wall = time.monotonic() - start
+    finally:
+        os.unlink(askpass)
+
+    ok = [t for good, t, _ in results if good]
+    failed = [why for good, _, why in results if not good]
+    print("%d sessions, %d parallel: %d ok, %d failed in %.2f s"
+          % (args.sessions, args.parallel, len(ok), len(failed), wall))
+    if ok:
+        print("%.2f sessions/s | per session: min %.2f s, median %.2f s, max %.2f s"
+              % (len(ok) / wall, min(ok), statistics.median(ok), max(ok)))
+    for why in sorted(set(failed)):
+        print("  failed (%dx): %s" % (failed.count(why), why))
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
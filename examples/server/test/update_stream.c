@@ -0,0 +1,219 @@
+/*
+ * update_stream.c - esp_update.c's "update" command over an exec channel.
+ *
+ * Links esp_shell.c and esp_update.c with the file writer, slowed to
+ * WRITE_DELAY_US per write as flash would be. The client sends PACKET-byte
+ * packets whenever it has window (what the channel opened with, less what
+ * the worker has not read yet) and sends EOF after the image. Checks that a
+ * good image arrives byte-identical, that a wrong digest leaves the target
+ * alone and no .part behind, and that an empty stdin opens nothing. Prints
+ * the time of the good update, the most unread data once past the first
+ * 64 KB, and the longest the session task spent in recv().
+ */
+
+#include <limits.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#include "includes.h"
+#include "shell_host.h"
+#include "esp_update.h"
+
+#define IMAGE_SIZE      (3 * 1024 * 1024)
+#define PACKET          2048
+#define WRITE_DELAY_US  1000
+#define UPDATE_WINDOW   8192    /* SHELL_JOB_STDIN_SIZE: the window exec opens with */
+
+static unsigned int failures;
+
+#define CHECK(cond) do { \
+	if (!(cond)) { \
+		fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond); \
+		failures++; \
+	} \
+} while (0)
+
+static char target[PATH_MAX], part[PATH_MAX + 8];
+static unsigned int begins;
+
+/* ---- the file writer, slowed down ---- */
+
+static esp_err_t slow_begin(void *arg, void **ctx)
+{
+	begins++;
+	return esp_update_file_writer.begin(arg, ctx);
+}
+
+static esp_err_t slow_write(void *ctx, const void *data, size_t len)
+{
+	usleep(WRITE_DELAY_US);
+	return esp_update_file_writer.write(ctx, data, len);
+}
+
+static esp_err_t slow_finish(void *ctx)
+{
+	return esp_update_file_writer.finish(ctx);
+}
+
+static void slow_abort(void *ctx)
+{
+	esp_update_file_writer.abort(ctx);
+}
+
+static const esp_update_writer_t slow_writer = {
+	"slow file", slow_begin, slow_write, slow_finish, slow_abort
+};
+
+/* ---- the client ---- */
+
+struct result {
+	int status;
+	double secs;
+	unsigned long most_unread;      /* after the first 64 KB */
+	long longest_recv_us;
+};
+
+static long usecs(const struct timespec *a, const struct timespec *b)
+{
+	return (b->tv_sec - a->tv_sec) * 1000000L + (b->tv_nsec - a->tv_nsec) / 1000;
+}
+
+static struct result update(const char *cmd, const unsigned char *image, unsigned long size)
+{
+	struct result r = { -1, 0, 0, 0 };
+	struct timespec start, end, t0, t1;
+	unsigned long sent = 0;
+	struct host_chan *hc;
+
+	hc = host_channel_open();
+	CHECK(hc != NULL && host_request(hc, "exec", cmd));
+	if (hc == NULL || !hc->attached) {
+		return r;
+	}
+	CHECK(hc->channel.recvwindow == UPDATE_WINDOW);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	while (!hc->closed || hc->pending > 0) {
+		unsigned long allowed = hc->channel.recvwindow - (sent - hc->consumed);
+
+		if (sent < size && allowed >= MIN(PACKET, size - sent)) {
+			unsigned int len = (unsigned int)MIN(PACKET, size - sent);
+
+			clock_gettime(CLOCK_MONOTONIC, &t0);
+			host_send_data(hc, image + sent, len);
+			clock_gettime(CLOCK_MONOTONIC, &t1);
+			r.longest_recv_us = MAX(r.longest_recv_us, usecs(&t0, &t1));
+			sent += len;
+			if (sent > 64 * 1024) {
+				r.most_unread = MAX(r.most_unread, sent - hc->consumed);
+			}
+			continue;
+		}
+		if (sent == size) {
+			hc->channel.recv_eof = 1;
+		}
+		host_loop_once(1);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	r.secs = (double)usecs(&start, &end) / 1e6;
+	r.status = hc->exit_status;
+	hc->out[hc->out_len] = '\0';
+	if (r.status != 0) {
+		printf("    %s", hc->out);
+	}
+	host_channel_cleanup(hc);
+	return r;
+}
+
+static int same_as(const char *path, const unsigned char *data, unsigned long size)
+{
+	struct stat st;
+	unsigned char *buf;
+	FILE *f;
+	int same;
+
+	if (stat(path, &st) != 0 || (unsigned long)st.st_size != size) {
+		return 0;
+	}
+	f = fopen(path, "rb");
+	buf = malloc(size);
+	same = f != NULL && buf != NULL && fread(buf, 1, size, f) == size
+		&& memcmp(buf, data, size) == 0;
+	if (f != NULL) fclose(f);
+	free(buf);
+	return same;
+}
+
+static void sha256_hex(char *out, const unsigned char *data, unsigned long size)
+{
+	unsigned char digest[32];
+	hash_state hs;
+	unsigned int i;
+
+	sha256_init(&hs);
+	sha256_process(&hs, data, size);
+	sha256_done(&hs, digest);
+	for (i = 0; i < sizeof(digest); i++) {
+		sprintf(out + 2 * i, "%02x", digest[i]);
+	}
+}
+
+int main(void)
+{
+	char dir[] = "/tmp/update_stream.XXXXXX", cmd[128], hex[65];
+	unsigned char *image, *old;
+	struct result r;
+	struct stat st;
+	unsigned long i;
+	FILE *f;
+
+	image = malloc(IMAGE_SIZE);
+	old = malloc(IMAGE_SIZE);
+	if (image == NULL || old == NULL || mkdtemp(dir) == NULL) {
+		perror("update_stream");
+		return 1;
+	}
+	srand(1);
+	for (i = 0; i < IMAGE_SIZE; i++) {
+		image[i] = (unsigned char)rand();
+		old[i] = (unsigned char)~image[i];
+	}
+	snprintf(target, sizeof(target), "%s/firmware.bin", dir);
+	snprintf(part, sizeof(part), "%s.part", target);
+	esp_update_set_writer(&slow_writer, target);
+
+	sha256_hex(hex, image, IMAGE_SIZE);
+	snprintf(cmd, sizeof(cmd), "update %s", hex);
+	r = update(cmd, image, IMAGE_SIZE);
+	CHECK(r.status == 0 && same_as(target, image, IMAGE_SIZE));
+	CHECK(stat(part, &st) != 0);
+	CHECK(r.most_unread <= UPDATE_WINDOW);
+	printf("  3 MB, correct digest: %s, exit %d, %.2f s\n",
+		same_as(target, image, IMAGE_SIZE) ? "byte-identical" : "DIFFERENT", r.status, r.secs);
+	printf("  unread after the first 64 KB: at most %lu B\n", r.most_unread);
+	printf("  longest session-task recv(): %ld us\n", r.longest_recv_us);
+
+	/* the target holds the old image; the new one is sent with the wrong digest */
+	f = fopen(target, "wb");
+	CHECK(f != NULL && fwrite(old, 1, IMAGE_SIZE, f) == IMAGE_SIZE && fclose(f) == 0);
+	hex[0] = hex[0] == '0' ? '1' : '0';
+	snprintf(cmd, sizeof(cmd), "update %s", hex);
+	r = update(cmd, image, IMAGE_SIZE);
+	CHECK(r.status == 1 && same_as(target, old, IMAGE_SIZE));
+	CHECK(stat(part, &st) != 0);
+	printf("  3 MB, wrong digest: exit %d, .part %s, target %s\n", r.status,
+		stat(part, &st) != 0 ? "removed" : "LEFT", same_as(target, old, IMAGE_SIZE)
+		? "untouched" : "CHANGED");
+
+	begins = 0;
+	r = update("update", image, 0);
+	CHECK(r.status == 1 && begins == 0);
+	printf("  empty stdin: exit %d, %u writers opened\n", r.status, begins);
+
+	snprintf(cmd, sizeof(cmd), "rm -rf %s", dir);
+	CHECK(system(cmd) == 0);
+	free(image);
+	free(old);
+	printf("update_stream: %s\n", failures ? "FAILED" : "ok");
+	return failures ? 1 : 0;
+}
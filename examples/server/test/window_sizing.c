@@ -0,0 +1,361 @@
+/*
+ * window_sizing.c - port/chan_inproc.c's adaptive windows, simulated.
+ *
+ * Links the real chan_inproc.c with a virtual clock (esp_timer_get_time())
+ * and free heap (esp_get_free_heap_size()). The client uploads as fast as
+ * its window and a LINK bytes/s link allow. The device consumes each packet
+ * as it arrives, as a shell does, and its window adjusts and round-trip
+ * probes reach the client half an RTT later. Probe replies queue on the
+ * uplink behind the data sent before them. In the "fixed" runs the client
+ * leaves the probes unanswered, so the window stays the one offered at
+ * open, Dropbear's 24 KB. Prints the window offered at open for the
+ * footprint table's heap and channel counts, the bytes uploaded in
+ * SIM_SECS per RTT and link rate, and the window after the heap drops in
+ * the middle of a transfer. A client sending past its window would end the
+ * run in dropbear_exit("Oversized packet").
+ */
+
+#include <limits.h>
+
+#include "includes.h"
+#include "session.h"
+#include "channel.h"
+#include "runopts.h"
+#include "ssh.h"
+#include "dbutil.h"
+#include "chan_inproc.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+
+#define SIM_SECS        3
+#define SIM_START_US    10000000        /* esp_timer counts from boot */
+#define RECV_WINDOW     24576           /* Dropbear's DEFAULT_RECV_WINDOW */
+#define RECV_MAXPACKET  32768           /* RECV_MAX_PAYLOAD_LEN */
+#define REPLY_LEN       48              /* SSH_MSG_CHANNEL_FAILURE on the wire */
+#define QUEUE_LEN       8192
+#define KB              1024
+
+static unsigned int failures;
+
+#define CHECK(cond) do { \
+	if (!(cond)) { \
+		fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond); \
+		failures++; \
+	} \
+} while (0)
+
+struct sshsession ses;
+runopts opts = { RECV_WINDOW };
+
+static int64_t now_us;
+static uint32_t free_heap;
+static struct Channel *channel_table[1];
+static buffer payload, writepayload;
+
+/* ---- ESP-IDF and Dropbear ---- */
+
+int64_t esp_timer_get_time(void)
+{
+	return now_us;
+}
+
+uint32_t esp_get_free_heap_size(void)
+{
+	return free_heap;
+}
+
+struct Channel *getchannel(void)
+{
+	unsigned int index = buf_getint(ses.payload);
+
+	if (index >= ses.chansize || ses.channels[index] == NULL) {
+		dropbear_exit("Unknown channel");
+	}
+	return ses.channels[index];
+}
+
+void __real_recv_msg_channel_data(void)
+{
+	dropbear_exit("Data for a channel that is not in-process");
+}
+
+void __real_ignore_recv_response(void)
+{
+}
+
+void __wrap_recv_msg_channel_data(void);
+void __wrap_ignore_recv_response(void);
+
+/* ---- the link ---- */
+
+struct packet {
+	int64_t at;                     /* arrival time */
+	unsigned char type;
+	unsigned int len;               /* data length or window increment */
+};
+
+struct queue {
+	struct packet p[QUEUE_LEN];
+	unsigned int head, tail;
+};
+
+/* uplink: client to device, in order; downlink: device to client */
+static struct queue up, down;
+static unsigned int rtt_us;
+
+static void push(struct queue *q, int64_t at, unsigned char type, unsigned int len)
+{
+	if (q->tail - q->head == QUEUE_LEN) {
+		dropbear_exit("Link queue full");
+	}
+	q->p[q->tail % QUEUE_LEN] = (struct packet){ at, type, len };
+	q->tail++;
+}
+
+static const struct packet *peek(const struct queue *q)
+{
+	return q->head == q->tail ? NULL : &q->p[q->head % QUEUE_LEN];
+}
+
+/* Device to client: what chan_inproc.c sends, delayed by half a round trip. */
+void encrypt_packet(void)
+{
+	buffer *buf = ses.writepayload;
+	unsigned char type = buf->data[0];
+
+	buf->pos = 1;
+	(void)buf_getint(buf);
+	if (type == SSH_MSG_CHANNEL_WINDOW_ADJUST) {
+		push(&down, now_us + rtt_us / 2, type, buf_getint(buf));
+	} else if (type == SSH_MSG_CHANNEL_REQUEST) {
+		push(&down, now_us + rtt_us / 2, type, 0);
+	}
+	buf->len = 0;
+	buf->pos = 0;
+}
+
+/* ---- the device's endpoint: consumes everything at once ---- */
+
+static unsigned long received;
+
+static void count_recv(struct Channel *channel, const unsigned char *data, unsigned int len)
+{
+	(void)channel;
+	(void)data;
+	received += len;
+}
+
+static const struct chan_inproc_ops counting_ops = { count_recv, 0 };
+
+static unsigned int window_now, window_largest;
+
+static void window_seen(const struct Channel *channel, const struct chan_window_info *info)
+{
+	(void)channel;
+	window_now = info->window;
+	window_largest = MAX(window_largest, info->window);
+}
+
+/* ---- simulation ---- */
+
+static struct Channel chan;
+
+static void channel_open(struct Channel *channel, unsigned int index)
+{
+	memset(channel, 0, sizeof(*channel));
+	channel->index = index;
+	channel->recvwindow = RECV_WINDOW;
+	channel->recvmaxpacket = RECV_MAXPACKET;
+	channel->readfd = channel->writefd = FD_UNINIT;
+	chan_inproc_open_window(channel, UINT_MAX);
+}
+
+/* A device packet as Dropbear's packet dispatch hands it over. */
+static void arrive(const struct packet *p)
+{
+	static const char zeros[RECV_MAXPACKET];
+
+	payload.len = 0;
+	buf_putbyte(&payload, p->type);
+	buf_putint(&payload, chan.index);
+	if (p->type == SSH_MSG_CHANNEL_DATA) {
+		buf_putstring(&payload, zeros, p->len);
+	}
+	payload.pos = 1;
+	if (p->type == SSH_MSG_CHANNEL_DATA) {
+		__wrap_recv_msg_channel_data();
+	} else {
+		__wrap_ignore_recv_response();
+	}
+}
+
+struct result {
+	unsigned long bytes;            /* uploaded in SIM_SECS */
+	unsigned int window_largest;
+	unsigned int window_after_drop; /* 0 if the heap did not drop */
+	int64_t cut_after_us;           /* from the drop to the smaller window */
+};
+
+/*
+ * Upload for SIM_SECS over a link of `link` bytes/s and `rtt` us. `answer`:
+ * the client replies to the round-trip probes. From `drop_us` into the run
+ * (if nonzero) free heap is `drop_heap`.
+ */
+static struct result simulate(unsigned int rtt, unsigned long link, int answer,
+	int64_t drop_us, uint32_t drop_heap)
+{
+	int64_t end = SIM_START_US + SIM_SECS * 1000000LL, link_free, drop_at = 0;
+	unsigned int client_window, maxpacket;
+	struct result r = { 0, 0, 0, 0 };
+	const struct packet *p;
+
+	now_us = SIM_START_US;
+	free_heap = 200 * KB;
+	rtt_us = rtt;
+	up.head = up.tail = down.head = down.tail = 0;
+	received = 0;
+	channel_open(&chan, 0);
+	CHECK(chan_inproc_attach(&chan, &counting_ops) == DROPBEAR_SUCCESS);
+	window_largest = window_now = chan.recvwindow;
+	client_window = chan.recvwindow;
+	maxpacket = chan.recvmaxpacket;
+	link_free = now_us;
+
+	for (;;) {
+		int64_t next = end;
+
+		/* the client sends whatever its window allows; the link queues it */
+		while (client_window > 0) {
+			unsigned int n = MIN(client_window, maxpacket);
+
+			link_free = MAX(link_free, now_us) + (int64_t)n * 1000000 / link;
+			push(&up, link_free + rtt / 2, SSH_MSG_CHANNEL_DATA, n);
+			client_window -= n;
+		}
+
+		if ((p = peek(&up)) != NULL) next = MIN(next, p->at);
+		if ((p = peek(&down)) != NULL) next = MIN(next, p->at);
+		if (drop_us != 0 && drop_at == 0) next = MIN(next, SIM_START_US + drop_us);
+		if (next >= end) {
+			break;
+		}
+		now_us = next;
+
+		if (drop_us != 0 && drop_at == 0 && now_us >= SIM_START_US + drop_us) {
+			drop_at = now_us;
+			free_heap = drop_heap;
+		}
+		while ((p = peek(&up)) != NULL && p->at <= now_us) {
+			up.head++;
+			arrive(p);
+		}
+		while ((p = peek(&down)) != NULL && p->at <= now_us) {
+			down.head++;
+			if (p->type == SSH_MSG_CHANNEL_WINDOW_ADJUST) {
+				client_window += p->len;
+			} else if (answer) {
+				/* SSH_MSG_CHANNEL_FAILURE, behind the data already queued */
+				link_free = MAX(link_free, now_us) + REPLY_LEN * 1000000LL / link;
+				push(&up, link_free + rtt / 2, SSH_MSG_CHANNEL_FAILURE, 0);
+			}
+		}
+		if (drop_at != 0 && r.window_after_drop == 0 && window_now < window_largest) {
+			r.window_after_drop = window_now;
+			r.cut_after_us = now_us - drop_at;
+		}
+	}
+
+	r.bytes = received;
+	r.window_largest = window_largest;
+	chan_inproc_detach(&chan);
+	return r;
+}
+
+/* ---- footprint rows ---- */
+
+static void open_windows(void)
+{
+	static const struct {
+		uint32_t heap;
+		unsigned int channels, window, maxpacket;
+	} rows[] = {
+		{ 200 * KB, 1, 24 * KB, 12 * KB },
+		{ 120 * KB, 4, 9 * KB, 4608 },
+		{ 80 * KB, 8, 4 * KB, 2 * KB },
+	};
+	struct Channel others[8], c;
+	unsigned int i, j;
+
+	printf("  window at open (48 KB reserve, 64 KB maximum):\n");
+	for (i = 0; i < sizeof(rows) / sizeof(rows[0]); i++) {
+		free_heap = rows[i].heap;
+		for (j = 0; j + 1 < rows[i].channels; j++) {
+			channel_open(&others[j], j + 1);
+			CHECK(chan_inproc_attach(&others[j], &counting_ops) == DROPBEAR_SUCCESS);
+		}
+		channel_open(&c, 0);
+		CHECK(c.recvwindow == rows[i].window && c.recvmaxpacket == rows[i].maxpacket);
+		printf("    %3u KB free, %u open: window %u B, max packet %u B\n",
+			rows[i].heap / KB, rows[i].channels, c.recvwindow, c.recvmaxpacket);
+		for (j = 0; j + 1 < rows[i].channels; j++) {
+			chan_inproc_detach(&others[j]);
+		}
+	}
+}
+
+static void uploads(void)
+{
+	static const struct {
+		unsigned int rtt_ms;
+		unsigned long link;
+	} rows[] = {
+		{ 20, 4000000 },
+		{ 50, 4000000 },
+		{ 20, 500000 },
+		{ 2, 4000000 },
+	};
+	struct result fixed, adaptive;
+	unsigned int i;
+
+	printf("  uploaded in %u s:\n", SIM_SECS);
+	for (i = 0; i < sizeof(rows) / sizeof(rows[0]); i++) {
+		fixed = simulate(rows[i].rtt_ms * 1000, rows[i].link, 0, 0, 0);
+		adaptive = simulate(rows[i].rtt_ms * 1000, rows[i].link, 1, 0, 0);
+		CHECK(fixed.window_largest == RECV_WINDOW);
+		CHECK(adaptive.bytes >= fixed.bytes);
+		CHECK(adaptive.window_largest <= CONFIG_DROPBEAR_WINDOW_MAX);
+		printf("    RTT %2u ms, %.1f MB/s: fixed %.1f MB, adaptive %.1f MB, window reached %u KB\n",
+			rows[i].rtt_ms, rows[i].link / 1e6, fixed.bytes / 1e6, adaptive.bytes / 1e6,
+			adaptive.window_largest / KB);
+	}
+}
+
+static void heap_drop(void)
+{
+	struct result r = simulate(20000, 4000000, 1, 1500000, 90 * KB);
+
+	/* half of the 42 KB above the reserve */
+	CHECK(r.window_after_drop == (90 - 48) * KB / 2);
+	printf("  heap down to 90 KB after 1.5 s: window %u KB -> %u B, %.1f ms later\n",
+		r.window_largest / KB, r.window_after_drop, r.cut_after_us / 1e3);
+}
+
+int main(void)
+{
+	ses.channels = channel_table;
+	ses.chansize = 1;
+	ses.payload = &payload;
+	ses.writepayload = &writepayload;
+	ses.dataallowed = 1;
+	channel_table[0] = &chan;
+	chan_inproc_set_window_hook(window_seen);
+
+	open_windows();
+	uploads();
+	heap_drop();
+
+	free(payload.data);
+	free(writepayload.data);
+	printf("window_sizing: %s\n", failures ? "FAILED" : "ok");
+	return failures ? 1 : 0;
+}
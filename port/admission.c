@@ -0,0 +1,254 @@
+/*
+ * admission.c - Admission control for accepted connections.
+ *
+ * admission_check() runs in the accept loop's task and
+ * admission_session_closed() in session tasks, so the host table is
+ * guarded by its own mutex. Both only touch a fixed table of
+ * ADMISSION_HOSTS entries; nothing is allocated per connection.
+ *
+ * Token buckets count whole connections. tokens is refilled lazily on the
+ * next lookup: one per refill_ms since `refilled`, up to burst. Replacing
+ * a known address means more clients than the table holds; such newcomers
+ * share one more bucket, so cycling through addresses does not buy a full
+ * bucket per connection. Addresses that have logged in are replaced only
+ * when every entry has, so such a storm does not push out known clients.
+ */
+
+#include "includes.h"
+#include "dbutil.h"
+#include "session_pool.h"
+#include "admission.h"
+#include "sdkconfig.h"
+
+#include <netinet/in.h>
+
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+struct admission_host {
+	unsigned char addr[16];         /* IPv4 in the first 4 bytes        */
+	int family;                     /* AF_UNSPEC if the entry is free   */
+	unsigned int tokens;
+	unsigned int fails;             /* failed sessions since last block */
+	int trusted;                    /* has logged in: replaced last     */
+	int64_t refilled;               /* ms, last token added             */
+	int64_t blocked_until;          /* ms, 0 if not blocked             */
+	int64_t seen;                   /* ms, last connection              */
+};
+
+static struct {
+	admission_config_t config;
+	SemaphoreHandle_t lock;
+	struct admission_host hosts[ADMISSION_HOSTS];
+	struct admission_host newcomers; /* bucket for replacing entries    */
+	admission_stats_t stats;
+} adm;
+
+static const char *const reasons[ADMISSION_REASONS] = {
+	"admitted", "blocked after failed logins", "too many connections",
+	"all sessions busy", "low free heap"
+};
+
+void admission_init(const admission_config_t *config)
+{
+	unsigned int i;
+
+	adm.config = *config;
+	adm.config.burst = MAX(adm.config.burst, 1);
+	adm.lock = xSemaphoreCreateMutex();
+	if (adm.lock == NULL) {
+		dropbear_exit("Failed to create admission lock");
+	}
+	for (i = 0; i < ADMISSION_HOSTS; i++) {
+		adm.hosts[i].family = AF_UNSPEC;
+	}
+	adm.newcomers.tokens = adm.config.burst;
+}
+
+static int64_t now_ms(void)
+{
+	return esp_timer_get_time() / 1000;
+}
+
+/* Address bytes of `peer`; IPv4-mapped IPv6 counts as IPv4. */
+static int peer_key(const struct sockaddr_storage *peer, unsigned char addr[16])
+{
+	memset(addr, 0, 16);
+	if (peer->ss_family == AF_INET) {
+		const struct sockaddr_in *in = (const struct sockaddr_in *)peer;
+
+		memcpy(addr, &in->sin_addr, 4);
+		return AF_INET;
+	}
+	if (peer->ss_family == AF_INET6) {
+		const struct sockaddr_in6 *in6 = (const struct sockaddr_in6 *)peer;
+		static const unsigned char mapped[12] = { 0,0,0,0,0,0,0,0,0,0,0xff,0xff };
+
+		if (memcmp(&in6->sin6_addr, mapped, sizeof(mapped)) == 0) {
+			memcpy(addr, (const unsigned char *)&in6->sin6_addr + 12, 4);
+			return AF_INET;
+		}
+		memcpy(addr, &in6->sin6_addr, 16);
+		return AF_INET6;
+	}
+	return AF_UNSPEC;
+}
+
+static void host_refill(struct admission_host *h, int64_t now)
+{
+	int64_t add;
+
+	if (adm.config.refill_ms == 0) {
+		h->tokens = adm.config.burst;
+		return;
+	}
+	add = (now - h->refilled) / adm.config.refill_ms;
+	if (add <= 0) {
+		return;
+	}
+	if (h->tokens + add >= adm.config.burst) {
+		h->tokens = adm.config.burst;
+		h->refilled = now;
+	} else {
+		h->tokens += (unsigned int)add;
+		h->refilled += add * adm.config.refill_ms;
+	}
+}
+
+/* Replace `b` rather than `a`? Free entries first, then untrusted, then LRU. */
+static int host_older(const struct admission_host *a, const struct admission_host *b)
+{
+	if ((a->family == AF_UNSPEC) != (b->family == AF_UNSPEC)) {
+		return b->family == AF_UNSPEC;
+	}
+	if (a->trusted != b->trusted) {
+		return a->trusted;
+	}
+	return b->seen < a->seen;
+}
+
+/*
+ * Entry for `peer`, NULL if there is none. With `create`, a missing one
+ * takes a free entry or, if the newcomer bucket allows, the one
+ * host_older() picks; it starts with a full bucket.
+ */
+static struct admission_host *host_get(const struct sockaddr_storage *peer,
+	int create, int64_t now)
+{
+	struct admission_host *oldest = NULL;
+	unsigned char addr[16];
+	int family = peer_key(peer, addr);
+	unsigned int i;
+
+	if (family == AF_UNSPEC) {
+		return NULL;
+	}
+	for (i = 0; i < ADMISSION_HOSTS; i++) {
+		struct admission_host *h = &adm.hosts[i];
+
+		if (h->family == family && memcmp(h->addr, addr, sizeof(addr)) == 0) {
+			return h;
+		}
+		if (oldest == NULL || host_older(oldest, h)) {
+			oldest = h;
+		}
+	}
+	if (!create) {
+		return NULL;
+	}
+	if (oldest->family != AF_UNSPEC) {
+		host_refill(&adm.newcomers, now);
+		if (adm.newcomers.tokens == 0) {
+			return NULL;
+		}
+		adm.newcomers.tokens--;
+	}
+	memset(oldest, 0, sizeof(*oldest));
+	memcpy(oldest->addr, addr, sizeof(addr));
+	oldest->family = family;
+	oldest->tokens = adm.config.burst;
+	oldest->refilled = now;
+	return oldest;
+}
+
+admission_result_t admission_check(const struct sockaddr_storage *peer)
+{
+	admission_result_t result = ADMISSION_OK;
+	int64_t now = now_ms();
+	struct admission_host *h;
+
+	xSemaphoreTake(adm.lock, portMAX_DELAY);
+	h = host_get(peer, 1, now);
+	if (h == NULL) {
+		/* unknown family (not counted), or no room for another address */
+		if (peer->ss_family == AF_INET || peer->ss_family == AF_INET6) {
+			result = ADMISSION_RATE;
+		}
+	} else {
+		h->seen = now;
+		if (h->blocked_until != 0 && now < h->blocked_until) {
+			result = ADMISSION_BLOCKED;
+		} else {
+			h->blocked_until = 0;
+			host_refill(h, now);
+			if (h->tokens == 0) {
+				result = ADMISSION_RATE;
+			} else {
+				h->tokens--;
+			}
+		}
+	}
+	/* cheapest first; a refused connection still used its token */
+	if (result == ADMISSION_OK && session_pool_active() >= CONFIG_DROPBEAR_MAX_SESSIONS) {
+		result = ADMISSION_BUSY;
+	}
+	if (result == ADMISSION_OK && adm.config.min_free_heap > 0
+			&& esp_get_free_heap_size() < adm.config.min_free_heap) {
+		result = ADMISSION_HEAP;
+	}
+
+	if (result == ADMISSION_OK) {
+		adm.stats.admitted++;
+	} else {
+		adm.stats.refused[result]++;
+	}
+	xSemaphoreGive(adm.lock);
+	return result;
+}
+
+void admission_session_closed(const struct sockaddr_storage *peer,
+	int authenticated, unsigned int auth_failures)
+{
+	struct admission_host *h;
+	int64_t now = now_ms();
+
+	xSemaphoreTake(adm.lock, portMAX_DELAY);
+	h = host_get(peer, 0, now);
+	if (h != NULL) {
+		if (authenticated) {
+			h->fails = 0;
+			h->trusted = 1;
+		} else if (auth_failures > 0 && adm.config.fail_limit > 0
+				&& ++h->fails >= adm.config.fail_limit) {
+			dropbear_log(LOG_WARNING, "Blocking a client for %u s after %u failed sessions",
+				adm.config.block_secs, h->fails);
+			h->blocked_until = now + (int64_t)adm.config.block_secs * 1000;
+			h->fails = 0;
+		}
+	}
+	xSemaphoreGive(adm.lock);
+}
+
+const char *admission_reason(admission_result_t result)
+{
+	return (unsigned)result < ADMISSION_REASONS ? reasons[result] : "?";
+}
+
+void admission_get_stats(admission_stats_t *stats)
+{
+	xSemaphoreTake(adm.lock, portMAX_DELAY);
+	*stats = adm.stats;
+	xSemaphoreGive(adm.lock);
+}
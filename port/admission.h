@@ -0,0 +1,66 @@
+#pragma once
+
+/*
+ * admission - decide right after accept() whether a connection gets a
+ * session at all.
+ *
+ * Everything a session costs (pool task, ~24 KB of heap, the X25519 key
+ * exchange) is spent only after the version exchange starts. A connection
+ * refused here costs an accept() and a close(): no byte is sent and no key
+ * is generated. Dropbear's MAX_UNAUTH_CLIENTS / MAX_UNAUTH_PER_IP live in
+ * svr-main.c's accept loop, which this port does not use.
+ *
+ * A connection is refused when its address
+ *   - is blocked after too many failed authentications,
+ *   - has used up its token bucket (burst connections, then one per
+ *     refill_ms),
+ * or when the server has no idle session task or too little free heap.
+ * Addresses are kept in a small table; the least recently seen one is
+ * replaced when it is full.
+ */
+
+#include <stddef.h>
+#include <sys/socket.h>
+
+#define ADMISSION_HOSTS  16
+
+typedef struct {
+	size_t min_free_heap;       /* refuse below this, 0: no heap check     */
+	unsigned int burst;         /* connections per address in a burst      */
+	unsigned int refill_ms;     /* one more connection after this long     */
+	unsigned int fail_limit;    /* failed sessions that block, 0: never    */
+	unsigned int block_secs;    /* how long an address stays blocked       */
+} admission_config_t;
+
+typedef enum {
+	ADMISSION_OK = 0,
+	ADMISSION_BLOCKED,          /* too many failed authentications */
+	ADMISSION_RATE,             /* token bucket empty              */
+	ADMISSION_BUSY,             /* no idle session task            */
+	ADMISSION_HEAP,             /* free heap below min_free_heap   */
+	ADMISSION_REASONS
+} admission_result_t;
+
+typedef struct {
+	unsigned long admitted;
+	unsigned long refused[ADMISSION_REASONS];   /* by reason, [0] unused */
+} admission_stats_t;
+
+/* Call once, before the first admission_check(). */
+void admission_init(const admission_config_t *config);
+
+/* From the accept loop, before the connection is handed to a session. */
+admission_result_t admission_check(const struct sockaddr_storage *peer);
+
+/*
+ * A session from `peer` ended. A session that ended before authentication
+ * after `auth_failures` failed attempts counts towards fail_limit; an
+ * authenticated one clears the count.
+ */
+void admission_session_closed(const struct sockaddr_storage *peer,
+	int authenticated, unsigned int auth_failures);
+
+/* Short text for a result, for logging. */
+const char *admission_reason(admission_result_t result);
+
+void admission_get_stats(admission_stats_t *stats);
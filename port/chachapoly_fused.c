@@ -0,0 +1,363 @@
+/*
+ * chachapoly_fused.c - Replacement for Dropbear's chachapoly.c with a
+ * single-pass chacha20-poly1305@openssh.com packet kernel.
+ *
+ * The stock code runs three passes over each packet: Poly1305 over the
+ * ciphertext, ChaCha20 over the length field and the payload, and on
+ * decryption the MAC check before that. Here the packet is walked once in
+ * 64-byte ChaCha20 blocks; each block is encrypted and fed to Poly1305
+ * while it is still hot in the cache (or, for decryption, fed to Poly1305
+ * and then decrypted). Output is bit-identical to chachapoly.c.
+ *
+ * Decryption still only hands back plaintext for authentic packets: if
+ * the tag does not match, the output is wiped before returning
+ * CRYPT_ERROR.
+ *
+ * The key schedule stays in libtomcrypt's chacha_state (set up with
+ * chacha_setup() as before); only its key words are read here.
+ */
+
+#include "includes.h"
+#include "algo.h"
+#include "dbutil.h"
+#include "chachapoly.h"
+
+#if DROPBEAR_CHACHA20POLY1305
+
+#define CHACHA20_KEY_LEN 32
+#define CHACHA20_BLOCKSIZE 8
+#define POLY1305_KEY_LEN 32
+#define POLY1305_TAG_LEN 16
+
+static const struct ltc_cipher_descriptor dummy = {.name = NULL};
+
+static const struct dropbear_hash dropbear_chachapoly_mac =
+	{NULL, POLY1305_KEY_LEN, POLY1305_TAG_LEN};
+
+const struct dropbear_cipher dropbear_chachapoly =
+	{&dummy, CHACHA20_KEY_LEN*2, CHACHA20_BLOCKSIZE};
+
+/* ------------------------------------------------------------------ */
+/*  ChaCha20 block function                                           */
+/* ------------------------------------------------------------------ */
+
+#define ROTL32(v, n)  (((v) << (n)) | ((v) >> (32 - (n))))
+
+#define QUARTERROUND(a, b, c, d) \
+	a += b; d ^= a; d = ROTL32(d, 16); \
+	c += d; b ^= c; b = ROTL32(b, 12); \
+	a += b; d ^= a; d = ROTL32(d, 8);  \
+	c += d; b ^= c; b = ROTL32(b, 7)
+
+static inline uint32_t load32_le(const unsigned char *p)
+{
+	return (uint32_t)p[0] | ((uint32_t)p[1] << 8)
+		| ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline void store32_le(unsigned char *p, uint32_t v)
+{
+	p[0] = (unsigned char)v;
+	p[1] = (unsigned char)(v >> 8);
+	p[2] = (unsigned char)(v >> 16);
+	p[3] = (unsigned char)(v >> 24);
+}
+
+/*
+ * One 64-byte keystream block. `key` is the libtomcrypt state whose
+ * input[0..11] hold the constants and key; the 64-bit block counter and
+ * the 64-bit nonce (the packet sequence number) are supplied here, laid
+ * out as chacha_ivctr64() would.
+ */
+static void chacha20_block(unsigned char out[64], const chacha_state *key,
+	uint64_t counter, const uint32_t nonce[2])
+{
+	uint32_t in[16], x[16];
+	int i;
+
+	for (i = 0; i < 12; i++) {
+		in[i] = (uint32_t)key->input[i];
+	}
+	in[12] = (uint32_t)counter;
+	in[13] = (uint32_t)(counter >> 32);
+	in[14] = nonce[0];
+	in[15] = nonce[1];
+
+	memcpy(x, in, sizeof(x));
+	for (i = 0; i < 10; i++) {
+		QUARTERROUND(x[0], x[4], x[8],  x[12]);
+		QUARTERROUND(x[1], x[5], x[9],  x[13]);
+		QUARTERROUND(x[2], x[6], x[10], x[14]);
+		QUARTERROUND(x[3], x[7], x[11], x[15]);
+		QUARTERROUND(x[0], x[5], x[10], x[15]);
+		QUARTERROUND(x[1], x[6], x[11], x[12]);
+		QUARTERROUND(x[2], x[7], x[8],  x[13]);
+		QUARTERROUND(x[3], x[4], x[9],  x[14]);
+	}
+	for (i = 0; i < 16; i++) {
+		store32_le(out + 4 * i, x[i] + in[i]);
+	}
+	m_burn(x, sizeof(x));
+}
+
+/* ------------------------------------------------------------------ */
+/*  Poly1305, 26-bit limbs (poly1305-donna-32)                        */
+/* ------------------------------------------------------------------ */
+
+struct poly1305 {
+	uint32_t r[5];
+	uint32_t h[5];
+	uint32_t pad[4];
+};
+
+static void poly1305_start(struct poly1305 *st, const unsigned char key[32])
+{
+	st->r[0] = (load32_le(key +  0)     ) & 0x3ffffff;
+	st->r[1] = (load32_le(key +  3) >> 2) & 0x3ffff03;
+	st->r[2] = (load32_le(key +  6) >> 4) & 0x3ffc0ff;
+	st->r[3] = (load32_le(key +  9) >> 6) & 0x3f03fff;
+	st->r[4] = (load32_le(key + 12) >> 8) & 0x00fffff;
+	memset(st->h, 0, sizeof(st->h));
+	st->pad[0] = load32_le(key + 16);
+	st->pad[1] = load32_le(key + 20);
+	st->pad[2] = load32_le(key + 24);
+	st->pad[3] = load32_le(key + 28);
+}
+
+/* Absorb one 16-byte block; hibit is 1 << 24 for full message blocks. */
+static void poly1305_block(struct poly1305 *st, const unsigned char m[16], uint32_t hibit)
+{
+	const uint32_t r0 = st->r[0], r1 = st->r[1], r2 = st->r[2], r3 = st->r[3], r4 = st->r[4];
+	const uint32_t s1 = r1 * 5, s2 = r2 * 5, s3 = r3 * 5, s4 = r4 * 5;
+	uint32_t h0 = st->h[0], h1 = st->h[1], h2 = st->h[2], h3 = st->h[3], h4 = st->h[4];
+	uint64_t d0, d1, d2, d3, d4;
+	uint32_t c;
+
+	h0 += (load32_le(m +  0)     ) & 0x3ffffff;
+	h1 += (load32_le(m +  3) >> 2) & 0x3ffffff;
+	h2 += (load32_le(m +  6) >> 4) & 0x3ffffff;
+	h3 += (load32_le(m +  9) >> 6) & 0x3ffffff;
+	h4 += (load32_le(m + 12) >> 8) | hibit;
+
+	d0 = (uint64_t)h0 * r0 + (uint64_t)h1 * s4 + (uint64_t)h2 * s3 + (uint64_t)h3 * s2 + (uint64_t)h4 * s1;
+	d1 = (uint64_t)h0 * r1 + (uint64_t)h1 * r0 + (uint64_t)h2 * s4 + (uint64_t)h3 * s3 + (uint64_t)h4 * s2;
+	d2 = (uint64_t)h0 * r2 + (uint64_t)h1 * r1 + (uint64_t)h2 * r0 + (uint64_t)h3 * s4 + (uint64_t)h4 * s3;
+	d3 = (uint64_t)h0 * r3 + (uint64_t)h1 * r2 + (uint64_t)h2 * r1 + (uint64_t)h3 * r0 + (uint64_t)h4 * s4;
+	d4 = (uint64_t)h0 * r4 + (uint64_t)h1 * r3 + (uint64_t)h2 * r2 + (uint64_t)h3 * r1 + (uint64_t)h4 * r0;
+
+	c = (uint32_t)(d0 >> 26); h0 = (uint32_t)d0 & 0x3ffffff;
+	d1 += c; c = (uint32_t)(d1 >> 26); h1 = (uint32_t)d1 & 0x3ffffff;
+	d2 += c; c = (uint32_t)(d2 >> 26); h2 = (uint32_t)d2 & 0x3ffffff;
+	d3 += c; c = (uint32_t)(d3 >> 26); h3 = (uint32_t)d3 & 0x3ffffff;
+	d4 += c; c = (uint32_t)(d4 >> 26); h4 = (uint32_t)d4 & 0x3ffffff;
+	h0 += c * 5; c = h0 >> 26; h0 &= 0x3ffffff;
+	h1 += c;
+
+	st->h[0] = h0;
+	st->h[1] = h1;
+	st->h[2] = h2;
+	st->h[3] = h3;
+	st->h[4] = h4;
+}
+
+/* Absorb the last 1..15 bytes of a message. */
+static void poly1305_tail(struct poly1305 *st, const unsigned char *m, unsigned long len)
+{
+	unsigned char block[16];
+
+	memset(block, 0, sizeof(block));
+	memcpy(block, m, len);
+	block[len] = 1;
+	poly1305_block(st, block, 0);
+}
+
+static void poly1305_finish(struct poly1305 *st, unsigned char tag[16])
+{
+	uint32_t h0 = st->h[0], h1 = st->h[1], h2 = st->h[2], h3 = st->h[3], h4 = st->h[4];
+	uint32_t g0, g1, g2, g3, g4, c, mask;
+	uint64_t f;
+
+	/* fully carry h */
+	c = h1 >> 26; h1 &= 0x3ffffff;
+	h2 += c; c = h2 >> 26; h2 &= 0x3ffffff;
+	h3 += c; c = h3 >> 26; h3 &= 0x3ffffff;
+	h4 += c; c = h4 >> 26; h4 &= 0x3ffffff;
+	h0 += c * 5; c = h0 >> 26; h0 &= 0x3ffffff;
+	h1 += c;
+
+	/* g = h - p; select h if h < p, else g */
+	g0 = h0 + 5; c = g0 >> 26; g0 &= 0x3ffffff;
+	g1 = h1 + c; c = g1 >> 26; g1 &= 0x3ffffff;
+	g2 = h2 + c; c = g2 >> 26; g2 &= 0x3ffffff;
+	g3 = h3 + c; c = g3 >> 26; g3 &= 0x3ffffff;
+	g4 = h4 + c - (1UL << 26);
+
+	mask = (g4 >> 31) - 1;
+	h0 = (h0 & ~mask) | (g0 & mask);
+	h1 = (h1 & ~mask) | (g1 & mask);
+	h2 = (h2 & ~mask) | (g2 & mask);
+	h3 = (h3 & ~mask) | (g3 & mask);
+	h4 = (h4 & ~mask) | (g4 & mask);
+
+	/* h = (h + pad) mod 2^128 */
+	h0 = (h0      ) | (h1 << 26);
+	h1 = (h1 >>  6) | (h2 << 20);
+	h2 = (h2 >> 12) | (h3 << 14);
+	h3 = (h3 >> 18) | (h4 <<  8);
+
+	f = (uint64_t)h0 + st->pad[0];             store32_le(tag +  0, (uint32_t)f);
+	f = (uint64_t)h1 + st->pad[1] + (f >> 32); store32_le(tag +  4, (uint32_t)f);
+	f = (uint64_t)h2 + st->pad[2] + (f >> 32); store32_le(tag +  8, (uint32_t)f);
+	f = (uint64_t)h3 + st->pad[3] + (f >> 32); store32_le(tag + 12, (uint32_t)f);
+
+	m_burn(st, sizeof(*st));
+}
+
+/* ------------------------------------------------------------------ */
+/*  Packet kernel                                                     */
+/* ------------------------------------------------------------------ */
+
+static void seq_nonce(uint32_t nonce[2], unsigned int seq)
+{
+	unsigned char seqbuf[8];
+
+	STORE64H((uint64_t)seq, seqbuf);
+	nonce[0] = load32_le(seqbuf);
+	nonce[1] = load32_le(seqbuf + 4);
+}
+
+static int dropbear_chachapoly_start(int UNUSED(cipher), const unsigned char* UNUSED(IV),
+			const unsigned char *key, int keylen,
+			int UNUSED(num_rounds), dropbear_chachapoly_state *state) {
+	int err;
+
+	TRACE2(("enter dropbear_chachapoly_start"))
+
+	if (keylen != CHACHA20_KEY_LEN*2) {
+		return CRYPT_ERROR;
+	}
+
+	if ((err = chacha_setup(&state->chacha, key,
+				CHACHA20_KEY_LEN, 20)) != CRYPT_OK) {
+		return err;
+	}
+
+	if ((err = chacha_setup(&state->header, key + CHACHA20_KEY_LEN,
+				CHACHA20_KEY_LEN, 20)) != CRYPT_OK) {
+		return err;
+	}
+
+	TRACE2(("leave dropbear_chachapoly_start"))
+	return CRYPT_OK;
+}
+
+/*
+ * The packet is [4-byte length | payload], len bytes in total, followed by
+ * the 16-byte tag. The length is encrypted with the header key, the payload
+ * with the main key from block counter 1, and Poly1305 (keyed from main key
+ * block 0) covers the whole ciphertext. The loop below walks "chunks" - the
+ * length field, then each 64-byte payload block - and keeps Poly1305 just
+ * behind (encrypt) or just ahead of (decrypt) the cipher, so every byte is
+ * touched once. Poly1305 blocks straddle chunk boundaries because of the
+ * 4-byte length field; `mac_pos` tracks how far it has got.
+ */
+static int dropbear_chachapoly_crypt(unsigned int seq,
+			const unsigned char *in, unsigned char *out,
+			unsigned long len, unsigned long taglen,
+			dropbear_chachapoly_state *state, int direction) {
+	struct poly1305 poly;
+	unsigned char ks[64], tag[POLY1305_TAG_LEN];
+	uint32_t nonce[2];
+	unsigned long pos, end, mac_pos = 0, i;
+	uint64_t counter = 1;
+	int ret = CRYPT_OK;
+
+	TRACE2(("enter dropbear_chachapoly_crypt"))
+
+	if (len < 4 || taglen != POLY1305_TAG_LEN) {
+		return CRYPT_ERROR;
+	}
+
+	seq_nonce(nonce, seq);
+	chacha20_block(ks, &state->chacha, 0, nonce);
+	poly1305_start(&poly, ks);
+
+	for (pos = 0; pos < len; pos = end) {
+		if (pos == 0) {
+			end = 4;
+			chacha20_block(ks, &state->header, 0, nonce);
+		} else {
+			end = pos + 64 < len ? pos + 64 : len;
+			chacha20_block(ks, &state->chacha, counter++, nonce);
+		}
+
+		if (direction == LTC_DECRYPT) {
+			/* MAC the ciphertext before it is overwritten (in may equal out) */
+			for (; mac_pos < end && mac_pos + 16 <= len; mac_pos += 16) {
+				poly1305_block(&poly, in + mac_pos, 1UL << 24);
+			}
+			if (mac_pos < len && mac_pos + 16 > len) {
+				poly1305_tail(&poly, in + mac_pos, len - mac_pos);
+				mac_pos = len;
+			}
+		}
+
+		for (i = pos; i < end; i++) {
+			out[i] = in[i] ^ ks[i - pos];
+		}
+
+		if (direction == LTC_ENCRYPT) {
+			for (; mac_pos + 16 <= end; mac_pos += 16) {
+				poly1305_block(&poly, out + mac_pos, 1UL << 24);
+			}
+		}
+	}
+
+	if (direction == LTC_ENCRYPT) {
+		if (mac_pos < len) {
+			poly1305_tail(&poly, out + mac_pos, len - mac_pos);
+		}
+		poly1305_finish(&poly, out + len);
+	} else {
+		poly1305_finish(&poly, tag);
+		if (constant_time_memcmp(in + len, tag, taglen) != 0) {
+			TRACE(("leave dropbear_chachapoly_crypt: mac failed"))
+			/* never release plaintext of a forged packet */
+			m_burn(out, len);
+			ret = CRYPT_ERROR;
+		}
+	}
+
+	m_burn(ks, sizeof(ks));
+	TRACE2(("leave dropbear_chachapoly_crypt"))
+	return ret;
+}
+
+static int dropbear_chachapoly_getlength(unsigned int seq,
+			const unsigned char *in, unsigned int *outlen,
+			unsigned long len, dropbear_chachapoly_state *state) {
+	unsigned char ks[64];
+	uint32_t nonce[2];
+
+	TRACE2(("enter dropbear_chachapoly_getlength"))
+
+	if (len < 4) {
+		return CRYPT_ERROR;
+	}
+
+	seq_nonce(nonce, seq);
+	chacha20_block(ks, &state->header, 0, nonce);
+	*outlen = ((uint32_t)(in[0] ^ ks[0]) << 24) | ((uint32_t)(in[1] ^ ks[1]) << 16)
+		| ((uint32_t)(in[2] ^ ks[2]) << 8) | (uint32_t)(in[3] ^ ks[3]);
+	m_burn(ks, sizeof(ks));
+
+	TRACE2(("leave dropbear_chachapoly_getlength"))
+	return CRYPT_OK;
+}
+
+const struct dropbear_cipher_mode dropbear_mode_chachapoly =
+	{(void *)dropbear_chachapoly_start, NULL, NULL,
+	 (void *)dropbear_chachapoly_crypt,
+	 (void *)dropbear_chachapoly_getlength, &dropbear_chachapoly_mac};
+
+#endif /* DROPBEAR_CHACHA20POLY1305 */
@@ -0,0 +1,501 @@
+/*
+ * chan_inproc.c - In-process SSH channel endpoints.
+ *
+ * Channel data for an attached channel is taken out of the decrypted
+ * packet in __wrap_recv_msg_channel_data() and passed to the endpoint's
+ * recv() callback. The receive window is handed back in RECV_WINDOWEXTEND
+ * steps, as Dropbear does once its writebuf has been drained. Endpoints that
+ * queue requests (defer_window) hand it back only as they work through them,
+ * so a client cannot run further ahead than its window. Output is
+ * sent as SSH_MSG_CHANNEL_DATA packets within the peer's window and maximum
+ * packet size. Output that has to wait for a window adjust or the end of a
+ * key exchange is kept in a small circular buffer. chan_inproc_flush() sends
+ * at most one maximum-size packet of it per call, so channels sharing a
+ * connection take turns in the write queue, as Dropbear's fd channels do.
+ *
+ * With CONFIG_DROPBEAR_ADAPTIVE_WINDOW the window and maximum packet size
+ * offered when a channel opens come from the free heap shared out between
+ * the open in-process channels. During a transfer a "keepalive@openssh.com"
+ * channel request with want_reply goes out at most once a second; its reply
+ * (-Wl,--wrap=ignore_recv_response) gives the round-trip time. When a whole
+ * window's worth of data arrives in less than two round trips the window,
+ * not the link, limits the transfer, and the window doubles, up to the
+ * heap share. It shrinks again (by not re-advertising consumed data) when
+ * the heap share drops below it.
+ *
+ * Only the session task holding the session pool lock runs Dropbear code,
+ * so the slot table needs no locking.
+ */
+
+#include "includes.h"
+#include "session.h"
+#include "channel.h"
+#include "packet.h"
+#include "buffer.h"
+#include "circbuffer.h"
+#include "runopts.h"
+#include "ssh.h"
+#include "dbutil.h"
+#include "sdkconfig.h"
+#include "chan_inproc.h"
+
+#include "esp_system.h"
+#include "esp_timer.h"
+
+#include <limits.h>
+
+#define CHAN_INPROC_SLOTS     (CONFIG_DROPBEAR_MAX_SESSIONS * CONFIG_DROPBEAR_MAX_SESSION_CHANNELS)
+#define CHAN_INPROC_PENDING   4096
+
+#if CONFIG_DROPBEAR_ADAPTIVE_WINDOW
+#define CHAN_WINDOW_MIN       4096
+#define CHAN_PACKET_MIN       2048
+#define CHAN_PROBE_US         1000000
+#endif
+
+struct inproc_slot {
+	struct Channel *channel;            /* NULL if the slot is free */
+	const struct chan_inproc_ops *ops;
+	circbuffer *pending;                /* output waiting for window */
+	unsigned int recvdone;              /* consumed, not yet re-advertised */
+	unsigned int debt;                  /* consumed bytes never re-advertised */
+	unsigned int size;                  /* window offered, debt excluded */
+	unsigned int limit;                 /* largest window the endpoint takes */
+	int64_t adjust_us;                  /* last window adjust sent */
+	int64_t probe_us;                   /* RTT probe in flight, 0 if none */
+	int64_t probed_us;                  /* last RTT probe sent */
+	unsigned int rtt_us;                /* smallest probe round trip, 0 if none yet */
+	int closing;
+};
+
+static struct inproc_slot slots[CHAN_INPROC_SLOTS];
+static unsigned long stat_packets, stat_bytes;
+static chan_inproc_window_hook_t window_hook;
+
+void __real_recv_msg_channel_data(void);
+void __real_ignore_recv_response(void);
+
+static struct inproc_slot *slot_of(const struct Channel *channel)
+{
+	int i;
+
+	for (i = 0; i < CHAN_INPROC_SLOTS; i++) {
+		if (slots[i].channel == channel) {
+			return &slots[i];
+		}
+	}
+	return NULL;
+}
+
+static int can_send(const struct Channel *channel)
+{
+	return ses.dataallowed && !channel->sent_eof && !channel->sent_close;
+}
+
+/* One SSH_MSG_CHANNEL_DATA packet per transmaxpacket, while the window lasts. */
+static unsigned int send_data(struct Channel *channel, const unsigned char *data,
+	unsigned int len)
+{
+	unsigned int sent = 0;
+
+	while (sent < len && channel->transwindow > 0 && can_send(channel)) {
+		unsigned int n = MIN(len - sent, channel->transwindow);
+
+		n = MIN(n, channel->transmaxpacket);
+		buf_putbyte(ses.writepayload, SSH_MSG_CHANNEL_DATA);
+		buf_putint(ses.writepayload, channel->remotechan);
+		buf_putstring(ses.writepayload, (const char *)data + sent, n);
+		encrypt_packet();
+
+		channel->transwindow -= n;
+		sent += n;
+		stat_packets++;
+		stat_bytes += n;
+	}
+	return sent;
+}
+
+static void send_window_adjust(struct Channel *channel, unsigned int incr)
+{
+	buf_putbyte(ses.writepayload, SSH_MSG_CHANNEL_WINDOW_ADJUST);
+	buf_putint(ses.writepayload, channel->remotechan);
+	buf_putint(ses.writepayload, incr);
+	encrypt_packet();
+
+	channel->recvwindow += incr;
+}
+
+/* ------------------------------------------------------------------ */
+/*  Window sizing                                                     */
+/* ------------------------------------------------------------------ */
+#if CONFIG_DROPBEAR_ADAPTIVE_WINDOW
+static unsigned int slots_in_use(void)
+{
+	unsigned int i, n = 0;
+
+	for (i = 0; i < CHAN_INPROC_SLOTS; i++) {
+		if (slots[i].channel != NULL) {
+			n++;
+		}
+	}
+	return n;
+}
+
+static void report_window(const struct Channel *channel, unsigned int window,
+	unsigned int cap, unsigned int rtt_us)
+{
+	struct chan_window_info info;
+
+	if (window_hook == NULL) {
+		return;
+	}
+	info.window = window;
+	info.maxpacket = channel->recvmaxpacket;
+	info.cap = cap;
+	info.rtt_us = rtt_us;
+	info.free_heap = esp_get_free_heap_size();
+	window_hook(channel, &info);
+}
+
+/*
+ * Free heap above the reserve, split between `channels` channels. Up to a
+ * window of client data can end up buffered on the device (lwIP, packet
+ * buffers, endpoint queues), so a window gets at most half of a share.
+ */
+static unsigned int heap_share(unsigned int channels)
+{
+	size_t free_heap = esp_get_free_heap_size();
+
+	if (free_heap <= CONFIG_DROPBEAR_WINDOW_HEAP_RESERVE) {
+		return 0;
+	}
+	return (unsigned int)((free_heap - CONFIG_DROPBEAR_WINDOW_HEAP_RESERVE) / MAX(channels, 1));
+}
+
+static unsigned int window_cap(unsigned int share, unsigned int limit)
+{
+	unsigned int cap = MIN(share / 2, CONFIG_DROPBEAR_WINDOW_MAX);
+
+	return MAX(MIN(cap, limit), CHAN_WINDOW_MIN);
+}
+
+/*
+ * Round-trip probe. Clients answer unknown channel requests with
+ * SSH_MSG_CHANNEL_FAILURE, which Dropbear hands to ignore_recv_response().
+ */
+static void window_probe(struct inproc_slot *slot, int64_t now)
+{
+	if (slot->probe_us != 0 || now - slot->probed_us < CHAN_PROBE_US) {
+		return;
+	}
+	buf_putbyte(ses.writepayload, SSH_MSG_CHANNEL_REQUEST);
+	buf_putint(ses.writepayload, slot->channel->remotechan);
+	buf_putstring(ses.writepayload, "keepalive@openssh.com", 21);
+	buf_putbyte(ses.writepayload, 1);
+	encrypt_packet();
+	slot->probe_us = now;
+	slot->probed_us = now;
+}
+
+/*
+ * About to re-advertise recvdone bytes. Shrink a window the heap can no
+ * longer back; double one that the client used up in less than two round
+ * trips, which is what the bandwidth-delay product asks for.
+ */
+static void window_tune(struct inproc_slot *slot)
+{
+	unsigned int cap = window_cap(heap_share(slots_in_use()), slot->limit);
+	int64_t now = esp_timer_get_time();
+
+	if (slot->size > cap) {
+		unsigned int cut = slot->size - cap;
+		unsigned int keep = MIN(cut, slot->recvdone);
+
+		slot->recvdone -= keep;
+		slot->debt += cut - keep;
+		slot->size = cap;
+		report_window(slot->channel, slot->size, cap, slot->rtt_us);
+	} else if (slot->size < cap && slot->rtt_us != 0 && slot->adjust_us != 0
+			&& (now - slot->adjust_us) * slot->size
+				< 2 * (int64_t)slot->rtt_us * slot->recvdone) {
+		unsigned int grow = MIN(slot->size, cap - slot->size);
+
+		slot->recvdone += grow;
+		slot->size += grow;
+		report_window(slot->channel, slot->size, cap, slot->rtt_us);
+	}
+	slot->adjust_us = now;
+	window_probe(slot, now);
+}
+#endif
+
+/* `len` bytes of client data are done with: re-advertise them in window/3 steps. */
+static void window_done(struct inproc_slot *slot, unsigned int len)
+{
+	unsigned int keep = MIN(len, slot->debt);
+	unsigned int extend = MIN(RECV_WINDOWEXTEND, slot->size / 3);
+
+	slot->debt -= keep;
+	slot->recvdone += len - keep;
+	if (slot->recvdone >= extend && can_send(slot->channel)) {
+#if CONFIG_DROPBEAR_ADAPTIVE_WINDOW
+		window_tune(slot);
+#endif
+		if (slot->recvdone > 0) {
+			send_window_adjust(slot->channel, slot->recvdone);
+			slot->recvdone = 0;
+		}
+	}
+}
+
+void chan_inproc_open_window(struct Channel *channel, unsigned int max)
+{
+#if CONFIG_DROPBEAR_ADAPTIVE_WINDOW
+	/* counting the channel being opened */
+	unsigned int share = heap_share(slots_in_use() + 1);
+	unsigned int cap;
+#endif
+
+	channel->recvwindow = MIN(channel->recvwindow, max);
+#if CONFIG_DROPBEAR_ADAPTIVE_WINDOW
+	cap = MIN(window_cap(share, channel->recvwindow), channel->recvwindow);
+	channel->recvwindow = cap;
+	channel->recvmaxpacket = MIN(channel->recvmaxpacket, MAX(cap / 2, CHAN_PACKET_MIN));
+	report_window(channel, cap, cap, 0);
+#endif
+}
+
+void chan_inproc_set_window_hook(chan_inproc_window_hook_t hook)
+{
+	window_hook = hook;
+}
+
+int chan_inproc_attach(struct Channel *channel, const struct chan_inproc_ops *ops)
+{
+	struct inproc_slot *slot = slot_of(NULL);
+
+	if (slot == NULL) {
+		return DROPBEAR_FAILURE;
+	}
+	memset(slot, 0, sizeof(*slot));
+	slot->channel = channel;
+	slot->ops = ops;
+	/* no data has arrived yet: the window left is the one offered */
+	slot->size = channel->recvwindow;
+	/* endpoints that queue data keep the window they were opened with */
+	slot->limit = ops->defer_window ? channel->recvwindow : UINT_MAX;
+	return DROPBEAR_SUCCESS;
+}
+
+void chan_inproc_detach(const struct Channel *channel)
+{
+	struct inproc_slot *slot = slot_of(channel);
+
+	if (slot == NULL) {
+		return;
+	}
+	if (slot->pending != NULL) {
+		cbuf_free(slot->pending);
+	}
+	memset(slot, 0, sizeof(*slot));
+}
+
+unsigned int chan_inproc_send(struct Channel *channel, const void *data, unsigned int len)
+{
+	struct inproc_slot *slot = slot_of(channel);
+	unsigned int sent = 0, n;
+
+	if (slot == NULL || slot->closing || len == 0) {
+		return 0;
+	}
+
+	/* keep the byte order: nothing goes out directly while older output waits */
+	if (slot->pending == NULL || cbuf_getused(slot->pending) == 0) {
+		sent = send_data(channel, data, len);
+	}
+	if (sent == len) {
+		return len;
+	}
+
+	if (slot->pending == NULL) {
+		slot->pending = cbuf_new(CHAN_INPROC_PENDING);
+	}
+	while (sent < len && (n = MIN(len - sent, cbuf_writelen(slot->pending))) > 0) {
+		memcpy(cbuf_writeptr(slot->pending, n), (const unsigned char *)data + sent, n);
+		cbuf_incrwrite(slot->pending, n);
+		sent += n;
+	}
+	return sent;
+}
+
+void chan_inproc_flush(struct Channel *channel)
+{
+	struct inproc_slot *slot = slot_of(channel);
+	unsigned char *p1, *p2;
+	unsigned int len1, len2, n;
+
+	if (slot == NULL) {
+		return;
+	}
+
+	if (slot->pending != NULL && cbuf_getused(slot->pending) > 0) {
+		/* one packet per loop iteration; the queued packet wakes the next one */
+		cbuf_readptrs(slot->pending, &p1, &len1, &p2, &len2);
+		len1 = MIN(len1, channel->transmaxpacket);
+		len2 = MIN(len2, channel->transmaxpacket - len1);
+		n = send_data(channel, p1, len1);
+		if (n == len1 && len2 > 0) {
+			n += send_data(channel, p2, len2);
+		}
+		cbuf_incrread(slot->pending, n);
+	}
+
+	if (slot->closing && chan_inproc_pending(channel) == 0) {
+		channel->readfd = FD_CLOSED;
+		channel->writefd = FD_CLOSED;
+	}
+}
+
+unsigned int chan_inproc_room(const struct Channel *channel)
+{
+	const struct inproc_slot *slot = slot_of(channel);
+
+	if (slot == NULL || slot->closing) {
+		return 0;
+	}
+	if (slot->pending == NULL) {
+		return CHAN_INPROC_PENDING;
+	}
+	return CHAN_INPROC_PENDING - cbuf_getused(slot->pending);
+}
+
+unsigned int chan_inproc_pending(const struct Channel *channel)
+{
+	const struct inproc_slot *slot = slot_of(channel);
+
+	if (slot == NULL || slot->pending == NULL) {
+		return 0;
+	}
+	return cbuf_getused(slot->pending);
+}
+
+void chan_inproc_consumed(struct Channel *channel, unsigned int len)
+{
+	struct inproc_slot *slot = slot_of(channel);
+
+	if (slot != NULL && slot->ops->defer_window) {
+		window_done(slot, len);
+	}
+}
+
+void chan_inproc_cap_window(struct Channel *channel, unsigned int max)
+{
+	struct inproc_slot *slot = slot_of(channel);
+
+	if (slot == NULL) {
+		return;
+	}
+	if (channel->recvwindow > max) {
+		slot->debt = channel->recvwindow - max;
+		slot->size = max;
+	}
+	slot->limit = MIN(slot->limit, max);
+}
+
+void chan_inproc_close(struct Channel *channel)
+{
+	struct inproc_slot *slot = slot_of(channel);
+
+	if (slot == NULL) {
+		return;
+	}
+	slot->closing = 1;
+	chan_inproc_flush(channel);
+}
+
+void chan_inproc_get_stats(unsigned long *packets, unsigned long *bytes)
+{
+	*packets = stat_packets;
+	*bytes = stat_bytes;
+}
+
+/* ------------------------------------------------------------------ */
+/*  Link-time wrapper                                                 */
+/* ------------------------------------------------------------------ */
+
+void __wrap_recv_msg_channel_data(void)
+{
+	unsigned int pos = ses.payload->pos;
+	struct Channel *channel;
+	struct inproc_slot *slot;
+	unsigned char *data;
+	unsigned int len;
+
+	channel = getchannel();
+	slot = slot_of(channel);
+	if (slot == NULL) {
+		buf_setpos(ses.payload, pos);
+		__real_recv_msg_channel_data();
+		return;
+	}
+
+	if (channel->recv_eof) {
+		dropbear_exit("Received data after eof");
+	}
+	len = buf_getint(ses.payload);
+	if (len > channel->recvwindow) {
+		dropbear_exit("Oversized packet");
+	}
+	data = buf_getptr(ses.payload, len);
+	buf_incrpos(ses.payload, len);
+	channel->recvwindow -= len;
+
+	if (!slot->closing) {
+		slot->ops->recv(channel, data, len);
+		if (slot->ops->defer_window) {
+			return;
+		}
+	}
+
+	/* all of it was consumed */
+	window_done(slot, len);
+}
+
+#if CONFIG_DROPBEAR_ADAPTIVE_WINDOW
+/*
+ * SSH_MSG_CHANNEL_SUCCESS/FAILURE and SSH_MSG_REQUEST_SUCCESS/FAILURE. Only
+ * the channel replies carry a recipient channel, an index into this
+ * session's channel table; the slot table is shared by all sessions, so the
+ * channel is looked up there rather than by index. Replies to requests on a
+ * channel come back in the order the requests went out, and the probe is the
+ * only request with want_reply this file sends, so the first reply on a
+ * channel with a probe in flight ends the probe. Dropbear sends its own
+ * keepalive only after the client has been silent for -K seconds, which a
+ * transfer being probed never is. The smallest sample is kept: replies
+ * queue behind upload data and can come back late.
+ */
+void __wrap_ignore_recv_response(void)
+{
+	unsigned int pos = ses.payload->pos;
+	unsigned char type = ses.payload->data[pos - 1];
+
+	if ((type == SSH_MSG_CHANNEL_SUCCESS || type == SSH_MSG_CHANNEL_FAILURE)
+			&& ses.payload->len - pos >= 4) {
+		unsigned int index = buf_getint(ses.payload);
+		struct inproc_slot *slot = NULL;
+
+		if (index < ses.chansize && ses.channels[index] != NULL) {
+			slot = slot_of(ses.channels[index]);
+		}
+		if (slot != NULL && slot->probe_us != 0) {
+			unsigned int sample = (unsigned int)(esp_timer_get_time() - slot->probe_us);
+
+			sample = MAX(sample, 1);
+			slot->rtt_us = slot->rtt_us == 0 ? sample : MIN(slot->rtt_us, sample);
+			slot->probe_us = 0;
+		}
+		buf_setpos(ses.payload, pos);
+	}
+	__real_ignore_recv_response();
+}
+#endif
@@ -0,0 +1,94 @@
+#pragma once
+
+/*
+ * chan_inproc - SSH channels whose far end is code in the session task.
+ *
+ * A channel normally talks to a process through readfd/writefd, and
+ * Dropbear's channel loop moves data between those fds and the wire. An
+ * in-process endpoint has no fds. Data from the client is handed to its
+ * recv() callback straight out of the decrypted packet, and chan_inproc_send()
+ * turns output into SSH_MSG_CHANNEL_DATA packets right away.
+ *
+ * The component links with -Wl,--wrap=recv_msg_channel_data, so channel data
+ * for attached channels never reaches Dropbear's writebuf. Until
+ * chan_inproc_close() the channel's fds stay FD_UNINIT, which Dropbear's
+ * channel loop leaves alone.
+ */
+
+#include "includes.h"
+#include "channel.h"
+
+struct chan_inproc_ops {
+	/* Data from the client. Must take all of it; the window is handed back. */
+	void (*recv)(struct Channel *channel, const unsigned char *data, unsigned int len);
+	/*
+	 * Nonzero: recv() only queues the data, and the window is handed back as
+	 * the endpoint reports it done with chan_inproc_consumed(). Queued data
+	 * then still counts against the client's window.
+	 */
+	int defer_window;
+};
+
+/* Make `channel` an in-process channel. Returns DROPBEAR_FAILURE if no slot is free. */
+int chan_inproc_attach(struct Channel *channel, const struct chan_inproc_ops *ops);
+
+/* Release the channel's slot and any unsent output (from ChanType cleanup). */
+void chan_inproc_detach(const struct Channel *channel);
+
+/*
+ * Send `len` bytes to the client. Whatever does not fit the peer's window is
+ * kept (up to a few KB) and sent by chan_inproc_flush(). Returns the number
+ * of bytes accepted.
+ */
+unsigned int chan_inproc_send(struct Channel *channel, const void *data, unsigned int len);
+
+/* Send up to one full packet of kept output, window permitting. Call once per loop iteration. */
+void chan_inproc_flush(struct Channel *channel);
+
+/* chan_inproc_send() accepts at least this many bytes right now. */
+unsigned int chan_inproc_room(const struct Channel *channel);
+
+/* Bytes accepted by chan_inproc_send() but not sent yet. */
+unsigned int chan_inproc_pending(const struct Channel *channel);
+
+/* defer_window endpoints: `len` more bytes from recv() have been dealt with. */
+void chan_inproc_consumed(struct Channel *channel, unsigned int len);
+
+/*
+ * defer_window endpoints with a fixed-size queue: keep the client's window at
+ * no more than `max` bytes by not re-advertising the excess as it is consumed.
+ * The window never grows past `max` either.
+ */
+void chan_inproc_cap_window(struct Channel *channel, unsigned int max);
+
+/*
+ * From the channel type's inithandler, before the open is confirmed: choose
+ * the window and maximum packet size offered. The window is at most `max`,
+ * the most client data the endpoint can queue: a client may send all of the
+ * window offered here before a later chan_inproc_cap_window() takes effect.
+ * With CONFIG_DROPBEAR_ADAPTIVE_WINDOW the free heap lowers both further. Only ever lowers Dropbear's defaults; the window grows later,
+ * once the channel is attached, and never past `max` for defer_window
+ * endpoints.
+ */
+void chan_inproc_open_window(struct Channel *channel, unsigned int max);
+
+/* A window choice, as passed to the window hook. */
+struct chan_window_info {
+	unsigned int window;        /* window now offered to the client */
+	unsigned int maxpacket;     /* channel's maximum packet size */
+	unsigned int cap;           /* largest window the heap share allows */
+	unsigned int rtt_us;        /* measured round trip, 0 if not yet known */
+	unsigned int free_heap;
+};
+
+typedef void (*chan_inproc_window_hook_t)(const struct Channel *channel,
+	const struct chan_window_info *info);
+
+/* Called when a channel opens and whenever its window grows or shrinks. */
+void chan_inproc_set_window_hook(chan_inproc_window_hook_t hook);
+
+/* No more data either way: Dropbear sends EOF and CLOSE once output is flushed. */
+void chan_inproc_close(struct Channel *channel);
+
+/* SSH_MSG_CHANNEL_DATA packets and payload bytes sent for in-process channels since boot. */
+void chan_inproc_get_stats(unsigned long *packets, unsigned long *bytes);
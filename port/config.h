@@ -432,7 +432,13 @@
 #define HAVE_U_INT8_T 1
 
 /* Define to 1 if you have the `writev' function. */
-// #define HAVE_WRITEV 1
+/* port/writev_lwip.c, backed by lwip_writev() */
+#define HAVE_WRITEV 1
+
+/* packet.c only gathers the write queue when IOV_MAX is known */
+#ifndef IOV_MAX
+#define IOV_MAX 16
+#endif
 
 /* Define to 1 if you have the `_getpty' function. */
 /* #undef HAVE__GETPTY */
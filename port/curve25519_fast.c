@@ -0,0 +1,1170 @@
+/*
+ * curve25519_fast.c - Optimized replacement for Dropbear's curve25519.c.
+ *
+ * Dropbear's curve25519.c is derived from TweetNaCl: field elements are
+ * sixteen 16-bit limbs and every multiplication is a 256-step schoolbook
+ * loop with a separate reduction pass. That is compact, but on a 32-bit
+ * core it dominates handshake time.
+ *
+ * This file keeps the same interface (curve25519.h) and uses the ref10
+ * representation instead: ten signed 32-bit limbs alternating 26 and 25
+ * bits (radix 2^25.5), so a product is 100 32x32->64 multiplies with the
+ * reduction folded in, and squaring has its own routine that needs only
+ * 55 of them. X25519 is a Montgomery ladder with a constant-time swap;
+ * fixed-base multiplications (Ed25519 keys and signatures, X25519 public
+ * keys) use signed 4-bit digits over a comb table of multiples of the base
+ * point. The table is either generated at build time into flash
+ * (CONFIG_DROPBEAR_ED25519_BASE_TABLE) or, without it, eight points
+ * computed into RAM on first use.
+ *
+ * Everything that touches secret data runs in constant time: no
+ * secret-dependent branches or table indices. Only signature verification,
+ * which works on public data, uses variable-time code.
+ */
+
+#include "includes.h"
+#include "dbrandom.h"
+#include "dbutil.h"
+#include "curve25519.h"
+#include "sdkconfig.h"
+
+#if DROPBEAR_CURVE25519_DEP
+
+/* ------------------------------------------------------------------ */
+/*  Field arithmetic mod 2^255 - 19                                   */
+/* ------------------------------------------------------------------ */
+
+/*
+ * h = h[0] + h[1]*2^26 + h[2]*2^51 + h[3]*2^77 + ... + h[9]*2^230.
+ * Limbs are signed and may exceed their nominal width between carries.
+ */
+typedef int32_t fe[10];
+
+#define FE_WIDTH(i)  (26 - ((i) & 1))
+
+static const fe fe_d = {
+	56195235, 13857412, 51736253, 6949390, 114729,
+	24766616, 60832955, 30306712, 48412415, 21499315
+};
+static const fe fe_d2 = {
+	45281625, 27714825, 36363642, 13898781, 229458,
+	15978800, 54557047, 27058993, 29715967, 9444199
+};
+static const fe fe_sqrtm1 = {
+	34513072, 25610706, 9377949, 3500415, 12389472,
+	33281959, 41962654, 31548777, 326685, 11406482
+};
+#if !CONFIG_DROPBEAR_ED25519_BASE_TABLE_STRIDE
+/* Ed25519 base point, affine */
+static const fe fe_base_x = {
+	52811034, 25909283, 16144682, 17082669, 27570973,
+	30858332, 40966398, 8378388, 20764389, 8758491
+};
+static const fe fe_base_y = {
+	40265304, 26843545, 13421772, 20132659, 26843545,
+	6710886, 53687091, 13421772, 40265318, 26843545
+};
+#endif
+
+static void fe_0(fe h)
+{
+	memset(h, 0, sizeof(fe));
+}
+
+static void fe_1(fe h)
+{
+	memset(h, 0, sizeof(fe));
+	h[0] = 1;
+}
+
+static void fe_copy(fe h, const fe f)
+{
+	memcpy(h, f, sizeof(fe));
+}
+
+static void fe_add(fe h, const fe f, const fe g)
+{
+	int i;
+
+	for (i = 0; i < 10; i++) {
+		h[i] = f[i] + g[i];
+	}
+}
+
+static void fe_sub(fe h, const fe f, const fe g)
+{
+	int i;
+
+	for (i = 0; i < 10; i++) {
+		h[i] = f[i] - g[i];
+	}
+}
+
+static void fe_neg(fe h, const fe f)
+{
+	int i;
+
+	for (i = 0; i < 10; i++) {
+		h[i] = -f[i];
+	}
+}
+
+/* f = g if b == 1, unchanged if b == 0 */
+static void fe_cmov(fe f, const fe g, uint32_t b)
+{
+	uint32_t mask = 0u - b;
+	int i;
+
+	for (i = 0; i < 10; i++) {
+		f[i] ^= (int32_t)(((uint32_t)f[i] ^ (uint32_t)g[i]) & mask);
+	}
+}
+
+/* swap f and g if b == 1 */
+static void fe_cswap(fe f, fe g, uint32_t b)
+{
+	uint32_t mask = 0u - b;
+	int32_t x;
+	int i;
+
+	for (i = 0; i < 10; i++) {
+		x = (int32_t)(((uint32_t)f[i] ^ (uint32_t)g[i]) & mask);
+		f[i] ^= x;
+		g[i] ^= x;
+	}
+}
+
+/*
+ * Reduce 64-bit limb sums (from a product) back to 26/25-bit limbs.
+ * The carry order is the one from ref10, which keeps every intermediate
+ * inside 64 bits for the inputs produced by this file.
+ */
+static void fe_carry(fe h, int64_t t[10])
+{
+	int64_t c;
+
+#define CARRY26(i)  c = (t[i] + ((int64_t)1 << 25)) >> 26; t[(i) + 1] += c; t[i] -= c * ((int64_t)1 << 26)
+#define CARRY25(i)  c = (t[i] + ((int64_t)1 << 24)) >> 25; t[(i) + 1] += c; t[i] -= c * ((int64_t)1 << 25)
+	CARRY26(0);
+	CARRY26(4);
+	CARRY25(1);
+	CARRY25(5);
+	CARRY26(2);
+	CARRY26(6);
+	CARRY25(3);
+	CARRY25(7);
+	CARRY26(4);
+	CARRY26(8);
+	c = (t[9] + ((int64_t)1 << 24)) >> 25;
+	t[0] += c * 19;
+	t[9] -= c * ((int64_t)1 << 25);
+	CARRY26(0);
+#undef CARRY26
+#undef CARRY25
+
+	h[0] = (int32_t)t[0];
+	h[1] = (int32_t)t[1];
+	h[2] = (int32_t)t[2];
+	h[3] = (int32_t)t[3];
+	h[4] = (int32_t)t[4];
+	h[5] = (int32_t)t[5];
+	h[6] = (int32_t)t[6];
+	h[7] = (int32_t)t[7];
+	h[8] = (int32_t)t[8];
+	h[9] = (int32_t)t[9];
+}
+
+/*
+ * h = f * g. Limb products whose weight reaches 2^255 are folded back with
+ * a factor of 19; products of two odd limbs get an extra factor of 2
+ * because their half bits do not add up to an integer exponent.
+ */
+static void fe_mul(fe h, const fe f, const fe g)
+{
+	int32_t f0 = f[0], f1 = f[1], f2 = f[2], f3 = f[3], f4 = f[4];
+	int32_t f5 = f[5], f6 = f[6], f7 = f[7], f8 = f[8], f9 = f[9];
+	int32_t g0 = g[0], g1 = g[1], g2 = g[2], g3 = g[3], g4 = g[4];
+	int32_t g5 = g[5], g6 = g[6], g7 = g[7], g8 = g[8], g9 = g[9];
+	int32_t f1_2 = 2 * f1;
+	int32_t f3_2 = 2 * f3;
+	int32_t f5_2 = 2 * f5;
+	int32_t f7_2 = 2 * f7;
+	int32_t f9_2 = 2 * f9;
+	int32_t g1_19 = 19 * g1;
+	int32_t g2_19 = 19 * g2;
+	int32_t g3_19 = 19 * g3;
+	int32_t g4_19 = 19 * g4;
+	int32_t g5_19 = 19 * g5;
+	int32_t g6_19 = 19 * g6;
+	int32_t g7_19 = 19 * g7;
+	int32_t g8_19 = 19 * g8;
+	int32_t g9_19 = 19 * g9;
+	int64_t t[10];
+
+	t[0] = (int64_t)f0 * g0 + (int64_t)f1_2 * g9_19 + (int64_t)f2 * g8_19
+		+ (int64_t)f3_2 * g7_19 + (int64_t)f4 * g6_19 + (int64_t)f5_2 * g5_19
+		+ (int64_t)f6 * g4_19 + (int64_t)f7_2 * g3_19 + (int64_t)f8 * g2_19
+		+ (int64_t)f9_2 * g1_19;
+	t[1] = (int64_t)f0 * g1 + (int64_t)f1 * g0 + (int64_t)f2 * g9_19 + (int64_t)f3 * g8_19
+		+ (int64_t)f4 * g7_19 + (int64_t)f5 * g6_19 + (int64_t)f6 * g5_19
+		+ (int64_t)f7 * g4_19 + (int64_t)f8 * g3_19 + (int64_t)f9 * g2_19;
+	t[2] = (int64_t)f0 * g2 + (int64_t)f1_2 * g1 + (int64_t)f2 * g0 + (int64_t)f3_2 * g9_19
+		+ (int64_t)f4 * g8_19 + (int64_t)f5_2 * g7_19 + (int64_t)f6 * g6_19
+		+ (int64_t)f7_2 * g5_19 + (int64_t)f8 * g4_19 + (int64_t)f9_2 * g3_19;
+	t[3] = (int64_t)f0 * g3 + (int64_t)f1 * g2 + (int64_t)f2 * g1 + (int64_t)f3 * g0
+		+ (int64_t)f4 * g9_19 + (int64_t)f5 * g8_19 + (int64_t)f6 * g7_19
+		+ (int64_t)f7 * g6_19 + (int64_t)f8 * g5_19 + (int64_t)f9 * g4_19;
+	t[4] = (int64_t)f0 * g4 + (int64_t)f1_2 * g3 + (int64_t)f2 * g2 + (int64_t)f3_2 * g1
+		+ (int64_t)f4 * g0 + (int64_t)f5_2 * g9_19 + (int64_t)f6 * g8_19
+		+ (int64_t)f7_2 * g7_19 + (int64_t)f8 * g6_19 + (int64_t)f9_2 * g5_19;
+	t[5] = (int64_t)f0 * g5 + (int64_t)f1 * g4 + (int64_t)f2 * g3 + (int64_t)f3 * g2
+		+ (int64_t)f4 * g1 + (int64_t)f5 * g0 + (int64_t)f6 * g9_19 + (int64_t)f7 * g8_19
+		+ (int64_t)f8 * g7_19 + (int64_t)f9 * g6_19;
+	t[6] = (int64_t)f0 * g6 + (int64_t)f1_2 * g5 + (int64_t)f2 * g4 + (int64_t)f3_2 * g3
+		+ (int64_t)f4 * g2 + (int64_t)f5_2 * g1 + (int64_t)f6 * g0 + (int64_t)f7_2 * g9_19
+		+ (int64_t)f8 * g8_19 + (int64_t)f9_2 * g7_19;
+	t[7] = (int64_t)f0 * g7 + (int64_t)f1 * g6 + (int64_t)f2 * g5 + (int64_t)f3 * g4
+		+ (int64_t)f4 * g3 + (int64_t)f5 * g2 + (int64_t)f6 * g1 + (int64_t)f7 * g0
+		+ (int64_t)f8 * g9_19 + (int64_t)f9 * g8_19;
+	t[8] = (int64_t)f0 * g8 + (int64_t)f1_2 * g7 + (int64_t)f2 * g6 + (int64_t)f3_2 * g5
+		+ (int64_t)f4 * g4 + (int64_t)f5_2 * g3 + (int64_t)f6 * g2 + (int64_t)f7_2 * g1
+		+ (int64_t)f8 * g0 + (int64_t)f9_2 * g9_19;
+	t[9] = (int64_t)f0 * g9 + (int64_t)f1 * g8 + (int64_t)f2 * g7 + (int64_t)f3 * g6
+		+ (int64_t)f4 * g5 + (int64_t)f5 * g4 + (int64_t)f6 * g3 + (int64_t)f7 * g2
+		+ (int64_t)f8 * g1 + (int64_t)f9 * g0;
+
+	fe_carry(h, t);
+}
+
+/*
+ * h = f^2 (or 2*f^2). Each cross product appears twice in a square, so it
+ * is computed once and doubled: 55 multiplies instead of 100.
+ */
+static void fe_sq_common(fe h, const fe f, int twice)
+{
+	int32_t f0 = f[0], f1 = f[1], f2 = f[2], f3 = f[3], f4 = f[4];
+	int32_t f5 = f[5], f6 = f[6], f7 = f[7], f8 = f[8], f9 = f[9];
+	int32_t f0_2 = 2 * f0;
+	int32_t f1_2 = 2 * f1;
+	int32_t f1_4 = 4 * f1;
+	int32_t f2_2 = 2 * f2;
+	int32_t f3_2 = 2 * f3;
+	int32_t f3_4 = 4 * f3;
+	int32_t f4_2 = 2 * f4;
+	int32_t f5_2 = 2 * f5;
+	int32_t f5_4 = 4 * f5;
+	int32_t f5_19 = 19 * f5;
+	int32_t f6_2 = 2 * f6;
+	int32_t f6_19 = 19 * f6;
+	int32_t f7_2 = 2 * f7;
+	int32_t f7_4 = 4 * f7;
+	int32_t f7_19 = 19 * f7;
+	int32_t f8_2 = 2 * f8;
+	int32_t f8_19 = 19 * f8;
+	int32_t f9_2 = 2 * f9;
+	int32_t f9_19 = 19 * f9;
+	int64_t t[10];
+	int i;
+
+	t[0] = (int64_t)f0 * f0 + (int64_t)f1_4 * f9_19 + (int64_t)f2_2 * f8_19
+		+ (int64_t)f3_4 * f7_19 + (int64_t)f4_2 * f6_19 + (int64_t)f5_2 * f5_19;
+	t[1] = (int64_t)f0_2 * f1 + (int64_t)f2_2 * f9_19 + (int64_t)f3_2 * f8_19
+		+ (int64_t)f4_2 * f7_19 + (int64_t)f5_2 * f6_19;
+	t[2] = (int64_t)f0_2 * f2 + (int64_t)f1_2 * f1 + (int64_t)f3_4 * f9_19
+		+ (int64_t)f4_2 * f8_19 + (int64_t)f5_4 * f7_19 + (int64_t)f6 * f6_19;
+	t[3] = (int64_t)f0_2 * f3 + (int64_t)f1_2 * f2 + (int64_t)f4_2 * f9_19
+		+ (int64_t)f5_2 * f8_19 + (int64_t)f6_2 * f7_19;
+	t[4] = (int64_t)f0_2 * f4 + (int64_t)f1_4 * f3 + (int64_t)f2 * f2
+		+ (int64_t)f5_4 * f9_19 + (int64_t)f6_2 * f8_19 + (int64_t)f7_2 * f7_19;
+	t[5] = (int64_t)f0_2 * f5 + (int64_t)f1_2 * f4 + (int64_t)f2_2 * f3
+		+ (int64_t)f6_2 * f9_19 + (int64_t)f7_2 * f8_19;
+	t[6] = (int64_t)f0_2 * f6 + (int64_t)f1_4 * f5 + (int64_t)f2_2 * f4 + (int64_t)f3_2 * f3
+		+ (int64_t)f7_4 * f9_19 + (int64_t)f8 * f8_19;
+	t[7] = (int64_t)f0_2 * f7 + (int64_t)f1_2 * f6 + (int64_t)f2_2 * f5 + (int64_t)f3_2 * f4
+		+ (int64_t)f8_2 * f9_19;
+	t[8] = (int64_t)f0_2 * f8 + (int64_t)f1_4 * f7 + (int64_t)f2_2 * f6 + (int64_t)f3_4 * f5
+		+ (int64_t)f4 * f4 + (int64_t)f9_2 * f9_19;
+	t[9] = (int64_t)f0_2 * f9 + (int64_t)f1_2 * f8 + (int64_t)f2_2 * f7 + (int64_t)f3_2 * f6
+		+ (int64_t)f4_2 * f5;
+
+	if (twice) {
+		for (i = 0; i < 10; i++) {
+			t[i] += t[i];
+		}
+	}
+	fe_carry(h, t);
+}
+
+static void fe_sq(fe h, const fe f)
+{
+	fe_sq_common(h, f, 0);
+}
+
+static void fe_sq2(fe h, const fe f)
+{
+	fe_sq_common(h, f, 1);
+}
+
+/* h = f * n for a small constant n */
+static void fe_mul_small(fe h, const fe f, int32_t n)
+{
+	int64_t t[10];
+	int i;
+
+	for (i = 0; i < 10; i++) {
+		t[i] = (int64_t)f[i] * n;
+	}
+	fe_carry(h, t);
+}
+
+/* h = f^(2^n), n >= 1 */
+static void fe_sqn(fe h, const fe f, int n)
+{
+	fe_sq(h, f);
+	while (--n > 0) {
+		fe_sq(h, h);
+	}
+}
+
+/* out = z^(2^250 - 1); also returns z^11 in z11 */
+static void fe_pow2_250_1(fe out, fe z11, const fe z)
+{
+	fe t0, t1, t2;
+
+	fe_sq(t0, z);                /* 2 */
+	fe_sqn(t1, t0, 2);           /* 8 */
+	fe_mul(t1, z, t1);           /* 9 */
+	fe_mul(z11, t0, t1);         /* 11 */
+	fe_sq(t0, z11);              /* 22 */
+	fe_mul(t0, t1, t0);          /* 2^5 - 1 */
+	fe_sqn(t1, t0, 5);
+	fe_mul(t0, t1, t0);          /* 2^10 - 1 */
+	fe_sqn(t1, t0, 10);
+	fe_mul(t1, t1, t0);          /* 2^20 - 1 */
+	fe_sqn(t2, t1, 20);
+	fe_mul(t1, t2, t1);          /* 2^40 - 1 */
+	fe_sqn(t1, t1, 10);
+	fe_mul(t0, t1, t0);          /* 2^50 - 1 */
+	fe_sqn(t1, t0, 50);
+	fe_mul(t1, t1, t0);          /* 2^100 - 1 */
+	fe_sqn(t2, t1, 100);
+	fe_mul(t1, t2, t1);          /* 2^200 - 1 */
+	fe_sqn(t1, t1, 50);
+	fe_mul(out, t1, t0);         /* 2^250 - 1 */
+}
+
+/* out = z^(p - 2) = 1/z */
+static void fe_invert(fe out, const fe z)
+{
+	fe t, z11;
+
+	fe_pow2_250_1(t, z11, z);
+	fe_sqn(t, t, 5);             /* 2^255 - 2^5 */
+	fe_mul(out, t, z11);         /* 2^255 - 21 */
+}
+
+/* out = z^((p - 5) / 8) = z^(2^252 - 3) */
+static void fe_pow22523(fe out, const fe z)
+{
+	fe t, z11;
+
+	fe_pow2_250_1(t, z11, z);
+	fe_sqn(t, t, 2);             /* 2^252 - 4 */
+	fe_mul(out, t, z);           /* 2^252 - 3 */
+}
+
+/* Load 255 bits, little endian; the top bit of s[31] is ignored. */
+static void fe_frombytes(fe h, const unsigned char *s)
+{
+	uint64_t acc = 0;
+	int i, bits = 0, n = 0;
+
+	for (i = 0; i < 10; i++) {
+		while (bits < FE_WIDTH(i)) {
+			acc |= (uint64_t)s[n++] << bits;
+			bits += 8;
+		}
+		h[i] = (int32_t)(acc & ((1u << FE_WIDTH(i)) - 1));
+		acc >>= FE_WIDTH(i);
+		bits -= FE_WIDTH(i);
+	}
+}
+
+/* Store the canonical (fully reduced) value of f. */
+static void fe_tobytes(unsigned char *s, const fe f)
+{
+	int64_t t[10];
+	int32_t h[10];
+	int32_t q, c;
+	uint64_t acc = 0;
+	int i, bits = 0, n = 0;
+
+	for (i = 0; i < 10; i++) {
+		t[i] = f[i];
+	}
+	fe_carry(h, t);
+
+	/* q = 1 if h >= p, else 0 */
+	q = (19 * h[9] + (1 << 24)) >> 25;
+	for (i = 0; i < 10; i++) {
+		q = (h[i] + q) >> FE_WIDTH(i);
+	}
+
+	/* h - q*p, computed as h + 19q with the 2^255 bit dropped below */
+	h[0] += 19 * q;
+	for (i = 0; i < 9; i++) {
+		c = h[i] >> FE_WIDTH(i);
+		h[i + 1] += c;
+		h[i] -= c * (1 << FE_WIDTH(i));
+	}
+	h[9] &= (1 << 25) - 1;
+
+	for (i = 0; i < 10; i++) {
+		acc |= (uint64_t)(uint32_t)h[i] << bits;
+		bits += FE_WIDTH(i);
+		while (bits >= 8) {
+			s[n++] = (unsigned char)acc;
+			acc >>= 8;
+			bits -= 8;
+		}
+	}
+	s[n] = (unsigned char)acc;
+}
+
+static int fe_isnegative(const fe f)
+{
+	unsigned char s[32];
+
+	fe_tobytes(s, f);
+	return s[0] & 1;
+}
+
+static int fe_isnonzero(const fe f)
+{
+	unsigned char s[32];
+	unsigned char r = 0;
+	int i;
+
+	fe_tobytes(s, f);
+	for (i = 0; i < 32; i++) {
+		r |= s[i];
+	}
+	return r != 0;
+}
+
+/* ------------------------------------------------------------------ */
+/*  X25519                                                            */
+/* ------------------------------------------------------------------ */
+
+/* RFC 7748 section 5, with the conditional swaps merged across steps. */
+static void x25519_ladder(fe x2, fe z2, const unsigned char *e, const fe x1)
+{
+	fe x3, z3, a, aa, b, bb, c, d, da, cb, ee;
+	uint32_t swap = 0, bit;
+	int pos;
+
+	fe_1(x2);
+	fe_0(z2);
+	fe_copy(x3, x1);
+	fe_1(z3);
+
+	for (pos = 254; pos >= 0; pos--) {
+		bit = (e[pos >> 3] >> (pos & 7)) & 1;
+		swap ^= bit;
+		fe_cswap(x2, x3, swap);
+		fe_cswap(z2, z3, swap);
+		swap = bit;
+
+		fe_add(a, x2, z2);
+		fe_sub(b, x2, z2);
+		fe_add(c, x3, z3);
+		fe_sub(d, x3, z3);
+		fe_sq(aa, a);
+		fe_sq(bb, b);
+		fe_mul(da, d, a);
+		fe_mul(cb, c, b);
+		fe_sub(ee, aa, bb);
+
+		fe_add(x3, da, cb);
+		fe_sq(x3, x3);
+		fe_sub(z3, da, cb);
+		fe_sq(z3, z3);
+		fe_mul(z3, z3, x1);
+
+		fe_mul(x2, aa, bb);
+		fe_mul_small(z2, ee, 121665);
+		fe_add(z2, z2, aa);
+		fe_mul(z2, z2, ee);
+	}
+	fe_cswap(x2, x3, swap);
+	fe_cswap(z2, z3, swap);
+
+	m_burn(x3, sizeof(x3));
+	m_burn(z3, sizeof(z3));
+	m_burn(a, sizeof(a));
+	m_burn(b, sizeof(b));
+	m_burn(aa, sizeof(aa));
+	m_burn(bb, sizeof(bb));
+}
+
+/* ------------------------------------------------------------------ */
+/*  Edwards25519 group                                                */
+/* ------------------------------------------------------------------ */
+
+/*
+ * Point representations as in ref10:
+ *   p2:      (X:Y:Z)          x = X/Z, y = Y/Z
+ *   p3:      (X:Y:Z:T)        extended, XY = ZT
+ *   p1p1:    ((X:Z),(Y:T))    result of an addition before projection
+ *   precomp: (y+x, y-x, 2dxy) affine, for mixed additions
+ *   cached:  (Y+X, Y-X, Z, 2dT)
+ */
+typedef struct { fe X, Y, Z; } ge_p2;
+typedef struct { fe X, Y, Z, T; } ge_p3;
+typedef struct { fe X, Y, Z, T; } ge_p1p1;
+typedef struct { fe yplusx, yminusx, xy2d; } ge_precomp;
+typedef struct { fe YplusX, YminusX, Z, T2d; } ge_cached;
+
+static void ge_p3_0(ge_p3 *h)
+{
+	fe_0(h->X);
+	fe_1(h->Y);
+	fe_1(h->Z);
+	fe_0(h->T);
+}
+
+static void ge_precomp_0(ge_precomp *h)
+{
+	fe_1(h->yplusx);
+	fe_1(h->yminusx);
+	fe_0(h->xy2d);
+}
+
+static void ge_p1p1_to_p2(ge_p2 *r, const ge_p1p1 *p)
+{
+	fe_mul(r->X, p->X, p->T);
+	fe_mul(r->Y, p->Y, p->Z);
+	fe_mul(r->Z, p->Z, p->T);
+}
+
+static void ge_p1p1_to_p3(ge_p3 *r, const ge_p1p1 *p)
+{
+	fe_mul(r->X, p->X, p->T);
+	fe_mul(r->Y, p->Y, p->Z);
+	fe_mul(r->Z, p->Z, p->T);
+	fe_mul(r->T, p->X, p->Y);
+}
+
+static void ge_p3_to_p2(ge_p2 *r, const ge_p3 *p)
+{
+	fe_copy(r->X, p->X);
+	fe_copy(r->Y, p->Y);
+	fe_copy(r->Z, p->Z);
+}
+
+static void ge_p3_to_cached(ge_cached *r, const ge_p3 *p)
+{
+	fe_add(r->YplusX, p->Y, p->X);
+	fe_sub(r->YminusX, p->Y, p->X);
+	fe_copy(r->Z, p->Z);
+	fe_mul(r->T2d, p->T, fe_d2);
+}
+
+#if !CONFIG_DROPBEAR_ED25519_BASE_TABLE_STRIDE
+static void ge_p3_to_precomp(ge_precomp *r, const ge_p3 *p)
+{
+	fe recip, x, y;
+
+	fe_invert(recip, p->Z);
+	fe_mul(x, p->X, recip);
+	fe_mul(y, p->Y, recip);
+	fe_add(r->yplusx, y, x);
+	fe_sub(r->yminusx, y, x);
+	fe_mul(r->xy2d, x, y);
+	fe_mul(r->xy2d, r->xy2d, fe_d2);
+}
+#endif
+
+/* r = 2p */
+static void ge_p2_dbl(ge_p1p1 *r, const ge_p2 *p)
+{
+	fe t0;
+
+	fe_sq(r->X, p->X);
+	fe_sq(r->Z, p->Y);
+	fe_sq2(r->T, p->Z);
+	fe_add(r->Y, p->X, p->Y);
+	fe_sq(t0, r->Y);
+	fe_add(r->Y, r->Z, r->X);
+	fe_sub(r->Z, r->Z, r->X);
+	fe_sub(r->X, t0, r->Y);
+	fe_sub(r->T, r->T, r->Z);
+}
+
+static void ge_p3_dbl(ge_p1p1 *r, const ge_p3 *p)
+{
+	ge_p2 q;
+
+	ge_p3_to_p2(&q, p);
+	ge_p2_dbl(r, &q);
+}
+
+/* r = p + q */
+static void ge_add(ge_p1p1 *r, const ge_p3 *p, const ge_cached *q)
+{
+	fe t0;
+
+	fe_add(r->X, p->Y, p->X);
+	fe_sub(r->Y, p->Y, p->X);
+	fe_mul(r->Z, r->X, q->YplusX);
+	fe_mul(r->Y, r->Y, q->YminusX);
+	fe_mul(r->T, q->T2d, p->T);
+	fe_mul(r->X, p->Z, q->Z);
+	fe_add(t0, r->X, r->X);
+	fe_sub(r->X, r->Z, r->Y);
+	fe_add(r->Y, r->Z, r->Y);
+	fe_add(r->Z, t0, r->T);
+	fe_sub(r->T, t0, r->T);
+}
+
+/* r = p - q */
+static void ge_sub(ge_p1p1 *r, const ge_p3 *p, const ge_cached *q)
+{
+	fe t0;
+
+	fe_add(r->X, p->Y, p->X);
+	fe_sub(r->Y, p->Y, p->X);
+	fe_mul(r->Z, r->X, q->YminusX);
+	fe_mul(r->Y, r->Y, q->YplusX);
+	fe_mul(r->T, q->T2d, p->T);
+	fe_mul(r->X, p->Z, q->Z);
+	fe_add(t0, r->X, r->X);
+	fe_sub(r->X, r->Z, r->Y);
+	fe_add(r->Y, r->Z, r->Y);
+	fe_sub(r->Z, t0, r->T);
+	fe_add(r->T, t0, r->T);
+}
+
+/* r = p + q, q affine */
+static void ge_madd(ge_p1p1 *r, const ge_p3 *p, const ge_precomp *q)
+{
+	fe t0;
+
+	fe_add(r->X, p->Y, p->X);
+	fe_sub(r->Y, p->Y, p->X);
+	fe_mul(r->Z, r->X, q->yplusx);
+	fe_mul(r->Y, r->Y, q->yminusx);
+	fe_mul(r->T, q->xy2d, p->T);
+	fe_add(t0, p->Z, p->Z);
+	fe_sub(r->X, r->Z, r->Y);
+	fe_add(r->Y, r->Z, r->Y);
+	fe_add(r->Z, t0, r->T);
+	fe_sub(r->T, t0, r->T);
+}
+
+/* r = p - q, q affine */
+static void ge_msub(ge_p1p1 *r, const ge_p3 *p, const ge_precomp *q)
+{
+	fe t0;
+
+	fe_add(r->X, p->Y, p->X);
+	fe_sub(r->Y, p->Y, p->X);
+	fe_mul(r->Z, r->X, q->yminusx);
+	fe_mul(r->Y, r->Y, q->yplusx);
+	fe_mul(r->T, q->xy2d, p->T);
+	fe_add(t0, p->Z, p->Z);
+	fe_sub(r->X, r->Z, r->Y);
+	fe_add(r->Y, r->Z, r->Y);
+	fe_sub(r->Z, t0, r->T);
+	fe_add(r->T, t0, r->T);
+}
+
+/* h = 16 * h */
+static void ge_p3_dbl4(ge_p3 *h)
+{
+	ge_p1p1 r;
+	ge_p2 s;
+
+	ge_p3_dbl(&r, h);
+	ge_p1p1_to_p2(&s, &r);
+	ge_p2_dbl(&r, &s);
+	ge_p1p1_to_p2(&s, &r);
+	ge_p2_dbl(&r, &s);
+	ge_p1p1_to_p2(&s, &r);
+	ge_p2_dbl(&r, &s);
+	ge_p1p1_to_p3(h, &r);
+}
+
+static void ge_tobytes(unsigned char *s, const fe X, const fe Y, const fe Z)
+{
+	fe recip, x, y;
+
+	fe_invert(recip, Z);
+	fe_mul(x, X, recip);
+	fe_mul(y, Y, recip);
+	fe_tobytes(s, y);
+	s[31] ^= fe_isnegative(x) << 7;
+}
+
+/*
+ * Decode a point and negate it (verification needs -A). Returns -1 if the
+ * encoding is not a point on the curve. Variable time: public input only.
+ */
+static int ge_frombytes_negate_vartime(ge_p3 *h, const unsigned char *s)
+{
+	fe u, v, v3, vxx, check;
+
+	fe_frombytes(h->Y, s);
+	fe_1(h->Z);
+	fe_sq(u, h->Y);
+	fe_mul(v, u, fe_d);
+	fe_sub(u, u, h->Z);          /* u = y^2 - 1 */
+	fe_add(v, v, h->Z);          /* v = d*y^2 + 1 */
+
+	fe_sq(v3, v);
+	fe_mul(v3, v3, v);           /* v^3 */
+	fe_sq(h->X, v3);
+	fe_mul(h->X, h->X, v);
+	fe_mul(h->X, h->X, u);       /* u*v^7 */
+	fe_pow22523(h->X, h->X);
+	fe_mul(h->X, h->X, v3);
+	fe_mul(h->X, h->X, u);       /* x = u*v^3 * (u*v^7)^((p-5)/8) */
+
+	fe_sq(vxx, h->X);
+	fe_mul(vxx, vxx, v);
+	fe_sub(check, vxx, u);
+	if (fe_isnonzero(check)) {
+		fe_add(check, vxx, u);
+		if (fe_isnonzero(check)) {
+			return -1;
+		}
+		fe_mul(h->X, h->X, fe_sqrtm1);
+	}
+
+	if (fe_isnegative(h->X) == (s[31] >> 7)) {
+		fe_neg(h->X, h->X);
+	}
+	fe_mul(h->T, h->X, h->Y);
+	return 0;
+}
+
+/* ------------------------------------------------------------------ */
+/*  Fixed-base scalar multiplication                                  */
+/* ------------------------------------------------------------------ */
+
+#if CONFIG_DROPBEAR_ED25519_BASE_TABLE_STRIDE
+/*
+ * Comb table generated at build time by port/gen_ed25519_table.py:
+ * ed25519_base_table[i][j] = (j + 1) * 16^(STRIDE * i) * B, in flash.
+ */
+#include "ed25519_base_table.h"
+#if ED25519_BASE_STRIDE != CONFIG_DROPBEAR_ED25519_BASE_TABLE_STRIDE
+#error "ed25519_base_table.h does not match CONFIG_DROPBEAR_ED25519_BASE_TABLE_STRIDE"
+#endif
+#define base_table ed25519_base_table
+
+static void base_table_init(void)
+{
+}
+#else
+/*
+ * No generated table: keep [1]B ... [8]B in RAM, filled on first use.
+ * That is a comb with a single row, i.e. a plain 4-bit window.
+ */
+#define ED25519_BASE_STRIDE 64
+static ge_precomp base_table[1][8];
+static int base_table_ready;
+
+static void base_table_init(void)
+{
+	ge_p3 b, p;
+	ge_cached bc;
+	ge_p1p1 r;
+	int i;
+
+	if (base_table_ready) {
+		return;
+	}
+
+	fe_copy(b.X, fe_base_x);
+	fe_copy(b.Y, fe_base_y);
+	fe_1(b.Z);
+	fe_mul(b.T, b.X, b.Y);
+	ge_p3_to_cached(&bc, &b);
+
+	p = b;
+	for (i = 0; i < 8; i++) {
+		ge_p3_to_precomp(&base_table[0][i], &p);
+		ge_add(&r, &p, &bc);
+		ge_p1p1_to_p3(&p, &r);
+	}
+	base_table_ready = 1;
+}
+#endif
+
+#define BASE_TABLE_ROWS (64 / ED25519_BASE_STRIDE)
+
+static uint32_t ct_equal(int8_t b, int8_t c)
+{
+	uint32_t x = (uint8_t)(b ^ c);
+
+	return (x - 1) >> 31;
+}
+
+static uint32_t ct_negative(int8_t b)
+{
+	return (uint32_t)(uint8_t)b >> 7;
+}
+
+/* t = b * row[0] for b in -8..8, without secret-dependent memory access */
+static void select_base(ge_precomp *t, const ge_precomp row[8], int8_t b)
+{
+	ge_precomp minust;
+	uint32_t bneg = ct_negative(b);
+	int8_t babs = (int8_t)(b - (int8_t)((-(int8_t)bneg & b) * 2));
+	int i;
+
+	ge_precomp_0(t);
+	for (i = 0; i < 8; i++) {
+		uint32_t eq = ct_equal(babs, (int8_t)(i + 1));
+
+		fe_cmov(t->yplusx, row[i].yplusx, eq);
+		fe_cmov(t->yminusx, row[i].yminusx, eq);
+		fe_cmov(t->xy2d, row[i].xy2d, eq);
+	}
+	fe_copy(minust.yplusx, t->yminusx);
+	fe_copy(minust.yminusx, t->yplusx);
+	fe_neg(minust.xy2d, t->xy2d);
+	fe_cmov(t->yplusx, minust.yplusx, bneg);
+	fe_cmov(t->yminusx, minust.yminusx, bneg);
+	fe_cmov(t->xy2d, minust.xy2d, bneg);
+}
+
+/* Signed radix-16 digits e[0..63] in -8..8 of a, where a[31] <= 127. */
+static void scalar_to_radix16(int8_t e[64], const unsigned char *a)
+{
+	int8_t carry = 0;
+	int i;
+
+	for (i = 0; i < 32; i++) {
+		e[2 * i] = a[i] & 15;
+		e[2 * i + 1] = (a[i] >> 4) & 15;
+	}
+	for (i = 0; i < 63; i++) {
+		e[i] += carry;
+		carry = (int8_t)((e[i] + 8) >> 4);
+		e[i] -= (int8_t)(carry * 16);
+	}
+	e[63] += carry;
+}
+
+/*
+ * h = [a]B, a[31] <= 127. Constant time.
+ *
+ * With digits e[] and stride s, a = sum_k 16^k * sum_i e[s*i + k] * 16^(s*i),
+ * so each of the s passes adds one digit per table row and the passes are
+ * joined by four doublings: 64 additions and 4*(s-1) doublings in total.
+ */
+static void ge_scalarmult_base(ge_p3 *h, const unsigned char *a)
+{
+	int8_t e[64];
+	ge_precomp t;
+	ge_p1p1 r;
+	int k, row;
+
+	base_table_init();
+	scalar_to_radix16(e, a);
+
+	ge_p3_0(h);
+	for (k = ED25519_BASE_STRIDE - 1; k >= 0; k--) {
+		if (k != ED25519_BASE_STRIDE - 1) {
+			ge_p3_dbl4(h);
+		}
+		for (row = 0; row < BASE_TABLE_ROWS; row++) {
+			select_base(&t, base_table[row], e[ED25519_BASE_STRIDE * row + k]);
+			ge_madd(&r, h, &t);
+			ge_p1p1_to_p3(h, &r);
+		}
+	}
+
+	m_burn(e, sizeof(e));
+	m_burn(&t, sizeof(t));
+}
+
+/*
+ * r = [a]A + [b]B for signature verification. Variable time: a, b and A
+ * are all public.
+ */
+static void ge_double_scalarmult_vartime(ge_p3 *h, const unsigned char *a,
+	const ge_p3 *A, const unsigned char *b)
+{
+	int8_t ea[64], eb[64];
+	ge_cached ai[8];
+	ge_cached a1;
+	ge_p1p1 r;
+	ge_p3 t;
+	int i;
+
+	base_table_init();
+	scalar_to_radix16(ea, a);
+	scalar_to_radix16(eb, b);
+
+	/* ai[i] = [i+1]A */
+	ge_p3_to_cached(&a1, A);
+	ai[0] = a1;
+	t = *A;
+	for (i = 1; i < 8; i++) {
+		ge_add(&r, &t, &a1);
+		ge_p1p1_to_p3(&t, &r);
+		ge_p3_to_cached(&ai[i], &t);
+	}
+
+	ge_p3_0(h);
+	for (i = 63; i >= 0; i--) {
+		if (i != 63) {
+			ge_p3_dbl4(h);
+		}
+		if (ea[i] > 0) {
+			ge_add(&r, h, &ai[ea[i] - 1]);
+			ge_p1p1_to_p3(h, &r);
+		} else if (ea[i] < 0) {
+			ge_sub(&r, h, &ai[-ea[i] - 1]);
+			ge_p1p1_to_p3(h, &r);
+		}
+		if (eb[i] > 0) {
+			ge_madd(&r, h, &base_table[0][eb[i] - 1]);
+			ge_p1p1_to_p3(h, &r);
+		} else if (eb[i] < 0) {
+			ge_msub(&r, h, &base_table[0][-eb[i] - 1]);
+			ge_p1p1_to_p3(h, &r);
+		}
+	}
+}
+
+/* ------------------------------------------------------------------ */
+/*  Scalars mod L = 2^252 + 27742317777372353535851937790883648493    */
+/* ------------------------------------------------------------------ */
+
+static const int64_t sc_L[32] = {
+	0xed, 0xd3, 0xf5, 0x5c, 0x1a, 0x63, 0x12, 0x58,
+	0xd6, 0x9c, 0xf7, 0xa2, 0xde, 0xf9, 0xde, 0x14,
+	0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0x10
+};
+
+/* r = x mod L, x given as 64 signed byte-sized limbs (TweetNaCl modL) */
+static void sc_modl(unsigned char *r, int64_t x[64])
+{
+	int64_t carry;
+	int i, j;
+
+	for (i = 63; i >= 32; i--) {
+		carry = 0;
+		for (j = i - 32; j < i - 12; j++) {
+			x[j] += carry - 16 * x[i] * sc_L[j - (i - 32)];
+			carry = (x[j] + 128) >> 8;
+			x[j] -= carry * 256;
+		}
+		x[j] += carry;
+		x[i] = 0;
+	}
+	carry = 0;
+	for (j = 0; j < 32; j++) {
+		x[j] += carry - (x[31] >> 4) * sc_L[j];
+		carry = x[j] >> 8;
+		x[j] &= 255;
+	}
+	for (j = 0; j < 32; j++) {
+		x[j] -= carry * sc_L[j];
+	}
+	for (i = 0; i < 32; i++) {
+		x[i + 1] += x[i] >> 8;
+		r[i] = (unsigned char)(x[i] & 255);
+	}
+}
+
+/* s[0..31] = s[0..63] mod L */
+static void sc_reduce(unsigned char *s)
+{
+	int64_t x[64];
+	int i;
+
+	for (i = 0; i < 64; i++) {
+		x[i] = s[i];
+	}
+	sc_modl(s, x);
+	m_burn(x, sizeof(x));
+}
+
+/* s = (a*b + c) mod L */
+static void sc_muladd(unsigned char *s, const unsigned char *a,
+	const unsigned char *b, const unsigned char *c)
+{
+	int64_t x[64];
+	int i, j;
+
+	memset(x, 0, sizeof(x));
+	for (i = 0; i < 32; i++) {
+		x[i] = c[i];
+	}
+	for (i = 0; i < 32; i++) {
+		for (j = 0; j < 32; j++) {
+			x[i + j] += (int64_t)a[i] * b[j];
+		}
+	}
+	sc_modl(s, x);
+	m_burn(x, sizeof(x));
+}
+
+/* s < L, public input only */
+static int sc_is_canonical(const unsigned char *s)
+{
+	int i;
+
+	for (i = 31; i >= 0; i--) {
+		if (s[i] < sc_L[i]) {
+			return 1;
+		}
+		if (s[i] > sc_L[i]) {
+			return 0;
+		}
+	}
+	return 0;
+}
+
+/* ------------------------------------------------------------------ */
+/*  curve25519.h interface                                            */
+/* ------------------------------------------------------------------ */
+
+static const unsigned char x25519_basepoint[32] = {9};
+
+void dropbear_curve25519_scalarmult(unsigned char *q, const unsigned char *n,
+	const unsigned char *p)
+{
+	unsigned char e[32];
+	fe x1, x2, z2;
+	ge_p3 A;
+
+	memcpy(e, n, 32);
+	e[0] &= 248;
+	e[31] &= 127;
+	e[31] |= 64;
+
+	if (memcmp(p, x25519_basepoint, 32) == 0) {
+		/*
+		 * Public key generation: [e]B on the Edwards curve is much cheaper
+		 * than the ladder, then map to Montgomery u = (Z + Y) / (Z - Y).
+		 */
+		ge_scalarmult_base(&A, e);
+		fe_add(x2, A.Z, A.Y);
+		fe_sub(z2, A.Z, A.Y);
+	} else {
+		fe_frombytes(x1, p);
+		x25519_ladder(x2, z2, e, x1);
+	}
+
+	fe_invert(z2, z2);
+	fe_mul(x2, x2, z2);
+	fe_tobytes(q, x2);
+
+	m_burn(e, sizeof(e));
+	m_burn(x2, sizeof(x2));
+	m_burn(z2, sizeof(z2));
+	m_burn(&A, sizeof(A));
+}
+
+/* az = SHA-512(sk) with the scalar half clamped */
+static void ed25519_expand_key(unsigned char az[64], const unsigned char *sk)
+{
+	hash_state hs;
+
+	sha512_init(&hs);
+	sha512_process(&hs, sk, 32);
+	sha512_done(&hs, az);
+	az[0] &= 248;
+	az[31] &= 127;
+	az[31] |= 64;
+}
+
+void dropbear_ed25519_make_key(unsigned char *pk, unsigned char *sk)
+{
+	unsigned char az[64];
+	ge_p3 A;
+
+	genrandom(sk, 32);
+	ed25519_expand_key(az, sk);
+	ge_scalarmult_base(&A, az);
+	ge_tobytes(pk, A.X, A.Y, A.Z);
+
+	m_burn(az, sizeof(az));
+	m_burn(&A, sizeof(A));
+}
+
+void dropbear_ed25519_sign(const unsigned char *m, unsigned long mlen,
+	unsigned char *s, unsigned long *slen,
+	const unsigned char *sk, const unsigned char *pk)
+{
+	hash_state hs;
+	unsigned char az[64], nonce[64], hram[64];
+	ge_p3 R;
+
+	ed25519_expand_key(az, sk);
+
+	/* r = H(prefix || M) */
+	sha512_init(&hs);
+	sha512_process(&hs, az + 32, 32);
+	sha512_process(&hs, m, mlen);
+	sha512_done(&hs, nonce);
+	sc_reduce(nonce);
+
+	ge_scalarmult_base(&R, nonce);
+	ge_tobytes(s, R.X, R.Y, R.Z);
+
+	/* S = r + H(R || A || M) * a */
+	sha512_init(&hs);
+	sha512_process(&hs, s, 32);
+	sha512_process(&hs, pk, 32);
+	sha512_process(&hs, m, mlen);
+	sha512_done(&hs, hram);
+	sc_reduce(hram);
+	sc_muladd(s + 32, hram, az, nonce);
+	*slen = 64;
+
+	m_burn(az, sizeof(az));
+	m_burn(nonce, sizeof(nonce));
+	m_burn(&R, sizeof(R));
+}
+
+int dropbear_ed25519_verify(const unsigned char *m, unsigned long mlen,
+	const unsigned char *s, unsigned long slen,
+	const unsigned char *pk)
+{
+	hash_state hs;
+	unsigned char hram[64], rcheck[32];
+	ge_p3 A, R;
+
+	if (slen != 64) {
+		return -1;
+	}
+	if (!sc_is_canonical(s + 32)) {
+		return -1;
+	}
+	if (ge_frombytes_negate_vartime(&A, pk) != 0) {
+		return -1;
+	}
+
+	sha512_init(&hs);
+	sha512_process(&hs, s, 32);
+	sha512_process(&hs, pk, 32);
+	sha512_process(&hs, m, mlen);
+	sha512_done(&hs, hram);
+	sc_reduce(hram);
+
+	/* R' = [S]B - [h]A must encode to R */
+	ge_double_scalarmult_vartime(&R, hram, &A, s + 32);
+	ge_tobytes(rcheck, R.X, R.Y, R.Z);
+
+	return constant_time_memcmp(rcheck, s, 32) == 0 ? 0 : -1;
+}
+
+#endif /* DROPBEAR_CURVE25519_DEP */
@@ -0,0 +1,501 @@
+/*
+ * dbmalloc_arena.c - Replacement for Dropbear's dbmalloc.c that serves
+ * session allocations from a per-session arena.
+ *
+ * The arena is a single heap block reserved once per session task. Inside
+ * it, a first-fit allocator with boundary tags and an explicit free list
+ * handles the churn of a live session (packet buffers, kex state, channel
+ * structs). When the session ends the whole arena is reset in one step.
+ *
+ * Dropbear frees memory with plain free() (m_free_direct is a macro for it),
+ * so the component and its users are compiled with free and realloc defined
+ * to session_arena_free() and session_arena_realloc() (see CMakeLists.txt).
+ * Those send arena pointers back to their arena and pass anything else to
+ * the C library. Code outside Dropbear keeps calling free() directly.
+ *
+ * With CONFIG_DROPBEAR_PACKET_POOL each arena also has a few fixed packet
+ * buffer slots in three size classes, placed after the general region.
+ * session_arena_pool_alloc() hands out a free slot of the smallest class
+ * that fits and free() puts it back on its class list, so a packet costs
+ * neither a heap call nor a free-list walk. The slots never mix with the
+ * general region and cannot fragment it. Packets that are too large, or that
+ * arrive while every slot of their class is busy, use m_malloc() as before.
+ */
+
+#include "includes.h"
+#include "dbutil.h"
+#include "sdkconfig.h"
+#include "dbmalloc_arena.h"
+
+/* The C library's own free() and realloc(), not the renamed ones. */
+#undef free
+#undef realloc
+void free(void *ptr);
+void *realloc(void *ptr, size_t size);
+
+#if DROPBEAR_TRACKING_MALLOC
+#error "CONFIG_DROPBEAR_SESSION_ARENA cannot be combined with DROPBEAR_TRACKING_MALLOC"
+#endif
+
+#define ARENA_ALIGN       8
+#define ALIGN_UP(x)       (((x) + (ARENA_ALIGN - 1)) & ~(size_t)(ARENA_ALIGN - 1))
+#define MAX_ARENAS        16
+
+struct block {
+	uint32_t prev_size;   /* size of the block just below, 0 for the first */
+	uint32_t size;        /* size including this header; bit 0 = in use    */
+};
+
+struct free_block {
+	struct block hdr;
+	struct free_block *next;
+	struct free_block *prev;
+};
+
+#define BLOCK_USED        1u
+#define HDR_SIZE          ALIGN_UP(sizeof(struct block))
+#define MIN_BLOCK         ALIGN_UP(sizeof(struct free_block))
+
+/*
+ * Packet buffer slots per arena: 4 x 256 + 2 x 1 KB + 1 x 4 KB = 7 KB.
+ * Bulk packets (up to TRANS_MAX_PAYLOAD_LEN) are not pooled; a 16 KB slot
+ * would cost more arena than one allocation per bulk packet costs time.
+ */
+static const struct {
+	uint32_t size;
+	unsigned int slots;
+} pool_classes[] = {
+	{ 256,  4 },
+	{ 1024, 2 },
+	{ 4096, 1 },
+};
+
+#define POOL_CLASSES      (sizeof(pool_classes) / sizeof(pool_classes[0]))
+
+#if CONFIG_DROPBEAR_PACKET_POOL
+#define POOL_ENABLED      1
+#else
+#define POOL_ENABLED      0
+#endif
+
+struct pool_link {
+	struct pool_link *next;
+};
+
+struct session_arena {
+	unsigned char *base;
+	unsigned char *end;                 /* end of the general region        */
+	unsigned char *pool_end;            /* end of the packet slots after it */
+	struct free_block *free_list;
+	struct pool_link *pool[POOL_CLASSES];
+	unsigned char *pool_class_end[POOL_CLASSES];
+	session_arena_stats_t stats;
+};
+
+static session_arena_t *arenas[MAX_ARENAS];
+static unsigned int arena_count;
+
+static __thread session_arena_t *cur_arena;
+
+/* ------------------------------------------------------------------ */
+/*  Arena internals                                                   */
+/* ------------------------------------------------------------------ */
+
+static inline size_t blk_size(const struct block *b)
+{
+	return b->size & ~BLOCK_USED;
+}
+
+static inline struct block *blk_next(struct block *b)
+{
+	return (struct block *)((unsigned char *)b + blk_size(b));
+}
+
+static inline struct block *blk_of(void *ptr)
+{
+	return (struct block *)((unsigned char *)ptr - HDR_SIZE);
+}
+
+static void list_insert(session_arena_t *arena, struct free_block *fb)
+{
+	fb->prev = NULL;
+	fb->next = arena->free_list;
+	if (fb->next) {
+		fb->next->prev = fb;
+	}
+	arena->free_list = fb;
+}
+
+static void list_remove(session_arena_t *arena, struct free_block *fb)
+{
+	if (fb->prev) {
+		fb->prev->next = fb->next;
+	} else {
+		arena->free_list = fb->next;
+	}
+	if (fb->next) {
+		fb->next->prev = fb->prev;
+	}
+}
+
+/* Tell the block above `b` how large `b` is now. */
+static void set_next_prev_size(session_arena_t *arena, struct block *b)
+{
+	struct block *next = blk_next(b);
+
+	if ((unsigned char *)next < arena->end) {
+		next->prev_size = blk_size(b);
+	}
+}
+
+static void *arena_alloc(session_arena_t *arena, size_t n)
+{
+	struct free_block *fb;
+	size_t need;
+
+	if (n > arena->stats.size) {
+		return NULL;
+	}
+	need = ALIGN_UP(n + HDR_SIZE);
+	if (need < MIN_BLOCK) {
+		need = MIN_BLOCK;
+	}
+
+	for (fb = arena->free_list; fb != NULL; fb = fb->next) {
+		size_t have = fb->hdr.size;
+
+		if (have < need) {
+			continue;
+		}
+
+		list_remove(arena, fb);
+		if (have - need >= MIN_BLOCK) {
+			struct free_block *rest = (struct free_block *)((unsigned char *)fb + need);
+
+			rest->hdr.prev_size = need;
+			rest->hdr.size = have - need;
+			set_next_prev_size(arena, &rest->hdr);
+			list_insert(arena, rest);
+			have = need;
+		}
+		fb->hdr.size = have | BLOCK_USED;
+
+		arena->stats.used += have;
+		if (arena->stats.used > arena->stats.high_water) {
+			arena->stats.high_water = arena->stats.used;
+		}
+		return (unsigned char *)fb + HDR_SIZE;
+	}
+
+	return NULL;
+}
+
+static void arena_free(session_arena_t *arena, void *ptr)
+{
+	struct block *b = blk_of(ptr);
+	struct block *next;
+	size_t size = blk_size(b);
+
+	arena->stats.used -= size;
+	b->size = size;
+
+	/* merge with the block above */
+	next = blk_next(b);
+	if ((unsigned char *)next < arena->end && !(next->size & BLOCK_USED)) {
+		list_remove(arena, (struct free_block *)next);
+		b->size += next->size;
+	}
+
+	/* and with the block below */
+	if (b->prev_size != 0) {
+		struct block *prev = (struct block *)((unsigned char *)b - b->prev_size);
+
+		if (!(prev->size & BLOCK_USED)) {
+			list_remove(arena, (struct free_block *)prev);
+			prev->size += b->size;
+			b = prev;
+		}
+	}
+
+	set_next_prev_size(arena, b);
+	list_insert(arena, (struct free_block *)b);
+}
+
+static session_arena_t *arena_of(const void *ptr)
+{
+	unsigned int i;
+
+	for (i = 0; i < arena_count; i++) {
+		const session_arena_t *arena = arenas[i];
+
+		if ((const unsigned char *)ptr >= arena->base
+				&& (const unsigned char *)ptr < arena->pool_end) {
+			return arenas[i];
+		}
+	}
+	return NULL;
+}
+
+static size_t pool_bytes(void)
+{
+	size_t n = 0;
+	unsigned int c;
+
+	for (c = 0; POOL_ENABLED && c < POOL_CLASSES; c++) {
+		n += (size_t)pool_classes[c].size * pool_classes[c].slots;
+	}
+	return n;
+}
+
+/* Class of a packet slot, or POOL_CLASSES if `ptr` is in the general region. */
+static unsigned int pool_class_of_ptr(const session_arena_t *arena, const void *ptr)
+{
+	unsigned int c;
+
+	if ((const unsigned char *)ptr < arena->end) {
+		return POOL_CLASSES;
+	}
+	c = 0;
+	while ((const unsigned char *)ptr >= arena->pool_class_end[c]) {
+		c++;
+	}
+	return c;
+}
+
+/* free() of an arena pointer: packet slots go back to their class list. */
+static void arena_release(session_arena_t *arena, void *ptr)
+{
+	unsigned int c = pool_class_of_ptr(arena, ptr);
+
+	if (c < POOL_CLASSES) {
+		struct pool_link *l = ptr;
+
+		l->next = arena->pool[c];
+		arena->pool[c] = l;
+	} else {
+		arena_free(arena, ptr);
+	}
+}
+
+/* Allocate from the attached arena, falling back to the heap. Not zeroed. */
+static void *alloc_raw(size_t size)
+{
+	session_arena_t *arena = cur_arena;
+	void *ret;
+
+	if (arena != NULL) {
+		ret = arena_alloc(arena, size);
+		if (ret != NULL) {
+			return ret;
+		}
+		arena->stats.overflows++;
+	}
+	return malloc(size);
+}
+
+static void *realloc_impl(void *ptr, size_t size)
+{
+	session_arena_t *owner = ptr ? arena_of(ptr) : NULL;
+	unsigned int c;
+	size_t cap;
+	void *ret;
+
+	if (owner == NULL) {
+		return realloc(ptr, size);
+	}
+
+	if (size == 0) {
+		arena_release(owner, ptr);
+		return NULL;
+	}
+
+	c = pool_class_of_ptr(owner, ptr);
+	if (c < POOL_CLASSES) {
+		cap = pool_classes[c].size;
+	} else {
+		cap = blk_size(blk_of(ptr)) - HDR_SIZE;
+	}
+	if (size <= cap) {
+		return ptr;
+	}
+
+	ret = NULL;
+	if (c < POOL_CLASSES) {
+		/* a growing packet buffer (buf_resize()) stays a packet buffer */
+		ret = session_arena_pool_alloc(size);
+	}
+	if (ret == NULL) {
+		ret = alloc_raw(size);
+	}
+	if (ret != NULL) {
+		memcpy(ret, ptr, cap);
+		arena_release(owner, ptr);
+	}
+	return ret;
+}
+
+/* ------------------------------------------------------------------ */
+/*  Arena API                                                         */
+/* ------------------------------------------------------------------ */
+
+session_arena_t *session_arena_create(size_t size)
+{
+	session_arena_t *arena;
+
+	size = ALIGN_UP(size);
+	if (arena_count >= MAX_ARENAS || size < MIN_BLOCK) {
+		return NULL;
+	}
+
+	arena = malloc(ALIGN_UP(sizeof(*arena)) + size + pool_bytes());
+	if (arena == NULL) {
+		return NULL;
+	}
+	memset(arena, 0, sizeof(*arena));
+	arena->base = (unsigned char *)arena + ALIGN_UP(sizeof(*arena));
+	arena->end = arena->base + size;
+	arena->pool_end = arena->end + pool_bytes();
+	arena->stats.size = size;
+	session_arena_reset(arena);
+
+	arenas[arena_count++] = arena;
+	return arena;
+}
+
+void session_arena_attach(session_arena_t *arena)
+{
+	cur_arena = arena;
+}
+
+session_arena_t *session_arena_current(void)
+{
+	return cur_arena;
+}
+
+void session_arena_reset(session_arena_t *arena)
+{
+	struct free_block *fb = (struct free_block *)arena->base;
+	unsigned char *slot;
+	unsigned int c, i;
+
+	fb->hdr.prev_size = 0;
+	fb->hdr.size = arena->stats.size;
+	fb->next = NULL;
+	fb->prev = NULL;
+	arena->free_list = fb;
+	arena->stats.used = 0;
+
+	/* every packet slot is free again */
+	slot = arena->end;
+	for (c = 0; c < POOL_CLASSES; c++) {
+		arena->pool[c] = NULL;
+		for (i = 0; POOL_ENABLED && i < pool_classes[c].slots; i++) {
+			struct pool_link *l = (struct pool_link *)slot;
+
+			l->next = arena->pool[c];
+			arena->pool[c] = l;
+			slot += pool_classes[c].size;
+		}
+		arena->pool_class_end[c] = slot;
+	}
+}
+
+void *session_arena_pool_alloc(size_t size)
+{
+	session_arena_t *arena = cur_arena;
+	unsigned int c;
+
+	if (!POOL_ENABLED || arena == NULL) {
+		return NULL;
+	}
+	for (c = 0; c < POOL_CLASSES; c++) {
+		if (size <= pool_classes[c].size && arena->pool[c] != NULL) {
+			struct pool_link *l = arena->pool[c];
+
+			arena->pool[c] = l->next;
+			arena->stats.pool_hits++;
+			return l;
+		}
+	}
+	arena->stats.pool_misses++;
+	return NULL;
+}
+
+void session_arena_get_stats(const session_arena_t *arena, session_arena_stats_t *stats)
+{
+	*stats = arena->stats;
+}
+
+/* ------------------------------------------------------------------ */
+/*  dbmalloc.c interface                                              */
+/* ------------------------------------------------------------------ */
+
+void * m_malloc(size_t size)
+{
+	void *ret;
+
+	if (size == 0) {
+		dropbear_exit("m_malloc failed");
+	}
+	ret = alloc_raw(size);
+	if (ret == NULL) {
+		dropbear_exit("m_malloc failed");
+	}
+	memset(ret, 0, size);
+	return ret;
+}
+
+void * m_calloc(size_t nmemb, size_t size)
+{
+	if (SIZE_MAX / nmemb < size) {
+		dropbear_exit("m_calloc failed");
+	}
+	return m_malloc(nmemb * size);
+}
+
+void * m_strdup(const char * str)
+{
+	size_t len = strlen(str);
+	char *ret = m_malloc(len + 1);
+
+	memcpy(ret, str, len + 1);
+	return ret;
+}
+
+void * m_realloc(void* ptr, size_t size)
+{
+	void *ret;
+
+	if (size == 0) {
+		dropbear_exit("m_realloc failed");
+	}
+	ret = realloc_impl(ptr, size);
+	if (ret == NULL) {
+		dropbear_exit("m_realloc failed");
+	}
+	return ret;
+}
+
+/* ------------------------------------------------------------------ */
+/*  free() / realloc() as seen by Dropbear                            */
+/* ------------------------------------------------------------------ */
+
+void session_arena_free(void *ptr)
+{
+	session_arena_t *owner;
+
+	if (ptr == NULL) {
+		return;
+	}
+	owner = arena_of(ptr);
+	if (owner != NULL) {
+		arena_release(owner, ptr);
+	} else {
+		free(ptr);
+	}
+}
+
+void *session_arena_realloc(void *ptr, size_t size)
+{
+	return realloc_impl(ptr, size);
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+/*
+ * dbmalloc_arena - session-scoped arenas behind m_malloc()/m_realloc()/m_free().
+ *
+ * With CONFIG_DROPBEAR_SESSION_ARENA, port/dbmalloc_arena.c replaces
+ * Dropbear's dbmalloc.c. Every allocation made by a task that has an arena
+ * attached is carved out of that arena; session teardown then returns the
+ * whole region at once with session_arena_reset(), so session churn can no
+ * longer fragment the system heap. Allocations that do not fit fall back to
+ * the heap and are counted as overflows.
+ *
+ * With CONFIG_DROPBEAR_PACKET_POOL the arena also holds a few fixed packet
+ * buffer slots, handed out by session_arena_pool_alloc() (see
+ * port/packet_pool.c) and recycled by free().
+ *
+ * Dropbear's m_free() is plain free(), so the component and the code that
+ * uses it are built with free and realloc defined to the two functions at
+ * the end of this file. The rest of the firmware is not affected.
+ */
+
+#include <stddef.h>
+
+typedef struct session_arena session_arena_t;
+
+typedef struct {
+	size_t size;             /* usable arena capacity in bytes          */
+	size_t used;             /* bytes currently allocated in the arena  */
+	size_t high_water;       /* peak of `used` since the arena was made */
+	unsigned int overflows;  /* allocations served by the heap instead  */
+	unsigned int pool_hits;  /* packet buffers served from a slot       */
+	unsigned int pool_misses;/* packet buffers that did not get a slot  */
+} session_arena_stats_t;
+
+/* Reserve an arena of `size` bytes from the heap. Returns NULL on failure. */
+session_arena_t *session_arena_create(size_t size);
+
+/* Route the calling task's m_malloc() calls to `arena` (NULL detaches). */
+void session_arena_attach(session_arena_t *arena);
+
+/* Arena attached to the calling task, or NULL. */
+session_arena_t *session_arena_current(void);
+
+/* Drop every allocation in the arena. Counters other than `used` are kept. */
+void session_arena_reset(session_arena_t *arena);
+
+/*
+ * Take a free packet buffer slot of at least `size` bytes from the calling
+ * task's arena. free() returns it. The memory is not zeroed. Returns NULL if
+ * there is no arena or pool, `size` is above the largest slot, or every
+ * fitting slot is busy; use m_malloc() then.
+ */
+void *session_arena_pool_alloc(size_t size);
+
+void session_arena_get_stats(const session_arena_t *arena, session_arena_stats_t *stats);
+
+/*
+ * free() and realloc() for Dropbear code: arena pointers go back to their
+ * arena (or packet slot), anything else to the C library.
+ */
+void session_arena_free(void *ptr);
+void *session_arena_realloc(void *ptr, size_t size);
@@ -6,6 +6,8 @@ Local customisation goes in localoptions.h
 
 #ifndef DROPBEAR_DEFAULT_OPTIONS_H_
 #define DROPBEAR_DEFAULT_OPTIONS_H_
+
+#include "sdkconfig.h"
 /*
                      > > > Read This < < <
 
@@ -182,9 +184,15 @@ IMPORTANT: Some options will require "make clean" after changes */
  * for security and forwards compatibility, but slower than CTR on
  * CPU w/o dedicated AES/GHASH instructions.
  * Compiling in will add ~6kB to binary size on x86-64 */
+/* Only offered with the table-driven GHASH (port/ghash_table.c): with
+ * libtomcrypt's bit-serial multiplication GCM is about 20x slower than CTR. */
 #ifndef DROPBEAR_ENABLE_GCM_MODE
+#ifdef CONFIG_DROPBEAR_GCM_GHASH_TABLE
+#define DROPBEAR_ENABLE_GCM_MODE CONFIG_DROPBEAR_GCM_GHASH_TABLE
+#else
 #define DROPBEAR_ENABLE_GCM_MODE 0
 #endif
+#endif
 
 /* Message integrity. sha2-256 is recommended as a default,
    sha1 for compatibility */
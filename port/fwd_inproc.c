@@ -0,0 +1,184 @@
+/*
+ * fwd_inproc.c - In-process endpoints for direct-tcpip channels.
+ *
+ * newtcpdirect() in svr-tcpfwd.c checks the request and calls
+ * connect_remote() with channel_connect_done() as the callback. The wrapper
+ * below looks the target up; for a registered one it attaches the channel
+ * to chan_inproc, swaps in a ChanType with cleanup and extra-io hooks, and
+ * completes the "connect" on the spot, so the open confirmation goes out
+ * before newtcpdirect() returns SSH_OPEN_IN_PROGRESS. The channel's fds
+ * stay FD_UNINIT and no dropbear_progress_connection is created.
+ */
+
+#include "includes.h"
+#include "session.h"
+#include "channel.h"
+#include "netio.h"
+#include "dbutil.h"
+#include "chan_inproc.h"
+#include "fwd_inproc.h"
+
+#include <limits.h>
+#include <stdlib.h>
+#include <strings.h>
+
+struct fwd_target {
+	const char *host;
+	unsigned int port;
+	const struct fwd_inproc_endpoint *ep;
+};
+
+/* typedata of an in-process direct-tcpip channel */
+struct fwd_conn {
+	const struct fwd_inproc_endpoint *ep;
+	void *ctx;
+};
+
+static struct fwd_target targets[FWD_INPROC_MAX];
+static unsigned int ntargets;
+static unsigned long stat_count;
+
+struct dropbear_progress_connection *__real_connect_remote(const char *remotehost,
+	const char *remoteport, connect_callback cb, void *cb_data,
+	const char *bind_address, const char *bind_port, enum dropbear_prio prio);
+
+int fwd_inproc_register(const char *host, unsigned int port,
+	const struct fwd_inproc_endpoint *ep)
+{
+	if (ntargets == FWD_INPROC_MAX) {
+		return DROPBEAR_FAILURE;
+	}
+	targets[ntargets].host = host;
+	targets[ntargets].port = port;
+	targets[ntargets].ep = ep;
+	ntargets++;
+	return DROPBEAR_SUCCESS;
+}
+
+unsigned long fwd_inproc_get_count(void)
+{
+	return stat_count;
+}
+
+static int is_loopback(const char *host)
+{
+	return strcasecmp(host, "localhost") == 0 || strcmp(host, "127.0.0.1") == 0
+		|| strcmp(host, "::1") == 0;
+}
+
+static const struct fwd_inproc_endpoint *find_target(const char *host, const char *port)
+{
+	unsigned long p;
+	char *end;
+	unsigned int i;
+
+	p = strtoul(port, &end, 10);
+	if (*port == '\0' || *end != '\0') {
+		return NULL;
+	}
+	for (i = 0; i < ntargets; i++) {
+		if (targets[i].port == p && (strcasecmp(targets[i].host, host) == 0
+				|| (is_loopback(targets[i].host) && is_loopback(host)))) {
+			return targets[i].ep;
+		}
+	}
+	return NULL;
+}
+
+/* ------------------------------------------------------------------ */
+/*  Channel hooks                                                     */
+/* ------------------------------------------------------------------ */
+
+static void fwd_recv(struct Channel *channel, const unsigned char *data, unsigned int len)
+{
+	struct fwd_conn *conn = (struct fwd_conn *)channel->typedata;
+
+	conn->ep->recv(conn->ctx, channel, data, len);
+}
+
+static const struct chan_inproc_ops fwd_ops = {
+	fwd_recv, 0
+};
+
+static void fwd_handle_extra_io(struct Channel *channel,
+	const fd_set *readfds, const fd_set *writefds)
+{
+	struct fwd_conn *conn = (struct fwd_conn *)channel->typedata;
+
+	(void)readfds;
+	(void)writefds;
+	chan_inproc_flush(channel);
+	if (conn->ep->poll != NULL) {
+		conn->ep->poll(conn->ctx, channel);
+		chan_inproc_flush(channel);
+	}
+}
+
+static void fwd_cleanup(const struct Channel *channel)
+{
+	struct fwd_conn *conn = (struct fwd_conn *)channel->typedata;
+
+	conn->ep->close(conn->ctx);
+	chan_inproc_detach(channel);
+	m_free(conn);
+}
+
+/* svr_chan_tcpdirect has no hooks past inithandler; these take its place once open */
+static const struct ChanType fwd_chantype = {
+	"direct-tcpip",
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	fwd_cleanup,
+	NULL,
+	fwd_handle_extra_io
+};
+
+/* ------------------------------------------------------------------ */
+/*  Link-time wrapper                                                 */
+/* ------------------------------------------------------------------ */
+
+struct dropbear_progress_connection *__wrap_connect_remote(const char *remotehost,
+	const char *remoteport, connect_callback cb, void *cb_data,
+	const char *bind_address, const char *bind_port, enum dropbear_prio prio)
+{
+	const struct fwd_inproc_endpoint *ep = NULL;
+	struct Channel *channel = (struct Channel *)cb_data;
+	struct fwd_conn *conn;
+
+	if (cb == channel_connect_done) {
+		ep = find_target(remotehost, remoteport);
+	}
+	if (ep == NULL) {
+		return __real_connect_remote(remotehost, remoteport, cb, cb_data,
+			bind_address, bind_port, prio);
+	}
+
+	/* endpoints take all data they are handed */
+	chan_inproc_open_window(channel, UINT_MAX);
+	if (chan_inproc_attach(channel, &fwd_ops) == DROPBEAR_FAILURE) {
+		dropbear_log(LOG_WARNING, "No free in-process channel slot");
+		return __real_connect_remote(remotehost, remoteport, cb, cb_data,
+			bind_address, bind_port, prio);
+	}
+	conn = (struct fwd_conn *)m_malloc(sizeof(*conn));
+	conn->ep = ep;
+	conn->ctx = NULL;
+	if (ep->open(channel, &conn->ctx) != 0) {
+		chan_inproc_detach(channel);
+		m_free(conn);
+		return __real_connect_remote(remotehost, remoteport, cb, cb_data,
+			bind_address, bind_port, prio);
+	}
+
+	TRACE(("fwd_inproc: %s:%s in-process", remotehost, remoteport))
+	channel->typedata = conn;
+	channel->type = &fwd_chantype;
+	stat_count++;
+
+	/* sends the open confirmation; the fds stay FD_UNINIT */
+	channel_connect_done(DROPBEAR_SUCCESS, FD_UNINIT, channel, NULL);
+	channel->bidir_fd = 0;
+	return NULL;
+}
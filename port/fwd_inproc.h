@@ -0,0 +1,54 @@
+#pragma once
+
+/*
+ * fwd_inproc - Virtual localhost services for direct-tcpip channels.
+ *
+ * A client's `ssh -L 8080:localhost:8080` forward normally makes the server
+ * connect() a socket to the target, and the channel moves data through it
+ * (on the MCU: lwIP loopback, pbuf copies, one socket per forward). An
+ * endpoint registered here for "localhost:8080" takes such channels
+ * itself: svr-tcpfwd.c still parses the request and applies the
+ * authorized_keys and -j/-k restrictions, and the component links with
+ * -Wl,--wrap=connect_remote, so the connect for a registered target
+ * becomes a chan_inproc endpoint (see chan_inproc.h) instead of a socket.
+ * No listening port is opened for the service.
+ *
+ * Targets that are not registered, and connections an endpoint refuses,
+ * are connected as before. "localhost", "127.0.0.1" and "::1" name the
+ * same target.
+ */
+
+#include "includes.h"
+#include "channel.h"
+
+struct fwd_inproc_endpoint {
+	/*
+	 * A forwarded connection was opened on `channel`. Set *conn to per-
+	 * connection state. Nonzero refuses it.
+	 */
+	int (*open)(struct Channel *channel, void **conn);
+	/* Data from the client. The window is handed back once this returns. */
+	void (*recv)(void *conn, struct Channel *channel, const unsigned char *data,
+		unsigned int len);
+	/*
+	 * Every loop iteration, may be NULL. Send more output while
+	 * chan_inproc_room() allows; channel->recv_eof is the client's EOF.
+	 * chan_inproc_close() ends the connection.
+	 */
+	void (*poll)(void *conn, struct Channel *channel);
+	/* The channel is gone: free `conn`. */
+	void (*close)(void *conn);
+};
+
+#define FWD_INPROC_MAX  8
+
+/*
+ * Serve direct-tcpip channels to `host`:`port` with `ep`. Neither is copied.
+ * Register before the server starts; the table is not locked.
+ * DROPBEAR_FAILURE if the table is full.
+ */
+int fwd_inproc_register(const char *host, unsigned int port,
+	const struct fwd_inproc_endpoint *ep);
+
+/* Forwarded connections served in-process since boot. */
+unsigned long fwd_inproc_get_count(void);
@@ -0,0 +1,100 @@
+#!/usr/bin/env python3
+"""Generate the Ed25519 base point comb table for port/curve25519_fast.c.
+
+For a stride s the table has 64/s rows of eight points each:
+
+    table[i][j] = (j + 1) * 16^(s*i) * B
+
+stored as affine (y+x, y-x, 2dxy) in the radix 2^25.5 limb layout used by
+curve25519_fast.c. A fixed-base multiplication then needs 64 mixed
+additions and 4*(s-1) doublings. Each entry is 120 bytes.
+
+Usage: gen_ed25519_table.py STRIDE OUTPUT
+"""
+
+import sys
+
+P = 2**255 - 19
+D = (-121665 * pow(121666, P - 2, P)) % P
+WIDTHS = [26 - (i & 1) for i in range(10)]
+
+
+def base_point():
+    y = 4 * pow(5, P - 2, P) % P
+    u = (y * y - 1) % P
+    v = (D * y * y + 1) % P
+    x = pow(u * pow(v, P - 2, P), (P + 3) // 8, P)
+    if (x * x * v - u) % P:
+        x = x * pow(2, (P - 1) // 4, P) % P
+    if x & 1:
+        x = P - x
+    return (x, y)
+
+
+def add(a, b):
+    (x1, y1), (x2, y2) = a, b
+    t = D * x1 * x2 * y1 * y2 % P
+    x3 = (x1 * y2 + x2 * y1) * pow(1 + t, P - 2, P) % P
+    y3 = (y1 * y2 + x1 * x2) * pow(1 - t, P - 2, P) % P
+    return (x3, y3)
+
+
+def mul(k, a):
+    r = (0, 1)
+    while k:
+        if k & 1:
+            r = add(r, a)
+        a = add(a, a)
+        k >>= 1
+    return r
+
+
+def limbs(v):
+    v %= P
+    out = []
+    for w in WIDTHS:
+        out.append(v & ((1 << w) - 1))
+        v >>= w
+    return out
+
+
+def fe(v):
+    return "{" + ", ".join(str(x) for x in limbs(v)) + "}"
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit(__doc__)
+    stride = int(sys.argv[1])
+    if stride not in (1, 2, 4, 8, 16, 32, 64):
+        sys.exit("stride must divide 64")
+    rows = 64 // stride
+
+    lines = [
+        "/* Generated by port/gen_ed25519_table.py - do not edit */",
+        "",
+        "#define ED25519_BASE_STRIDE %d" % stride,
+        "",
+        "static const ge_precomp ed25519_base_table[%d][8] = {" % rows,
+    ]
+    row_base = base_point()
+    step = 16**stride
+    for i in range(rows):
+        lines.append("\t{")
+        p = row_base
+        for j in range(8):
+            x, y = p
+            lines.append("\t\t{%s," % fe(y + x))
+            lines.append("\t\t %s," % fe(y - x))
+            lines.append("\t\t %s}," % fe(2 * D * x * y))
+            p = add(p, row_base)
+        lines.append("\t},")
+        row_base = mul(step, row_base)
+    lines.append("};")
+
+    with open(sys.argv[2], "w") as f:
+        f.write("\n".join(lines) + "\n")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,189 @@
+/*
+ * ghash_table.c - Replacement for libtomcrypt's gcm_mult_h.c using a 4-bit
+ * (Shoup) table multiplication.
+ *
+ * Without LTC_GCM_TABLES libtomcrypt multiplies by H with gcm_gf_mult(),
+ * one bit of the block at a time: 128 conditional XORs and shifts per
+ * 16 bytes of ciphertext. LTC_GCM_TABLES fixes that with a 64 KB table in
+ * every gcm_state, which is not an option here.
+ *
+ * This version keeps the sixteen multiples 0*H .. 15*H (256 bytes) per key
+ * and processes the block a nibble at a time, folding the bits shifted out
+ * back in with the 16-entry reduction table. gcm_state has no room for the
+ * table, so tables live in a small cache keyed by H. The entry used last is
+ * checked first, which is the common case: one session moving a bulk
+ * transfer in one direction.
+ *
+ * The table is indexed by nibbles of the GHASH accumulator, which depend
+ * on H. tables[] is in .bss, which ESP-IDF keeps in internal SRAM unless
+ * told otherwise; the Xtensa and RISC-V cores read that without a data
+ * cache. Where the table is behind a cache (the Linux target, or .bss moved
+ * to PSRAM) the lookup time may depend on the index, as with any table
+ * GHASH such as mbedTLS's; leave the option off where that matters.
+ */
+
+#include "tomcrypt.h"
+#include "sdkconfig.h"
+#include "ghash_table.h"
+
+#ifdef LTC_GCM_MODE
+
+#ifdef LTC_GCM_TABLES
+#error "port/ghash_table.c replaces the LTC_GCM_TABLES code, undefine LTC_GCM_TABLES"
+#endif
+
+/* Two directions per session, plus room for a rekey in flight. */
+#define GHASH_TABLE_ENTRIES  (2 * CONFIG_DROPBEAR_MAX_SESSIONS + 2)
+
+struct ghash_table {
+	int used;
+	unsigned long last_use;
+	unsigned char H[16];
+	ulong64 hl[16];                     /* low/high halves of i*H */
+	ulong64 hh[16];
+};
+
+/* x^4 reduction of the nibble shifted out of the low end, pre-shifted by 48 */
+static const ulong64 last4[16] = {
+	0x0000, 0x1c20, 0x3840, 0x2460, 0x7080, 0x6ca0, 0x48c0, 0x54e0,
+	0xe100, 0xfd20, 0xd940, 0xc560, 0x9180, 0x8da0, 0xa9c0, 0xb5e0
+};
+
+static struct ghash_table tables[GHASH_TABLE_ENTRIES];
+static struct ghash_table *last_table;
+static unsigned long use_clock;
+static unsigned long table_hits, table_misses;
+
+/* Constant-time 16-byte compare, H is key material. */
+static int h_neq(const unsigned char *a, const unsigned char *b)
+{
+	unsigned char d = 0;
+	int i;
+
+	for (i = 0; i < 16; i++) {
+		d |= a[i] ^ b[i];
+	}
+	return d != 0;
+}
+
+static void table_build(struct ghash_table *t, const unsigned char *H)
+{
+	ulong64 vh, vl;
+	int i, j;
+
+	LOAD64H(vh, H);
+	LOAD64H(vl, H + 8);
+
+	/* bit-reflected field: entry 8 is H, entries 4, 2, 1 are H*x, H*x^2, H*x^3 */
+	t->hl[0] = 0;
+	t->hh[0] = 0;
+	t->hl[8] = vl;
+	t->hh[8] = vh;
+	for (i = 4; i > 0; i >>= 1) {
+		ulong64 r = (vl & 1) ? CONST64(0xe100000000000000) : 0;
+
+		vl = (vh << 63) | (vl >> 1);
+		vh = (vh >> 1) ^ r;
+		t->hl[i] = vl;
+		t->hh[i] = vh;
+	}
+	for (i = 2; i <= 8; i <<= 1) {
+		for (j = 1; j < i; j++) {
+			t->hl[i + j] = t->hl[i] ^ t->hl[j];
+			t->hh[i + j] = t->hh[i] ^ t->hh[j];
+		}
+	}
+	XMEMCPY(t->H, H, 16);
+	t->used = 1;
+}
+
+static struct ghash_table *table_get(const unsigned char *H)
+{
+	struct ghash_table *victim;
+	int i;
+
+	if (last_table != NULL && !h_neq(last_table->H, H)) {
+		table_hits++;
+		last_table->last_use = ++use_clock;
+		return last_table;
+	}
+
+	victim = &tables[0];
+	for (i = 0; i < GHASH_TABLE_ENTRIES; i++) {
+		struct ghash_table *t = &tables[i];
+
+		if (t->used && !h_neq(t->H, H)) {
+			table_hits++;
+			t->last_use = ++use_clock;
+			last_table = t;
+			return t;
+		}
+		if (victim->used && (!t->used || t->last_use < victim->last_use)) {
+			victim = t;
+		}
+	}
+
+	table_misses++;
+	zeromem(victim, sizeof(*victim));
+	table_build(victim, H);
+	victim->last_use = ++use_clock;
+	last_table = victim;
+	return victim;
+}
+
+/**
+  GCM multiply by H
+  @param gcm   The GCM state which holds the H value
+  @param I     The value to multiply H by
+ */
+void gcm_mult_h(const gcm_state *gcm, unsigned char *I)
+{
+	const struct ghash_table *t;
+	ulong64 zh, zl;
+	unsigned char rem;
+	int i, lo, hi;
+
+	LTC_ARGCHKVD(gcm != NULL);
+	LTC_ARGCHKVD(I != NULL);
+
+	t = table_get(gcm->H);
+
+	lo = I[15] & 0x0f;
+	zh = t->hh[lo];
+	zl = t->hl[lo];
+
+	for (i = 15; i >= 0; i--) {
+		lo = I[i] & 0x0f;
+		hi = I[i] >> 4;
+
+		if (i != 15) {
+			rem = (unsigned char)(zl & 0x0f);
+			zl = (zh << 60) | (zl >> 4);
+			zh = (zh >> 4) ^ (last4[rem] << 48);
+			zh ^= t->hh[lo];
+			zl ^= t->hl[lo];
+		}
+		rem = (unsigned char)(zl & 0x0f);
+		zl = (zh << 60) | (zl >> 4);
+		zh = (zh >> 4) ^ (last4[rem] << 48);
+		zh ^= t->hh[hi];
+		zl ^= t->hl[hi];
+	}
+
+	STORE64H(zh, I);
+	STORE64H(zl, I + 8);
+}
+
+void ghash_table_clear(void)
+{
+	zeromem(tables, sizeof(tables));
+	last_table = NULL;
+}
+
+void ghash_table_get_stats(unsigned long *hits, unsigned long *misses)
+{
+	*hits = table_hits;
+	*misses = table_misses;
+}
+
+#endif /* LTC_GCM_MODE */
@@ -0,0 +1,17 @@
+#pragma once
+
+/*
+ * ghash_table - 4-bit table GHASH for aes*-gcm@openssh.com.
+ *
+ * With CONFIG_DROPBEAR_GCM_GHASH_TABLE, port/ghash_table.c replaces
+ * libtomcrypt's gcm_mult_h.c. The multiples of the hash key H are computed
+ * once per key (256 bytes) and kept in a small static cache, so each 16-byte
+ * block costs 32 table lookups instead of a 128-step bitwise multiplication.
+ * Dropbear's gcm.c is unchanged.
+ */
+
+/* Forget all cached tables and wipe them. */
+void ghash_table_clear(void);
+
+/* Hit/miss counters since boot (one lookup per 16-byte block). */
+void ghash_table_get_stats(unsigned long *hits, unsigned long *misses);
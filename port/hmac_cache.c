@@ -0,0 +1,221 @@
+/*
+ * hmac_cache.c - Replacement for libtomcrypt's hmac_init.c and hmac_done.c
+ * that caches the keyed inner/outer hash states.
+ *
+ * Dropbear computes every packet MAC with hmac_init() + hmac_process() +
+ * hmac_done(), keyed with the same per-direction session key until the
+ * next key exchange. The stock hmac_init() hashes the ipad block and the
+ * stock hmac_done() hashes the opad block again for each packet; for small
+ * interactive packets that is half of the MAC cost.
+ *
+ * Here hmac_init() looks the key up in a small LRU cache. On a hit it only
+ * copies two hash states. The outer state travels to hmac_done() in the
+ * otherwise unused hmac_state.hashstate member, so hmac->key is never
+ * allocated. Keys are compared in constant time and evicted entries are
+ * wiped.
+ */
+
+#include "tomcrypt.h"
+#include "sdkconfig.h"
+#include "hmac_cache.h"
+
+#ifdef LTC_HMAC
+
+/* Two directions per session, plus room for a rekey in flight. */
+#define HMAC_CACHE_ENTRIES   (2 * CONFIG_DROPBEAR_MAX_SESSIONS + 2)
+
+struct hmac_cache_entry {
+	int hash;                           /* -1 if the slot is empty */
+	unsigned long keylen;
+	unsigned long last_use;
+	unsigned char key[MAXBLOCKSIZE];
+	hash_state inner;                   /* after absorbing key ^ ipad */
+	hash_state outer;                   /* after absorbing key ^ opad */
+};
+
+static struct hmac_cache_entry cache[HMAC_CACHE_ENTRIES];
+static int cache_ready;
+static unsigned long use_clock;
+static unsigned long cache_hits, cache_misses;
+
+static void cache_init(void)
+{
+	int i;
+
+	if (cache_ready) {
+		return;
+	}
+	for (i = 0; i < HMAC_CACHE_ENTRIES; i++) {
+		cache[i].hash = -1;
+	}
+	cache_ready = 1;
+}
+
+static void cache_wipe(struct hmac_cache_entry *e)
+{
+	zeromem(e, sizeof(*e));
+	e->hash = -1;
+}
+
+static struct hmac_cache_entry *cache_lookup(int hash,
+	const unsigned char *key, unsigned long keylen)
+{
+	int i;
+
+	for (i = 0; i < HMAC_CACHE_ENTRIES; i++) {
+		struct hmac_cache_entry *e = &cache[i];
+
+		if (e->hash == hash && e->keylen == keylen
+				&& mem_neq(e->key, key, keylen) == 0) {
+			return e;
+		}
+	}
+	return NULL;
+}
+
+static struct hmac_cache_entry *cache_victim(void)
+{
+	struct hmac_cache_entry *victim = &cache[0];
+	int i;
+
+	for (i = 0; i < HMAC_CACHE_ENTRIES; i++) {
+		if (cache[i].hash == -1) {
+			return &cache[i];
+		}
+		if (cache[i].last_use < victim->last_use) {
+			victim = &cache[i];
+		}
+	}
+	return victim;
+}
+
+/* Absorb (key ^ pad) into a fresh hash state. */
+static int absorb_pad(int hash, hash_state *md, const unsigned char *key,
+	unsigned char pad)
+{
+	unsigned char buf[MAXBLOCKSIZE];
+	unsigned long blocksize = hash_descriptor[hash].blocksize;
+	unsigned long i;
+	int err;
+
+	for (i = 0; i < blocksize; i++) {
+		buf[i] = key[i] ^ pad;
+	}
+	if ((err = hash_descriptor[hash].init(md)) == CRYPT_OK) {
+		err = hash_descriptor[hash].process(md, buf, blocksize);
+	}
+	zeromem(buf, sizeof(buf));
+	return err;
+}
+
+int hmac_init(hmac_state *hmac, int hash, const unsigned char *key, unsigned long keylen)
+{
+	struct hmac_cache_entry *e;
+	unsigned long blocksize;
+	int err;
+
+	LTC_ARGCHK(hmac != NULL);
+	LTC_ARGCHK(key  != NULL);
+
+	if ((err = hash_is_valid(hash)) != CRYPT_OK) {
+		return err;
+	}
+	blocksize = hash_descriptor[hash].blocksize;
+	if (keylen == 0 || blocksize > MAXBLOCKSIZE) {
+		return CRYPT_INVALID_KEYSIZE;
+	}
+
+	cache_init();
+	hmac->hash = hash;
+	hmac->key = NULL;
+
+	e = keylen <= blocksize ? cache_lookup(hash, key, keylen) : NULL;
+	if (e != NULL) {
+		cache_hits++;
+	} else {
+		cache_misses++;
+		e = cache_victim();
+		cache_wipe(e);
+
+		if (keylen > blocksize) {
+			/* long keys are replaced by their hash and never match a lookup */
+			unsigned long z = sizeof(e->key);
+
+			if ((err = hash_memory(hash, key, keylen, e->key, &z)) != CRYPT_OK) {
+				cache_wipe(e);
+				return err;
+			}
+			e->keylen = 0;
+		} else {
+			XMEMCPY(e->key, key, keylen);
+			e->keylen = keylen;
+		}
+
+		if ((err = absorb_pad(hash, &e->inner, e->key, 0x36)) != CRYPT_OK
+				|| (err = absorb_pad(hash, &e->outer, e->key, 0x5C)) != CRYPT_OK) {
+			cache_wipe(e);
+			return err;
+		}
+		e->hash = hash;
+	}
+
+	e->last_use = ++use_clock;
+	XMEMCPY(&hmac->md, &e->inner, sizeof(hash_state));
+	XMEMCPY(&hmac->hashstate, &e->outer, sizeof(hash_state));
+	return CRYPT_OK;
+}
+
+int hmac_done(hmac_state *hmac, unsigned char *out, unsigned long *outlen)
+{
+	unsigned char isha[MAXBLOCKSIZE];
+	unsigned long hashsize, i;
+	int hash, err;
+
+	LTC_ARGCHK(hmac  != NULL);
+	LTC_ARGCHK(out   != NULL);
+
+	hash = hmac->hash;
+	if ((err = hash_is_valid(hash)) != CRYPT_OK) {
+		return err;
+	}
+	hashsize = hash_descriptor[hash].hashsize;
+
+	/* H(K ^ opad || H(K ^ ipad || msg)), outer state prepared by hmac_init() */
+	if ((err = hash_descriptor[hash].done(&hmac->md, isha)) != CRYPT_OK) {
+		goto LBL_ERR;
+	}
+	if ((err = hash_descriptor[hash].process(&hmac->hashstate, isha, hashsize)) != CRYPT_OK) {
+		goto LBL_ERR;
+	}
+	if ((err = hash_descriptor[hash].done(&hmac->hashstate, isha)) != CRYPT_OK) {
+		goto LBL_ERR;
+	}
+
+	for (i = 0; i < hashsize && i < *outlen; i++) {
+		out[i] = isha[i];
+	}
+	*outlen = i;
+
+LBL_ERR:
+	zeromem(isha, sizeof(isha));
+	zeromem(&hmac->hashstate, sizeof(hash_state));
+	return err;
+}
+
+void hmac_cache_clear(void)
+{
+	int i;
+
+	for (i = 0; i < HMAC_CACHE_ENTRIES; i++) {
+		cache_wipe(&cache[i]);
+	}
+	cache_ready = 1;
+}
+
+void hmac_cache_get_stats(unsigned long *hits, unsigned long *misses)
+{
+	*hits = cache_hits;
+	*misses = cache_misses;
+}
+
+#endif /* LTC_HMAC */
@@ -0,0 +1,18 @@
+#pragma once
+
+/*
+ * hmac_cache - keyed HMAC states reused across packets.
+ *
+ * With CONFIG_DROPBEAR_HMAC_CACHE, port/hmac_cache.c replaces libtomcrypt's
+ * hmac_init.c and hmac_done.c. The hash states after absorbing the ipad and
+ * opad key blocks are computed once per MAC key and cloned for every later
+ * packet that uses the same key, which saves two hash compressions and two
+ * heap allocations per packet. Dropbear's packet.c is unchanged: it still
+ * calls hmac_init() with the session MAC key for each packet.
+ */
+
+/* Forget all cached keys and wipe their states. */
+void hmac_cache_clear(void);
+
+/* Hit/miss counters since boot. */
+void hmac_cache_get_stats(unsigned long *hits, unsigned long *misses);
@@ -13,6 +13,8 @@ struct rlimit {
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 
+#include "session_pool.h"
+
 /*
  * Minimal stubs for missing libc/Dropbear symbols on ESP-IDF.
  *
@@ -148,7 +150,10 @@ int nanosleep(const struct timespec *req, struct timespec *rem)
 	}
 	uint32_t ms = (uint32_t)(req->tv_sec * 1000) + (uint32_t)(req->tv_nsec / 1000000);
 	if (ms > 0) {
+		/* let other sessions run while this one sleeps */
+		session_pool_leave();
 		vTaskDelay(pdMS_TO_TICKS(ms));
+		session_pool_enter();
 	}
 	if (rem) {
 		rem->tv_sec = 0;
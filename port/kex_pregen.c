@@ -0,0 +1,248 @@
+/*
+ * kex_pregen.c - Pools of ephemeral X25519 and P-256 key pairs for the
+ * handshake.
+ *
+ * The pregeneration task runs outside the session pool lock, so it keeps
+ * away from Dropbear's global state. It draws private keys from
+ * esp_fill_random() rather than genrandom(), whose pool is unlocked; for
+ * P-256 through a libtomcrypt PRNG descriptor of its own. It allocates with
+ * malloc(): m_malloc() would dropbear_exit() on failure, and this task has
+ * no session to unwind. libtommath has no such choice, so a P-256 pair is
+ * only made while the free heap is well above what it needs.
+ * dropbear_curve25519_scalarmult() keeps no state, except
+ * curve25519_fast.c's RAM base table (used when there is no flash table).
+ * kex_pregen_init() makes the first X25519 pair itself, so that table is
+ * filled before the task starts. libtomcrypt's ECC code keeps none.
+ *
+ * The task runs below the session tasks, so it only computes while they
+ * wait for the network.
+ */
+
+#include "includes.h"
+#include "dbutil.h"
+#include "kex.h"
+#include "curve25519.h"
+#include "sdkconfig.h"
+#include "kex_pregen.h"
+#if DROPBEAR_ECDH
+#include "ecc.h"
+#include "session.h"
+#endif
+
+#include "esp_random.h"
+#include "esp_system.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+#if DROPBEAR_ECDH
+/* libtomcrypt's point multiplication on top of the X25519 needs */
+#define KEX_PREGEN_STACK    4096
+#else
+#define KEX_PREGEN_STACK    3072
+#endif
+#define KEX_PREGEN_RETRY_MS 1000
+/* free heap below which no P-256 pair is made; one takes well under 2 KB */
+#define KEX_PREGEN_ECDH_HEAP 16384
+
+struct key_pool {
+	void *ready[CONFIG_DROPBEAR_KEX_PREGEN_DEPTH];
+	unsigned int nready;
+	void *(*make)(void);
+};
+
+static SemaphoreHandle_t ready_lock;
+static TaskHandle_t pregen_task;
+static unsigned long stat_hits, stat_misses;
+
+struct kex_curve25519_param *__real_gen_kexcurve25519_param(void);
+
+/* As gen_kexcurve25519_param() in kex-x25519.c, without Dropbear's RNG and allocator. */
+static void *make_x25519(void)
+{
+	static const unsigned char basepoint[32] = {9};
+	struct kex_curve25519_param *param = malloc(sizeof(*param));
+
+	if (param == NULL) {
+		return NULL;
+	}
+	esp_fill_random(param->priv, CURVE25519_LEN);
+	dropbear_curve25519_scalarmult(param->pub, param->priv, basepoint);
+	return param;
+}
+
+static struct key_pool x25519_pool = { .make = make_x25519 };
+
+#if DROPBEAR_ECDH
+static int esp_prng = -1;
+
+struct kex_ecdh_param *__real_gen_kexecdh_param(void);
+
+/* ecc_make_key_ex() only calls read() */
+static unsigned long esp_prng_read(unsigned char *out, unsigned long outlen, prng_state *prng)
+{
+	(void)prng;
+	esp_fill_random(out, outlen);
+	return outlen;
+}
+
+static const struct ltc_prng_descriptor esp_prng_desc = {
+	.name = "esp_random",
+	.read = esp_prng_read,
+};
+
+/* As gen_kexecdh_param() for nistp256, without Dropbear's RNG. */
+static void *make_ecdh_p256(void)
+{
+	struct kex_ecdh_param *param;
+
+	if (esp_get_free_heap_size() < KEX_PREGEN_ECDH_HEAP) {
+		return NULL;
+	}
+	param = malloc(sizeof(*param));
+	if (param == NULL) {
+		return NULL;
+	}
+	if (ecc_make_key_ex(NULL, esp_prng, &param->key, ecc_curve_nistp256.dp) != CRYPT_OK) {
+		free(param);
+		return NULL;
+	}
+	return param;
+}
+
+static struct key_pool ecdh_pool = { .make = make_ecdh_p256 };
+#endif
+
+static struct key_pool *const pools[] = {
+	&x25519_pool,
+#if DROPBEAR_ECDH
+	&ecdh_pool,
+#endif
+};
+
+#define POOL_COUNT (sizeof(pools) / sizeof(pools[0]))
+
+/* The first pool with room, X25519 first: it is the one most handshakes use. */
+static struct key_pool *pool_to_fill(void)
+{
+	struct key_pool *pool = NULL;
+	unsigned int i;
+
+	xSemaphoreTake(ready_lock, portMAX_DELAY);
+	for (i = 0; i < POOL_COUNT && pool == NULL; i++) {
+		if (pools[i]->nready < CONFIG_DROPBEAR_KEX_PREGEN_DEPTH) {
+			pool = pools[i];
+		}
+	}
+	xSemaphoreGive(ready_lock);
+	return pool;
+}
+
+static void kex_pregen_task(void *arg)
+{
+	(void)arg;
+
+	for (;;) {
+		struct key_pool *pool = pool_to_fill();
+		void *param;
+
+		if (pool == NULL) {
+			/* woken when a handshake takes one */
+			ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+			continue;
+		}
+
+		param = pool->make();
+		if (param == NULL) {
+			vTaskDelay(pdMS_TO_TICKS(KEX_PREGEN_RETRY_MS));
+			continue;
+		}
+		/* only this task adds, so there is still room */
+		xSemaphoreTake(ready_lock, portMAX_DELAY);
+		pool->ready[pool->nready++] = param;
+		xSemaphoreGive(ready_lock);
+	}
+}
+
+/* A pregenerated pair out of `pool`, or NULL if it is empty. */
+static void *pool_take(struct key_pool *pool)
+{
+	void *param = NULL;
+
+	if (ready_lock != NULL) {
+		xSemaphoreTake(ready_lock, portMAX_DELAY);
+		if (pool->nready > 0) {
+			/* out of the pool before use: no pair serves two handshakes */
+			param = pool->ready[--pool->nready];
+			pool->ready[pool->nready] = NULL;
+		}
+		xSemaphoreGive(ready_lock);
+	}
+
+	if (param == NULL) {
+		stat_misses++;
+		return NULL;
+	}
+	stat_hits++;
+	xTaskNotifyGive(pregen_task);
+	return param;
+}
+
+void kex_pregen_init(void)
+{
+	ready_lock = xSemaphoreCreateMutex();
+	if (ready_lock == NULL) {
+		dropbear_exit("Failed to create key pool lock");
+	}
+	x25519_pool.ready[0] = make_x25519();
+	x25519_pool.nready = x25519_pool.ready[0] != NULL;
+#if DROPBEAR_ECDH
+	esp_prng = register_prng(&esp_prng_desc);
+	if (esp_prng < 0) {
+		dropbear_exit("Failed to register the key pool's PRNG");
+	}
+#endif
+
+	if (xTaskCreate(kex_pregen_task, "kex_pregen", KEX_PREGEN_STACK, NULL,
+			CONFIG_DROPBEAR_KEX_PREGEN_PRIORITY, &pregen_task) != pdPASS) {
+		dropbear_exit("Failed to create key pregeneration task");
+	}
+#if DROPBEAR_ECDH
+	dropbear_log(LOG_INFO, "KEX key pool: %d X25519 and %d P-256 pairs",
+		CONFIG_DROPBEAR_KEX_PREGEN_DEPTH, CONFIG_DROPBEAR_KEX_PREGEN_DEPTH);
+#else
+	dropbear_log(LOG_INFO, "KEX key pool: %d X25519 pairs", CONFIG_DROPBEAR_KEX_PREGEN_DEPTH);
+#endif
+}
+
+void kex_pregen_get_stats(unsigned long *hits, unsigned long *misses)
+{
+	*hits = stat_hits;
+	*misses = stat_misses;
+}
+
+/* ------------------------------------------------------------------ */
+/*  Link-time wrappers                                                */
+/* ------------------------------------------------------------------ */
+
+struct kex_curve25519_param *__wrap_gen_kexcurve25519_param(void)
+{
+	struct kex_curve25519_param *param = pool_take(&x25519_pool);
+
+	return param != NULL ? param : __real_gen_kexcurve25519_param();
+}
+
+#if DROPBEAR_ECDH
+/* Only nistp256 is pooled; the larger curves are rarely negotiated. */
+struct kex_ecdh_param *__wrap_gen_kexecdh_param(void)
+{
+	struct kex_ecdh_param *param = NULL;
+
+	if (ses.newkeys->algo_kex->ecc_curve == &ecc_curve_nistp256) {
+		param = pool_take(&ecdh_pool);
+	} else {
+		stat_misses++;
+	}
+	return param != NULL ? param : __real_gen_kexecdh_param();
+}
+#endif
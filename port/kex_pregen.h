@@ -0,0 +1,26 @@
+#pragma once
+
+/*
+ * kex_pregen - ephemeral key pairs generated ahead of the handshake.
+ *
+ * The server's only key generation in curve25519-sha256,
+ * sntrup761x25519-sha512 and mlkem768x25519-sha256 is the X25519 pair made
+ * by gen_kexcurve25519_param(), and in ecdh-sha2-nistp256 the P-256 pair
+ * made by gen_kexecdh_param(). Dropbear calls them after the client's
+ * KEX_ECDH_INIT has arrived. (The post-quantum halves only encapsulate to
+ * the client's public key; there is nothing to generate in advance.)
+ *
+ * With CONFIG_DROPBEAR_KEX_PREGEN the component links with
+ * -Wl,--wrap=gen_kexcurve25519_param,--wrap=gen_kexecdh_param. A
+ * low-priority task keeps CONFIG_DROPBEAR_KEX_PREGEN_DEPTH pairs of each
+ * kind ready (P-256 only with DROPBEAR_ECDH), and the wrappers hand one
+ * out. It is removed from the pool first, so it is used once. Dropbear
+ * burns and frees it after the shared secret, as it does its own. An empty
+ * pool, or ECDH on nistp384/521, falls back to generating inline.
+ */
+
+/* Fill the first key pair and start the task. Call once, after crypto_init(). */
+void kex_pregen_init(void);
+
+/* Handshakes served from the pool / generated inline, since boot. */
+void kex_pregen_get_stats(unsigned long *hits, unsigned long *misses);
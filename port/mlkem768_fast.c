@@ -0,0 +1,757 @@
+/*
+ * mlkem768_fast.c - Replacement for Dropbear's mlkem768.c.
+ *
+ * ML-KEM-768 (FIPS 203) for mlkem768x25519-sha256: same key, ciphertext
+ * and shared secret bytes, same interface (mlkem768.h).
+ *
+ * The server side of the key exchange is crypto_kem_mlkem768_enc() only.
+ * Dropbear's generated code holds the whole 3x3 matrix A, the vectors and
+ * their intermediate copies at once, and runs a generic NTT. Here:
+ *
+ *  - the NTT uses Montgomery multiplication and Barrett reduction with
+ *    16-bit coefficients (the structure of the FIPS 203 reference code);
+ *  - each entry of A is sampled from SHAKE128 straight into the product:
+ *    every accepted pair of coefficients is multiplied by the matching pair
+ *    of the vector and added to one accumulator polynomial, so A never
+ *    exists in memory, not even one entry of it;
+ *  - a pair product needs three Montgomery reductions instead of five;
+ *  - the public key's t is decoded three bytes (one pair) at a time where
+ *    it is used, and the noise polynomials are added as they are sampled;
+ *  - u and v are compressed into the ciphertext row by row.
+ *
+ * Encapsulation keeps the NTT of y (3 polynomials), one accumulator and
+ * one SHAKE128 state and block on the stack, about 3 KB. Key generation
+ * and decapsulation, which only a client runs, are built the same way.
+ *
+ * Everything that touches secret data runs in constant time. Rejection
+ * sampling of A depends only on the public seed.
+ */
+
+#include "includes.h"
+#include "dbrandom.h"
+#include "dbutil.h"
+#include "mlkem768.h"
+
+#if DROPBEAR_MLKEM768
+
+#define MLKEM_K      3
+#define MLKEM_N      256
+#define MLKEM_Q      3329
+
+#define SEED_BYTES   32
+#define POLY_BYTES   384                                /* 256 x 12 bits */
+#define PK_BYTES     (MLKEM_K * POLY_BYTES + SEED_BYTES) /* 1184 */
+#define SK_PKE_BYTES (MLKEM_K * POLY_BYTES)              /* 1152 */
+#define U_BYTES      320                                /* 256 x 10 bits */
+#define V_BYTES      128                                /* 256 x 4 bits */
+#define CT_BYTES     (MLKEM_K * U_BYTES + V_BYTES)       /* 1088 */
+
+/* q^-1 mod 2^16 */
+#define QINV         (-3327)
+
+/* ------------------------------------------------------------------ */
+/*  Keccak (SHA3-256, SHA3-512, SHAKE128, SHAKE256)                   */
+/* ------------------------------------------------------------------ */
+
+#define SHAKE128_RATE 168
+#define SHAKE256_RATE 136
+#define SHA3_256_RATE 136
+#define SHA3_512_RATE 72
+
+typedef struct {
+	uint64_t s[25];
+	unsigned int pos;       /* byte offset in the current block */
+	unsigned int rate;
+} keccak_state;
+
+static const uint64_t keccak_rc[24] = {
+	0x0000000000000001ULL, 0x0000000000008082ULL, 0x800000000000808aULL,
+	0x8000000080008000ULL, 0x000000000000808bULL, 0x0000000080000001ULL,
+	0x8000000080008081ULL, 0x8000000000008009ULL, 0x000000000000008aULL,
+	0x0000000000000088ULL, 0x0000000080008009ULL, 0x000000008000000aULL,
+	0x000000008000808bULL, 0x800000000000008bULL, 0x8000000000008089ULL,
+	0x8000000000008003ULL, 0x8000000000008002ULL, 0x8000000000000080ULL,
+	0x000000000000800aULL, 0x800000008000000aULL, 0x8000000080008081ULL,
+	0x8000000000008080ULL, 0x0000000080000001ULL, 0x8000000080008008ULL
+};
+
+static const unsigned char keccak_rho[24] = {
+	1, 3, 6, 10, 15, 21, 28, 36, 45, 55, 2, 14,
+	27, 41, 56, 8, 25, 43, 62, 18, 39, 61, 20, 44
+};
+
+static const unsigned char keccak_pi[24] = {
+	10, 7, 11, 17, 18, 3, 5, 16, 8, 21, 24, 4,
+	15, 23, 19, 13, 12, 2, 20, 14, 22, 9, 6, 1
+};
+
+#define ROL64(x, n) (((x) << (n)) | ((x) >> (64 - (n))))
+
+static void keccak_f1600(uint64_t s[25])
+{
+	uint64_t c[5], t;
+	int round, i, j;
+
+	for (round = 0; round < 24; round++) {
+		/* theta */
+		for (i = 0; i < 5; i++) {
+			c[i] = s[i] ^ s[i + 5] ^ s[i + 10] ^ s[i + 15] ^ s[i + 20];
+		}
+		for (i = 0; i < 5; i++) {
+			t = c[(i + 4) % 5] ^ ROL64(c[(i + 1) % 5], 1);
+			for (j = 0; j < 25; j += 5) {
+				s[j + i] ^= t;
+			}
+		}
+		/* rho and pi */
+		t = s[1];
+		for (i = 0; i < 24; i++) {
+			uint64_t next = s[keccak_pi[i]];
+
+			s[keccak_pi[i]] = ROL64(t, keccak_rho[i]);
+			t = next;
+		}
+		/* chi */
+		for (j = 0; j < 25; j += 5) {
+			for (i = 0; i < 5; i++) {
+				c[i] = s[j + i];
+			}
+			for (i = 0; i < 5; i++) {
+				s[j + i] = c[i] ^ (~c[(i + 1) % 5] & c[(i + 2) % 5]);
+			}
+		}
+		/* iota */
+		s[0] ^= keccak_rc[round];
+	}
+}
+
+static void keccak_init(keccak_state *ks, unsigned int rate)
+{
+	memset(ks->s, 0, sizeof(ks->s));
+	ks->pos = 0;
+	ks->rate = rate;
+}
+
+static uint64_t load64(const unsigned char *x)
+{
+	uint64_t r = 0;
+	int i;
+
+	for (i = 7; i >= 0; i--) {
+		r = (r << 8) | x[i];
+	}
+	return r;
+}
+
+static uint32_t load32(const unsigned char *x)
+{
+	return (uint32_t)x[0] | ((uint32_t)x[1] << 8) | ((uint32_t)x[2] << 16)
+		| ((uint32_t)x[3] << 24);
+}
+
+static void store64(unsigned char *x, uint64_t v)
+{
+	int i;
+
+	for (i = 0; i < 8; i++) {
+		x[i] = (unsigned char)(v >> (8 * i));
+	}
+}
+
+/* Whole lanes where the input allows, single bytes otherwise. */
+static void keccak_absorb(keccak_state *ks, const unsigned char *in, unsigned long len)
+{
+	while (len > 0) {
+		if (ks->pos % 8 == 0 && len >= 8) {
+			ks->s[ks->pos / 8] ^= load64(in);
+			ks->pos += 8;
+			in += 8;
+			len -= 8;
+		} else {
+			ks->s[ks->pos / 8] ^= (uint64_t)*in++ << (8 * (ks->pos % 8));
+			ks->pos++;
+			len--;
+		}
+		if (ks->pos == ks->rate) {
+			keccak_f1600(ks->s);
+			ks->pos = 0;
+		}
+	}
+}
+
+/* Pad (0x06 for SHA3, 0x1f for SHAKE) and switch to squeezing. */
+static void keccak_finish(keccak_state *ks, unsigned char pad)
+{
+	ks->s[ks->pos / 8] ^= (uint64_t)pad << (8 * (ks->pos % 8));
+	ks->s[(ks->rate - 1) / 8] ^= 0x80ULL << (8 * ((ks->rate - 1) % 8));
+	ks->pos = ks->rate;
+}
+
+static void keccak_squeeze(keccak_state *ks, unsigned char *out, unsigned long len)
+{
+	while (len > 0) {
+		if (ks->pos == ks->rate) {
+			keccak_f1600(ks->s);
+			ks->pos = 0;
+		}
+		if (ks->pos % 8 == 0 && len >= 8) {
+			store64(out, ks->s[ks->pos / 8]);
+			ks->pos += 8;
+			out += 8;
+			len -= 8;
+		} else {
+			*out++ = (unsigned char)(ks->s[ks->pos / 8] >> (8 * (ks->pos % 8)));
+			ks->pos++;
+			len--;
+		}
+	}
+}
+
+/* H: SHA3-256(in) */
+static void hash_h(unsigned char out[32], const unsigned char *in, unsigned long len)
+{
+	keccak_state ks;
+
+	keccak_init(&ks, SHA3_256_RATE);
+	keccak_absorb(&ks, in, len);
+	keccak_finish(&ks, 0x06);
+	keccak_squeeze(&ks, out, 32);
+	m_burn(&ks, sizeof(ks));
+}
+
+/* G: SHA3-512(a || b) */
+static void hash_g(unsigned char out[64], const unsigned char *a, unsigned long alen,
+	const unsigned char *b, unsigned long blen)
+{
+	keccak_state ks;
+
+	keccak_init(&ks, SHA3_512_RATE);
+	keccak_absorb(&ks, a, alen);
+	keccak_absorb(&ks, b, blen);
+	keccak_finish(&ks, 0x06);
+	keccak_squeeze(&ks, out, 64);
+	m_burn(&ks, sizeof(ks));
+}
+
+/* PRF: SHAKE256(seed || n), squeezed by the caller */
+static void prf_init(keccak_state *ks, const unsigned char seed[SEED_BYTES], unsigned char n)
+{
+	keccak_init(ks, SHAKE256_RATE);
+	keccak_absorb(ks, seed, SEED_BYTES);
+	keccak_absorb(ks, &n, 1);
+	keccak_finish(ks, 0x1f);
+}
+
+/* ------------------------------------------------------------------ */
+/*  Arithmetic mod q                                                  */
+/* ------------------------------------------------------------------ */
+
+/* 2^16 * 17^bitrev7(i) mod q, centered */
+static const int16_t zetas[128] = {
+	-1044,  -758,  -359, -1517,  1493,  1422,   287,   202,
+	 -171,   622,  1577,   182,   962, -1202, -1474,  1468,
+	  573, -1325,   264,   383,  -829,  1458, -1602,  -130,
+	 -681,  1017,   732,   608, -1542,   411,  -205, -1571,
+	 1223,   652,  -552,  1015, -1293,  1491,  -282, -1544,
+	  516,    -8,  -320,  -666, -1618, -1162,   126,  1469,
+	 -853,   -90,  -271,   830,   107, -1421,  -247,  -951,
+	 -398,   961, -1508,  -725,   448, -1065,   677, -1275,
+	-1103,   430,   555,   843, -1251,   871,  1550,   105,
+	  422,   587,   177,  -235,  -291,  -460,  1574,  1653,
+	 -246,   778,  1159,  -147,  -777,  1483,  -602,  1119,
+	-1590,   644,  -872,   349,   418,   329,  -156,   -75,
+	  817,  1097,   603,   610,  1322, -1285, -1465,   384,
+	-1215,  -136,  1218, -1335,  -874,   220, -1187, -1659,
+	-1185, -1530, -1278,   794, -1510,  -854,  -870,   478,
+	 -108,  -308,   996,   991,   958, -1460,  1522,  1628
+};
+
+/* a * 2^-16 mod q, |result| < q for |a| < q * 2^15 */
+static int16_t montgomery_reduce(int32_t a)
+{
+	int16_t t = (int16_t)((int16_t)a * QINV);
+
+	return (int16_t)((a - (int32_t)t * MLKEM_Q) >> 16);
+}
+
+/* a mod q, centered: -(q-1)/2 .. (q-1)/2 */
+static int16_t barrett_reduce(int16_t a)
+{
+	const int32_t v = ((1 << 26) + MLKEM_Q / 2) / MLKEM_Q;
+	int16_t t = (int16_t)((v * a + (1 << 25)) >> 26);
+
+	return (int16_t)(a - t * MLKEM_Q);
+}
+
+static int16_t fqmul(int16_t a, int16_t b)
+{
+	return montgomery_reduce((int32_t)a * b);
+}
+
+static void poly_reduce(int16_t r[MLKEM_N])
+{
+	int i;
+
+	for (i = 0; i < MLKEM_N; i++) {
+		r[i] = barrett_reduce(r[i]);
+	}
+}
+
+/* Forward NTT, bit-reversed output, reduced. */
+static void poly_ntt(int16_t r[MLKEM_N])
+{
+	int len, start, j, k = 1;
+
+	for (len = 128; len >= 2; len >>= 1) {
+		for (start = 0; start < MLKEM_N; start += 2 * len) {
+			int16_t zeta = zetas[k++];
+
+			for (j = start; j < start + len; j++) {
+				int16_t t = fqmul(zeta, r[j + len]);
+
+				r[j + len] = (int16_t)(r[j] - t);
+				r[j] = (int16_t)(r[j] + t);
+			}
+		}
+	}
+	poly_reduce(r);
+}
+
+/* Inverse NTT, times 2^16 (undoing one Montgomery factor of the products). */
+static void poly_invntt_tomont(int16_t r[MLKEM_N])
+{
+	const int16_t f = 1441;     /* 2^32 / 128 mod q */
+	int len, start, j, k = 127;
+
+	for (len = 2; len <= 128; len <<= 1) {
+		for (start = 0; start < MLKEM_N; start += 2 * len) {
+			int16_t zeta = zetas[k--];
+
+			for (j = start; j < start + len; j++) {
+				int16_t t = r[j];
+
+				r[j] = barrett_reduce((int16_t)(t + r[j + len]));
+				r[j + len] = fqmul(zeta, (int16_t)(r[j + len] - t));
+			}
+		}
+	}
+	for (j = 0; j < MLKEM_N; j++) {
+		r[j] = fqmul(r[j], f);
+	}
+}
+
+/*
+ * r += (a0 + a1 X)(b0 + b1 X) mod (X^2 - zeta), times 2^-16: pair i of a
+ * product in the NTT domain. |a| < 2^12 and |b| <= q/2, so both sums stay
+ * below q * 2^15 and need one reduction each.
+ */
+static void pair_mul_acc(int16_t r[2], int16_t a0, int16_t a1, const int16_t b[2], int i)
+{
+	int16_t zeta = (i & 1) ? (int16_t)-zetas[64 + i / 2] : zetas[64 + i / 2];
+
+	r[0] = (int16_t)(r[0] + montgomery_reduce((int32_t)fqmul(a1, b[1]) * zeta
+		+ (int32_t)a0 * b[0]));
+	r[1] = (int16_t)(r[1] + montgomery_reduce((int32_t)a0 * b[1] + (int32_t)a1 * b[0]));
+}
+
+/*
+ * acc += A * b for the matrix entry SampleNTT(rho || x || y), streamed from
+ * SHAKE128. rho is public, so the rejection loop may branch.
+ */
+static void matrix_mul_acc(int16_t acc[MLKEM_N], const unsigned char *rho,
+	unsigned char x, unsigned char y, const int16_t b[MLKEM_N])
+{
+	keccak_state ks;
+	unsigned char buf[SHAKE128_RATE];
+	int16_t pending = 0;
+	int n = 0, pos = SHAKE128_RATE;
+
+	keccak_init(&ks, SHAKE128_RATE);
+	keccak_absorb(&ks, rho, SEED_BYTES);
+	keccak_absorb(&ks, &x, 1);
+	keccak_absorb(&ks, &y, 1);
+	keccak_finish(&ks, 0x1f);
+
+	while (n < MLKEM_N) {
+		int16_t d[2];
+		int i;
+
+		/* the rate is a multiple of 3 */
+		if (pos == SHAKE128_RATE) {
+			keccak_squeeze(&ks, buf, SHAKE128_RATE);
+			pos = 0;
+		}
+		d[0] = (int16_t)(buf[pos] | ((buf[pos + 1] & 0x0f) << 8));
+		d[1] = (int16_t)((buf[pos + 1] >> 4) | (buf[pos + 2] << 4));
+		pos += 3;
+		for (i = 0; i < 2 && n < MLKEM_N; i++) {
+			if (d[i] >= MLKEM_Q) {
+				continue;
+			}
+			if ((n & 1) == 0) {
+				pending = d[i];
+			} else {
+				pair_mul_acc(&acc[n - 1], pending, d[i], &b[n - 1], n / 2);
+			}
+			n++;
+		}
+	}
+}
+
+/* acc += t * b for t ByteEncode12()d in `in` */
+static void packed_mul_acc(int16_t acc[MLKEM_N], const unsigned char *in,
+	const int16_t b[MLKEM_N])
+{
+	int i;
+
+	for (i = 0; i < MLKEM_N / 2; i++, in += 3) {
+		int16_t a0 = (int16_t)(in[0] | ((in[1] & 0x0f) << 8));
+		int16_t a1 = (int16_t)((in[1] >> 4) | (in[2] << 4));
+
+		pair_mul_acc(&acc[2 * i], a0, a1, &b[2 * i], i);
+	}
+}
+
+/* r (+)= CBD_2(PRF(seed, n)), squeezed one lane at a time */
+static void poly_noise(int16_t r[MLKEM_N], const unsigned char seed[SEED_BYTES],
+	unsigned char n, int add)
+{
+	keccak_state ks;
+	unsigned char buf[8];
+	int i, j;
+
+	prf_init(&ks, seed, n);
+	for (i = 0; i < MLKEM_N / 8; i++) {
+		uint32_t t, d;
+
+		if (i % 2 == 0) {
+			keccak_squeeze(&ks, buf, 8);
+		}
+		t = load32(buf + 4 * (i % 2));
+		d = (t & 0x55555555u) + ((t >> 1) & 0x55555555u);
+		for (j = 0; j < 8; j++) {
+			int16_t e = (int16_t)(((d >> (4 * j)) & 3) - ((d >> (4 * j + 2)) & 3));
+
+			r[8 * i + j] = (int16_t)((add ? r[8 * i + j] : 0) + e);
+		}
+	}
+	m_burn(&ks, sizeof(ks));
+	m_burn(buf, sizeof(buf));
+}
+
+/* ------------------------------------------------------------------ */
+/*  Encoding                                                          */
+/* ------------------------------------------------------------------ */
+
+/* 0 .. q-1 for a reduced (centered) coefficient */
+static uint16_t freeze(int16_t a)
+{
+	return (uint16_t)(a + ((a >> 15) & MLKEM_Q));
+}
+
+/* ByteEncode12 of a reduced polynomial */
+static void poly_tobytes(unsigned char *out, const int16_t a[MLKEM_N])
+{
+	int i;
+
+	for (i = 0; i < MLKEM_N / 2; i++) {
+		uint16_t t0 = freeze(a[2 * i]), t1 = freeze(a[2 * i + 1]);
+
+		out[3 * i] = (unsigned char)t0;
+		out[3 * i + 1] = (unsigned char)((t0 >> 8) | (t1 << 4));
+		out[3 * i + 2] = (unsigned char)(t1 >> 4);
+	}
+}
+
+
+/* Every 12-bit coefficient of the public key below q (FIPS 203 input check) */
+static int pk_check(const unsigned char *pk)
+{
+	int i;
+
+	for (i = 0; i < MLKEM_K * MLKEM_N / 2; i++, pk += 3) {
+		if ((pk[0] | ((pk[1] & 0x0f) << 8)) >= MLKEM_Q
+				|| ((pk[1] >> 4) | (pk[2] << 4)) >= MLKEM_Q) {
+			return -1;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Compress_d without division: round(x * 2^d / q) for 0 <= x < q, as
+ * ((x << d) + q/2) * round(2^k / q) >> k.
+ */
+static void poly_compress10(unsigned char *out, const int16_t a[MLKEM_N])
+{
+	int i, j;
+
+	for (i = 0; i < MLKEM_N / 4; i++, out += 5) {
+		uint16_t t[4];
+
+		for (j = 0; j < 4; j++) {
+			uint64_t d = (uint64_t)freeze(a[4 * i + j]) << 10;
+
+			t[j] = (uint16_t)((((d + 1665) * 1290167) >> 32) & 0x3ff);
+		}
+		out[0] = (unsigned char)t[0];
+		out[1] = (unsigned char)((t[0] >> 8) | (t[1] << 2));
+		out[2] = (unsigned char)((t[1] >> 6) | (t[2] << 4));
+		out[3] = (unsigned char)((t[2] >> 4) | (t[3] << 6));
+		out[4] = (unsigned char)(t[3] >> 2);
+	}
+}
+
+static void poly_compress4(unsigned char *out, const int16_t a[MLKEM_N])
+{
+	int i;
+
+	for (i = 0; i < MLKEM_N / 2; i++) {
+		uint32_t t0 = ((((uint32_t)freeze(a[2 * i]) << 4) + 1665) * 80635) >> 28;
+		uint32_t t1 = ((((uint32_t)freeze(a[2 * i + 1]) << 4) + 1665) * 80635) >> 28;
+
+		out[i] = (unsigned char)((t0 & 15) | ((t1 & 15) << 4));
+	}
+}
+
+static void poly_decompress10(int16_t r[MLKEM_N], const unsigned char *in)
+{
+	int i, j;
+
+	for (i = 0; i < MLKEM_N / 4; i++, in += 5) {
+		uint16_t t[4];
+
+		t[0] = (uint16_t)(in[0] | (in[1] << 8));
+		t[1] = (uint16_t)((in[1] >> 2) | (in[2] << 6));
+		t[2] = (uint16_t)((in[2] >> 4) | (in[3] << 4));
+		t[3] = (uint16_t)((in[3] >> 6) | (in[4] << 2));
+		for (j = 0; j < 4; j++) {
+			r[4 * i + j] = (int16_t)(((uint32_t)(t[j] & 0x3ff) * MLKEM_Q + 512) >> 10);
+		}
+	}
+}
+
+/* r = Decompress4(in) - a */
+static void poly_decompress4_sub(int16_t r[MLKEM_N], const unsigned char *in)
+{
+	int i;
+
+	for (i = 0; i < MLKEM_N / 2; i++) {
+		r[2 * i] = (int16_t)((((in[i] & 15) * MLKEM_Q + 8) >> 4) - r[2 * i]);
+		r[2 * i + 1] = (int16_t)((((in[i] >> 4) * MLKEM_Q + 8) >> 4) - r[2 * i + 1]);
+	}
+}
+
+/* r += Decompress1(m): bit set -> (q+1)/2 */
+static void poly_add_msg(int16_t r[MLKEM_N], const unsigned char m[32])
+{
+	int i;
+
+	for (i = 0; i < MLKEM_N; i++) {
+		int16_t mask = (int16_t)-(int16_t)((m[i / 8] >> (i % 8)) & 1);
+
+		r[i] = (int16_t)(r[i] + (mask & ((MLKEM_Q + 1) / 2)));
+	}
+}
+
+/* ByteEncode1(Compress1(a)) */
+static void poly_tomsg(unsigned char m[32], const int16_t a[MLKEM_N])
+{
+	int i;
+
+	memset(m, 0, 32);
+	for (i = 0; i < MLKEM_N; i++) {
+		uint32_t t = ((((uint32_t)freeze(a[i]) << 1) + 1665) * 80635) >> 28;
+
+		m[i / 8] |= (unsigned char)((t & 1) << (i % 8));
+	}
+}
+
+/* ------------------------------------------------------------------ */
+/*  K-PKE                                                             */
+/* ------------------------------------------------------------------ */
+
+/* K-PKE.Encrypt(pk, m, coins) */
+static void indcpa_enc(unsigned char c[CT_BYTES], const unsigned char *pk,
+	const unsigned char m[32], const unsigned char coins[SEED_BYTES])
+{
+	const unsigned char *rho = pk + MLKEM_K * POLY_BYTES;
+	int16_t y[MLKEM_K][MLKEM_N], acc[MLKEM_N];
+	int i, j;
+
+	for (j = 0; j < MLKEM_K; j++) {
+		poly_noise(y[j], coins, (unsigned char)j, 0);
+		poly_ntt(y[j]);
+	}
+
+	/* u_i = NTT^-1(sum_j A[j][i] y_j) + e1_i */
+	for (i = 0; i < MLKEM_K; i++) {
+		memset(acc, 0, sizeof(acc));
+		for (j = 0; j < MLKEM_K; j++) {
+			matrix_mul_acc(acc, rho, (unsigned char)i, (unsigned char)j, y[j]);
+		}
+		poly_reduce(acc);
+		poly_invntt_tomont(acc);
+		poly_noise(acc, coins, (unsigned char)(MLKEM_K + i), 1);
+		poly_reduce(acc);
+		poly_compress10(c + i * U_BYTES, acc);
+	}
+
+	/* v = NTT^-1(sum_j t_j y_j) + e2 + Decompress1(m) */
+	memset(acc, 0, sizeof(acc));
+	for (j = 0; j < MLKEM_K; j++) {
+		packed_mul_acc(acc, pk + j * POLY_BYTES, y[j]);
+	}
+	poly_reduce(acc);
+	poly_invntt_tomont(acc);
+	poly_noise(acc, coins, 2 * MLKEM_K, 1);
+	poly_add_msg(acc, m);
+	poly_reduce(acc);
+	poly_compress4(c + MLKEM_K * U_BYTES, acc);
+
+	m_burn(y, sizeof(y));
+	m_burn(acc, sizeof(acc));
+}
+
+/* K-PKE.Decrypt(sk, c) */
+static void indcpa_dec(unsigned char m[32], const unsigned char *sk,
+	const unsigned char *c)
+{
+	int16_t u[MLKEM_N], acc[MLKEM_N];
+	int j;
+
+	/* w = Decompress4(c2) - NTT^-1(sum_j s_j NTT(Decompress10(c1_j))) */
+	memset(acc, 0, sizeof(acc));
+	for (j = 0; j < MLKEM_K; j++) {
+		poly_decompress10(u, c + j * U_BYTES);
+		poly_ntt(u);
+		packed_mul_acc(acc, sk + j * POLY_BYTES, u);
+	}
+	poly_reduce(acc);
+	poly_invntt_tomont(acc);
+	poly_decompress4_sub(acc, c + MLKEM_K * U_BYTES);
+	poly_reduce(acc);
+	poly_tomsg(m, acc);
+
+	m_burn(acc, sizeof(acc));
+}
+
+/* ------------------------------------------------------------------ */
+/*  KEM                                                               */
+/* ------------------------------------------------------------------ */
+
+int crypto_kem_mlkem768_keypair(unsigned char *pk, unsigned char *sk)
+{
+	unsigned char dk[SEED_BYTES + 1], seeds[64];
+	const unsigned char *rho = seeds, *sigma = seeds + SEED_BYTES;
+	int16_t s[MLKEM_K][MLKEM_N], acc[MLKEM_N], e[MLKEM_N];
+	int i, j;
+
+	/* (rho, sigma) = G(d || k) */
+	genrandom(dk, SEED_BYTES);
+	dk[SEED_BYTES] = MLKEM_K;
+	hash_g(seeds, dk, sizeof(dk), NULL, 0);
+
+	for (j = 0; j < MLKEM_K; j++) {
+		poly_noise(s[j], sigma, (unsigned char)j, 0);
+		poly_ntt(s[j]);
+		poly_tobytes(sk + j * POLY_BYTES, s[j]);
+	}
+
+	/* t_i = sum_j A[i][j] s_j + e_i, in the NTT domain */
+	for (i = 0; i < MLKEM_K; i++) {
+		memset(acc, 0, sizeof(acc));
+		for (j = 0; j < MLKEM_K; j++) {
+			matrix_mul_acc(acc, rho, (unsigned char)j, (unsigned char)i, s[j]);
+		}
+		for (j = 0; j < MLKEM_N; j++) {
+			acc[j] = fqmul(acc[j], 1353);   /* 2^32 mod q: back to plain */
+		}
+		poly_noise(e, sigma, (unsigned char)(MLKEM_K + i), 0);
+		poly_ntt(e);
+		for (j = 0; j < MLKEM_N; j++) {
+			acc[j] = barrett_reduce((int16_t)(acc[j] + e[j]));
+		}
+		poly_tobytes(pk + i * POLY_BYTES, acc);
+	}
+	memcpy(pk + MLKEM_K * POLY_BYTES, rho, SEED_BYTES);
+
+	/* sk: s, pk, H(pk), z */
+	memcpy(sk + SK_PKE_BYTES, pk, PK_BYTES);
+	hash_h(sk + SK_PKE_BYTES + PK_BYTES, pk, PK_BYTES);
+	genrandom(sk + SK_PKE_BYTES + PK_BYTES + SEED_BYTES, SEED_BYTES);
+
+	m_burn(dk, sizeof(dk));
+	m_burn(seeds, sizeof(seeds));
+	m_burn(s, sizeof(s));
+	m_burn(acc, sizeof(acc));
+	m_burn(e, sizeof(e));
+	return 0;
+}
+
+int crypto_kem_mlkem768_enc(unsigned char *c, unsigned char *k, const unsigned char *pk)
+{
+	unsigned char m[32], h[32], kr[64];
+
+	if (pk_check(pk) != 0) {
+		return -1;
+	}
+
+	/* (K, r) = G(m || H(pk)) */
+	genrandom(m, sizeof(m));
+	hash_h(h, pk, PK_BYTES);
+	hash_g(kr, m, sizeof(m), h, sizeof(h));
+	indcpa_enc(c, pk, m, kr + 32);
+	memcpy(k, kr, 32);
+
+	m_burn(m, sizeof(m));
+	m_burn(kr, sizeof(kr));
+	return 0;
+}
+
+int crypto_kem_mlkem768_dec(unsigned char *k, const unsigned char *c, const unsigned char *sk)
+{
+	const unsigned char *pk = sk + SK_PKE_BYTES;
+	const unsigned char *hpk = pk + PK_BYTES;
+	const unsigned char *z = hpk + SEED_BYTES;
+	unsigned char m[32], kr[64], kbar[32], cnew[CT_BYTES], h[32];
+	keccak_state ks;
+	unsigned char diff = 0;
+	int i;
+
+	/* FIPS 203 hash check of the stored public key */
+	hash_h(h, pk, PK_BYTES);
+	if (memcmp(h, hpk, sizeof(h)) != 0) {
+		return -1;
+	}
+
+	indcpa_dec(m, sk, c);
+	hash_g(kr, m, sizeof(m), hpk, SEED_BYTES);
+	indcpa_enc(cnew, pk, m, kr + 32);
+
+	/* implicit rejection: K' if c re-encrypts, else J(z || c) */
+	keccak_init(&ks, SHAKE256_RATE);
+	keccak_absorb(&ks, z, SEED_BYTES);
+	keccak_absorb(&ks, c, CT_BYTES);
+	keccak_finish(&ks, 0x1f);
+	keccak_squeeze(&ks, kbar, sizeof(kbar));
+
+	for (i = 0; i < CT_BYTES; i++) {
+		diff |= c[i] ^ cnew[i];
+	}
+	/* 0xff if they differ */
+	diff = (unsigned char)(((unsigned int)diff + 0xff) >> 8);
+	diff = (unsigned char)-diff;
+	for (i = 0; i < 32; i++) {
+		k[i] = (unsigned char)(kr[i] ^ (diff & (kr[i] ^ kbar[i])));
+	}
+
+	m_burn(m, sizeof(m));
+	m_burn(kr, sizeof(kr));
+	m_burn(kbar, sizeof(kbar));
+	m_burn(cnew, sizeof(cnew));
+	m_burn(&ks, sizeof(ks));
+	return 0;
+}
+
+#endif /* DROPBEAR_MLKEM768 */
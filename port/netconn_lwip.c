@@ -0,0 +1,294 @@
+/*
+ * netconn_lwip.c - writev() on the session's netconn, without a copy.
+ *
+ * Replaces writev_lwip.c with CONFIG_DROPBEAR_NETCONN_NOCOPY. Dropbear only
+ * calls writev() from write_packet(), with the encrypted packets of its
+ * write queue. They go to netconn_write_vectors_partly() as lwip_writev()
+ * sends them, but with NETCONN_NOCOPY instead of NETCONN_COPY: lwIP's send
+ * queue points into the packet buffers instead of holding a copy of them.
+ *
+ * lwIP reads those bytes again for every retransmission, so a buffer must
+ * stay allocated until the client has acked all of it. Each write records a
+ * pin per vector: the first byte handed to lwIP and the sequence number
+ * after the last. The component links with -Wl,--wrap=buf_free, and
+ * buf_free() of a buffer with unacked pins leaves it with its last pin.
+ * Pins are checked against the connection's lastack after every writev()
+ * and freed, with their buffers, once acked. netconn_lwip_close() waits for
+ * the last acks when the session ends.
+ *
+ * Pins belong to the session task that wrote them. writev() and buf_free()
+ * run with the session pool's lock held, so claiming an entry is not racy;
+ * netconn_lwip_close() only touches its own task's entry.
+ *
+ * A write that finds no room for its pins is copied, as by lwip_writev().
+ * Anything that is not an lwIP socket gets one write() per buffer.
+ */
+
+#include <errno.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include "includes.h"
+#include "buffer.h"
+#include "sdkconfig.h"
+#include "lwip/api.h"
+#include "lwip/tcp.h"
+#include "lwip/priv/sockets_priv.h"
+#include "lwip/priv/tcpip_priv.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "netconn_lwip.h"
+#include "writev_lwip.h"
+
+#if LWIP_NETIF_TX_SINGLE_PBUF
+#warning "tcp_write() copies anyway with LWIP_NETIF_TX_SINGLE_PBUF; CONFIG_DROPBEAR_NETCONN_NOCOPY only holds buffers longer"
+#endif
+
+#define NETCONN_VECTORS        16      /* per call, as IOV_MAX in port/config.h */
+#define NETCONN_PINS           32      /* unacked writes per connection */
+#define NETCONN_CLOSE_WAIT_MS  2000    /* for the last acks at session end */
+#define NETCONN_CLOSE_POLL_MS  10
+
+struct pin {
+	const unsigned char *data;      /* first byte handed to lwIP        */
+	u32_t end;                      /* sequence number after the last   */
+	buffer *buf;                    /* freed with this pin, or NULL     */
+};
+
+struct pinned_conn {
+	TaskHandle_t owner;             /* session task, NULL if unused     */
+	int fd;
+	struct netconn *conn;
+	unsigned int count;
+	struct pin pins[NETCONN_PINS];  /* in sequence order                */
+};
+
+/* TCP/IP task call: where the send queue ends, what is acked */
+struct seq_call {
+	struct tcpip_api_call_data call;
+	struct netconn *conn;
+	int reset;                      /* abort the connection instead     */
+	int open;                       /* the netconn still has its pcb    */
+	u32_t lbb;
+	u32_t lastack;
+};
+
+void __real_buf_free(buffer *buf);
+
+static struct pinned_conn conns[CONFIG_DROPBEAR_MAX_SESSIONS];
+static unsigned long writev_calls, writev_buffers;
+static unsigned long nocopy_bytes, copied_bytes, close_resets;
+
+static ssize_t writev_plain(int fd, const struct iovec *iov, int iovcnt)
+{
+	ssize_t total = 0;
+	int i;
+
+	for (i = 0; i < iovcnt; i++) {
+		ssize_t n = write(fd, iov[i].iov_base, iov[i].iov_len);
+
+		if (n < 0) {
+			return total > 0 ? total : n;
+		}
+		total += n;
+		if ((size_t)n < iov[i].iov_len) {
+			break;
+		}
+	}
+	return total;
+}
+
+static err_t seq_read(struct tcpip_api_call_data *call)
+{
+	struct seq_call *msg = (struct seq_call *)call;
+	struct tcp_pcb *pcb = msg->conn->pcb.tcp;
+
+	msg->open = pcb != NULL && !msg->reset;
+	msg->lbb = msg->lastack = 0;
+	if (pcb != NULL && msg->reset) {
+		/* as a reset from the peer: err_tcp() detaches the netconn */
+		tcp_abort(pcb);
+	} else if (pcb != NULL) {
+		msg->lbb = pcb->snd_lbb;
+		msg->lastack = pcb->lastack;
+	}
+	return ERR_OK;
+}
+
+static void seq_get(struct pinned_conn *pc, struct seq_call *msg, int reset)
+{
+	msg->conn = pc->conn;
+	msg->reset = reset;
+	tcpip_api_call(seq_read, &msg->call);
+}
+
+/* Frees the pins the client has acked; all of them once the pcb is gone. */
+static void pins_release(struct pinned_conn *pc, const struct seq_call *msg)
+{
+	unsigned int n;
+
+	for (n = 0; n < pc->count; n++) {
+		if (msg->open && (s32_t)(msg->lastack - pc->pins[n].end) < 0) {
+			break;
+		}
+		if (pc->pins[n].buf != NULL) {
+			__real_buf_free(pc->pins[n].buf);
+		}
+	}
+	pc->count -= n;
+	memmove(pc->pins, pc->pins + n, pc->count * sizeof(pc->pins[0]));
+}
+
+static struct pinned_conn *pinned_find(TaskHandle_t owner)
+{
+	unsigned int i;
+
+	for (i = 0; i < CONFIG_DROPBEAR_MAX_SESSIONS; i++) {
+		if (conns[i].owner == owner) {
+			return &conns[i];
+		}
+	}
+	return NULL;
+}
+
+/* The calling task's entry for fd, claimed on its first write. */
+static struct pinned_conn *pinned_get(int fd, struct netconn *conn)
+{
+	TaskHandle_t self = xTaskGetCurrentTaskHandle();
+	struct pinned_conn *pc = pinned_find(self);
+
+	if (pc == NULL && (pc = pinned_find(NULL)) != NULL) {
+		pc->count = 0;
+		pc->owner = self;
+	}
+	if (pc != NULL && pc->conn != conn) {
+		if (pc->count > 0) {
+			/* an earlier connection of this task still waits for acks */
+			return NULL;
+		}
+		pc->fd = fd;
+		pc->conn = conn;
+	}
+	return pc;
+}
+
+ssize_t __wrap_writev(int fd, const struct iovec *iov, int iovcnt)
+{
+	struct netvector vec[NETCONN_VECTORS];
+	struct pinned_conn *pc;
+	struct lwip_sock *sock;
+	struct seq_call msg;
+	size_t written = 0, off = 0;
+	u8_t flags = NETCONN_COPY;
+	err_t err;
+	int i;
+
+	writev_calls++;
+	writev_buffers += iovcnt;
+
+	sock = lwip_socket_dbg_get_socket(fd);
+	if (sock == NULL || sock->conn == NULL) {
+		return writev_plain(fd, iov, iovcnt);
+	}
+
+	iovcnt = MIN(iovcnt, NETCONN_VECTORS);
+	for (i = 0; i < iovcnt; i++) {
+		vec[i].ptr = iov[i].iov_base;
+		vec[i].len = iov[i].iov_len;
+	}
+	pc = pinned_get(fd, sock->conn);
+	if (pc != NULL && pc->count + (unsigned int)iovcnt > NETCONN_PINS) {
+		/* make room with what has been acked since the last write */
+		seq_get(pc, &msg, 0);
+		pins_release(pc, &msg);
+	}
+	if (pc != NULL && pc->count + (unsigned int)iovcnt <= NETCONN_PINS) {
+		flags = NETCONN_NOCOPY;
+	}
+	err = netconn_write_vectors_partly(sock->conn, vec, (u16_t)iovcnt,
+		flags | NETCONN_DONTBLOCK, &written);
+
+	if (pc != NULL && (pc->count > 0 || (flags == NETCONN_NOCOPY && written > 0))) {
+		seq_get(pc, &msg, 0);
+		for (i = 0; flags == NETCONN_NOCOPY && i < iovcnt && off < written; i++) {
+			off += vec[i].len;
+			pc->pins[pc->count].data = vec[i].ptr;
+			pc->pins[pc->count].end = msg.lbb - (u32_t)(written - MIN(off, written));
+			pc->pins[pc->count].buf = NULL;
+			pc->count++;
+		}
+		pins_release(pc, &msg);
+	}
+
+	if (flags == NETCONN_NOCOPY) {
+		nocopy_bytes += written;
+	} else {
+		copied_bytes += written;
+	}
+	if (err != ERR_OK && written == 0) {
+		errno = err_to_errno(err);
+		return -1;
+	}
+	return (ssize_t)written;
+}
+
+void __wrap_buf_free(buffer *buf)
+{
+	struct pinned_conn *pc = NULL;
+	struct pin *last = NULL;
+	unsigned int i;
+
+	if (buf != NULL) {
+		pc = pinned_find(xTaskGetCurrentTaskHandle());
+	}
+	for (i = 0; pc != NULL && i < pc->count; i++) {
+		if (pc->pins[i].data >= buf->data && pc->pins[i].data < buf->data + buf->size) {
+			last = &pc->pins[i];
+		}
+	}
+	if (last != NULL) {
+		last->buf = buf;
+		return;
+	}
+	__real_buf_free(buf);
+}
+
+void netconn_lwip_close(int fd)
+{
+	struct pinned_conn *pc = pinned_find(xTaskGetCurrentTaskHandle());
+	struct seq_call msg;
+	unsigned int polls = 0;
+
+	if (pc == NULL || pc->fd != fd) {
+		return;
+	}
+	for (;;) {
+		seq_get(pc, &msg, 0);
+		pins_release(pc, &msg);
+		if (pc->count == 0 || polls++ == NETCONN_CLOSE_WAIT_MS / NETCONN_CLOSE_POLL_MS) {
+			break;
+		}
+		vTaskDelay(pdMS_TO_TICKS(NETCONN_CLOSE_POLL_MS));
+	}
+	if (pc->count > 0) {
+		/* never acked: lwIP drops its references with the pcb */
+		seq_get(pc, &msg, 1);
+		pins_release(pc, &msg);
+		close_resets++;
+	}
+	pc->conn = NULL;
+	pc->fd = -1;
+	pc->owner = NULL;
+}
+
+void writev_get_stats(unsigned long *calls, unsigned long *buffers)
+{
+	*calls = writev_calls;
+	*buffers = writev_buffers;
+}
+
+void netconn_lwip_get_stats(unsigned long *nocopy, unsigned long *copied, unsigned long *resets)
+{
+	*nocopy = nocopy_bytes;
+	*copied = copied_bytes;
+	*resets = close_resets;
+}
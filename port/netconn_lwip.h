@@ -0,0 +1,20 @@
+#pragma once
+
+/*
+ * netconn_lwip - writev() without the send-buffer copy.
+ *
+ * With CONFIG_DROPBEAR_NETCONN_NOCOPY, port/netconn_lwip.c replaces
+ * port/writev_lwip.c: packets are written with NETCONN_NOCOPY and their
+ * buffers are kept, past Dropbear's buf_free(), until the client acks them.
+ * The component then also links with -Wl,--wrap=buf_free.
+ */
+
+/*
+ * Called by the session task before it closes fd: waits up to 2 s for the
+ * client to ack what is still held, then resets the connection if needed,
+ * and frees the held buffers.
+ */
+void netconn_lwip_close(int fd);
+
+/* Bytes written without and with a copy, and connections reset at close. */
+void netconn_lwip_get_stats(unsigned long *nocopy, unsigned long *copied, unsigned long *resets);
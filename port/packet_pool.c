@@ -0,0 +1,41 @@
+/*
+ * packet_pool.c - Packet buffers from the session arena's size-class pool.
+ *
+ * Dropbear allocates a new buffer with buf_new() for every packet it reads,
+ * decrypts, encrypts or queues, and frees it again once it has been
+ * processed or written. The component links with -Wl,--wrap=buf_new, so
+ * those calls land here and take a recycled block from the calling task's
+ * arena (see session_arena_pool_alloc()). Freeing needs no hook: buf_free()
+ * is m_free(), which already reaches session_arena_free(), and buf_resize()
+ * is m_realloc().
+ *
+ * A recycled block still holds the previous packet, which may be plaintext
+ * or key material, so it is zeroed like an m_malloc() block before it is
+ * handed out.
+ */
+
+#include "includes.h"
+#include "dbutil.h"
+#include "buffer.h"
+#include "dbmalloc_arena.h"
+
+buffer *__real_buf_new(unsigned int size);
+
+buffer *__wrap_buf_new(unsigned int size)
+{
+	buffer *buf;
+
+	if (size > BUF_MAX_SIZE) {
+		dropbear_exit("buf->size too big");
+	}
+
+	buf = session_arena_pool_alloc(sizeof(buffer) + size);
+	if (buf == NULL) {
+		return __real_buf_new(size);
+	}
+
+	memset(buf, 0, sizeof(buffer) + size);
+	buf->data = (unsigned char *)buf + sizeof(buffer);
+	buf->size = size;
+	return buf;
+}
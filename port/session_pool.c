@@ -0,0 +1,431 @@
+/*
+ * session_pool.c - Concurrent Dropbear server sessions on FreeRTOS.
+ *
+ * Each session task runs svr_session() for one connection at a time. Only
+ * one task executes Dropbear code at any moment (pool.lock); the lock is
+ * dropped while a task waits in select(), which is where Dropbear's session
+ * loop spends its idle time. The task that takes the lock next saves the
+ * previous owner's `ses`/`svr_ses` into that owner's slot and installs its
+ * own, so Dropbear never notices it is sharing the process.
+ *
+ * The component links with -Wl,--wrap=select so that Dropbear's select()
+ * calls land in __wrap_select() below.
+ *
+ * The same wrapper is where sessions are supervised. It caps the select()
+ * timeout at check_secs, so even an idle session task wakes up that often.
+ * With the lock taken back, the slots' saved `ses` copies tell how long
+ * each session has been idle. If free heap is below evict_below, the
+ * longest-idle session is marked, and it disconnects itself the next time
+ * its own task wakes.
+ */
+
+#include "includes.h"
+#include "session.h"
+#include "dbutil.h"
+#include "dbrandom.h"
+#include "packet.h"
+#include "buffer.h"
+#include "ssh.h"
+#include "session_pool.h"
+#include "sdkconfig.h"
+#if CONFIG_DROPBEAR_SESSION_ARENA
+#include "dbmalloc_arena.h"
+#endif
+#if CONFIG_DROPBEAR_HMAC_CACHE
+#include "hmac_cache.h"
+#endif
+#if CONFIG_DROPBEAR_GCM_GHASH_TABLE
+#include "ghash_table.h"
+#endif
+#if CONFIG_DROPBEAR_NETCONN_NOCOPY
+#include "netconn_lwip.h"
+#endif
+
+#include <setjmp.h>
+
+#include "esp_system.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+
+struct pool_slot {
+	TaskHandle_t task;
+	int sock;                       /* -1 while idle                    */
+	int exiting;                    /* inside pool_dropbear_exit()      */
+	int running;                    /* inside svr_session()             */
+	int evict;                      /* disconnect at the next wakeup    */
+	time_t started;                 /* monotonic_now() at start         */
+	struct sockaddr_storage peer;   /* AF_UNSPEC if unknown             */
+	int authenticated;              /* how the last session ended       */
+	unsigned int auth_failures;
+	jmp_buf exit_jmp;               /* where dropbear_exit() unwinds to */
+#if CONFIG_DROPBEAR_SESSION_ARENA
+	session_arena_t *arena;         /* backs every m_malloc() of a session */
+#endif
+	/* session globals, saved while another task owns the lock */
+	struct sshsession ses;
+	struct serversession svr_ses;
+};
+
+static struct {
+	SemaphoreHandle_t lock;         /* serialises all Dropbear code     */
+	SemaphoreHandle_t idle;         /* counts idle session tasks        */
+	QueueHandle_t pending;          /* accepted sockets awaiting a task */
+	struct pool_slot *slots;
+	struct pool_slot *owner;        /* whose state is in the globals    */
+	unsigned int max_sessions;
+	size_t evict_below;
+	unsigned int check_secs;
+	void (*closed)(const struct sockaddr_storage *peer, int authenticated,
+		unsigned int auth_failures);
+	time_t checked;                 /* last free heap check             */
+	session_pool_stats_t stats;
+} pool;
+
+#ifndef SSH_DISCONNECT_BY_APPLICATION
+#define SSH_DISCONNECT_BY_APPLICATION 11
+#endif
+
+/* Slot served by the calling task, NULL for any other task. */
+static __thread struct pool_slot *cur_slot;
+
+int __real_select(int nfds, fd_set *readfds, fd_set *writefds,
+	fd_set *exceptfds, struct timeval *timeout);
+
+/* ------------------------------------------------------------------ */
+/*  Session state switching                                           */
+/* ------------------------------------------------------------------ */
+
+/* Called with pool.lock held: make `slot` the owner of the globals. */
+static void pool_switch_to(struct pool_slot *slot, int fresh)
+{
+	struct pool_slot *prev = pool.owner;
+
+	if (prev != NULL && prev != slot) {
+		memcpy(&prev->ses, &ses, sizeof(ses));
+		memcpy(&prev->svr_ses, &svr_ses, sizeof(svr_ses));
+	}
+
+	if (fresh) {
+		memset(&ses, 0, sizeof(ses));
+		memset(&svr_ses, 0, sizeof(svr_ses));
+	} else if (prev != slot) {
+		memcpy(&ses, &slot->ses, sizeof(ses));
+		memcpy(&svr_ses, &slot->svr_ses, sizeof(svr_ses));
+	}
+
+	pool.owner = slot;
+}
+
+void session_pool_leave(void)
+{
+	if (cur_slot != NULL) {
+		xSemaphoreGive(pool.lock);
+	}
+}
+
+void session_pool_enter(void)
+{
+	struct pool_slot *slot = cur_slot;
+
+	if (slot != NULL) {
+		xSemaphoreTake(pool.lock, portMAX_DELAY);
+		pool_switch_to(slot, 0);
+	}
+}
+
+/* ------------------------------------------------------------------ */
+/*  Supervision                                                       */
+/* ------------------------------------------------------------------ */
+
+/*
+ * Called with pool.lock held, in the globals' owner: say goodbye and unwind.
+ * Between packets here, so writepayload is free.
+ */
+static void pool_evict(void) ATTRIB_NORETURN;
+static void pool_evict(void)
+{
+	pool.stats.evicted++;
+
+	buf_putbyte(ses.writepayload, SSH_MSG_DISCONNECT);
+	buf_putint(ses.writepayload, SSH_DISCONNECT_BY_APPLICATION);
+	buf_putstring(ses.writepayload, "Server low on memory", 20);
+	buf_putstring(ses.writepayload, "", 0);
+	encrypt_packet();
+	/* one non-blocking try; the socket is closed right after anyway */
+	if (!isempty(&ses.writequeue)) {
+		write_packet();
+	}
+	dropbear_exit("Evicted, free heap low");
+}
+
+/* Called with pool.lock held, in `self`'s task, with its session in the globals. */
+static void pool_supervise(struct pool_slot *self)
+{
+	struct pool_slot *victim = NULL;
+	time_t now = monotonic_now();
+	time_t victim_last = 0;
+	size_t free_heap;
+	unsigned int i;
+
+	if (self->evict) {
+		pool_evict();
+	}
+	if (now - pool.checked < (time_t)pool.check_secs) {
+		return;
+	}
+	pool.checked = now;
+
+	free_heap = esp_get_free_heap_size();
+	if (pool.stats.min_free_heap == 0 || free_heap < pool.stats.min_free_heap) {
+		pool.stats.min_free_heap = free_heap;
+	}
+	if (free_heap >= pool.evict_below) {
+		return;
+	}
+
+	for (i = 0; i < pool.max_sessions; i++) {
+		struct pool_slot *slot = &pool.slots[i];
+		time_t last;
+
+		if (!slot->running) {
+			continue;
+		}
+		if (slot->evict) {
+			/* one at a time: its memory is not back yet */
+			return;
+		}
+		last = slot == self ? ses.last_packet_time_idle : slot->ses.last_packet_time_idle;
+		last = MAX(last, slot->started);
+		if (victim == NULL || last < victim_last) {
+			victim = slot;
+			victim_last = last;
+		}
+	}
+	if (victim == NULL) {
+		return;
+	}
+
+	dropbear_log(LOG_WARNING, "Free heap %u below %u, evicting a session idle for %ld s",
+		(unsigned)free_heap, (unsigned)pool.evict_below, (long)(now - victim_last));
+	victim->evict = 1;
+	if (victim == self) {
+		pool_evict();
+	}
+}
+
+int __wrap_select(int nfds, fd_set *readfds, fd_set *writefds,
+	fd_set *exceptfds, struct timeval *timeout)
+{
+	struct timeval check;
+	int ret, saved_errno;
+
+	if (cur_slot == NULL) {
+		return __real_select(nfds, readfds, writefds, exceptfds, timeout);
+	}
+
+	if (pool.check_secs > 0 && (timeout == NULL || timeout->tv_sec >= (time_t)pool.check_secs)) {
+		check.tv_sec = pool.check_secs;
+		check.tv_usec = 0;
+		timeout = &check;
+	}
+
+	session_pool_leave();
+	ret = __real_select(nfds, readfds, writefds, exceptfds, timeout);
+	saved_errno = errno;
+	session_pool_enter();
+	if (pool.check_secs > 0) {
+		pool_supervise(cur_slot);
+	}
+	errno = saved_errno;
+
+	return ret;
+}
+
+/* ------------------------------------------------------------------ */
+/*  Exit handling                                                     */
+/* ------------------------------------------------------------------ */
+
+/*
+ * Replacement for svr_dropbear_exit() inside session tasks: log like the
+ * stock handler, free the session and unwind to session_task().
+ */
+static void pool_dropbear_exit(int exitcode, const char *format, va_list param)
+	ATTRIB_NORETURN;
+static void pool_dropbear_exit(int exitcode, const char *format, va_list param)
+{
+	struct pool_slot *slot = cur_slot;
+	char exitmsg[150];
+	const char *addr;
+
+	if (slot == NULL) {
+		svr_dropbear_exit(exitcode, format, param);
+	}
+
+	if (!slot->exiting) {
+		slot->exiting = 1;
+
+		vsnprintf(exitmsg, sizeof(exitmsg), format, param);
+		slot->authenticated = ses.authstate.authdone;
+		slot->auth_failures = ses.authstate.failcount;
+		/* as worded by checktimeouts() in common-session.c */
+		if (strcmp(exitmsg, "Keepalive timeout") == 0) {
+			pool.stats.keepalive_timeouts++;
+		} else if (strcmp(exitmsg, "Idle timeout") == 0) {
+			pool.stats.idle_timeouts++;
+		}
+		addr = svr_ses.addrstring ? svr_ses.addrstring : "?";
+		if (ses.authstate.authdone) {
+			dropbear_log(LOG_INFO, "Exit (%s) from <%s>: %s",
+				ses.authstate.pw_name, addr, exitmsg);
+		} else {
+			dropbear_log(LOG_INFO, "Exit before auth from <%s>: %s",
+				addr, exitmsg);
+		}
+
+		session_cleanup();
+	}
+
+	longjmp(slot->exit_jmp, 1);
+}
+
+/* ------------------------------------------------------------------ */
+/*  Session tasks                                                     */
+/* ------------------------------------------------------------------ */
+
+static void session_task(void *arg)
+{
+	struct pool_slot *slot = (struct pool_slot *)arg;
+	socklen_t peerlen;
+	int sock;
+
+	cur_slot = slot;
+#if CONFIG_DROPBEAR_SESSION_ARENA
+	session_arena_attach(slot->arena);
+#endif
+
+	for (;;) {
+		xQueueReceive(pool.pending, &sock, portMAX_DELAY);
+		slot->sock = sock;
+		slot->exiting = 0;
+		peerlen = sizeof(slot->peer);
+		if (getpeername(sock, (struct sockaddr *)&slot->peer, &peerlen) != 0) {
+			slot->peer.ss_family = AF_UNSPEC;
+		}
+
+		xSemaphoreTake(pool.lock, portMAX_DELAY);
+		pool_switch_to(slot, 1);
+		slot->running = 1;
+		slot->evict = 0;
+		slot->started = monotonic_now();
+
+		if (setjmp(slot->exit_jmp) == 0) {
+			seedrandom();
+			/* Only returns through dropbear_exit() */
+			svr_session(slot->sock, -1);
+		}
+
+		/* Still holding the lock here; our globals are now stale. */
+		pool.owner = NULL;
+		slot->running = 0;
+#if CONFIG_DROPBEAR_HMAC_CACHE
+		/* don't keep this session's MAC keys around; live sessions re-add theirs */
+		hmac_cache_clear();
+#endif
+#if CONFIG_DROPBEAR_GCM_GHASH_TABLE
+		ghash_table_clear();
+#endif
+		xSemaphoreGive(pool.lock);
+
+		if (pool.closed != NULL && slot->peer.ss_family != AF_UNSPEC) {
+			pool.closed(&slot->peer, slot->authenticated, slot->auth_failures);
+		}
+#if CONFIG_DROPBEAR_NETCONN_NOCOPY
+		/* lwIP may still point into packet buffers the arena reset frees */
+		netconn_lwip_close(slot->sock);
+#endif
+		close(slot->sock);
+		slot->sock = -1;
+#if CONFIG_DROPBEAR_SESSION_ARENA
+		/* whatever session_cleanup() left behind goes with the arena */
+		session_arena_reset(slot->arena);
+#endif
+		xSemaphoreGive(pool.idle);
+	}
+}
+
+/* task names: "ssh_sess" and the slot number, at most two digits */
+#define SESSION_TASK_NAME      "ssh_sess"
+#define SESSION_TASK_MAX       100
+
+_Static_assert(sizeof(SESSION_TASK_NAME) + 2 <= configMAX_TASK_NAME_LEN,
+	"session task names do not fit configMAX_TASK_NAME_LEN");
+
+int session_pool_init(const session_pool_config_t *config)
+{
+	unsigned int i;
+	char name[sizeof(SESSION_TASK_NAME) + 2];
+
+	if (config->max_sessions > SESSION_TASK_MAX) {
+		dropbear_exit("Too many sessions for the pool");
+	}
+	pool.max_sessions = config->max_sessions;
+	pool.evict_below = config->evict_below;
+	pool.check_secs = config->check_secs;
+	pool.closed = config->closed;
+	pool.lock = xSemaphoreCreateMutex();
+	pool.idle = xSemaphoreCreateCounting(config->max_sessions, config->max_sessions);
+	pool.pending = xQueueCreate(config->max_sessions, sizeof(int));
+	pool.slots = m_calloc(config->max_sessions, sizeof(struct pool_slot));
+	if (pool.lock == NULL || pool.idle == NULL || pool.pending == NULL) {
+		dropbear_exit("Failed to create session pool");
+	}
+
+	_dropbear_exit = pool_dropbear_exit;
+
+	for (i = 0; i < config->max_sessions; i++) {
+		struct pool_slot *slot = &pool.slots[i];
+
+		slot->sock = -1;
+#if CONFIG_DROPBEAR_SESSION_ARENA
+		slot->arena = session_arena_create(CONFIG_DROPBEAR_SESSION_ARENA_SIZE);
+		if (slot->arena == NULL) {
+			dropbear_exit("Failed to create session arena");
+		}
+#endif
+		snprintf(name, sizeof(name), SESSION_TASK_NAME "%u", i % SESSION_TASK_MAX);
+		if (xTaskCreate(session_task, name, config->stack_size, slot,
+				config->priority, &slot->task) != pdPASS) {
+			dropbear_exit("Failed to create session task");
+		}
+	}
+
+	dropbear_log(LOG_INFO, "Session pool: %u tasks, %u bytes stack each",
+		config->max_sessions, (unsigned)config->stack_size);
+	if (config->check_secs > 0 && config->evict_below > 0) {
+		dropbear_log(LOG_INFO, "Session pool: evicting below %u bytes free heap, checked every %u s",
+			(unsigned)config->evict_below, config->check_secs);
+	}
+	return DROPBEAR_SUCCESS;
+}
+
+int session_pool_submit(int sock)
+{
+	if (xSemaphoreTake(pool.idle, 0) != pdTRUE) {
+		return DROPBEAR_FAILURE;
+	}
+	xQueueSend(pool.pending, &sock, portMAX_DELAY);
+	return DROPBEAR_SUCCESS;
+}
+
+unsigned int session_pool_active(void)
+{
+	return pool.max_sessions - (unsigned int)uxSemaphoreGetCount(pool.idle);
+}
+
+void session_pool_get_stats(session_pool_stats_t *stats)
+{
+	*stats = pool.stats;
+}
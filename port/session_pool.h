@@ -0,0 +1,64 @@
+#pragma once
+
+/*
+ * session_pool - serve several SSH connections concurrently from a fixed
+ * set of FreeRTOS session tasks.
+ *
+ * Dropbear keeps all per-connection state in the globals `ses` and
+ * `svr_ses`. The pool runs Dropbear code under a single lock and swaps
+ * those globals whenever a session task blocks in select(), so every task
+ * sees its own session. dropbear_exit() unwinds back into the session task
+ * instead of terminating the program, and the task then waits for the next
+ * connection.
+ *
+ * Dropbear's own keepalive and idle timeouts (-K, -I) run in each session's
+ * loop. On top of those, the pool watches free heap: session tasks wake at
+ * least every check_secs, and while free heap is below evict_below, one
+ * session per check is closed with SSH_MSG_DISCONNECT. The victim is the
+ * one idle the longest, so sessions still in use go last.
+ */
+
+#include <stddef.h>
+#include <sys/socket.h>
+
+typedef struct {
+	unsigned int max_sessions;  /* number of session tasks              */
+	size_t stack_size;          /* stack of each session task, in bytes */
+	unsigned int priority;      /* FreeRTOS priority of session tasks   */
+	size_t evict_below;         /* free heap to evict below, 0: never   */
+	unsigned int check_secs;    /* longest wait between heap checks     */
+	/* A session ended, from its task with the lock released. May be NULL. */
+	void (*closed)(const struct sockaddr_storage *peer, int authenticated,
+		unsigned int auth_failures);
+} session_pool_config_t;
+
+typedef struct {
+	unsigned long evicted;              /* closed for low free heap     */
+	unsigned long keepalive_timeouts;   /* closed by Dropbear's -K      */
+	unsigned long idle_timeouts;        /* closed by Dropbear's -I      */
+	size_t min_free_heap;               /* lowest free heap at a check  */
+} session_pool_stats_t;
+
+/* Create the session tasks. Call once, after dropbear_setup(). */
+int session_pool_init(const session_pool_config_t *config);
+
+/*
+ * Hand an accepted socket to an idle session task. Returns
+ * DROPBEAR_FAILURE if all tasks are busy; the caller still owns the
+ * socket in that case.
+ */
+int session_pool_submit(int sock);
+
+/* Number of connections currently being served. */
+unsigned int session_pool_active(void);
+
+/* Why sessions were closed by the pool or its timeouts, since boot. */
+void session_pool_get_stats(session_pool_stats_t *stats);
+
+/*
+ * Release / re-acquire the Dropbear lock around a blocking call made from
+ * session code (select() is handled automatically). No-ops outside of a
+ * session task.
+ */
+void session_pool_leave(void);
+void session_pool_enter(void);
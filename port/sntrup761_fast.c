@@ -0,0 +1,834 @@
+/*
+ * sntrup761_fast.c - Replacement for Dropbear's sntrup761.c.
+ *
+ * Streamlined NTRU Prime 761 as specified for round 3 and used by
+ * sntrup761x25519-sha512: same key, ciphertext and session key bytes as
+ * the reference code, same interface (sntrup761.h).
+ *
+ * The server side of the key exchange is crypto_kem_sntrup761_enc() only:
+ * decode the client's public key, multiply it by a random short
+ * polynomial, round and encode. The reference code spends nearly all of
+ * that time in Rq_mult_small(), a 761x761 schoolbook product that reduces
+ * mod q after every term, and keeps ~14 KB of arrays on the stack for it
+ * and for the recursive encoder/decoder. Here:
+ *
+ *  - the product is still schoolbook, but each coefficient of it is summed
+ *    in a 32-bit register and reduced once (|sum| <= 3 * 761 * 2295), and
+ *    the ring reduction (x^761 = x + 1) is folded into that sum;
+ *  - reductions mod q and mod 3 multiply by a rounded reciprocal instead
+ *    of dividing;
+ *  - encoding and decoding work in place, with the per-level moduli kept
+ *    as scalars instead of arrays.
+ *
+ * Blocked Karatsuba was tried for the product: it cuts the multiplies by
+ * 43% but was slower than this schoolbook on the host, with or without
+ * auto-vectorization, for all its extra additions and loads.
+ *
+ * Key generation (two reciprocals) and decapsulation are only used by a
+ * client. The reciprocals run the reference's divsteps: in R/3 on
+ * bitsliced polynomials, 32 coefficients per word; in R/q with each step's
+ * swap and elimination in one pass. Everything that touches secret data
+ * runs in constant time: no secret-dependent branches, table indices or
+ * divisions.
+ */
+
+#include <sys/param.h>  /* MIN */
+
+#include "includes.h"
+#include "dbrandom.h"
+#include "dbutil.h"
+#include "sntrup761.h"
+
+#if DROPBEAR_SNTRUP761
+
+#define NTRU_P    761
+#define NTRU_Q    4591
+#define NTRU_W    286
+#define NTRU_Q12  ((NTRU_Q - 1) / 2)
+
+#define SMALL_BYTES    ((NTRU_P + 3) / 4)      /* 191 */
+#define RQ_BYTES       1158
+#define ROUNDED_BYTES  1007
+#define HASH_BYTES     32
+#define CT_BYTES       (ROUNDED_BYTES + HASH_BYTES)
+
+/* modulus of the rounded coefficients, (q + 2) / 3 */
+#define ROUNDED_M      1531
+
+typedef int8_t small;
+typedef int16_t Fq;
+
+/* ------------------------------------------------------------------ */
+/*  Constant-time arithmetic                                          */
+/* ------------------------------------------------------------------ */
+
+/* x = quot * m + rem, 0 < m < 16384, with no division by x */
+static void uint32_divmod_uint14(uint32_t *quot, uint16_t *rem, uint32_t x, uint16_t m)
+{
+	uint32_t v = 0x80000000u / m;
+	uint32_t qpart, mask;
+
+	qpart = (uint32_t)(((uint64_t)x * v) >> 31);
+	x -= qpart * m;
+	*quot = qpart;
+	/* x < 49147 */
+	qpart = (uint32_t)(((uint64_t)x * v) >> 31);
+	x -= qpart * m;
+	*quot += qpart;
+	/* x <= m */
+	x -= m;
+	*quot += 1;
+	mask = 0u - (x >> 31);
+	x += mask & (uint32_t)m;
+	*quot += mask;
+	*rem = (uint16_t)x;
+}
+
+static uint16_t uint32_mod_uint14(uint32_t x, uint16_t m)
+{
+	uint32_t quot;
+	uint16_t rem;
+
+	uint32_divmod_uint14(&quot, &rem, x, m);
+	return rem;
+}
+
+/*
+ * x mod q, centered, for |x| < 2^24: the reference divides, this
+ * multiplies by 2^18/q and then by 2^27/q, rounded. Every caller's input
+ * is a sum of at most 2 * 2295^2 in magnitude.
+ */
+static Fq Fq_freeze(int32_t x)
+{
+	x -= NTRU_Q * ((57 * x) >> 18);
+	x -= NTRU_Q * ((29235 * x + (1 << 26)) >> 27);
+	return (Fq)x;
+}
+
+/* x mod 3 in -1 .. 1, for |x| < 2^13 */
+static small F3_freeze(int32_t x)
+{
+	return (small)(x - 3 * ((10923 * x + (1 << 14)) >> 15));
+}
+
+/* -1 if x != 0, else 0 */
+static int int16_nonzero_mask(int16_t x)
+{
+	uint32_t u = (uint16_t)x;
+
+	return -(int)((0u - u) >> 31);
+}
+
+/* -1 if x < 0, else 0 */
+static int int16_negative_mask(int16_t x)
+{
+	return -(int)((uint16_t)x >> 15);
+}
+
+/* a^(q-2); the exponent is public, so square and multiply is constant time */
+static Fq Fq_recip(Fq a)
+{
+	Fq r = 1;
+	int bit;
+
+	for (bit = 12; bit >= 0; bit--) {
+		r = Fq_freeze(r * (int32_t)r);
+		if ((NTRU_Q - 2) >> bit & 1) {
+			r = Fq_freeze(r * (int32_t)a);
+		}
+	}
+	return r;
+}
+
+/* ------------------------------------------------------------------ */
+/*  Sorting network (djbsort, portable)                               */
+/* ------------------------------------------------------------------ */
+
+static void uint32_minmax(uint32_t *a, uint32_t *b)
+{
+	uint32_t x = *a, y = *b;
+	/* y < x, without a comparison */
+	uint32_t lt = (y ^ ((y ^ x) | ((y - x) ^ x))) >> 31;
+	uint32_t t = (x ^ y) & (0u - lt);
+
+	*a = x ^ t;
+	*b = y ^ t;
+}
+
+static void sort_uint32(uint32_t *x, int n)
+{
+	int top, p, qq, r, i;
+
+	top = 1;
+	while (top < n - top) {
+		top += top;
+	}
+	for (p = top; p > 0; p >>= 1) {
+		for (i = 0; i < n - p; i++) {
+			if (!(i & p)) {
+				uint32_minmax(&x[i], &x[i + p]);
+			}
+		}
+		i = 0;
+		for (qq = top; qq > p; qq >>= 1) {
+			for (; i < n - qq; i++) {
+				if (!(i & p)) {
+					uint32_t a = x[i + p];
+
+					for (r = qq; r > p; r >>= 1) {
+						uint32_minmax(&a, &x[i + r]);
+					}
+					x[i + p] = a;
+				}
+			}
+		}
+	}
+}
+
+/* ------------------------------------------------------------------ */
+/*  Small polynomials                                                 */
+/* ------------------------------------------------------------------ */
+
+/* Four coefficients per byte, each stored as c + 1 in two bits. */
+static void small_encode(unsigned char *s, const small *f)
+{
+	int i;
+
+	for (i = 0; i < NTRU_P / 4; i++) {
+		s[i] = (unsigned char)((f[4 * i] + 1) | (f[4 * i + 1] + 1) << 2
+			| (f[4 * i + 2] + 1) << 4 | (f[4 * i + 3] + 1) << 6);
+	}
+	s[i] = (unsigned char)(f[NTRU_P - 1] + 1);
+}
+
+/* Coefficients start .. start + n - 1 of an encoded polynomial, 0 past the end. */
+static void small_decode(small *f, const unsigned char *s, int start, int n)
+{
+	int i;
+
+	for (i = 0; i < n; i++) {
+		int t = start + i;
+
+		f[i] = t < NTRU_P ? (small)(((s[t >> 2] >> 2 * (t & 3)) & 3) - 1) : 0;
+	}
+}
+
+/*
+ * Random polynomial of weight w, encoded. As the reference: w random words
+ * with the low bits cleared or set so that they become +-1, the rest 0,
+ * then a constant-time sort shuffles them.
+ */
+static void short_random(unsigned char *s)
+{
+	uint32_t L[NTRU_P];
+	int i;
+
+	genrandom((unsigned char *)L, sizeof(L));
+	for (i = 0; i < NTRU_P; i++) {
+		const unsigned char *b = (const unsigned char *)&L[i];
+		uint32_t x = b[0] | (uint32_t)b[1] << 8 | (uint32_t)b[2] << 16 | (uint32_t)b[3] << 24;
+
+		L[i] = i < NTRU_W ? x & ~1u : (x & ~3u) | 1;
+	}
+	sort_uint32(L, NTRU_P);
+	/* L[i] & 3 is the coefficient plus one */
+	for (i = 0; i < NTRU_P / 4; i++) {
+		s[i] = (unsigned char)((L[4 * i] & 3) | (L[4 * i + 1] & 3) << 2
+			| (L[4 * i + 2] & 3) << 4 | (L[4 * i + 3] & 3) << 6);
+	}
+	s[i] = (unsigned char)(L[NTRU_P - 1] & 3);
+	m_burn(L, sizeof(L));
+}
+
+static void small_random(small *f)
+{
+	uint32_t L[NTRU_P];
+	int i;
+
+	genrandom((unsigned char *)L, sizeof(L));
+	for (i = 0; i < NTRU_P; i++) {
+		const unsigned char *b = (const unsigned char *)&L[i];
+		uint32_t x = b[0] | (uint32_t)b[1] << 8 | (uint32_t)b[2] << 16 | (uint32_t)b[3] << 24;
+
+		f[i] = (small)((((x & 0x3fffffff) * 3) >> 30) - 1);
+	}
+	m_burn(L, sizeof(L));
+}
+
+/* ------------------------------------------------------------------ */
+/*  Multiplication by a small polynomial                              */
+/* ------------------------------------------------------------------ */
+
+/*
+ * h = f * g in Z[x]/(x^p - x - 1), reduced mod q (or mod 3 with mod3).
+ * g is small_encode()d. Column t of the product, c_t = sum of f_i * g_(t-i),
+ * is summed in a register. x^t for t >= p is x^(t-p+1) + x^(t-p), so
+ * h_k = c_k + c_(k+p) + c_(k+p-1), and c_(k+p) is carried over to h_(k+1).
+ * |f| <= 2295 and |g| <= 1 keep every sum below 3 * 761 * 2295, so each
+ * coefficient is reduced once. g is unpacked reversed so that both
+ * operands of the inner loops run forwards.
+ */
+static void mult_small(Fq *h, const Fq *f, const unsigned char *g, int mod3)
+{
+	small gr[NTRU_P];
+	int32_t lo, hi, carry = 0;
+	int i, k;
+
+	small_decode(gr, g, 0, NTRU_P);
+	for (i = 0; i < NTRU_P / 2; i++) {
+		small t = gr[i];
+
+		gr[i] = gr[NTRU_P - 1 - i];
+		gr[NTRU_P - 1 - i] = t;
+	}
+
+	for (k = 0; k < NTRU_P; k++) {
+		/* g_(k-i) = gr[p-1-k+i], g_(k+p-i) = gr[i-k-1] */
+		const small *glo = gr + NTRU_P - 1 - k;
+
+		lo = 0;
+		for (i = 0; i <= k; i++) {
+			lo += f[i] * (int32_t)glo[i];
+		}
+		hi = 0;
+		for (i = k + 1; i < NTRU_P; i++) {
+			hi += f[i] * (int32_t)gr[i - k - 1];
+		}
+		h[k] = mod3 ? F3_freeze(lo + hi + carry) : Fq_freeze(lo + hi + carry);
+		carry = hi;
+	}
+	m_burn(gr, sizeof(gr));
+}
+
+/* ------------------------------------------------------------------ */
+/*  Reciprocals (key generation only)                                 */
+/* ------------------------------------------------------------------ */
+
+/*
+ * Both run the reference's constant-time divsteps, 2p - 1 of them.
+ *
+ * In R/3 the polynomials are bitsliced: coefficient i is bit i of a
+ * "plus" and a "minus" bit string, 32 coefficients per word, so each
+ * divstep is a few dozen word operations instead of ~3000 byte ones.
+ */
+#define R3_WORDS  ((NTRU_P + 1 + 31) / 32)
+#define R3_TOP    ((1u << ((NTRU_P + 1) % 32)) - 1)     /* bits 0 .. p of the last word */
+
+struct r3_bits {
+	uint32_t p[R3_WORDS], m[R3_WORDS];
+};
+
+/* a += b * c in R/3 with c in -1 .. 1 */
+static void r3_addmul(struct r3_bits *a, const struct r3_bits *b, int c)
+{
+	uint32_t cp = 0u - (uint32_t)((c + 1) >> 1), cm = 0u - (uint32_t)((1 - c) >> 1);
+	uint32_t ap, am, bp, bm, az, bz;
+	int w;
+
+	for (w = 0; w < R3_WORDS; w++) {
+		ap = a->p[w];
+		am = a->m[w];
+		bp = (b->p[w] & cp) | (b->m[w] & cm);
+		bm = (b->m[w] & cp) | (b->p[w] & cm);
+		az = ~(ap | am);
+		bz = ~(bp | bm);
+		/* 1 + 1 = -1, -1 + -1 = 1 */
+		a->p[w] = (ap & bz) | (bp & az) | (am & bm);
+		a->m[w] = (am & bz) | (bm & az) | (ap & bp);
+	}
+}
+
+/* swaps a and b if mask is all ones */
+static void r3_swap(struct r3_bits *a, struct r3_bits *b, uint32_t mask)
+{
+	uint32_t t;
+	int w;
+
+	for (w = 0; w < R3_WORDS; w++) {
+		t = mask & (a->p[w] ^ b->p[w]);
+		a->p[w] ^= t;
+		b->p[w] ^= t;
+		t = mask & (a->m[w] ^ b->m[w]);
+		a->m[w] ^= t;
+		b->m[w] ^= t;
+	}
+}
+
+/* coefficient i moves to i + 1; the one at p falls off */
+static void r3_shift_up(struct r3_bits *a)
+{
+	int w;
+
+	for (w = R3_WORDS - 1; w > 0; w--) {
+		a->p[w] = a->p[w] << 1 | a->p[w - 1] >> 31;
+		a->m[w] = a->m[w] << 1 | a->m[w - 1] >> 31;
+	}
+	a->p[0] <<= 1;
+	a->m[0] <<= 1;
+	a->p[R3_WORDS - 1] &= R3_TOP;
+	a->m[R3_WORDS - 1] &= R3_TOP;
+}
+
+/* coefficient i moves to i - 1; the one at 0 falls off */
+static void r3_shift_down(struct r3_bits *a)
+{
+	int w;
+
+	for (w = 0; w < R3_WORDS - 1; w++) {
+		a->p[w] = a->p[w] >> 1 | a->p[w + 1] << 31;
+		a->m[w] = a->m[w] >> 1 | a->m[w + 1] << 31;
+	}
+	a->p[R3_WORDS - 1] >>= 1;
+	a->m[R3_WORDS - 1] >>= 1;
+}
+
+static void r3_set(struct r3_bits *a, int i, int c)
+{
+	a->p[i / 32] |= (uint32_t)(c > 0) << (i % 32);
+	a->m[i / 32] |= (uint32_t)(c < 0) << (i % 32);
+}
+
+static int r3_get(const struct r3_bits *a, int i)
+{
+	return (int)(a->p[i / 32] >> (i % 32) & 1) - (int)(a->m[i / 32] >> (i % 32) & 1);
+}
+
+/* out = 1/in in R/3; returns 0 if in is invertible, else -1 */
+static int R3_recip(small *out, const small *in)
+{
+	struct r3_bits f, g, v, r;
+	int i, loop, delta, sign, f0, g0;
+	uint32_t swap;
+
+	memset(&f, 0, sizeof(f));
+	memset(&g, 0, sizeof(g));
+	memset(&v, 0, sizeof(v));
+	memset(&r, 0, sizeof(r));
+	r3_set(&r, 0, 1);
+	r3_set(&f, 0, 1);
+	r3_set(&f, NTRU_P - 1, -1);
+	r3_set(&f, NTRU_P, -1);
+	for (i = 0; i < NTRU_P; i++) {
+		g.p[(NTRU_P - 1 - i) / 32] |= (uint32_t)((in[i] + 1) >> 1) << (NTRU_P - 1 - i) % 32;
+		g.m[(NTRU_P - 1 - i) / 32] |= (uint32_t)((1 - in[i]) >> 1) << (NTRU_P - 1 - i) % 32;
+	}
+
+	delta = 1;
+	for (loop = 0; loop < 2 * NTRU_P - 1; loop++) {
+		r3_shift_up(&v);
+
+		/* the same before and after the swap */
+		f0 = (int)(f.p[0] & 1) - (int)(f.m[0] & 1);
+		g0 = (int)(g.p[0] & 1) - (int)(g.m[0] & 1);
+		sign = -g0 * f0;
+		swap = (uint32_t)(int16_negative_mask((int16_t)-delta) & int16_nonzero_mask((int16_t)g0));
+		delta ^= (int)swap & (delta ^ -delta);
+		delta += 1;
+
+		r3_swap(&f, &g, swap);
+		r3_swap(&v, &r, swap);
+		r3_addmul(&g, &f, sign);
+		r3_addmul(&r, &v, sign);
+		r3_shift_down(&g);
+	}
+
+	sign = r3_get(&f, 0);
+	for (i = 0; i < NTRU_P; i++) {
+		out[i] = (small)(sign * r3_get(&v, NTRU_P - 1 - i));
+	}
+	m_burn(&f, sizeof(f));
+	m_burn(&g, sizeof(g));
+	m_burn(&v, sizeof(v));
+	m_burn(&r, sizeof(r));
+	return int16_nonzero_mask((int16_t)delta);
+}
+
+/* out = 1/(3*in) in R/q; in must be invertible */
+static void Rq_recip3(Fq *out, const small *in)
+{
+	Fq f[NTRU_P + 1], g[NTRU_P + 1], v[NTRU_P + 1], r[NTRU_P + 1];
+	int i, loop, delta, swap, t;
+	int32_t f0, g0;
+	Fq scale;
+
+	memset(f, 0, sizeof(f));
+	memset(v, 0, sizeof(v));
+	memset(r, 0, sizeof(r));
+	r[0] = Fq_recip(3);
+	f[0] = 1;
+	f[NTRU_P - 1] = f[NTRU_P] = -1;
+	for (i = 0; i < NTRU_P; i++) {
+		g[NTRU_P - 1 - i] = in[i];
+	}
+	g[NTRU_P] = 0;
+
+	delta = 1;
+	for (loop = 0; loop < 2 * NTRU_P - 1; loop++) {
+		memmove(v + 1, v, NTRU_P * sizeof(Fq));
+		v[0] = 0;
+
+		swap = int16_negative_mask((int16_t)-delta) & int16_nonzero_mask(g[0]);
+		delta ^= swap & (delta ^ -delta);
+		delta += 1;
+
+		/* f[0] and g[0] after the swap */
+		t = swap & (f[0] ^ g[0]);
+		f0 = f[0] ^ t;
+		g0 = g[0] ^ t;
+		for (i = 0; i < NTRU_P + 1; i++) {
+			t = swap & (f[i] ^ g[i]);
+			f[i] ^= t;
+			g[i] = Fq_freeze(f0 * (g[i] ^ t) - g0 * f[i]);
+		}
+		/* v and r are zero above loop + 1: one more each divstep */
+		for (i = 0; i <= MIN(loop + 1, NTRU_P); i++) {
+			t = swap & (v[i] ^ r[i]);
+			v[i] ^= t;
+			r[i] = Fq_freeze(f0 * (r[i] ^ t) - g0 * v[i]);
+		}
+		memmove(g, g + 1, NTRU_P * sizeof(Fq));
+		g[NTRU_P] = 0;
+	}
+
+	scale = Fq_recip(f[0]);
+	for (i = 0; i < NTRU_P; i++) {
+		out[i] = Fq_freeze(scale * (int32_t)v[NTRU_P - 1 - i]);
+	}
+	m_burn(f, sizeof(f));
+	m_burn(g, sizeof(g));
+	m_burn(v, sizeof(v));
+	m_burn(r, sizeof(r));
+}
+
+/* ------------------------------------------------------------------ */
+/*  Encoding                                                          */
+/* ------------------------------------------------------------------ */
+
+/*
+ * The reference's mixed-radix code for p values below m0: pairs are merged
+ * into one value below the product of their moduli, whole bytes are split
+ * off while that is >= 2^14, and the same is repeated on the half-length
+ * list. All values share m0, so on each level every value has the same
+ * modulus except the last; two scalars replace the reference's per-level
+ * arrays, and R is reused for each level's values.
+ */
+#define ENCODE_LEVELS  10   /* 761 381 191 96 48 24 12 6 3 2 */
+
+/* modulus left of a pair with product m; *bytes split off */
+static uint32_t encode_bytes(uint32_t m, int *bytes)
+{
+	*bytes = 0;
+	while (m >= 16384) {
+		m = (m + 255) >> 8;
+		(*bytes)++;
+	}
+	return m;
+}
+
+/* Encodes R[0..p-1], each below m0. Destroys R. */
+static void encode(unsigned char *s, uint16_t *R, uint16_t m0)
+{
+	uint32_t m = m0, mlast = m0, r;
+	int len = NTRU_P, i;
+
+	while (len > 1) {
+		uint32_t m2 = m, m2last = mlast;
+
+		for (i = 0; i + 1 < len; i += 2) {
+			uint32_t pm = m * (i + 2 == len ? mlast : m);
+
+			r = R[i] + (uint32_t)R[i + 1] * m;
+			while (pm >= 16384) {
+				*s++ = (unsigned char)r;
+				r >>= 8;
+				pm = (pm + 255) >> 8;
+			}
+			R[i / 2] = (uint16_t)r;
+			if (i + 2 == len) {
+				m2last = pm;
+			} else {
+				m2 = pm;
+			}
+		}
+		if (len & 1) {
+			R[len / 2] = R[len - 1];
+		}
+		m = m2;
+		mlast = m2last;
+		len = (len + 1) / 2;
+	}
+	for (r = R[0]; mlast > 1; mlast = (mlast + 255) >> 8) {
+		*s++ = (unsigned char)r;
+		r >>= 8;
+	}
+}
+
+/* Inverse of encode(); out-of-range input still gives values below m0. */
+static void decode(uint16_t *R, const unsigned char *s, uint16_t m0)
+{
+	struct {
+		const unsigned char *s;     /* this level's bytes             */
+		uint32_t m, mlast;          /* modulus of each value, of last */
+		int len, bytes;             /* values; bytes per pair         */
+	} lv[ENCODE_LEVELS];
+	uint32_t m = m0, mlast = m0, r, r1;
+	uint16_t r0;
+	int len = NTRU_P, n = 0, j, b;
+
+	/* the bytes of level 0 come first, so find each level's offset */
+	while (len > 1) {
+		uint32_t m2 = encode_bytes(m * m, &b), m2last = mlast;
+
+		lv[n].s = s;
+		lv[n].m = m;
+		lv[n].mlast = mlast;
+		lv[n].len = len;
+		lv[n].bytes = b;
+		s += (len / 2) * b;
+		if (!(len & 1)) {
+			s -= b;
+			m2last = encode_bytes(m * mlast, &b);
+			s += b;
+		}
+		m = m2;
+		mlast = m2last;
+		len = (len + 1) / 2;
+		n++;
+	}
+
+	if (mlast == 1) {
+		R[0] = 0;
+	} else if (mlast <= 256) {
+		R[0] = uint32_mod_uint14(s[0], (uint16_t)mlast);
+	} else {
+		R[0] = uint32_mod_uint14(s[0] + ((uint32_t)s[1] << 8), (uint16_t)mlast);
+	}
+
+	/* split each level's values back into pairs, from the top */
+	while (n-- > 0) {
+		len = lv[n].len;
+		m = lv[n].m;
+		if (len & 1) {
+			R[len - 1] = R[len / 2];
+		}
+		for (j = len / 2 - 1; j >= 0; j--) {
+			const unsigned char *ps = lv[n].s + j * lv[n].bytes;
+			uint32_t m1 = 2 * j + 2 == len ? lv[n].mlast : m;
+			uint32_t pm = m * m1;
+
+			r = R[j];
+			if (pm > 256 * 16383) {
+				r = ps[0] + 256 * (uint32_t)ps[1] + 65536 * r;
+			} else if (pm >= 16384) {
+				r = ps[0] + 256 * r;
+			}
+			uint32_divmod_uint14(&r1, &r0, r, (uint16_t)m);
+			R[2 * j] = r0;
+			R[2 * j + 1] = uint32_mod_uint14(r1, (uint16_t)m1);
+		}
+	}
+}
+
+/* Destroys r. */
+static void rq_encode(unsigned char *s, Fq *r)
+{
+	uint16_t *R = (uint16_t *)r;
+	int i;
+
+	for (i = 0; i < NTRU_P; i++) {
+		R[i] = (uint16_t)(r[i] + NTRU_Q12);
+	}
+	encode(s, R, NTRU_Q);
+}
+
+static void rq_decode(Fq *r, const unsigned char *s)
+{
+	uint16_t *R = (uint16_t *)r;
+	int i;
+
+	decode(R, s, NTRU_Q);
+	for (i = 0; i < NTRU_P; i++) {
+		r[i] = (Fq)(R[i] - NTRU_Q12);
+	}
+}
+
+/* Rounds each coefficient to a multiple of 3 and encodes it. Destroys r. */
+static void rounded_encode(unsigned char *s, Fq *r)
+{
+	uint16_t *R = (uint16_t *)r;
+	int i;
+
+	for (i = 0; i < NTRU_P; i++) {
+		Fq c = (Fq)(r[i] - F3_freeze(r[i]));
+
+		R[i] = (uint16_t)(((c + NTRU_Q12) * 10923) >> 15);
+	}
+	encode(s, R, ROUNDED_M);
+}
+
+static void rounded_decode(Fq *r, const unsigned char *s)
+{
+	uint16_t *R = (uint16_t *)r;
+	int i;
+
+	decode(R, s, ROUNDED_M);
+	for (i = 0; i < NTRU_P; i++) {
+		r[i] = (Fq)(R[i] * 3 - NTRU_Q12);
+	}
+}
+
+/* ------------------------------------------------------------------ */
+/*  KEM                                                               */
+/* ------------------------------------------------------------------ */
+
+/* First 32 bytes of SHA-512(b || in) */
+static void hash_prefix(unsigned char *out, unsigned char b,
+	const unsigned char *in, unsigned long inlen)
+{
+	hash_state hs;
+	unsigned char h[64];
+
+	sha512_init(&hs);
+	sha512_process(&hs, &b, 1);
+	sha512_process(&hs, in, inlen);
+	sha512_done(&hs, h);
+	memcpy(out, h, HASH_BYTES);
+	m_burn(h, sizeof(h));
+}
+
+static void hash_confirm(unsigned char *out, const unsigned char *r_enc,
+	const unsigned char *cache)
+{
+	unsigned char x[2 * HASH_BYTES];
+
+	hash_prefix(x, 3, r_enc, SMALL_BYTES);
+	memcpy(x + HASH_BYTES, cache, HASH_BYTES);
+	hash_prefix(out, 2, x, sizeof(x));
+	m_burn(x, sizeof(x));
+}
+
+/* First 32 bytes of SHA-512(b || Hash_prefix(3, r_enc) || c) */
+static void hash_session(unsigned char *k, unsigned char b,
+	const unsigned char *r_enc, const unsigned char *c)
+{
+	hash_state hs;
+	unsigned char h[64];
+
+	hash_prefix(h, 3, r_enc, SMALL_BYTES);
+	sha512_init(&hs);
+	sha512_process(&hs, &b, 1);
+	sha512_process(&hs, h, HASH_BYTES);
+	sha512_process(&hs, c, CT_BYTES);
+	sha512_done(&hs, h);
+	memcpy(k, h, HASH_BYTES);
+	m_burn(h, sizeof(h));
+}
+
+/* Round(h * r) for the encoded short polynomial r_enc; the confirm hash follows. */
+static void encrypt(unsigned char *c, const unsigned char *r_enc, const unsigned char *pk)
+{
+	Fq h[NTRU_P], hr[NTRU_P];
+
+	rq_decode(h, pk);
+	mult_small(hr, h, r_enc, 0);
+	rounded_encode(c, hr);
+	m_burn(hr, sizeof(hr));
+}
+
+int crypto_kem_sntrup761_keypair(unsigned char *pk, unsigned char *sk)
+{
+	small g[NTRU_P], f[NTRU_P];
+	unsigned char g_enc[SMALL_BYTES];
+	Fq finv[NTRU_P], h[NTRU_P];
+
+	/* sk: f, 1/g in R/3, pk, rho (random, for implicit rejection), Hash_prefix(4, pk) */
+	do {
+		small_random(g);
+	} while (R3_recip(f, g) != 0);
+	small_encode(sk + SMALL_BYTES, f);
+	short_random(sk);
+	small_encode(g_enc, g);
+
+	/* h = g / (3f) */
+	small_decode(f, sk, 0, NTRU_P);
+	Rq_recip3(finv, f);
+	mult_small(h, finv, g_enc, 0);
+	rq_encode(pk, h);
+
+	memcpy(sk + 2 * SMALL_BYTES, pk, RQ_BYTES);
+	genrandom(sk + 2 * SMALL_BYTES + RQ_BYTES, SMALL_BYTES);
+	hash_prefix(sk + 3 * SMALL_BYTES + RQ_BYTES, 4, pk, RQ_BYTES);
+
+	m_burn(g, sizeof(g));
+	m_burn(f, sizeof(f));
+	m_burn(g_enc, sizeof(g_enc));
+	m_burn(finv, sizeof(finv));
+	return 0;
+}
+
+int crypto_kem_sntrup761_enc(unsigned char *c, unsigned char *k, const unsigned char *pk)
+{
+	unsigned char r_enc[SMALL_BYTES], cache[HASH_BYTES];
+
+	hash_prefix(cache, 4, pk, RQ_BYTES);
+	short_random(r_enc);
+	encrypt(c, r_enc, pk);
+	hash_confirm(c + ROUNDED_BYTES, r_enc, cache);
+	hash_session(k, 1, r_enc, c);
+
+	m_burn(r_enc, sizeof(r_enc));
+	return 0;
+}
+
+int crypto_kem_sntrup761_dec(unsigned char *k, const unsigned char *c, const unsigned char *sk)
+{
+	const unsigned char *pk = sk + 2 * SMALL_BYTES;
+	const unsigned char *rho = pk + RQ_BYTES;
+	const unsigned char *cache = rho + SMALL_BYTES;
+	Fq t[NTRU_P], e[NTRU_P];
+	small r[NTRU_P];
+	unsigned char r_enc[SMALL_BYTES], cnew[CT_BYTES];
+	uint16_t diff = 0;
+	int i, weight = 0, mask;
+
+	/* e = 3 * c * f in R/3, r = e / g */
+	rounded_decode(t, c);
+	mult_small(e, t, sk, 0);
+	for (i = 0; i < NTRU_P; i++) {
+		t[i] = F3_freeze(Fq_freeze(3 * (int32_t)e[i]));
+	}
+	mult_small(e, t, sk + SMALL_BYTES, 1);
+
+	/* weight other than w: decrypt to (1,...,1,0,...,0) */
+	for (i = 0; i < NTRU_P; i++) {
+		weight += e[i] & 1;
+	}
+	mask = int16_nonzero_mask((int16_t)(weight - NTRU_W));
+	for (i = 0; i < NTRU_W; i++) {
+		r[i] = (small)(((e[i] ^ 1) & ~mask) ^ 1);
+	}
+	for (; i < NTRU_P; i++) {
+		r[i] = (small)(e[i] & ~mask);
+	}
+	small_encode(r_enc, r);
+
+	/* re-encrypt; on mismatch the session key comes from rho */
+	encrypt(cnew, r_enc, pk);
+	hash_confirm(cnew + ROUNDED_BYTES, r_enc, cache);
+	for (i = 0; i < CT_BYTES; i++) {
+		diff |= c[i] ^ cnew[i];
+	}
+	mask = (int)(1 & ((diff - 1) >> 8)) - 1;
+	for (i = 0; i < SMALL_BYTES; i++) {
+		r_enc[i] ^= mask & (r_enc[i] ^ rho[i]);
+	}
+	hash_session(k, (unsigned char)(1 + mask), r_enc, c);
+
+	m_burn(t, sizeof(t));
+	m_burn(e, sizeof(e));
+	m_burn(r, sizeof(r));
+	m_burn(r_enc, sizeof(r_enc));
+	return 0;
+}
+
+#endif /* DROPBEAR_SNTRUP761 */
@@ -0,0 +1,169 @@
+/*
+ * admission_storm.c - A connection storm against admission.c.
+ *
+ * Simulates 60 s of a CONFIG_DROPBEAR_MAX_SESSIONS task pool in 1 ms steps.
+ * Storm connections come from one or more addresses at a fixed rate; each
+ * one admitted holds a session task for 0.8 s (key exchange, one failed
+ * login). A legitimate client logs in every 5 s, holding a task for 1 s,
+ * and retries every second while it is refused. Runs once with only the
+ * busy check (what the accept loop did before) and once with the Kconfig
+ * defaults, and checks that admission keeps the legitimate client in.
+ */
+
+#include "includes.h"
+#include "dbutil.h"
+#include "session_pool.h"
+#include "admission.h"
+#include "sdkconfig.h"
+
+#include <netinet/in.h>
+
+#include "esp_system.h"
+#include "esp_timer.h"
+
+#define STORM_SESSION_US   800000
+#define LEGIT_SESSION_US  1000000
+#define LEGIT_PERIOD_US   5000000
+#define LEGIT_RETRY_US    1000000
+#define RUN_US           60000000
+
+static unsigned int failures;
+
+#define CHECK(cond) do { \
+	if (!(cond)) { \
+		fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond); \
+		failures++; \
+	} \
+} while (0)
+
+/* Kconfig defaults, and the accept loop before admission control */
+static const admission_config_t admission_defaults = { 40960, 4, 2000, 5, 300 };
+static const admission_config_t busy_only = { 0, 64, 0, 0, 300 };
+
+static int64_t now_us;
+static int64_t busy_until[CONFIG_DROPBEAR_MAX_SESSIONS];
+
+int64_t esp_timer_get_time(void)
+{
+	return now_us;
+}
+
+size_t esp_get_free_heap_size(void)
+{
+	return 150000;
+}
+
+unsigned int session_pool_active(void)
+{
+	unsigned int i, n = 0;
+
+	for (i = 0; i < CONFIG_DROPBEAR_MAX_SESSIONS; i++) {
+		n += busy_until[i] > now_us;
+	}
+	return n;
+}
+
+/* Hand the connection to an idle session task for `us`; 0 if none is idle. */
+static int session_start(int64_t us)
+{
+	unsigned int i;
+
+	for (i = 0; i < CONFIG_DROPBEAR_MAX_SESSIONS; i++) {
+		if (busy_until[i] <= now_us) {
+			busy_until[i] = now_us + us;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static struct sockaddr_storage peer(unsigned int n)
+{
+	struct sockaddr_storage ss;
+	struct sockaddr_in *in = (struct sockaddr_in *)&ss;
+
+	memset(&ss, 0, sizeof(ss));
+	in->sin_family = AF_INET;
+	in->sin_addr.s_addr = htonl(0x0a000000 | n);
+	return ss;
+}
+
+struct storm_result {
+	unsigned long storm_tries, storm_admitted;
+	unsigned long legit_tries, legit_admitted;
+	int64_t lockout_us;             /* longest the legitimate client waited */
+};
+
+static void storm(const char *name, unsigned int addrs, unsigned int per_sec,
+	const admission_config_t *config, struct storm_result *r)
+{
+	struct sockaddr_storage legit = peer(1), a;
+	int64_t end, next_storm, next_legit, waiting = -1;
+	unsigned int k = 0;
+
+	memset(r, 0, sizeof(*r));
+	memset(busy_until, 0, sizeof(busy_until));
+	now_us = 1000000000LL;
+	admission_init(config);
+	end = now_us + RUN_US;
+	next_storm = now_us;
+	next_legit = now_us;
+
+	for (; now_us < end; now_us += 1000) {
+		while (next_storm <= now_us) {
+			next_storm += 1000000 / per_sec;
+			a = peer(100 + k++ % addrs);
+			r->storm_tries++;
+			if (admission_check(&a) == ADMISSION_OK && session_start(STORM_SESSION_US)) {
+				r->storm_admitted++;
+				admission_session_closed(&a, 0, 1);
+			}
+		}
+		if (next_legit > now_us) {
+			continue;
+		}
+		r->legit_tries++;
+		if (admission_check(&legit) == ADMISSION_OK && session_start(LEGIT_SESSION_US)) {
+			r->legit_admitted++;
+			admission_session_closed(&legit, 1, 0);
+			next_legit = now_us + LEGIT_PERIOD_US;
+			if (waiting >= 0) {
+				r->lockout_us = MAX(r->lockout_us, now_us - waiting);
+				waiting = -1;
+			}
+		} else {
+			if (waiting < 0) {
+				waiting = now_us;
+			}
+			next_legit = now_us + LEGIT_RETRY_US;
+		}
+	}
+	if (waiting >= 0) {
+		r->lockout_us = MAX(r->lockout_us, now_us - waiting);
+	}
+	printf("  %-36s storm %4lu / %4lu admitted, legitimate %2lu / %2lu, longest lockout %2.0f s\n",
+		name, r->storm_admitted, r->storm_tries, r->legit_admitted, r->legit_tries,
+		r->lockout_us / 1e6);
+}
+
+int main(void)
+{
+	struct storm_result before, now;
+
+	storm("1 address, 50/s, busy only", 1, 50, &busy_only, &before);
+	storm("1 address, 50/s, admission", 1, 50, &admission_defaults, &now);
+	CHECK(before.lockout_us > 30000000);
+	CHECK(now.storm_admitted * 10 < before.storm_admitted);
+	CHECK(now.legit_admitted == now.legit_tries && now.lockout_us == 0);
+
+	storm("100 addresses, 50/s, busy only", 100, 50, &busy_only, &before);
+	storm("100 addresses, 50/s, admission", 100, 50, &admission_defaults, &now);
+	CHECK(now.storm_admitted * 2 < before.storm_admitted);
+	CHECK(now.legit_admitted >= 10 && now.lockout_us <= LEGIT_RETRY_US);
+
+	storm("8 addresses, 20/s, admission", 8, 20, &admission_defaults, &now);
+	CHECK(now.legit_admitted >= 10 && now.lockout_us <= LEGIT_RETRY_US);
+
+	printf("admission_storm: %s\n", failures ? "FAILED" : "ok");
+	return failures ? 1 : 0;
+}
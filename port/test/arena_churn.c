@@ -0,0 +1,169 @@
+/*
+ * arena_churn.c - Session churn against port/dbmalloc_arena.c.
+ *
+ * Runs many sessions back to back on one arena. Each session allocates,
+ * reallocates and frees random blocks the way a live session does, with the
+ * occasional maximum-size read buffer on top of its long-lived state, and
+ * checks every block's contents before it is freed. A maximum-size read
+ * buffer must fit next to the session state without overflowing to the
+ * heap. At the end of a session everything must have been returned
+ * (used == 0) and a block of the whole arena must fit again, so nothing
+ * carries over from one session to the next. Overflows during the random
+ * churn itself are allowed (they fall back to the heap) and are reported.
+ */
+
+#include "includes.h"
+#include "dbutil.h"
+#include "sdkconfig.h"
+#include "dbmalloc_arena.h"
+
+#define SESSIONS          200
+#define STEPS             20000
+#define LIVE              16
+/* RECV_MAX_PAYLOAD_LEN + padding + MAC, as packet.c sizes ses.readbuf */
+#define READBUF_MAX       (32768 + 2048)
+/* long-lived per-session state: keys, channels, algorithm contexts */
+#define SESSION_STATE     (16 * 1024)
+
+static unsigned int failures;
+
+#define CHECK(cond) do { \
+	if (!(cond)) { \
+		fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond); \
+		failures++; \
+	} \
+} while (0)
+
+void dropbear_exit(const char *format, ...)
+{
+	fprintf(stderr, "dropbear_exit: %s\n", format);
+	abort();
+}
+
+static void fill(unsigned char *p, size_t from, size_t to, unsigned int tag)
+{
+	size_t i;
+
+	for (i = from; i < to; i++) {
+		p[i] = (unsigned char)(tag + i);
+	}
+}
+
+static int intact(const unsigned char *p, size_t len, unsigned int tag)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		if (p[i] != (unsigned char)(tag + i)) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+static void run_session(unsigned int s)
+{
+	unsigned char *blk[LIVE] = { NULL };
+	size_t len[LIVE];
+	unsigned char *state;
+	unsigned int step, i;
+
+	session_arena_t *arena = session_arena_current();
+	session_arena_stats_t before, after;
+	unsigned char *readbuf;
+
+	state = m_malloc(SESSION_STATE);
+	fill(state, 0, SESSION_STATE, s);
+
+	session_arena_get_stats(arena, &before);
+	readbuf = m_malloc(READBUF_MAX);
+	session_arena_get_stats(arena, &after);
+	CHECK(after.overflows == before.overflows);
+	m_free(readbuf);
+
+	for (step = 0; step < STEPS; step++) {
+		i = (unsigned int)rand() % LIVE;
+		if (blk[i] == NULL) {
+			/* mostly packet-sized, sometimes a full read buffer */
+			len[i] = rand() % 500 == 0 ? READBUF_MAX
+				: 1 + (size_t)rand() % (rand() % 16 == 0 ? 4096 : 300);
+			if (len[i] == READBUF_MAX) {
+				/* only one of those at a time, as in packet.c */
+				unsigned int j;
+
+				for (j = 0; j < LIVE; j++) {
+					if (blk[j] != NULL && len[j] == READBUF_MAX) {
+						len[i] = 64;
+					}
+				}
+			}
+			blk[i] = m_malloc(len[i]);
+			CHECK(blk[i][0] == 0 && blk[i][len[i] - 1] == 0);
+			fill(blk[i], 0, len[i], i);
+		} else if (rand() % 4 == 0 && len[i] < 1024) {
+			size_t n = 1 + (size_t)rand() % 1024;
+
+			blk[i] = m_realloc(blk[i], n);
+			CHECK(intact(blk[i], MIN(len[i], n), i));
+			fill(blk[i], MIN(len[i], n), n, i);
+			len[i] = n;
+		} else {
+			CHECK(intact(blk[i], len[i], i));
+			m_free(blk[i]);
+		}
+	}
+
+	for (i = 0; i < LIVE; i++) {
+		if (blk[i] != NULL) {
+			CHECK(intact(blk[i], len[i], i));
+			m_free(blk[i]);
+		}
+	}
+	CHECK(intact(state, SESSION_STATE, s));
+	m_free(state);
+}
+
+int main(void)
+{
+	session_arena_t *arena = session_arena_create(CONFIG_DROPBEAR_SESSION_ARENA_SIZE);
+	session_arena_stats_t st;
+	unsigned char *heap, *slot;
+	unsigned int s;
+	void *p;
+
+	CHECK(arena != NULL);
+	srand(1);
+
+	/* pointers from outside any arena still go to the C library */
+	heap = malloc(100);
+	heap = realloc(heap, 5000);
+	free(heap);
+
+	session_arena_attach(arena);
+	for (s = 0; s < SESSIONS; s++) {
+		run_session(s);
+
+		session_arena_get_stats(arena, &st);
+		CHECK(st.used == 0);
+		/* everything coalesced: the whole region is one free block again */
+		p = m_malloc(st.size - 16);
+		m_free(p);
+		session_arena_reset(arena);
+	}
+
+	/* a freed packet slot is handed out again */
+	slot = session_arena_pool_alloc(200);
+	CHECK(slot != NULL);
+	free(slot);
+	CHECK(session_arena_pool_alloc(200) == slot);
+	session_arena_reset(arena);
+
+	session_arena_get_stats(arena, &st);
+	CHECK(st.high_water <= st.size);
+	session_arena_attach(NULL);
+
+	printf("arena_churn: %u sessions, %u steps each, peak %zu of %zu bytes, "
+		"%u overflows: %s\n", SESSIONS, STEPS, st.high_water, st.size,
+		st.overflows, failures ? "FAILED" : "ok");
+	return failures ? 1 : 0;
+}
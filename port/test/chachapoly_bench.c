@@ -0,0 +1,136 @@
+/*
+ * chachapoly_bench.c - chacha20-poly1305@openssh.com throughput, three
+ * passes as Dropbear's chachapoly.c vs. the fused pass of
+ * port/chachapoly_fused.c.
+ *
+ * The file includes chachapoly_fused.c so that both columns use its
+ * ChaCha20 block and Poly1305 functions; only the pass structure differs.
+ * Best of 9 runs; numbers are in examples/server/footprint.md.
+ *
+ *   make -C port/test bench
+ */
+
+#include <time.h>
+
+#include "../chachapoly_fused.c"
+
+typedef int (*crypt_fn)(unsigned int seq, const unsigned char *in, unsigned char *out,
+		unsigned long len, unsigned long taglen, dropbear_chachapoly_state *state,
+		int direction);
+
+static void xor_stream(const chacha_state *key, uint64_t counter, const uint32_t *nonce,
+		const unsigned char *in, unsigned char *out, unsigned long len)
+{
+	unsigned char ks[64];
+	unsigned long p, i, n;
+
+	for (p = 0; p < len; p += 64) {
+		chacha20_block(ks, key, counter++, nonce);
+		n = len - p < 64 ? len - p : 64;
+		for (i = 0; i < n; i++) {
+			out[p + i] = in[p + i] ^ ks[i];
+		}
+	}
+}
+
+static void poly1305_all(const unsigned char *key, const unsigned char *m,
+		unsigned long len, unsigned char *tag)
+{
+	struct poly1305 st;
+	unsigned long p;
+
+	poly1305_start(&st, key);
+	for (p = 0; p + 16 <= len; p += 16) {
+		poly1305_block(&st, m + p, 1UL << 24);
+	}
+	if (p < len) {
+		poly1305_tail(&st, m + p, len - p);
+	}
+	poly1305_finish(&st, tag);
+}
+
+/* the structure of chachapoly.c: MAC check, length, payload, MAC */
+static int three_pass(unsigned int seq, const unsigned char *in, unsigned char *out,
+		unsigned long len, unsigned long UNUSED(taglen),
+		dropbear_chachapoly_state *state, int direction)
+{
+	unsigned char ks[64], tag[16];
+	uint32_t nonce[2];
+
+	seq_nonce(nonce, seq);
+	chacha20_block(ks, &state->chacha, 0, nonce);
+	if (direction == LTC_DECRYPT) {
+		poly1305_all(ks, in, len, tag);
+		if (constant_time_memcmp(in + len, tag, 16) != 0) {
+			return CRYPT_ERROR;
+		}
+	}
+	xor_stream(&state->header, 0, nonce, in, out, 4);
+	xor_stream(&state->chacha, 1, nonce, in + 4, out + 4, len - 4);
+	if (direction == LTC_ENCRYPT) {
+		poly1305_all(ks, out, len, out + len);
+	}
+	return CRYPT_OK;
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(void)
+{
+	static unsigned char in[40000], ct[40000], out[40000];
+	static const unsigned long sizes[] = { 64, 1024, 32768 };
+	crypt_fn fns[2] = { three_pass, dropbear_chachapoly_crypt };
+	dropbear_chachapoly_state st;
+	unsigned char key[64];
+	unsigned int i;
+
+	for (i = 0; i < sizeof(key); i++) {
+		key[i] = i * 3 + 1;
+	}
+	for (i = 0; i < sizeof(in); i++) {
+		in[i] = (unsigned char)rand();
+	}
+	dropbear_chachapoly_start(0, NULL, key, 64, 0, &st);
+
+	/* the two must agree before their times mean anything */
+	three_pass(1, in, ct, 1000, 16, &st, LTC_ENCRYPT);
+	dropbear_chachapoly_crypt(1, in, out, 1000, 16, &st, LTC_ENCRYPT);
+	if (memcmp(ct, out, 1016) != 0) {
+		printf("chachapoly_bench: results differ\n");
+		return 1;
+	}
+
+	for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+		unsigned long len = sizes[i], iters = (8UL << 20) / len, n;
+		double best[2][2] = { { 0, 0 }, { 0, 0 } };
+		int run, f, dir;
+
+		fns[1](1, in, ct, len, 16, &st, LTC_ENCRYPT);
+		for (run = 0; run < 9; run++) {
+			for (f = 0; f < 2; f++) {
+				for (dir = LTC_ENCRYPT; dir <= LTC_DECRYPT; dir++) {
+					const unsigned char *src = dir == LTC_ENCRYPT ? in : ct;
+					double t = now(), mbs;
+
+					for (n = 0; n < iters; n++) {
+						fns[f](1, src, out, len, 16, &st, dir);
+					}
+					mbs = iters * len / (now() - t) / 1e6;
+					if (mbs > best[f][dir]) {
+						best[f][dir] = mbs;
+					}
+				}
+			}
+		}
+		printf("%6lu B: encrypt 3-pass %6.1f fused %6.1f | decrypt 3-pass %6.1f fused %6.1f MB/s\n",
+			len, best[0][LTC_ENCRYPT], best[1][LTC_ENCRYPT],
+			best[0][LTC_DECRYPT], best[1][LTC_DECRYPT]);
+	}
+	return 0;
+}
@@ -0,0 +1,135 @@
+/*
+ * chachapoly_check.c - port/chachapoly_fused.c against OpenSSL.
+ *
+ * Builds the chacha20-poly1305@openssh.com reference from OpenSSL's ChaCha20
+ * and Poly1305 and compares every packet length from 4 to 1199 bytes:
+ * encryption, the decrypted length field, decryption in place and out of
+ * place. A flipped bit anywhere in the packet or the tag must be rejected
+ * with the output wiped.
+ */
+
+#include <openssl/evp.h>
+
+#include "includes.h"
+#include "algo.h"
+#include "dbutil.h"
+#include "chachapoly.h"
+
+static unsigned int failures;
+
+#define CHECK(cond) do { \
+	if (!(cond)) { \
+		fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond); \
+		failures++; \
+	} \
+} while (0)
+
+static void ossl_chacha(const unsigned char *key, uint64_t counter, unsigned int seq,
+		const unsigned char *in, unsigned char *out, int len)
+{
+	EVP_CIPHER_CTX *c = EVP_CIPHER_CTX_new();
+	unsigned char iv[16];
+	int i, l;
+
+	/* OpenSSL's IV is the 64-bit block counter, then the 64-bit nonce */
+	for (i = 0; i < 8; i++) {
+		iv[i] = (unsigned char)(counter >> (8 * i));
+		iv[8 + i] = (unsigned char)((uint64_t)seq >> (56 - 8 * i));
+	}
+	EVP_EncryptInit_ex(c, EVP_chacha20(), NULL, key, iv);
+	EVP_EncryptUpdate(c, out, &l, in, len);
+	EVP_CIPHER_CTX_free(c);
+}
+
+static void ossl_poly1305(const unsigned char *key, const unsigned char *m, size_t len,
+		unsigned char *tag)
+{
+	EVP_MAC *mac = EVP_MAC_fetch(NULL, "POLY1305", NULL);
+	EVP_MAC_CTX *c = EVP_MAC_CTX_new(mac);
+	size_t l;
+
+	EVP_MAC_init(c, key, 32, NULL);
+	EVP_MAC_update(c, m, len);
+	EVP_MAC_final(c, tag, &l, 16);
+	EVP_MAC_CTX_free(c);
+	EVP_MAC_free(mac);
+}
+
+/* PROTOCOL.chacha20poly1305 from OpenSSH */
+static void ref_encrypt(const unsigned char *key, unsigned int seq,
+		const unsigned char *in, unsigned char *out, unsigned long len)
+{
+	unsigned char zero[64] = { 0 }, polykey[64];
+
+	ossl_chacha(key, 0, seq, zero, polykey, 64);
+	ossl_chacha(key + 32, 0, seq, in, out, 4);
+	ossl_chacha(key, 1, seq, in + 4, out + 4, (int)len - 4);
+	ossl_poly1305(polykey, out, len, out + len);
+}
+
+static int all_zero(const unsigned char *p, unsigned long len)
+{
+	unsigned char d = 0;
+
+	while (len--) {
+		d |= *p++;
+	}
+	return d == 0;
+}
+
+int main(void)
+{
+	const struct dropbear_cipher_mode *mode = &dropbear_mode_chachapoly;
+	static unsigned char in[1300], ref[1300], out[1300], tmp[1300];
+	dropbear_chachapoly_state st;
+	unsigned char key[64];
+	unsigned long len;
+	unsigned int i, plen;
+
+	for (i = 0; i < sizeof(key); i++) {
+		key[i] = i * 3 + 1;
+	}
+	for (i = 0; i < sizeof(in); i++) {
+		in[i] = (unsigned char)rand();
+	}
+	CHECK(mode->start(0, NULL, key, 32, 0, &st) == CRYPT_ERROR);
+	CHECK(mode->start(0, NULL, key, 64, 0, &st) == CRYPT_OK);
+
+	for (len = 4; len < 1200; len++) {
+		unsigned int seq = (unsigned int)len * 7919u, pos;
+
+		in[0] = len >> 24;
+		in[1] = len >> 16;
+		in[2] = len >> 8;
+		in[3] = len;
+
+		ref_encrypt(key, seq, in, ref, len);
+		CHECK(mode->aead_crypt(seq, in, out, len, 16, &st, LTC_ENCRYPT) == CRYPT_OK);
+		CHECK(memcmp(out, ref, len + 16) == 0);
+
+		CHECK(mode->aead_getlength(seq, ref, &plen, len, &st) == CRYPT_OK);
+		CHECK(plen == len);
+
+		CHECK(mode->aead_crypt(seq, ref, out, len, 16, &st, LTC_DECRYPT) == CRYPT_OK);
+		CHECK(memcmp(out, in, len) == 0);
+		memcpy(tmp, ref, len + 16);
+		CHECK(mode->aead_crypt(seq, tmp, tmp, len, 16, &st, LTC_DECRYPT) == CRYPT_OK);
+		CHECK(memcmp(tmp, in, len) == 0);
+
+		/* forgeries: in place and out of place, nothing usable comes back */
+		pos = (unsigned int)rand() % (len + 16);
+		memcpy(tmp, ref, len + 16);
+		tmp[pos] ^= 1 << (rand() % 8);
+		memset(out, 0xa5, len);
+		CHECK(mode->aead_crypt(seq, tmp, out, len, 16, &st, LTC_DECRYPT) == CRYPT_ERROR);
+		CHECK(all_zero(out, len));
+		CHECK(mode->aead_crypt(seq, tmp, tmp, len, 16, &st, LTC_DECRYPT) == CRYPT_ERROR);
+		CHECK(all_zero(tmp, len));
+
+		/* the wrong sequence number is a forgery too */
+		CHECK(mode->aead_crypt(seq + 1, ref, out, len, 16, &st, LTC_DECRYPT) == CRYPT_ERROR);
+	}
+
+	printf("chachapoly_check: %s\n", failures ? "FAILED" : "ok");
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,69 @@
+/*
+ * curve25519_bench.c - CPU cycles per X25519/Ed25519 operation, TweetNaCl
+ * (tweetnacl_ref.c, the code in Dropbear's curve25519.c) vs.
+ * port/curve25519_fast.c. Best of 3,000 runs, x86-64 rdtsc. Build with
+ * STRIDE=0/2/4/8 for the base point table rows in
+ * examples/server/footprint.md.
+ *
+ *   make -C port/test bench
+ */
+
+#include <x86intrin.h>
+
+#include "includes.h"
+#include "dbutil.h"
+#include "dbrandom.h"
+#include "curve25519.h"
+#include "sdkconfig.h"
+
+#define RUNS  3000
+
+void tweet_scalarmult(unsigned char *q, const unsigned char *n, const unsigned char *p);
+void tweet_ed25519_sign_core(unsigned char *R, const unsigned char *r);
+
+#define BENCH(name, expr) do { \
+	unsigned long long best = ~0ULL, t; \
+	int _i; \
+	for (_i = 0; _i < RUNS; _i++) { \
+		t = __rdtsc(); \
+		expr; \
+		t = __rdtsc() - t; \
+		if (t < best) { \
+			best = t; \
+		} \
+	} \
+	printf("%-36s %10llu\n", name, best); \
+} while (0)
+
+int main(void)
+{
+	unsigned char k[32], u[32], out[32], ref[32], r[32];
+	unsigned char base[32] = { 9 };
+	unsigned char sk[32], pk[32], sig[64], m[64] = { 0 };
+	unsigned long siglen;
+
+	genrandom(k, 32);
+	genrandom(u, 32);
+	u[31] &= 0x7f;
+	genrandom(r, 32);
+	r[31] &= 0x0f;
+
+	/* the two must agree before their times mean anything */
+	dropbear_curve25519_scalarmult(out, k, u);
+	tweet_scalarmult(ref, k, u);
+	if (memcmp(out, ref, 32) != 0) {
+		printf("curve25519_bench: results differ\n");
+		return 1;
+	}
+	dropbear_ed25519_make_key(pk, sk);
+
+	printf("base point table stride %d, cycles:\n", CONFIG_DROPBEAR_ED25519_BASE_TABLE_STRIDE);
+	BENCH("TweetNaCl X25519 shared secret", tweet_scalarmult(out, k, u));
+	BENCH("fast      X25519 shared secret", dropbear_curve25519_scalarmult(out, k, u));
+	BENCH("TweetNaCl X25519 key generation", tweet_scalarmult(out, k, base));
+	BENCH("fast      X25519 key generation", dropbear_curve25519_scalarmult(out, k, base));
+	BENCH("TweetNaCl Ed25519 [r]B + encode", tweet_ed25519_sign_core(out, r));
+	BENCH("fast      Ed25519 sign (64 bytes)", dropbear_ed25519_sign(m, 64, sig, &siglen, sk, pk));
+	BENCH("fast      Ed25519 verify", dropbear_ed25519_verify(m, 64, sig, 64, pk));
+	return 0;
+}
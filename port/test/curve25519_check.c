@@ -0,0 +1,187 @@
+/*
+ * curve25519_check.c - port/curve25519_fast.c against RFC 7748, RFC 8032
+ * and OpenSSL.
+ *
+ * X25519: the RFC 7748 test vectors, 1,000 iterations of the iterated test,
+ * and random scalars and u-coordinates (including non-canonical ones with
+ * the top bit set or all bytes 0xff) against OpenSSL. Ed25519: the RFC 8032
+ * test vectors, then random keys and messages, comparing public keys and
+ * signatures with OpenSSL and checking that a flipped signature bit fails
+ * to verify. Built once per base point table stride (see the Makefile).
+ */
+
+#include <openssl/evp.h>
+
+#include "includes.h"
+#include "dbutil.h"
+#include "dbrandom.h"
+#include "curve25519.h"
+#include "sdkconfig.h"
+
+static unsigned int failures;
+
+#define CHECK(cond) do { \
+	if (!(cond)) { \
+		fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond); \
+		failures++; \
+	} \
+} while (0)
+
+static size_t hex(const char *s, unsigned char *out)
+{
+	size_t n = 0;
+
+	for (; s[0] && s[1]; s += 2) {
+		sscanf(s, "%2hhx", &out[n++]);
+	}
+	return n;
+}
+
+static void ossl_x25519(unsigned char *out, const unsigned char *k, const unsigned char *u)
+{
+	EVP_PKEY *priv = EVP_PKEY_new_raw_private_key(EVP_PKEY_X25519, NULL, k, 32);
+	EVP_PKEY *peer = EVP_PKEY_new_raw_public_key(EVP_PKEY_X25519, NULL, u, 32);
+	EVP_PKEY_CTX *ctx = EVP_PKEY_CTX_new(priv, NULL);
+	size_t len = 32;
+
+	EVP_PKEY_derive_init(ctx);
+	EVP_PKEY_derive_set_peer(ctx, peer);
+	if (EVP_PKEY_derive(ctx, out, &len) <= 0) {
+		/* OpenSSL refuses an all-zero result */
+		memset(out, 0, 32);
+	}
+	EVP_PKEY_CTX_free(ctx);
+	EVP_PKEY_free(priv);
+	EVP_PKEY_free(peer);
+}
+
+static void ossl_ed25519(unsigned char *sig, unsigned char *pk, const unsigned char *sk,
+		const unsigned char *m, size_t mlen)
+{
+	EVP_PKEY *key = EVP_PKEY_new_raw_private_key(EVP_PKEY_ED25519, NULL, sk, 32);
+	EVP_MD_CTX *ctx = EVP_MD_CTX_new();
+	size_t len = 32;
+
+	EVP_PKEY_get_raw_public_key(key, pk, &len);
+	len = 64;
+	EVP_DigestSignInit(ctx, NULL, NULL, NULL, key);
+	EVP_DigestSign(ctx, sig, &len, m, mlen);
+	EVP_MD_CTX_free(ctx);
+	EVP_PKEY_free(key);
+}
+
+static void check_x25519(void)
+{
+	static const char *const vectors[][3] = {
+		/* RFC 7748 section 5.2: scalar, u, result */
+		{ "a546e36bf0527c9d3b16154b82465edd62144c0ac1fc5a18506a2244ba449ac4",
+		  "e6db6867583030db3594c1a424b15f7c726624ec26b3353b10a903a6d0ab1c4c",
+		  "c3da55379de9c6908e94ea4df28d084f32eccf03491c71f754b4075577a28552" },
+		{ "4b66e9d4d1b4673c5ad22691957d6af5c11b6421e0ea01d42ca4169e7918ba0d",
+		  "e5210f12786811d3f4b7959d0538ae2c31dbe7106fc03c3efc4cd549c715a493",
+		  "95cbde9476e8907d7aade45cb4b873f88b595a68799fa152e6f8f7647aac7957" },
+		/* section 6.1: Alice's public key */
+		{ "77076d0a7318a57d3c16c17251b26645df4c2f87ebc0992ab177fba51db92c2a",
+		  "0900000000000000000000000000000000000000000000000000000000000000",
+		  "8520f0098930a754748b7ddcb43ef75a0dbf3a0d26381af4eba4a98eaa9b4e6a" },
+	};
+	unsigned char k[32], u[32], out[32], ref[32], t[32];
+	unsigned char base[32] = { 9 };
+	unsigned int i;
+
+	for (i = 0; i < sizeof(vectors) / sizeof(vectors[0]); i++) {
+		hex(vectors[i][0], k);
+		hex(vectors[i][1], u);
+		hex(vectors[i][2], ref);
+		dropbear_curve25519_scalarmult(out, k, u);
+		CHECK(memcmp(out, ref, 32) == 0);
+	}
+
+	/* section 5.2, after 1,000 iterations */
+	memset(k, 0, 32);
+	k[0] = 9;
+	memcpy(u, k, 32);
+	for (i = 0; i < 1000; i++) {
+		dropbear_curve25519_scalarmult(t, k, u);
+		memcpy(u, k, 32);
+		memcpy(k, t, 32);
+	}
+	hex("684cf59ba83309552800ef566f2f4d3c1c3887c49360e3875f2eb94d99532c51", ref);
+	CHECK(memcmp(k, ref, 32) == 0);
+
+	for (i = 0; i < 2000; i++) {
+		genrandom(k, 32);
+		genrandom(u, 32);
+		if (i % 3 == 0) {
+			u[31] |= 0x80;
+		}
+		if (i % 7 == 0) {
+			memset(u, 0xff, 32);
+		}
+		dropbear_curve25519_scalarmult(out, k, u);
+		ossl_x25519(ref, k, u);
+		CHECK(memcmp(out, ref, 32) == 0);
+
+		/* key generation takes the base point path */
+		dropbear_curve25519_scalarmult(out, k, base);
+		ossl_x25519(ref, k, base);
+		CHECK(memcmp(out, ref, 32) == 0);
+	}
+}
+
+static void check_ed25519(void)
+{
+	static const char *const vectors[][4] = {
+		/* RFC 8032 section 7.1, tests 1 to 3: sk, pk, message, signature */
+		{ "9d61b19deffd5a60ba844af492ec2cc44449c5697b326919703bac031cae7f60",
+		  "d75a980182b10ab7d54bfed3c964073a0ee172f3daa62325af021a68f707511a",
+		  "",
+		  "e5564300c360ac729086e2cc806e828a84877f1eb8e5d974d873e065224901555fb8821590a33bacc61e39701cf9b46bd25bf5f0595bbe24655141438e7a100b" },
+		{ "4ccd089b28ff96da9db6c346ec114e0f5b8a319f35aba624da8cf6ed4fb8a6fb",
+		  "3d4017c3e843895a92b70aa74d1b7ebc9c982ccf2ec4968cc0cd55f12af4660c",
+		  "72",
+		  "92a009a9f0d4cab8720e820b5f642540a2b27b5416503f8fb3762223ebdb69da085ac1e43e15996e458f3613d0f11d8c387b2eaeb4302aeeb00d291612bb0c00" },
+		{ "c5aa8df43f9f837bedb7442f31dcb7b166d38535076f094b85ce3a2e0b4458f7",
+		  "fc51cd8e6218a1a38da47ed00230f0580816ed13ba3303ac5deb911548908025",
+		  "af82",
+		  "6291d657deec24024827e69c3abe01a30ce548a284743a445e3680d7db5ac3ac18ff9b538d16f290ae67f760984dc6594a7c15e9716ed28dc027beceea1ec40a" },
+	};
+	unsigned char sk[32], pk[32], ref_pk[32], sig[64], ref_sig[64], m[200];
+	unsigned long siglen;
+	unsigned int i;
+	size_t mlen;
+
+	for (i = 0; i < sizeof(vectors) / sizeof(vectors[0]); i++) {
+		hex(vectors[i][0], sk);
+		hex(vectors[i][1], pk);
+		mlen = hex(vectors[i][2], m);
+		hex(vectors[i][3], ref_sig);
+		dropbear_ed25519_sign(m, mlen, sig, &siglen, sk, pk);
+		CHECK(siglen == 64 && memcmp(sig, ref_sig, 64) == 0);
+		CHECK(dropbear_ed25519_verify(m, mlen, sig, 64, pk) == 0);
+	}
+
+	for (i = 0; i < 500; i++) {
+		mlen = (size_t)rand() % sizeof(m);
+		genrandom(m, mlen);
+		dropbear_ed25519_make_key(pk, sk);
+		ossl_ed25519(ref_sig, ref_pk, sk, m, mlen);
+		CHECK(memcmp(pk, ref_pk, 32) == 0);
+
+		dropbear_ed25519_sign(m, mlen, sig, &siglen, sk, pk);
+		CHECK(memcmp(sig, ref_sig, 64) == 0);
+		CHECK(dropbear_ed25519_verify(m, mlen, sig, 64, pk) == 0);
+
+		sig[rand() % 64] ^= 1 << (rand() % 8);
+		CHECK(dropbear_ed25519_verify(m, mlen, sig, 64, pk) != 0);
+	}
+}
+
+int main(void)
+{
+	check_x25519();
+	check_ed25519();
+	printf("curve25519_check (table stride %d): %s\n",
+		CONFIG_DROPBEAR_ED25519_BASE_TABLE_STRIDE, failures ? "FAILED" : "ok");
+	return failures ? 1 : 0;
+}
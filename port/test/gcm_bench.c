@@ -0,0 +1,288 @@
+/*
+ * gcm_bench.c - AES-GCM packet sealing with bitwise vs. 4-bit table GHASH.
+ *
+ * Seals SSH packets the way aes128-gcm@openssh.com does (4-byte length as
+ * AAD, payload, 16-byte tag) with a T-table AES-128 like libtomcrypt's,
+ * once with libtomcrypt's bitwise gcm_gf_mult() and once with
+ * port/ghash_table.c. Packets of 4 to 1499 bytes are first checked against
+ * OpenSSL's AES-128-GCM. Best of 9 runs; numbers are in
+ * examples/server/footprint.md.
+ *
+ *   make -C port/test bench
+ */
+
+#include <stdio.h>
+#include <time.h>
+#include <openssl/evp.h>
+
+#include "tomcrypt.h"
+#include "ghash_table.h"
+
+typedef void (*mult_fn)(const gcm_state *gcm, unsigned char *I);
+
+/* ---- AES-128 encryption, T-table, as libtomcrypt's aes.c ---- */
+
+static uint32_t Te[4][256];
+static unsigned char sbox[256];
+
+typedef struct {
+	uint32_t rk[44];
+} aes_key;
+
+static void aes_tables(void)
+{
+	unsigned char p = 1, q = 1;
+	int i, k;
+
+	do {
+		unsigned char x;
+
+		p = p ^ (p << 1) ^ (p & 0x80 ? 0x1b : 0);
+		q ^= q << 1;
+		q ^= q << 2;
+		q ^= q << 4;
+		if (q & 0x80) {
+			q ^= 0x09;
+		}
+		x = q ^ (q << 1 | q >> 7) ^ (q << 2 | q >> 6) ^ (q << 3 | q >> 5) ^ (q << 4 | q >> 4);
+		sbox[p] = x ^ 0x63;
+	} while (p != 1);
+	sbox[0] = 0x63;
+
+	for (i = 0; i < 256; i++) {
+		unsigned char s = sbox[i], s2 = (s << 1) ^ (s & 0x80 ? 0x1b : 0), s3 = s2 ^ s;
+		uint32_t w = (uint32_t)s2 << 24 | (uint32_t)s << 16 | (uint32_t)s << 8 | s3;
+
+		for (k = 0; k < 4; k++) {
+			Te[k][i] = w;
+			w = w >> 8 | w << 24;
+		}
+	}
+}
+
+static void aes_setup(aes_key *k, const unsigned char *key)
+{
+	static const unsigned char rc[10] = { 1, 2, 4, 8, 16, 32, 64, 128, 0x1b, 0x36 };
+	int i;
+
+	for (i = 0; i < 4; i++) {
+		k->rk[i] = (uint32_t)key[4 * i] << 24 | key[4 * i + 1] << 16
+			| key[4 * i + 2] << 8 | key[4 * i + 3];
+	}
+	for (i = 4; i < 44; i++) {
+		uint32_t t = k->rk[i - 1];
+
+		if (i % 4 == 0) {
+			t = (uint32_t)sbox[t >> 16 & 255] << 24 | (uint32_t)sbox[t >> 8 & 255] << 16
+				| (uint32_t)sbox[t & 255] << 8 | sbox[t >> 24];
+			t ^= (uint32_t)rc[i / 4 - 1] << 24;
+		}
+		k->rk[i] = k->rk[i - 4] ^ t;
+	}
+}
+
+static void aes_enc(const aes_key *k, const unsigned char *in, unsigned char *out)
+{
+	const uint32_t *rk = k->rk;
+	uint32_t s[4], t[4];
+	int i, r;
+
+	for (i = 0; i < 4; i++) {
+		s[i] = ((uint32_t)in[4 * i] << 24 | in[4 * i + 1] << 16
+			| in[4 * i + 2] << 8 | in[4 * i + 3]) ^ rk[i];
+	}
+	for (r = 1; r < 10; r++) {
+		rk += 4;
+		for (i = 0; i < 4; i++) {
+			t[i] = Te[0][s[i] >> 24] ^ Te[1][s[(i + 1) & 3] >> 16 & 255]
+				^ Te[2][s[(i + 2) & 3] >> 8 & 255] ^ Te[3][s[(i + 3) & 3] & 255] ^ rk[i];
+		}
+		memcpy(s, t, 16);
+	}
+	rk += 4;
+	for (i = 0; i < 4; i++) {
+		uint32_t w = (uint32_t)sbox[s[i] >> 24] << 24
+			| (uint32_t)sbox[s[(i + 1) & 3] >> 16 & 255] << 16
+			| (uint32_t)sbox[s[(i + 2) & 3] >> 8 & 255] << 8
+			| sbox[s[(i + 3) & 3] & 255];
+
+		w ^= rk[i];
+		out[4 * i] = w >> 24;
+		out[4 * i + 1] = w >> 16;
+		out[4 * i + 2] = w >> 8;
+		out[4 * i + 3] = w;
+	}
+}
+
+/* ---- GCM ---- */
+
+/* libtomcrypt src/encauth/gcm/gcm_gf_mult.c, generic version */
+static const unsigned char mask[] = { 0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01 };
+static const unsigned char poly[] = { 0x00, 0xE1 };
+
+static void gcm_gf_mult(const unsigned char *a, const unsigned char *b, unsigned char *c)
+{
+	unsigned char Z[16], V[16];
+	unsigned char x, y, z;
+
+	memset(Z, 0, 16);
+	memcpy(V, a, 16);
+	for (x = 0; x < 128; x++) {
+		if (b[x >> 3] & mask[x & 7]) {
+			for (y = 0; y < 16; y++) {
+				Z[y] ^= V[y];
+			}
+		}
+		z = V[15] & 0x01;
+		for (y = 15; y > 0; y--) {
+			V[y] = (V[y] >> 1) | ((V[y - 1] << 7) & 0x80);
+		}
+		V[0] >>= 1;
+		V[0] ^= poly[z];
+	}
+	memcpy(c, Z, 16);
+}
+
+/* gcm_mult_h() as libtomcrypt's gcm_mult_h.c has it without LTC_GCM_TABLES */
+static void mult_bitwise(const gcm_state *gcm, unsigned char *I)
+{
+	unsigned char T[16];
+
+	gcm_gf_mult(gcm->H, I, T);
+	memcpy(I, T, 16);
+}
+
+static void ghash(mult_fn mult, const gcm_state *g, unsigned char *X,
+		const unsigned char *data, unsigned long len)
+{
+	unsigned long p, i;
+
+	for (p = 0; p < len; p += 16) {
+		unsigned long n = len - p < 16 ? len - p : 16;
+
+		for (i = 0; i < n; i++) {
+			X[i] ^= data[p + i];
+		}
+		mult(g, X);
+	}
+}
+
+/* `len` bytes of packet (length field included) in, len + 16 bytes out */
+static void gcm_seal(mult_fn mult, const aes_key *k, const gcm_state *g,
+		const unsigned char *iv, const unsigned char *in, unsigned char *out,
+		unsigned long len)
+{
+	unsigned char Y[16], Y0[16], ks[16], X[16] = { 0 }, L[16];
+	ulong64 alen = 32, clen = (ulong64)(len - 4) * 8;
+	unsigned long p, i;
+	int c;
+
+	memcpy(Y, iv, 12);
+	Y[12] = Y[13] = Y[14] = 0;
+	Y[15] = 1;
+	memcpy(Y0, Y, 16);
+
+	memcpy(out, in, 4);
+	ghash(mult, g, X, in, 4);
+	for (p = 0; p < len - 4; p += 16) {
+		unsigned long n = len - 4 - p < 16 ? len - 4 - p : 16;
+
+		for (c = 15; c >= 12; c--) {
+			if (++Y[c]) {
+				break;
+			}
+		}
+		aes_enc(k, Y, ks);
+		for (i = 0; i < n; i++) {
+			out[4 + p + i] = in[4 + p + i] ^ ks[i];
+		}
+	}
+	ghash(mult, g, X, out + 4, len - 4);
+	STORE64H(alen, L);
+	STORE64H(clen, L + 8);
+	ghash(mult, g, X, L, 16);
+
+	aes_enc(k, Y0, ks);
+	for (i = 0; i < 16; i++) {
+		out[len + i] = X[i] ^ ks[i];
+	}
+}
+
+static void openssl_seal(const unsigned char *key, const unsigned char *iv,
+		const unsigned char *in, unsigned char *out, unsigned long len)
+{
+	EVP_CIPHER_CTX *c = EVP_CIPHER_CTX_new();
+	int l;
+
+	EVP_EncryptInit_ex(c, EVP_aes_128_gcm(), NULL, key, iv);
+	EVP_EncryptUpdate(c, NULL, &l, in, 4);
+	EVP_EncryptUpdate(c, out + 4, &l, in + 4, (int)(len - 4));
+	EVP_EncryptFinal_ex(c, out, &l);
+	memcpy(out, in, 4);
+	EVP_CIPHER_CTX_ctrl(c, EVP_CTRL_GCM_GET_TAG, 16, out + len);
+	EVP_CIPHER_CTX_free(c);
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(void)
+{
+	static unsigned char in[40000], out[40000], ref[40000];
+	static const unsigned long sizes[] = { 64, 1024, 32768 };
+	unsigned char key[16], iv[16] = { 0 }, zero[16] = { 0 };
+	unsigned long len, hits, misses;
+	gcm_state g;
+	aes_key k;
+	unsigned int i;
+
+	aes_tables();
+	for (i = 0; i < 16; i++) {
+		key[i] = i * 11 + 3;
+		iv[i] = i;
+	}
+	aes_setup(&k, key);
+	aes_enc(&k, zero, g.H);
+	for (i = 0; i < sizeof(in); i++) {
+		in[i] = (unsigned char)rand();
+	}
+
+	for (len = 4; len < 1500; len++) {
+		gcm_seal(gcm_mult_h, &k, &g, iv, in, out, len);
+		openssl_seal(key, iv, in, ref, len);
+		if (memcmp(out, ref, len + 16) != 0) {
+			printf("gcm_bench: mismatch with OpenSSL at %lu bytes\n", len);
+			return 1;
+		}
+	}
+	ghash_table_get_stats(&hits, &misses);
+	printf("checked against OpenSSL (table hits %lu, misses %lu)\n", hits, misses);
+
+	for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+		double best[2] = { 0, 0 };
+		int run, v;
+
+		for (run = 0; run < 9; run++) {
+			for (v = 0; v < 2; v++) {
+				unsigned long iters = (v ? 32UL << 20 : 4UL << 20) / sizes[i], n;
+				double t = now(), mbs;
+
+				for (n = 0; n < iters; n++) {
+					gcm_seal(v ? gcm_mult_h : mult_bitwise, &k, &g, iv, in, out, sizes[i]);
+				}
+				mbs = iters * sizes[i] / (now() - t) / 1e6;
+				if (mbs > best[v]) {
+					best[v] = mbs;
+				}
+			}
+		}
+		printf("%6lu B: bitwise GHASH %6.1f MB/s | 4-bit table %6.1f MB/s\n",
+			sizes[i], best[0], best[1]);
+	}
+	return 0;
+}
@@ -0,0 +1,125 @@
+/*
+ * ghash_check.c - port/ghash_table.c against libtomcrypt's bitwise GHASH.
+ *
+ * Multiplies random blocks (and blocks with all-zero halves) by random
+ * hash keys with both gcm_mult_h() and the generic gcm_gf_mult() from
+ * libtomcrypt, and checks the table cache: a key that is in use keeps its
+ * table while other keys come and go, and the least recently used one is
+ * the one that gets rebuilt.
+ */
+
+#include <stdio.h>
+
+#include "tomcrypt.h"
+#include "sdkconfig.h"
+#include "ghash_table.h"
+
+#define ENTRIES  (2 * CONFIG_DROPBEAR_MAX_SESSIONS + 2)
+
+static unsigned int failures;
+
+#define CHECK(cond) do { \
+	if (!(cond)) { \
+		fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond); \
+		failures++; \
+	} \
+} while (0)
+
+/* libtomcrypt src/encauth/gcm/gcm_gf_mult.c, generic version */
+static const unsigned char mask[] = { 0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01 };
+static const unsigned char poly[] = { 0x00, 0xE1 };
+
+static void gcm_gf_mult(const unsigned char *a, const unsigned char *b, unsigned char *c)
+{
+	unsigned char Z[16], V[16];
+	unsigned char x, y, z;
+
+	memset(Z, 0, 16);
+	memcpy(V, a, 16);
+	for (x = 0; x < 128; x++) {
+		if (b[x >> 3] & mask[x & 7]) {
+			for (y = 0; y < 16; y++) {
+				Z[y] ^= V[y];
+			}
+		}
+		z = V[15] & 0x01;
+		for (y = 15; y > 0; y--) {
+			V[y] = (V[y] >> 1) | ((V[y - 1] << 7) & 0x80);
+		}
+		V[0] >>= 1;
+		V[0] ^= poly[z];
+	}
+	memcpy(c, Z, 16);
+}
+
+static void random_block(unsigned char *b)
+{
+	int i;
+
+	for (i = 0; i < 16; i++) {
+		b[i] = (unsigned char)rand();
+	}
+}
+
+/* one multiplication, returns the table misses it caused */
+static unsigned long use_key(const gcm_state *g)
+{
+	unsigned long hits, before, after;
+	unsigned char I[16];
+
+	ghash_table_get_stats(&hits, &before);
+	random_block(I);
+	gcm_mult_h(g, I);
+	ghash_table_get_stats(&hits, &after);
+	return after - before;
+}
+
+int main(void)
+{
+	gcm_state keys[ENTRIES + 1];
+	unsigned char a[16], b[16], ref[16];
+	unsigned int t, i;
+
+	/* products */
+	for (t = 0; t < 100000; t++) {
+		gcm_state g;
+
+		random_block(g.H);
+		random_block(a);
+		if (t & 1) {
+			memset(a + ((t & 2) ? 8 : 0), 0, 8);
+		}
+		memcpy(b, a, 16);
+		gcm_gf_mult(g.H, a, ref);
+		gcm_mult_h(&g, b);
+		CHECK(memcmp(b, ref, 16) == 0);
+	}
+
+	/* fill the cache, one table per key */
+	ghash_table_clear();
+	for (i = 0; i <= ENTRIES; i++) {
+		random_block(keys[i].H);
+	}
+	for (i = 0; i < ENTRIES; i++) {
+		CHECK(use_key(&keys[i]) == 1);
+	}
+
+	/* key 0 moves a bulk transfer; it must not look idle afterwards */
+	for (t = 0; t < 1000; t++) {
+		CHECK(use_key(&keys[0]) == 0);
+	}
+	for (i = 1; i < ENTRIES; i++) {
+		CHECK(use_key(&keys[i]) == 0);
+	}
+	CHECK(use_key(&keys[0]) == 0);
+
+	/* a new key evicts key 1, the least recently used, not key 0 */
+	CHECK(use_key(&keys[ENTRIES]) == 1);
+	CHECK(use_key(&keys[0]) == 0);
+	CHECK(use_key(&keys[2]) == 0);
+	CHECK(use_key(&keys[1]) == 1);
+
+	ghash_table_clear();
+	printf("ghash_check: %s\n", failures ? "FAILED" : "ok");
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,140 @@
+/*
+ * hmac_check.c - port/hmac_cache.c against OpenSSL's HMAC-SHA256.
+ *
+ * MACs packets the way make_mac() in packet.c does (sequence number, then
+ * the packet) with several keys interleaved, keys longer than the block
+ * size, and more keys than the cache holds, and checks that every tag
+ * matches OpenSSL's. Also checks that the cache misses once per key, evicts
+ * the least recently used one, and that hmac_cache_clear() wipes it.
+ */
+
+#include <stdio.h>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+
+#include "tomcrypt.h"
+#include "sdkconfig.h"
+#include "hmac_cache.h"
+
+#define ENTRIES  (2 * CONFIG_DROPBEAR_MAX_SESSIONS + 2)
+
+static unsigned int failures;
+
+#define CHECK(cond) do { \
+	if (!(cond)) { \
+		fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond); \
+		failures++; \
+	} \
+} while (0)
+
+static unsigned char pkt[3000];
+
+static void mac(const unsigned char *key, unsigned long keylen, unsigned int seq,
+		unsigned long len, unsigned char *out)
+{
+	unsigned char sb[4] = { seq >> 24, seq >> 16, seq >> 8, seq };
+	unsigned long outlen = 32;
+	hmac_state h;
+
+	CHECK(hmac_init(&h, 0, key, keylen) == CRYPT_OK);
+	CHECK(h.key == NULL);
+	hmac_process(&h, sb, 4);
+	hmac_process(&h, pkt, len);
+	CHECK(hmac_done(&h, out, &outlen) == CRYPT_OK && outlen == 32);
+}
+
+static int mac_matches(const unsigned char *key, unsigned long keylen,
+		unsigned int seq, unsigned long len)
+{
+	static unsigned char msg[sizeof(pkt) + 4];
+	unsigned char out[32], ref[32];
+	unsigned int rl;
+
+	mac(key, keylen, seq, len, out);
+	msg[0] = seq >> 24;
+	msg[1] = seq >> 16;
+	msg[2] = seq >> 8;
+	msg[3] = seq;
+	memcpy(msg + 4, pkt, len);
+	HMAC(EVP_sha256(), key, (int)keylen, msg, len + 4, ref, &rl);
+	return memcmp(out, ref, 32) == 0;
+}
+
+/* one packet, returns the cache misses it caused */
+static unsigned long use_key(const unsigned char *key)
+{
+	unsigned long hits, before, after;
+
+	hmac_cache_get_stats(&hits, &before);
+	CHECK(mac_matches(key, 32, 0, 64));
+	hmac_cache_get_stats(&hits, &after);
+	return after - before;
+}
+
+int main(void)
+{
+	unsigned char keys[ENTRIES + 1][32], longkey[200];
+	unsigned long hits, misses, after, outlen = 32;
+	unsigned char out[32];
+	unsigned int i, s;
+	hmac_state h;
+
+	for (i = 0; i < sizeof(pkt); i++) {
+		pkt[i] = (unsigned char)rand();
+	}
+	for (i = 0; i <= ENTRIES; i++) {
+		for (s = 0; s < 32; s++) {
+			keys[i][s] = (unsigned char)rand();
+		}
+	}
+	for (i = 0; i < sizeof(longkey); i++) {
+		longkey[i] = (unsigned char)rand();
+	}
+
+	/* tags, more keys than entries, short, block-sized and long keys */
+	for (s = 0; s < 5000; s++) {
+		unsigned long len = (s * 37) % sizeof(pkt);
+
+		CHECK(mac_matches(keys[s % (ENTRIES + 1)], 32, s, len));
+		CHECK(mac_matches(keys[s % 3], 1 + s % 32, s, len));
+		if (s % 50 == 0) {
+			CHECK(mac_matches(longkey, 64, s, len));
+			CHECK(mac_matches(longkey, 65 + s % 100, s, len));
+		}
+	}
+
+	/* one miss per key, then hits */
+	hmac_cache_clear();
+	for (i = 0; i < ENTRIES; i++) {
+		CHECK(use_key(keys[i]) == 1);
+	}
+	for (s = 0; s < 100; s++) {
+		for (i = 0; i < ENTRIES; i++) {
+			CHECK(use_key(keys[i]) == 0);
+		}
+	}
+
+	/* key 0 is refreshed, so a new key evicts key 1 */
+	CHECK(use_key(keys[0]) == 0);
+	CHECK(use_key(keys[ENTRIES]) == 1);
+	CHECK(use_key(keys[0]) == 0);
+	CHECK(use_key(keys[2]) == 0);
+	CHECK(use_key(keys[1]) == 1);
+
+	/* cleared entries are keyed again */
+	hmac_cache_clear();
+	CHECK(use_key(keys[0]) == 1);
+
+	/* bad arguments leave the cache alone */
+	hmac_cache_get_stats(&hits, &misses);
+	CHECK(hmac_init(&h, 0, keys[0], 0) == CRYPT_INVALID_KEYSIZE);
+	CHECK(hmac_init(&h, 1, keys[0], 32) == CRYPT_INVALID_HASH);
+	CHECK(hmac_init(&h, 0, keys[0], 32) == CRYPT_OK);
+	CHECK(hmac_done(&h, out, &outlen) == CRYPT_OK);
+	hmac_cache_get_stats(&hits, &after);
+	CHECK(after == misses);
+
+	hmac_cache_clear();
+	printf("hmac_check: %s\n", failures ? "FAILED" : "ok");
+	return failures ? 1 : 0;
+}
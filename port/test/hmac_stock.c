@@ -0,0 +1,83 @@
+/*
+ * hmac_stock.c - libtomcrypt 1.18's hmac_init() and hmac_done(), renamed,
+ * as the baseline for hmac_bench.c.
+ */
+
+#include "tomcrypt.h"
+
+#define LTC_HMAC_BLOCKSIZE hash_descriptor[hash].blocksize
+
+int stock_hmac_init(hmac_state *hmac, int hash, const unsigned char *key, unsigned long keylen)
+{
+	unsigned char *buf;
+	unsigned long hashsize, i, z;
+	int err;
+
+	if ((err = hash_is_valid(hash)) != CRYPT_OK) {
+		return err;
+	}
+	hmac->hash = hash;
+	hashsize = hash_descriptor[hash].hashsize;
+	if (keylen == 0) {
+		return CRYPT_INVALID_KEYSIZE;
+	}
+
+	buf = XMALLOC(LTC_HMAC_BLOCKSIZE);
+	if (buf == NULL) {
+		return CRYPT_MEM;
+	}
+	hmac->key = XMALLOC(LTC_HMAC_BLOCKSIZE);
+	if (hmac->key == NULL) {
+		XFREE(buf);
+		return CRYPT_MEM;
+	}
+
+	if (keylen > LTC_HMAC_BLOCKSIZE) {
+		z = LTC_HMAC_BLOCKSIZE;
+		hash_memory(hash, key, keylen, hmac->key, &z);
+		keylen = hashsize;
+	} else {
+		XMEMCPY(hmac->key, key, (size_t)keylen);
+	}
+	if (keylen < LTC_HMAC_BLOCKSIZE) {
+		zeromem(hmac->key + keylen, (size_t)(LTC_HMAC_BLOCKSIZE - keylen));
+	}
+
+	for (i = 0; i < LTC_HMAC_BLOCKSIZE; i++) {
+		buf[i] = hmac->key[i] ^ 0x36;
+	}
+	hash_descriptor[hash].init(&hmac->md);
+	hash_descriptor[hash].process(&hmac->md, buf, LTC_HMAC_BLOCKSIZE);
+	XFREE(buf);
+	return CRYPT_OK;
+}
+
+int stock_hmac_done(hmac_state *hmac, unsigned char *out, unsigned long *outlen)
+{
+	unsigned char *buf, *isha;
+	unsigned long hashsize, i;
+	int hash = hmac->hash;
+
+	hashsize = hash_descriptor[hash].hashsize;
+	buf = XMALLOC(LTC_HMAC_BLOCKSIZE);
+	isha = XMALLOC(hashsize);
+
+	hash_descriptor[hash].done(&hmac->md, isha);
+	for (i = 0; i < LTC_HMAC_BLOCKSIZE; i++) {
+		buf[i] = hmac->key[i] ^ 0x5C;
+	}
+	hash_descriptor[hash].init(&hmac->md);
+	hash_descriptor[hash].process(&hmac->md, buf, LTC_HMAC_BLOCKSIZE);
+	hash_descriptor[hash].process(&hmac->md, isha, hashsize);
+	hash_descriptor[hash].done(&hmac->md, buf);
+
+	for (i = 0; i < hashsize && i < *outlen; i++) {
+		out[i] = buf[i];
+	}
+	*outlen = i;
+
+	XFREE(hmac->key);
+	XFREE(isha);
+	XFREE(buf);
+	return CRYPT_OK;
+}
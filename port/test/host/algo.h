@@ -0,0 +1,29 @@
+#pragma once
+
+/* Host stand-in for Dropbear's algo.h: the cipher and mode descriptors. */
+
+struct dropbear_hash {
+	const void *hash_desc;
+	const unsigned long keysize;
+	const unsigned char hashsize;
+};
+
+struct dropbear_cipher {
+	const struct ltc_cipher_descriptor *cipherdesc;
+	const unsigned long keysize;
+	const unsigned char blocksize;
+};
+
+struct dropbear_cipher_mode {
+	int (*start)(int cipher, const unsigned char *IV, const unsigned char *key,
+			int keylen, int num_rounds, void *cipher_state);
+	int (*encrypt)(const unsigned char *pt, unsigned char *ct,
+			unsigned long len, void *cipher_state);
+	int (*decrypt)(const unsigned char *ct, unsigned char *pt,
+			unsigned long len, void *cipher_state);
+	int (*aead_crypt)(unsigned int seq, const unsigned char *in, unsigned char *out,
+			unsigned long len, unsigned long taglen, void *cipher_state, int direction);
+	int (*aead_getlength)(unsigned int seq, const unsigned char *in, unsigned int *outlen,
+			unsigned long len, void *cipher_state);
+	const struct dropbear_hash *aead_mac;
+};
@@ -0,0 +1,74 @@
+/*
+ * buffer.c - buf_new() and the other buffer.c functions the port/ modules
+ * call, as Dropbear has them, for host tests. Kept out of the test files so
+ * that -Wl,--wrap=buf_new reaches the tests' calls.
+ */
+
+#include "includes.h"
+#include "dbutil.h"
+#include "buffer.h"
+
+buffer *buf_new(unsigned int size)
+{
+	buffer *buf;
+
+	if (size > BUF_MAX_SIZE) {
+		dropbear_exit("buf->size too big");
+	}
+	buf = m_malloc(sizeof(buffer) + size);
+	buf->data = (unsigned char *)buf + sizeof(buffer);
+	buf->size = size;
+	return buf;
+}
+
+buffer *buf_resize(buffer *buf, unsigned int newsize)
+{
+	if (newsize > BUF_MAX_SIZE) {
+		dropbear_exit("buf->size too big");
+	}
+	buf = m_realloc(buf, sizeof(buffer) + newsize);
+	buf->data = (unsigned char *)buf + sizeof(buffer);
+	buf->size = newsize;
+	buf->len = MIN(newsize, buf->len);
+	buf->pos = MIN(buf->len, buf->pos);
+	return buf;
+}
+
+void buf_free(buffer *buf)
+{
+	m_free(buf);
+}
+
+static unsigned char *buf_putptr(buffer *buf, unsigned int len)
+{
+	unsigned char *p;
+
+	if (len > buf->size - buf->pos) {
+		dropbear_exit("Bad buf_incrwritepos");
+	}
+	p = buf->data + buf->pos;
+	buf->pos += len;
+	buf->len = MAX(buf->len, buf->pos);
+	return p;
+}
+
+void buf_putbyte(buffer *buf, unsigned char val)
+{
+	*buf_putptr(buf, 1) = val;
+}
+
+void buf_putint(buffer *buf, unsigned int val)
+{
+	unsigned char *p = buf_putptr(buf, 4);
+
+	p[0] = (unsigned char)(val >> 24);
+	p[1] = (unsigned char)(val >> 16);
+	p[2] = (unsigned char)(val >> 8);
+	p[3] = (unsigned char)val;
+}
+
+void buf_putstring(buffer *buf, const char *str, unsigned int len)
+{
+	buf_putint(buf, len);
+	memcpy(buf_putptr(buf, len), str, len);
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+/* Host stand-in for Dropbear's buffer.h. */
+
+#define BUF_MAX_SIZE 1000000000
+
+typedef struct buf {
+	unsigned char *data;
+	unsigned int len;
+	unsigned int pos;
+	unsigned int size;
+} buffer;
+
+buffer *buf_new(unsigned int size);
+buffer *buf_resize(buffer *buf, unsigned int newsize);
+void buf_free(buffer *buf);
+void buf_putbyte(buffer *buf, unsigned char val);
+void buf_putint(buffer *buf, unsigned int val);
+void buf_putstring(buffer *buf, const char *str, unsigned int len);
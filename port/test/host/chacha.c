@@ -0,0 +1,29 @@
+/*
+ * chacha.c - chacha_setup() as libtomcrypt's chacha_setup.c fills in the
+ * constants and key words, for host tests. Nonce and counter are set per
+ * block by port/chachapoly_fused.c.
+ */
+
+#include "tomcrypt.h"
+
+static ulong32 load32_le(const unsigned char *p)
+{
+	return (ulong32)p[0] | (ulong32)p[1] << 8 | (ulong32)p[2] << 16 | (ulong32)p[3] << 24;
+}
+
+int chacha_setup(chacha_state *st, const unsigned char *key, unsigned long keylen, int rounds)
+{
+	static const unsigned char sigma[16] = "expand 32-byte k";
+	int i;
+
+	LTC_ARGCHK(keylen == 32);
+	memset(st, 0, sizeof(*st));
+	for (i = 0; i < 4; i++) {
+		st->input[i] = load32_le(sigma + 4 * i);
+	}
+	for (i = 0; i < 8; i++) {
+		st->input[4 + i] = load32_le(key + 4 * i);
+	}
+	st->rounds = rounds;
+	return CRYPT_OK;
+}
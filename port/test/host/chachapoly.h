@@ -0,0 +1,11 @@
+#pragma once
+
+/* Host stand-in for Dropbear's chachapoly.h. */
+
+typedef struct {
+	chacha_state chacha;
+	chacha_state header;
+} dropbear_chachapoly_state;
+
+extern const struct dropbear_cipher dropbear_chachapoly;
+extern const struct dropbear_cipher_mode dropbear_mode_chachapoly;
@@ -0,0 +1,12 @@
+#pragma once
+
+/* Host stand-in for Dropbear's curve25519.h. */
+
+void dropbear_curve25519_scalarmult(unsigned char *q, const unsigned char *n, const unsigned char *p);
+void dropbear_ed25519_make_key(unsigned char *pk, unsigned char *sk);
+void dropbear_ed25519_sign(const unsigned char *m, unsigned long mlen,
+		unsigned char *s, unsigned long *slen,
+		const unsigned char *sk, const unsigned char *pk);
+int dropbear_ed25519_verify(const unsigned char *m, unsigned long mlen,
+		const unsigned char *s, unsigned long slen,
+		const unsigned char *pk);
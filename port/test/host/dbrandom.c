@@ -0,0 +1,14 @@
+/*
+ * dbrandom.c - genrandom() for host tests: rand(), so runs are repeatable.
+ * Not for anything but tests.
+ */
+
+#include "includes.h"
+#include "dbrandom.h"
+
+void genrandom(unsigned char *buf, unsigned int len)
+{
+	while (len--) {
+		*buf++ = (unsigned char)rand();
+	}
+}
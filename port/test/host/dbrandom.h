@@ -0,0 +1,6 @@
+#pragma once
+
+/* Host stand-in for Dropbear's dbrandom.h. */
+
+void seedrandom(void);
+void genrandom(unsigned char *buf, unsigned int len);
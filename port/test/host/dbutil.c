@@ -0,0 +1,56 @@
+/*
+ * dbutil.c - The dbutil.c helpers the port/ modules call, for host tests.
+ */
+
+#include "includes.h"
+#include "dbutil.h"
+
+static void fail_exit(int exitcode, const char *format, va_list param) ATTRIB_NORETURN;
+static void fail_exit(int exitcode, const char *format, va_list param)
+{
+	(void)exitcode;
+	fprintf(stderr, "dropbear_exit: ");
+	vfprintf(stderr, format, param);
+	fprintf(stderr, "\n");
+	abort();
+}
+
+void (*_dropbear_exit)(int exitcode, const char *format, va_list param) ATTRIB_NORETURN = fail_exit;
+
+/* as Dropbear's: through _dropbear_exit, which a test may replace */
+void dropbear_exit(const char *format, ...)
+{
+	va_list ap;
+
+	va_start(ap, format);
+	_dropbear_exit(EXIT_FAILURE, format, ap);
+	va_end(ap);
+}
+
+/* tests check results, not log lines */
+void dropbear_log(int priority, const char *format, ...)
+{
+	(void)priority;
+	(void)format;
+}
+
+void m_burn(void *data, unsigned int len)
+{
+	volatile unsigned char *p = data;
+
+	while (len--) {
+		*p++ = 0;
+	}
+}
+
+int constant_time_memcmp(const void *a, const void *b, size_t n)
+{
+	const unsigned char *x = a, *y = b;
+	unsigned char d = 0;
+	size_t i;
+
+	for (i = 0; i < n; i++) {
+		d |= x[i] ^ y[i];
+	}
+	return d;
+}
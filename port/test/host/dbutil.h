@@ -0,0 +1,18 @@
+#pragma once
+
+/* Host stand-in for Dropbear's dbutil.h. */
+
+void dropbear_exit(const char *format, ...) ATTRIB_NORETURN;
+extern void (*_dropbear_exit)(int exitcode, const char *format, va_list param) ATTRIB_NORETURN;
+void dropbear_log(int priority, const char *format, ...);
+
+void *m_malloc(size_t size);
+void *m_calloc(size_t nmemb, size_t size);
+void *m_realloc(void *ptr, size_t size);
+void *m_strdup(const char *str);
+#define m_free(x) do { free(x); (x) = NULL; } while (0)
+
+time_t monotonic_now(void);
+
+void m_burn(void *data, unsigned int len);
+int constant_time_memcmp(const void *a, const void *b, size_t n);
@@ -0,0 +1,14 @@
+#pragma once
+
+/* Host stand-in for Dropbear's ecc.h: the curves kex_pregen.c compares. */
+
+#include "tomcrypt.h"
+
+struct dropbear_ecc_curve {
+	int ltc_size;
+	const ltc_ecc_set_type *dp;
+	const char *name;
+};
+
+extern struct dropbear_ecc_curve ecc_curve_nistp256;
+extern struct dropbear_ecc_curve ecc_curve_nistp384;
@@ -0,0 +1,7 @@
+#pragma once
+
+/* Host stand-in for ESP-IDF's esp_random.h. */
+
+#include <stddef.h>
+
+void esp_fill_random(void *buf, size_t len);
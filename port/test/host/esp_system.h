@@ -0,0 +1,7 @@
+#pragma once
+
+/* Host stand-in for ESP-IDF's esp_system.h; the test sets the value. */
+
+#include <stddef.h>
+
+size_t esp_get_free_heap_size(void);
@@ -0,0 +1,15 @@
+#pragma once
+
+/* Host stand-in for FreeRTOS.h: what the port/ modules under test use. */
+
+#include <stdint.h>
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+
+#define configMAX_TASK_NAME_LEN 16
+#define portMAX_DELAY ((TickType_t)0xffffffffUL)
+#define pdTRUE  1
+#define pdFALSE 0
+#define pdPASS  1
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
@@ -0,0 +1,14 @@
+#pragma once
+
+/*
+ * Host stand-in for FreeRTOS queue.h. The tests define these functions
+ * themselves.
+ */
+
+#include "freertos/FreeRTOS.h"
+
+typedef void *QueueHandle_t;
+
+QueueHandle_t xQueueCreate(unsigned int length, unsigned int item_size);
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t wait);
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t wait);
@@ -0,0 +1,39 @@
+#pragma once
+
+/*
+ * Host stand-in for FreeRTOS mutexes, on pthread mutexes. Modules create
+ * theirs once and never delete them, so they come from a small static pool.
+ */
+
+#include <stddef.h>
+#include <pthread.h>
+#include "freertos/FreeRTOS.h"
+
+typedef pthread_mutex_t *SemaphoreHandle_t;
+
+static inline SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+	static pthread_mutex_t pool[16];
+	static unsigned int used;
+
+	if (used == sizeof(pool) / sizeof(pool[0])) {
+		return NULL;
+	}
+	pthread_mutex_init(&pool[used], NULL);
+	return &pool[used++];
+}
+
+static inline int xSemaphoreTake(SemaphoreHandle_t m, TickType_t wait)
+{
+	(void)wait;
+	return pthread_mutex_lock(m) == 0;
+}
+
+static inline int xSemaphoreGive(SemaphoreHandle_t m)
+{
+	return pthread_mutex_unlock(m) == 0;
+}
+
+/* counting semaphores: the tests that need them define these */
+SemaphoreHandle_t xSemaphoreCreateCounting(unsigned int max, unsigned int initial);
+unsigned int uxSemaphoreGetCount(SemaphoreHandle_t sem);
@@ -0,0 +1,18 @@
+#pragma once
+
+/*
+ * Host stand-in for FreeRTOS task.h. The tests define these functions
+ * themselves, so they decide when a task runs.
+ */
+
+#include "freertos/FreeRTOS.h"
+
+typedef void *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *);
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack,
+	void *arg, unsigned int priority, TaskHandle_t *handle);
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t wait);
+void xTaskNotifyGive(TaskHandle_t task);
+void vTaskDelay(TickType_t ticks);
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
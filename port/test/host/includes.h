@@ -0,0 +1,43 @@
+#pragma once
+
+/*
+ * Host stand-in for Dropbear's includes.h: just the system headers and
+ * macros the port/ modules under test use. See ../Makefile.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/select.h>
+
+#include "tomcrypt.h"
+
+#define DROPBEAR_SUCCESS 0
+#define DROPBEAR_FAILURE -1
+#define ATTRIB_NORETURN __attribute__((noreturn))
+#define TRACE(x)
+#define TRACE2(x)
+#define UNUSED(x) x __attribute__((unused))
+
+/* syslog priorities, as ../config.h defines them */
+#define LOG_WARNING 3
+#define LOG_INFO 4
+
+/* sysoptions.h */
+#define DROPBEAR_CURVE25519_DEP 1
+#define DROPBEAR_CHACHA20POLY1305 1
+#define DROPBEAR_SNTRUP761 1
+#define DROPBEAR_MLKEM768 1
+#define DROPBEAR_ECDH 1
+
+#ifndef MAX
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+#endif
+#ifndef MIN
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#endif
@@ -0,0 +1,16 @@
+#pragma once
+
+/* Host stand-in for Dropbear's kex.h: the X25519 and ECDH key pairs. */
+
+#include "tomcrypt.h"
+
+#define CURVE25519_LEN 32
+
+struct kex_curve25519_param {
+	unsigned char priv[CURVE25519_LEN];
+	unsigned char pub[CURVE25519_LEN];
+};
+
+struct kex_ecdh_param {
+	ecc_key key;
+};
@@ -0,0 +1,44 @@
+#pragma once
+
+/*
+ * Host stand-in for lwIP's api.h, with the lwIP types and error codes it
+ * brings along: the netconn calls port/netconn_lwip.c makes. The tests
+ * define the functions.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef uint8_t u8_t;
+typedef uint16_t u16_t;
+typedef uint32_t u32_t;
+typedef int32_t s32_t;
+typedef int8_t err_t;
+
+#define ERR_OK          0
+#define ERR_WOULDBLOCK  -7
+#define ERR_CONN        -11
+
+/* lwipopts.h */
+#define LWIP_NETIF_TX_SINGLE_PBUF 0
+
+#define NETCONN_NOCOPY     0x00
+#define NETCONN_COPY       0x01
+#define NETCONN_DONTBLOCK  0x04
+
+struct tcp_pcb;
+
+struct netconn {
+	union {
+		struct tcp_pcb *tcp;
+	} pcb;
+};
+
+struct netvector {
+	const void *ptr;
+	size_t len;
+};
+
+err_t netconn_write_vectors_partly(struct netconn *conn, struct netvector *vectors,
+	u16_t vectorcnt, u8_t apiflags, size_t *bytes_written);
+int err_to_errno(err_t err);
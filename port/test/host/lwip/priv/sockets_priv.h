@@ -0,0 +1,12 @@
+#pragma once
+
+/* Host stand-in for lwIP's priv/sockets_priv.h: socket to netconn. */
+
+#include "lwip/api.h"
+
+struct lwip_sock {
+	struct netconn *conn;
+};
+
+/* NULL for a descriptor that is not an lwIP socket */
+struct lwip_sock *lwip_socket_dbg_get_socket(int fd);
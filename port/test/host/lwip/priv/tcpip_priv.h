@@ -0,0 +1,13 @@
+#pragma once
+
+/* Host stand-in for lwIP's priv/tcpip_priv.h: calls into the TCP/IP task. */
+
+#include "lwip/api.h"
+
+struct tcpip_api_call_data {
+	int unused;
+};
+
+typedef err_t (*tcpip_api_call_fn)(struct tcpip_api_call_data *call);
+
+err_t tcpip_api_call(tcpip_api_call_fn fn, struct tcpip_api_call_data *call);
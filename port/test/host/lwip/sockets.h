@@ -0,0 +1,7 @@
+#pragma once
+
+/* Host stand-in for lwIP's sockets.h: lwip_writev() is the host's writev(). */
+
+#include <sys/uio.h>
+
+#define lwip_writev writev
@@ -0,0 +1,12 @@
+#pragma once
+
+/* Host stand-in for lwIP's tcp.h: the pcb fields port/netconn_lwip.c reads. */
+
+#include "lwip/api.h"
+
+struct tcp_pcb {
+	u32_t snd_lbb;          /* sequence number of the next byte queued */
+	u32_t lastack;          /* highest sequence number acked */
+};
+
+void tcp_abort(struct tcp_pcb *pcb);
@@ -0,0 +1,6 @@
+#pragma once
+
+/* Host stand-in for Dropbear's packet.h. */
+
+void encrypt_packet(void);
+void write_packet(void);
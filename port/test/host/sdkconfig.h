@@ -0,0 +1,16 @@
+#pragma once
+
+/* Host stand-in for the generated sdkconfig.h. */
+
+#define CONFIG_DROPBEAR_MAX_SESSIONS 2
+#define CONFIG_DROPBEAR_SESSION_ARENA 1
+#define CONFIG_DROPBEAR_SESSION_ARENA_SIZE 65536
+#define CONFIG_DROPBEAR_PACKET_POOL 1
+
+#ifndef CONFIG_DROPBEAR_ED25519_BASE_TABLE_STRIDE
+#define CONFIG_DROPBEAR_ED25519_BASE_TABLE_STRIDE 0
+#endif
+
+#define CONFIG_DROPBEAR_KEX_PREGEN 1
+#define CONFIG_DROPBEAR_KEX_PREGEN_DEPTH 2
+#define CONFIG_DROPBEAR_KEX_PREGEN_PRIORITY 1
@@ -0,0 +1,50 @@
+#pragma once
+
+/*
+ * Host stand-in for Dropbear's session.h: the fields session_pool.c and
+ * kex_pregen.c use.
+ */
+
+#include "buffer.h"
+
+/* queue.h */
+struct Queue {
+	struct Link *head;
+	struct Link *tail;
+	unsigned int count;
+};
+
+int isempty(struct Queue *queue);
+
+struct AuthState {
+	int authdone;
+	unsigned int failcount;
+	char *pw_name;
+};
+
+struct dropbear_kex {
+	const struct dropbear_ecc_curve *ecc_curve;
+};
+
+struct key_context {
+	const struct dropbear_kex *algo_kex;
+};
+
+struct sshsession {
+	struct key_context *newkeys;
+	buffer *writepayload;
+	struct Queue writequeue;
+	time_t last_packet_time_idle;
+	struct AuthState authstate;
+};
+
+struct serversession {
+	char *addrstring;
+};
+
+extern struct sshsession ses;
+extern struct serversession svr_ses;
+
+void svr_session(int sock, int childpipe) ATTRIB_NORETURN;
+void session_cleanup(void);
+void svr_dropbear_exit(int exitcode, const char *format, va_list param) ATTRIB_NORETURN;
@@ -0,0 +1,156 @@
+/*
+ * sha256.c - SHA-256 in portable C as libtomcrypt's sha256.c has it (no
+ * SHA extensions), the hash descriptor table, hash_memory() and
+ * hmac_process(), for host tests and benchmarks.
+ */
+
+#include "tomcrypt.h"
+
+static const ulong32 K[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+#define ROR(x, n)  (((x) >> (n)) | ((x) << (32 - (n))))
+
+static void sha256_compress(struct sha256_state *md, const unsigned char *buf)
+{
+	ulong32 W[64], S[8], t0, t1;
+	int i;
+
+	for (i = 0; i < 8; i++) {
+		S[i] = md->state[i];
+	}
+	for (i = 0; i < 16; i++) {
+		W[i] = (ulong32)buf[4 * i] << 24 | (ulong32)buf[4 * i + 1] << 16
+			| (ulong32)buf[4 * i + 2] << 8 | buf[4 * i + 3];
+	}
+	for (i = 16; i < 64; i++) {
+		W[i] = (ROR(W[i - 2], 17) ^ ROR(W[i - 2], 19) ^ (W[i - 2] >> 10)) + W[i - 7]
+			+ (ROR(W[i - 15], 7) ^ ROR(W[i - 15], 18) ^ (W[i - 15] >> 3)) + W[i - 16];
+	}
+	for (i = 0; i < 64; i++) {
+		t0 = S[7] + (ROR(S[4], 6) ^ ROR(S[4], 11) ^ ROR(S[4], 25))
+			+ ((S[4] & S[5]) ^ (~S[4] & S[6])) + K[i] + W[i];
+		t1 = (ROR(S[0], 2) ^ ROR(S[0], 13) ^ ROR(S[0], 22))
+			+ ((S[0] & S[1]) | (S[2] & (S[0] | S[1])));
+		S[7] = S[6];
+		S[6] = S[5];
+		S[5] = S[4];
+		S[4] = S[3] + t0;
+		S[3] = S[2];
+		S[2] = S[1];
+		S[1] = S[0];
+		S[0] = t0 + t1;
+	}
+	for (i = 0; i < 8; i++) {
+		md->state[i] += S[i];
+	}
+}
+
+static int sha256_init(hash_state *md)
+{
+	static const ulong32 iv[8] = {
+		0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A,
+		0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19
+	};
+
+	memcpy(md->sha256.state, iv, sizeof(iv));
+	md->sha256.curlen = 0;
+	md->sha256.length = 0;
+	return CRYPT_OK;
+}
+
+static int sha256_process(hash_state *md, const unsigned char *in, unsigned long inlen)
+{
+	struct sha256_state *s = &md->sha256;
+
+	while (inlen > 0) {
+		if (s->curlen == 0 && inlen >= 64) {
+			sha256_compress(s, in);
+			s->length += 512;
+			in += 64;
+			inlen -= 64;
+		} else {
+			unsigned long n = 64 - s->curlen;
+
+			if (n > inlen) {
+				n = inlen;
+			}
+			memcpy(s->buf + s->curlen, in, n);
+			s->curlen += n;
+			in += n;
+			inlen -= n;
+			if (s->curlen == 64) {
+				sha256_compress(s, s->buf);
+				s->length += 512;
+				s->curlen = 0;
+			}
+		}
+	}
+	return CRYPT_OK;
+}
+
+static int sha256_done(hash_state *md, unsigned char *out)
+{
+	struct sha256_state *s = &md->sha256;
+	int i;
+
+	s->length += s->curlen * 8ULL;
+	s->buf[s->curlen++] = 0x80;
+	if (s->curlen > 56) {
+		while (s->curlen < 64) {
+			s->buf[s->curlen++] = 0;
+		}
+		sha256_compress(s, s->buf);
+		s->curlen = 0;
+	}
+	while (s->curlen < 56) {
+		s->buf[s->curlen++] = 0;
+	}
+	STORE64H(s->length, s->buf + 56);
+	sha256_compress(s, s->buf);
+	for (i = 0; i < 8; i++) {
+		out[4 * i] = (unsigned char)(s->state[i] >> 24);
+		out[4 * i + 1] = (unsigned char)(s->state[i] >> 16);
+		out[4 * i + 2] = (unsigned char)(s->state[i] >> 8);
+		out[4 * i + 3] = (unsigned char)s->state[i];
+	}
+	return CRYPT_OK;
+}
+
+const struct ltc_hash_descriptor hash_descriptor[] = {
+	{ "sha256", 32, 64, sha256_init, sha256_process, sha256_done },
+};
+
+int hash_is_valid(int idx)
+{
+	return idx == 0 ? CRYPT_OK : CRYPT_INVALID_HASH;
+}
+
+int hash_memory(int hash, const unsigned char *in, unsigned long inlen,
+		unsigned char *out, unsigned long *outlen)
+{
+	hash_state md;
+
+	if (hash_is_valid(hash) != CRYPT_OK || *outlen < hash_descriptor[hash].hashsize) {
+		return CRYPT_INVALID_HASH;
+	}
+	hash_descriptor[hash].init(&md);
+	hash_descriptor[hash].process(&md, in, inlen);
+	hash_descriptor[hash].done(&md, out);
+	*outlen = hash_descriptor[hash].hashsize;
+	return CRYPT_OK;
+}
+
+/* libtomcrypt's hmac_process.c */
+int hmac_process(hmac_state *hmac, const unsigned char *in, unsigned long inlen)
+{
+	return hash_descriptor[hmac->hash].process(&hmac->md, in, inlen);
+}
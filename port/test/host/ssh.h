@@ -0,0 +1,5 @@
+#pragma once
+
+/* Host stand-in for Dropbear's ssh.h. */
+
+#define SSH_MSG_DISCONNECT 1
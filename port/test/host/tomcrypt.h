@@ -0,0 +1,178 @@
+#pragma once
+
+/*
+ * Host stand-in for libtomcrypt's tomcrypt.h: the types, macros and helpers
+ * the port/ replacements of libtomcrypt files use.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <openssl/sha.h>
+
+#define LTC_GCM_MODE
+#define LTC_HMAC
+#define LTC_CHACHA
+
+#define CRYPT_OK                0
+#define CRYPT_ERROR             1
+#define CRYPT_INVALID_KEYSIZE   3
+#define CRYPT_MEM               13
+#define CRYPT_INVALID_HASH      22
+
+#define MAXBLOCKSIZE            144
+
+#define LTC_ENCRYPT             0
+#define LTC_DECRYPT             1
+
+typedef uint64_t ulong64;
+typedef uint32_t ulong32;
+
+#define CONST64(x) x##ULL
+#define XMEMCPY memcpy
+#define XMALLOC malloc
+#define XFREE free
+
+#define LTC_ARGCHK(x) do { if (!(x)) abort(); } while (0)
+#define LTC_ARGCHKVD(x) LTC_ARGCHK(x)
+
+#define LOAD64H(x, y) do { \
+	int _i; \
+	(x) = 0; \
+	for (_i = 0; _i < 8; _i++) (x) = ((x) << 8) | (y)[_i]; \
+} while (0)
+
+#define STORE64H(x, y) do { \
+	int _i; \
+	for (_i = 0; _i < 8; _i++) (y)[_i] = (unsigned char)((x) >> (56 - 8 * _i)); \
+} while (0)
+
+static inline void zeromem(volatile void *out, size_t outlen)
+{
+	volatile unsigned char *p = out;
+
+	while (outlen--) {
+		*p++ = 0;
+	}
+}
+
+struct ltc_cipher_descriptor {
+	const char *name;
+};
+
+typedef struct {
+	ulong32 input[16];
+	unsigned char kstream[64];
+	unsigned long ksleft;
+	unsigned long ivlen;
+	int rounds;
+} chacha_state;
+
+/* host/chacha.c: the key words only, as libtomcrypt's chacha_setup() */
+int chacha_setup(chacha_state *st, const unsigned char *key, unsigned long keylen, int rounds);
+
+/* gcm_mult_h() only reads H */
+typedef struct {
+	unsigned char H[16];
+} gcm_state;
+
+void gcm_mult_h(const gcm_state *gcm, unsigned char *I);
+
+static inline int mem_neq(const void *a, const void *b, size_t len)
+{
+	const unsigned char *x = a, *y = b;
+	unsigned char d = 0;
+
+	while (len--) {
+		d |= *x++ ^ *y++;
+	}
+	return d != 0;
+}
+
+/* SHA-256 is libtomcrypt's portable C code (host/sha256.c), SHA-512 is OpenSSL's */
+struct sha256_state {
+	ulong64 length;
+	ulong32 state[8], curlen;
+	unsigned char buf[64];
+};
+
+typedef union {
+	struct sha256_state sha256;
+	SHA512_CTX sha512;
+} hash_state;
+
+struct ltc_hash_descriptor {
+	const char *name;
+	unsigned long hashsize;
+	unsigned long blocksize;
+	int (*init)(hash_state *hash);
+	int (*process)(hash_state *hash, const unsigned char *in, unsigned long inlen);
+	int (*done)(hash_state *hash, unsigned char *out);
+};
+
+/* host/sha256.c: index 0 is SHA-256 */
+extern const struct ltc_hash_descriptor hash_descriptor[];
+int hash_is_valid(int idx);
+int hash_memory(int hash, const unsigned char *in, unsigned long inlen,
+		unsigned char *out, unsigned long *outlen);
+
+typedef struct Hmac_state {
+	hash_state md;
+	int hash;
+	hash_state hashstate;
+	unsigned char *key;
+} hmac_state;
+
+int hmac_init(hmac_state *hmac, int hash, const unsigned char *key, unsigned long keylen);
+int hmac_process(hmac_state *hmac, const unsigned char *in, unsigned long inlen);
+int hmac_done(hmac_state *hmac, unsigned char *out, unsigned long *outlen);
+
+/* ECC, for kex_pregen.c: the key is whatever the test's ecc_make_key_ex() makes */
+typedef struct {
+	int size;
+	const char *name;
+} ltc_ecc_set_type;
+
+typedef struct {
+	void *ec;
+} ecc_key;
+
+typedef struct {
+	int unused;
+} prng_state;
+
+struct ltc_prng_descriptor {
+	const char *name;
+	int export_size;
+	int (*start)(prng_state *prng);
+	int (*add_entropy)(const unsigned char *in, unsigned long inlen, prng_state *prng);
+	int (*ready)(prng_state *prng);
+	unsigned long (*read)(unsigned char *out, unsigned long outlen, prng_state *prng);
+	int (*done)(prng_state *prng);
+	int (*pexport)(unsigned char *out, unsigned long *outlen, prng_state *prng);
+	int (*pimport)(const unsigned char *in, unsigned long inlen, prng_state *prng);
+	int (*test)(void);
+};
+
+int register_prng(const struct ltc_prng_descriptor *prng);
+int ecc_make_key_ex(prng_state *prng, int wprng, ecc_key *key, const ltc_ecc_set_type *dp);
+void ecc_free(ecc_key *key);
+
+static inline int sha512_init(hash_state *md)
+{
+	SHA512_Init(&md->sha512);
+	return CRYPT_OK;
+}
+
+static inline int sha512_process(hash_state *md, const unsigned char *in, unsigned long inlen)
+{
+	SHA512_Update(&md->sha512, in, inlen);
+	return CRYPT_OK;
+}
+
+static inline int sha512_done(hash_state *md, unsigned char *out)
+{
+	SHA512_Final(out, &md->sha512);
+	return CRYPT_OK;
+}
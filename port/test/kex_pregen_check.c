@@ -0,0 +1,293 @@
+/*
+ * kex_pregen_check.c - kex_pregen.c's key pools.
+ *
+ * The pregeneration task is run by hand, until it would block waiting for
+ * a notification or sleep before a retry. Checks that each pair is a valid
+ * X25519 pair and is handed out once, that an empty pool falls back to
+ * Dropbear's own gen_kexcurve25519_param(), and that the task refills the
+ * pool after a handshake takes from it. Then the same for P-256 pairs,
+ * which libtomcrypt would make here (OpenSSL's P-256 from the bytes of
+ * the PRNG kex_pregen.c registered): other curves and a low heap go
+ * inline.
+ */
+
+#include "includes.h"
+#include "dbutil.h"
+#include "kex.h"
+#include "curve25519.h"
+#include "sdkconfig.h"
+#include "kex_pregen.h"
+#include "ecc.h"
+#include "session.h"
+
+#include <setjmp.h>
+#include <openssl/bn.h>
+#include <openssl/ec.h>
+#include <openssl/obj_mac.h>
+#include <openssl/rand.h>
+
+#include "esp_random.h"
+#include "esp_system.h"
+#include "freertos/task.h"
+
+#define DEPTH CONFIG_DROPBEAR_KEX_PREGEN_DEPTH
+
+static unsigned int failures;
+
+#define CHECK(cond) do { \
+	if (!(cond)) { \
+		fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond); \
+		failures++; \
+	} \
+} while (0)
+
+struct kex_curve25519_param *__wrap_gen_kexcurve25519_param(void);
+struct kex_ecdh_param *__wrap_gen_kexecdh_param(void);
+
+struct sshsession ses;
+
+static TaskFunction_t task_fn;
+static jmp_buf task_blocked;
+static unsigned int notified, delays, inline_pairs, inline_ecdh;
+static size_t free_heap = 200000;
+
+/* ---- FreeRTOS and ESP-IDF, driven by the test ---- */
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack,
+	void *arg, unsigned int priority, TaskHandle_t *handle)
+{
+	(void)name;
+	(void)stack;
+	(void)arg;
+	(void)priority;
+	task_fn = fn;
+	*handle = &task_fn;
+	return pdPASS;
+}
+
+/* the task would block here: back to run_task() */
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t wait)
+{
+	(void)clear;
+	(void)wait;
+	longjmp(task_blocked, 1);
+}
+
+void xTaskNotifyGive(TaskHandle_t task)
+{
+	CHECK(task == &task_fn);
+	notified++;
+}
+
+/* the task would sleep before retrying: back to run_task() too */
+void vTaskDelay(TickType_t ticks)
+{
+	(void)ticks;
+	delays++;
+	longjmp(task_blocked, 1);
+}
+
+void esp_fill_random(void *buf, size_t len)
+{
+	RAND_bytes(buf, (int)len);
+}
+
+size_t esp_get_free_heap_size(void)
+{
+	return free_heap;
+}
+
+/* ---- libtomcrypt's ECC, on OpenSSL ---- */
+
+static const ltc_ecc_set_type p256 = { 32, "ECC-256" }, p384 = { 48, "ECC-384" };
+struct dropbear_ecc_curve ecc_curve_nistp256 = { 32, &p256, "nistp256" };
+struct dropbear_ecc_curve ecc_curve_nistp384 = { 48, &p384, "nistp384" };
+
+static const struct ltc_prng_descriptor *prng_registered;
+
+int register_prng(const struct ltc_prng_descriptor *prng)
+{
+	prng_registered = prng;
+	return 0;
+}
+
+/* The private key is read from the PRNG, as libtomcrypt does. */
+int ecc_make_key_ex(prng_state *prng, int wprng, ecc_key *key, const ltc_ecc_set_type *dp)
+{
+	unsigned char k[32];
+	EC_POINT *pub;
+	BIGNUM *bn;
+	EC_KEY *ec;
+
+	CHECK(wprng == 0 && prng_registered != NULL && dp == &p256);
+	if (prng_registered->read(k, sizeof(k), prng) != sizeof(k)) {
+		return CRYPT_ERROR;
+	}
+	ec = EC_KEY_new_by_curve_name(NID_X9_62_prime256v1);
+	bn = BN_bin2bn(k, sizeof(k), NULL);
+	pub = EC_POINT_new(EC_KEY_get0_group(ec));
+	EC_POINT_mul(EC_KEY_get0_group(ec), pub, bn, NULL, NULL, NULL);
+	EC_KEY_set_private_key(ec, bn);
+	EC_KEY_set_public_key(ec, pub);
+	EC_POINT_free(pub);
+	BN_clear_free(bn);
+	key->ec = ec;
+	return CRYPT_OK;
+}
+
+void ecc_free(ecc_key *key)
+{
+	EC_KEY_free(key->ec);
+}
+
+/* Dropbear's kex-x25519.c, for an empty pool */
+struct kex_curve25519_param *__real_gen_kexcurve25519_param(void)
+{
+	struct kex_curve25519_param *param = malloc(sizeof(*param));
+
+	if (param == NULL) {
+		abort();
+	}
+	memset(param->priv, 0xee, sizeof(param->priv));
+	memset(param->pub, 0xee, sizeof(param->pub));
+	inline_pairs++;
+	return param;
+}
+
+/* Dropbear's gen_kexecdh_param(), for an empty pool and the other curves */
+struct kex_ecdh_param *__real_gen_kexecdh_param(void)
+{
+	struct kex_ecdh_param *param = calloc(1, sizeof(*param));
+
+	if (param == NULL) {
+		abort();
+	}
+	inline_ecdh++;
+	return param;
+}
+
+/* ---- test ---- */
+
+static void run_task(void)
+{
+	if (setjmp(task_blocked) == 0) {
+		task_fn(NULL);
+	}
+}
+
+static int valid_pair(const struct kex_curve25519_param *param)
+{
+	static const unsigned char basepoint[32] = {9};
+	unsigned char pub[CURVE25519_LEN];
+
+	dropbear_curve25519_scalarmult(pub, param->priv, basepoint);
+	return memcmp(pub, param->pub, sizeof(pub)) == 0;
+}
+
+static void free_ecdh(struct kex_ecdh_param *param)
+{
+	ecc_free(&param->key);
+	free(param);
+}
+
+static void check_ecdh(void)
+{
+	static const struct dropbear_kex nistp256 = { &ecc_curve_nistp256 };
+	static const struct dropbear_kex nistp384 = { &ecc_curve_nistp384 };
+	struct key_context keys = { &nistp256 };
+	struct kex_ecdh_param *pairs[DEPTH + 1];
+	unsigned long hits, misses, hits_before, misses_before;
+	unsigned int i, j;
+
+	kex_pregen_get_stats(&hits_before, &misses_before);
+	ses.newkeys = &keys;
+	notified = 0;
+
+	/* filled by the first run, with the X25519 pool */
+	for (i = 0; i < DEPTH; i++) {
+		pairs[i] = __wrap_gen_kexecdh_param();
+		CHECK(pairs[i]->key.ec != NULL && EC_KEY_check_key(pairs[i]->key.ec) == 1);
+		for (j = 0; j < i; j++) {
+			CHECK(BN_cmp(EC_KEY_get0_private_key(pairs[j]->key.ec),
+				EC_KEY_get0_private_key(pairs[i]->key.ec)) != 0);
+		}
+	}
+	CHECK(notified == DEPTH && inline_ecdh == 0);
+
+	/* empty, then another curve: inline */
+	pairs[DEPTH] = __wrap_gen_kexecdh_param();
+	CHECK(inline_ecdh == 1 && pairs[DEPTH]->key.ec == NULL);
+	free(pairs[DEPTH]);
+	keys.algo_kex = &nistp384;
+	run_task();
+	free(__wrap_gen_kexecdh_param());
+	CHECK(inline_ecdh == 2);
+
+	/* low on heap: the task waits rather than risk libtommath's m_malloc() */
+	keys.algo_kex = &nistp256;
+	for (i = 0; i < DEPTH; i++) {
+		free_ecdh(__wrap_gen_kexecdh_param());
+	}
+	delays = 0;
+	free_heap = 8000;
+	run_task();
+	CHECK(delays == 1);
+	free(__wrap_gen_kexecdh_param());
+	CHECK(inline_ecdh == 3);
+	free_heap = 200000;
+	run_task();
+	pairs[DEPTH] = __wrap_gen_kexecdh_param();
+	CHECK(inline_ecdh == 3 && EC_KEY_check_key(pairs[DEPTH]->key.ec) == 1);
+
+	kex_pregen_get_stats(&hits, &misses);
+	CHECK(hits - hits_before == 2 * DEPTH + 1 && misses - misses_before == 3);
+
+	for (i = 0; i <= DEPTH; i++) {
+		free_ecdh(pairs[i]);
+	}
+}
+
+int main(void)
+{
+	struct kex_curve25519_param *pairs[DEPTH + 1];
+	unsigned long hits, misses;
+	unsigned int i, j;
+
+	kex_pregen_init();
+	CHECK(task_fn != NULL && prng_registered != NULL);
+	run_task();
+
+	/* a full pool: DEPTH distinct, valid pairs, each one taken once */
+	for (i = 0; i < DEPTH; i++) {
+		pairs[i] = __wrap_gen_kexcurve25519_param();
+		CHECK(valid_pair(pairs[i]));
+		for (j = 0; j < i; j++) {
+			CHECK(pairs[j] != pairs[i]);
+			CHECK(memcmp(pairs[j]->priv, pairs[i]->priv, CURVE25519_LEN) != 0);
+		}
+	}
+	CHECK(notified == DEPTH && inline_pairs == 0);
+
+	/* empty: generated inline, as without the pool */
+	pairs[DEPTH] = __wrap_gen_kexcurve25519_param();
+	CHECK(inline_pairs == 1 && pairs[DEPTH]->priv[0] == 0xee);
+	free(pairs[DEPTH]);
+
+	/* the task refills it after being notified */
+	run_task();
+	pairs[DEPTH] = __wrap_gen_kexcurve25519_param();
+	CHECK(inline_pairs == 1 && valid_pair(pairs[DEPTH]));
+	for (j = 0; j < DEPTH; j++) {
+		CHECK(memcmp(pairs[j]->priv, pairs[DEPTH]->priv, CURVE25519_LEN) != 0);
+	}
+
+	kex_pregen_get_stats(&hits, &misses);
+	CHECK(hits == DEPTH + 1 && misses == 1);
+
+	for (i = 0; i <= DEPTH; i++) {
+		free(pairs[i]);
+	}
+	check_ecdh();
+	printf("kex_pregen_check: %s\n", failures ? "FAILED" : "ok");
+	return failures ? 1 : 0;
+}
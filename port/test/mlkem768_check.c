@@ -0,0 +1,375 @@
+/*
+ * mlkem768_check.c - mlkem768_fast.c against FIPS 203.
+ *
+ * Includes ../mlkem768_fast.c for its Keccak. Checks SHA3-256, SHA3-512,
+ * SHAKE128 and SHAKE256 against OpenSSL; key generation, decapsulation
+ * and implicit rejection against OpenSSL's ML-KEM-768; KEM round trips; and
+ * the FIPS 203 input checks (modulus check of ek, hash check of dk).
+ *
+ * The vectors come from mlkem768_vectors.py, which runs OpenSSL's FIPS 203
+ * implementation (3.5 or later) from Python. NIST's own ACVP files are not
+ * in the tree. OpenSSL encapsulates with fresh randomness, so a rerun of the
+ * script prints different ciphertexts; any of them must pass.
+ */
+
+#include "../mlkem768_fast.c"
+
+#include <openssl/evp.h>
+#include <openssl/sha.h>
+
+static unsigned int failures;
+
+#define CHECK(cond) do { \
+	if (!(cond)) { \
+		fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond); \
+		failures++; \
+	} \
+} while (0)
+
+/* genrandom() hands out these bytes in order, then rand() */
+static unsigned char random_queue[64];
+static unsigned int random_queued, random_pos;
+
+void genrandom(unsigned char *buf, unsigned int len)
+{
+	while (len--) {
+		*buf++ = random_pos < random_queued ? random_queue[random_pos++]
+			: (unsigned char)rand();
+	}
+}
+
+static void queue_random(const unsigned char *data, unsigned int len)
+{
+	memcpy(random_queue, data, len);
+	random_queued = len;
+	random_pos = 0;
+}
+
+/* ---- Keccak ---- */
+
+static void keccak(unsigned int rate, unsigned char pad, const unsigned char *in,
+	unsigned long len, unsigned char *out, unsigned long outlen)
+{
+	keccak_state ks;
+
+	keccak_init(&ks, rate);
+	keccak_absorb(&ks, in, len);
+	keccak_finish(&ks, pad);
+	keccak_squeeze(&ks, out, outlen);
+}
+
+static void openssl_digest(const EVP_MD *md, const unsigned char *in,
+	unsigned long len, unsigned char *out, unsigned long outlen)
+{
+	EVP_MD_CTX *ctx = EVP_MD_CTX_new();
+
+	EVP_DigestInit_ex(ctx, md, NULL);
+	EVP_DigestUpdate(ctx, in, len);
+	if (EVP_MD_flags(md) & EVP_MD_FLAG_XOF) {
+		EVP_DigestFinalXOF(ctx, out, outlen);
+	} else {
+		EVP_DigestFinal_ex(ctx, out, NULL);
+	}
+	EVP_MD_CTX_free(ctx);
+}
+
+static void check_keccak(void)
+{
+	static unsigned char in[600], a[600], b[600];
+	unsigned long len;
+
+	genrandom(in, sizeof(in));
+	/* every length across the first rates and their boundaries */
+	for (len = 0; len < sizeof(in); len++) {
+		keccak(SHA3_256_RATE, 0x06, in, len, a, 32);
+		openssl_digest(EVP_sha3_256(), in, len, b, 32);
+		CHECK(memcmp(a, b, 32) == 0);
+		keccak(SHA3_512_RATE, 0x06, in, len, a, 64);
+		openssl_digest(EVP_sha3_512(), in, len, b, 64);
+		CHECK(memcmp(a, b, 64) == 0);
+		/* squeezed past a block for some lengths */
+		keccak(SHAKE128_RATE, 0x1f, in, len, a, len);
+		openssl_digest(EVP_shake128(), in, len, b, len);
+		CHECK(memcmp(a, b, len) == 0);
+		keccak(SHAKE256_RATE, 0x1f, in, len, a, len);
+		openssl_digest(EVP_shake256(), in, len, b, len);
+		CHECK(memcmp(a, b, len) == 0);
+	}
+}
+
+/* ---- OpenSSL's answers ---- */
+
+struct mlkem_vector {
+	unsigned char ek[32];           /* SHA-256 of ek */
+	const char *c;                  /* OpenSSL's encapsulation, in hex */
+	unsigned char k[32];
+	unsigned char kbar[32];         /* c with its first bit flipped */
+};
+
+/* python3 mlkem768_vectors.py (OpenSSL 4.0.3) */
+static const struct mlkem_vector vectors[] = {
+	{
+		{   /* ek */
+			0x0b, 0x79, 0x34, 0xc8, 0x31, 0x25, 0xc7, 0x88,
+			0x99, 0x5e, 0x2b, 0xa6, 0xbd, 0x76, 0x1e, 0x33,
+			0x04, 0x6b, 0x3e, 0x40, 0x57, 0x1b, 0xe5, 0x3e,
+			0x02, 0x33, 0x09, 0xa2, 0x9f, 0x39, 0x8c, 0xc9,
+		},
+		/* c */
+		"6ef70dcbfa5fffbed611f88137ed6801c39749ec0ada141580e2c92d650fb62e"
+		"3d4c310d0a91ebdf5c73f24f1222c606482bf905323483e675adb10da07a9afa"
+		"99989213b0a60326a5b879b97a07d8373b038c30021bb8e2fafc467205221ad6"
+		"13aa862c8cbb7cf4fede4bade3cce0ddf0a1bd415960d33d5302c7eadbf36f73"
+		"80196614124e57289de8c195cee449f57cdb5dde7e2bd935ff265420ae6ef834"
+		"513a7c4647bed9dec5acdd6df2bb19e0c827fa0f6566c9f1d6a9465b136947de"
+		"a90982d5179dbedacc90cd7d24d85955c6ff2e54f67be7edfba2fe3574952001"
+		"fb9a7836bf3d18e260c4453beeb05478b054391934b4e252aa46cb516607042b"
+		"d1b9d47338493988c668374b25bbcd5970b3b499fa1f9a04557b0571170f51a3"
+		"b5553673e190515ad6b0b52cdd0c64287cd027a3d2d3798cb50c2c758205dac0"
+		"bdc9ba33bcca56766a9a9ea338935e747f0a327f5e9c8c8d2ca8e5e71723d621"
+		"4d3a81f8e98aeaefbeb7778381a1a4a678589725c67c5c2b89701090baf38a56"
+		"7719f158309ea29930cda1bd1881d939f7ca477d2d576f6bec85fbfec9644aca"
+		"e4f77836312da7c3be530bed65c9810d931203f0951796e91b4b6efd59cdfcf1"
+		"1631666980fa18566e67a5b950f6da25feffb235fe5c30dc58feef82d5a3174f"
+		"9e78191d8b8aeae9441460021fdeb193713a3cb3e7bfd6b2668c7c8db946055c"
+		"1ac8358e12474cce4354281839abd25299f962550b7903bb4c3611c259e504a9"
+		"4490990fd2fd33fdd71041486b1077b2277dbc4606b290d4d46693188d8d74db"
+		"037a5687981c5b31a29c20633aa0b2038c5b7c826ac23111fc0d741e829ce08f"
+		"7c15fa67a6248c49c4cf0f0ce1d2900129757adfb0100c6c3fc981036574cf4d"
+		"f94aaf7870b0c8ae0de2213904e8189f2d4a4e767abcfbcd302aad5e976f3b97"
+		"b769cb893c18e864a6db0ccd6c0cf2fb7729ffbc2afdd947e8d92a7d00bc3d6d"
+		"039042c93a0eb0af0a1c794eb032eadd609af5f2203062ab5f5a5130409be219"
+		"0fede451228393bd01dc4a8626a3a1f823ff3aae883a13bbaf12478ef5383fd8"
+		"e4d100c5695aadffd6958cedac3098bf6ea107fc116ee09abf96db15b13fd3c3"
+		"6e21be7d587eff9945468fdde14240c600335077f21766a1b74e0913dc3ef924"
+		"b2a6d67835768d753932fe84fa012ae0baefd4593121eae3b2d61232f58a3797"
+		"e6867ca56fae873cce2d145c6aa020805dd6e0736c8f7ac79605161334cfbda9"
+		"041bf32d124fc2d91f945809c3a9e52e09d30cf204a6a7fa37ea0c308884bbdd"
+		"1b0b8d69973334e6d02dc58fee5edac002987abf7454a53d90c8d80950357332"
+		"90e4d46c2823e39d9a757958c1b14431a8335f26b1e260555ab0e0f824078fff"
+		"36955b37ae0cfa35b858fd887ea75ad305771cd7590aef23bee2c2c4a49532c6"
+		"5f18b3e3e0a161bcaf92f0388bdc96f6ded3c623261cbb3f3e23e293ca0901d1"
+		"04787cf0f6126119b55abc3b65e10e11297459f0f0575a4297cb289028957250",
+		{   /* k */
+			0x59, 0xd2, 0x63, 0x24, 0xe0, 0x47, 0x50, 0xa0,
+			0x8c, 0x5a, 0xf5, 0xdd, 0xa7, 0x1a, 0x5c, 0x03,
+			0x33, 0xd0, 0xb4, 0x8c, 0x84, 0xa9, 0xb9, 0x46,
+			0xe6, 0x20, 0x11, 0xc1, 0x7b, 0x89, 0xca, 0x7a,
+		},
+		{   /* kbar */
+			0xba, 0x6d, 0xfa, 0x57, 0x96, 0xd7, 0xec, 0xf6,
+			0xe7, 0x25, 0x42, 0x43, 0xc7, 0xe4, 0x51, 0x80,
+			0xe0, 0x85, 0x5c, 0x5c, 0x30, 0xc5, 0x8f, 0xfd,
+			0x1a, 0x31, 0x70, 0xd4, 0xf7, 0x17, 0x59, 0x6f,
+		},
+	},
+	{
+		{   /* ek */
+			0xad, 0x4b, 0x36, 0x6f, 0xbf, 0x90, 0xa1, 0x12,
+			0xe4, 0xa9, 0xc5, 0x12, 0xd7, 0x62, 0xbe, 0xc1,
+			0x53, 0xf4, 0xbf, 0x0b, 0xdd, 0x3a, 0x2d, 0x6d,
+			0x05, 0xf6, 0x9a, 0x3a, 0x74, 0x4e, 0x03, 0x04,
+		},
+		/* c */
+		"ac249237433b21a2ee06f9f6e0e3474bf8612d8d1f9279b8475376994260b471"
+		"0f5942935666c314a43d778803261eda6711e926bc604678b812c14c449f3648"
+		"b3a6eb8b3b493b53212dbeb2df00007ae5128c8d032b06203df7ddec88f07df3"
+		"8e1eafcf42034abf3ecb5191029086eeea65769818dacf225de989c8b114beae"
+		"86ff8004088690ee1f04efcee8157fa05bbb29dd0f65e068e4efb1c6cd533eb8"
+		"36b0aaf87b57a2d79234c037b3d28f8e33d0b8887d368eb14c388a7b693bb080"
+		"f9c2652dd656883b6e087583519bfea823561ad7a27c4a1ac0b8f7939dc67d2b"
+		"6e502f0893f5c454d32a939e3fed9a4c688375f291814cad3a4390183b2cba1e"
+		"f2c7bdff9fa17b5e3e29fe0f1d813acb2d9bdec04f9ed2019844b038cf7b1db6"
+		"308be53bf28b96de594bdef3709a7fc4104d333b277117c1e2391af69463ac36"
+		"848be1819d46ec0d1bc21a458134f73727a6c2c91604105bf70ca939cc2547f3"
+		"a4b16ebe5c0d372a2cd85f4eb5dacfe07e05922792936dc2a83b4474facf1633"
+		"ca4742801deb8cbce7333a0afdf81a3c7f76bdbd82c84998742e005c26841137"
+		"8317d2411046a93cee34514c4163565f42502fd9b5b14c9e3ce32d77ecac230c"
+		"960c09b9adc9dc1b4b3f27b4b4252952a6b00ebdfeba40b19f4fe4f0a11494f5"
+		"4d743b68ef02944f26283e34549403b9cf145b39c64427e09c32d9b0a718c219"
+		"d3c16e8078f98b116899de0d5b00c0a70357d9326f242cafc1b81cb8b7770f14"
+		"0ee30011683cd25df2fc5807853c1196eec1de903bd4b9b1552c8e6a17583503"
+		"6d6b9cb32389a0711d2223c564c77d4bdc753ac6f935d36863be2d8173049dd1"
+		"2ab9e6b8e146449f3b2eacc8713ccb3191e7f53786ab5da038e90777111e066e"
+		"7d0eaaa1f8a118af177b21f02581a43b3b61a551862cf7fa3971e6be59915c54"
+		"4b5ec0e591ded578dcfde3d85c59e03f4976c9a171d54cd7c1663021a4e6f736"
+		"7f6db76262f043590cb54ef0c19ddac89c2f2da390288a88a794d42299480100"
+		"2f36b408a716a1a1faf7210afff38631d02c7bf427f2750da457c01a346a328d"
+		"cb5acea3092257f347ef9c2fa62adcac37767f05f388a77b16e7cfd7525f81a8"
+		"066fa3801e36065f7f1734538878821e0c5084ab85444fe474381e6c2ce74c30"
+		"2ddd012f4cbdb900570a3e80c0ed7e6c837ecc82f642984e2b1580e0dcf1c2a4"
+		"76469d8423103e9682fdfbb964e3c44a9a9c1505907c7bab64f11fb56ecefa79"
+		"eaa382f62db8bb0c0d767f6f7c0043f3b1d9ab61c546de50f075fa453c62a24a"
+		"e42d845dca88ca7b93e1fa1779d31ca86bcbe2f3f06f27fa3f20ac435cf60ac3"
+		"238ec9646324eca549222bc7bd80d6813fd5fce747d138705338e779d946c4d2"
+		"bb50861a02ba746d0e91f17865a1254779f229f096fb9b2a66789f947485a62b"
+		"9522bc21e0e7b78fac665869c993879ffd920049aab27d422be6be200a9ceecb"
+		"9160d07d9c98e3d4cb20c2485033124c63b8f6a428273d6172b1ab821d9f5d2c",
+		{   /* k */
+			0x70, 0x01, 0x0c, 0x13, 0xb6, 0x66, 0xf5, 0x15,
+			0x51, 0x9e, 0x12, 0x13, 0x98, 0x5e, 0x9a, 0xbc,
+			0xba, 0xc5, 0x50, 0x13, 0xff, 0xd5, 0xd9, 0x71,
+			0x93, 0x07, 0xcf, 0xbe, 0xd2, 0x4f, 0xf3, 0x16,
+		},
+		{   /* kbar */
+			0xff, 0x5c, 0x64, 0x4a, 0xc9, 0xca, 0x46, 0xe3,
+			0xfb, 0x45, 0x46, 0x7f, 0x24, 0x53, 0x57, 0xe7,
+			0xd3, 0xd6, 0x97, 0x23, 0x53, 0x2a, 0xaa, 0xf9,
+			0xf5, 0x05, 0x5e, 0x7f, 0x88, 0xf2, 0xbd, 0x9e,
+		},
+	},
+	{
+		{   /* ek */
+			0xd3, 0xf6, 0xe6, 0xac, 0x67, 0xdd, 0xe5, 0xba,
+			0x5e, 0x1f, 0xa4, 0x78, 0xed, 0x57, 0xfb, 0x6f,
+			0x10, 0xb6, 0x3b, 0x7c, 0xae, 0x85, 0x27, 0xbe,
+			0xa3, 0xbc, 0x9f, 0x10, 0xac, 0x0a, 0xf6, 0x20,
+		},
+		/* c */
+		"5323e7068c5c9bc60347346540f2bd05ca227f5083969363d0a6376b8e18e981"
+		"b321672336f38ef11f89010e9a228115dd00253374dfe3e4f9ee03fe8220984f"
+		"1fc9e9323fb0354d86ebd0ef1a7b4c5c5ef48be7ca73550d9b28eb7b600908d8"
+		"9b89c9f6bd58fa5c2eaf6ebfb2102beced6d77aa5cec10963052a81845913a38"
+		"e8aaa324b9875de1f5e380444c2572797edb25168e4fb9f934e2ecdcb1dd3e87"
+		"7528c8d911f336fefac784241ad6995c014f9725ab516414c218b50313f630b4"
+		"7e958e4e6484fa34f5e42383b6300c33a20eb8643c9afbd8c02a4bb64688a4b7"
+		"e2c06545f996871a802548d704c7ee48e252ff90ff8fed84e212ea97298ab72b"
+		"f9afd4533c84b4fde35a12e0618c7b568c319e407eeaf962a0443891532e303a"
+		"cfd40c4073e76f39604bf2d5a8585f23dfa7bb65d347c3839918f7783b3e34b6"
+		"b0f2b732e5aa038b7ec1c03e416610abc2dfdb17ffc2d80f6ce6f98a2d4230b4"
+		"87f291764be4ad1ef791395a5af7ebae7dbbfc5eea14f56416e8218af7236996"
+		"5ab36316582289ab61885ef494a1c606b045b770bad3520d6ccd3b70632d903e"
+		"c72bfb33e41b46ae0accedda03cc35e994e2742d8ea214c948f0f92390a5a1ec"
+		"fea9e6fc210218c255d2c13e65594e9ee4e2f60e3779ed97422387e3da1e29d0"
+		"63aeae59db3f1d6d2d406cccd5d3d97cefbe91f37dc34fe50bb1420d05f9c5d2"
+		"c89f9ad59c049eacf0cfd8cf18c09b10b7ea69ff87c4a4ccbab26485fa136e06"
+		"2ba7d288dfb4893af75b3aa447a003435cd1670ef5bd81d5d131346a42d74765"
+		"9601a30d15b5d9c039241626f6cdb88d2ba47a0749846b24cf840457ca9273bc"
+		"b70c008c0bb234f577fcdd1f9712e1789c6d774b95230198e38d42065a5ed205"
+		"3aff2d95409b1736a8b633eccabe6c6a8cfb307fa4a8bf3a923a80961119d845"
+		"bdfbdbe4d20d57b5bb8041c877a2de95200f203e6c038a7d2c0d997076fea350"
+		"48437379942004f3ff6a492a951dd01947f47aef84235ad0c4ed0ef04b8fe954"
+		"0fb26aed65141abecd2e2e294bd92baf96aafd8ba49ebb9ed2ed92405b36fdc0"
+		"f9779c39d90b8f9d9d1b6e9a53259448d8cf6079e9ca11ce001567847d0c238e"
+		"6f11d2f313122fa8fbfaedf937655024e6598bb7f5b239f68c287f2bf50f3fe9"
+		"f2f6b40e82429df640bf64eaafa5164ba1795e94f0c186e5297fab985d4d6c80"
+		"e734ada81adf17898735ee3430243297acab0e0449753cad5635a816c719c1fd"
+		"5deb84c5f90365be274f423632ce78953669bdc60b362ae2cf53b67c02f39f58"
+		"722cb11a3b1a597ff915cd64b2f7ad9d7d0632dda49beb6c131ccb866396ee9e"
+		"d8ad0315aafa9f1d0b381db16bf093f91589da18d6e6953634679e49edbc9e3c"
+		"0cdeff4d7e025b14939cc98875e90cd81cf2a53f2b6933d4f62238ef2ca0446e"
+		"522863bdeee5aabf0c64255b68539271be111522e04655817426ebd8db279850"
+		"ce99d4481e15a017b9e788b12f1fbe9ef811931735c3a0461025f124c9aadcac",
+		{   /* k */
+			0x8f, 0x84, 0xec, 0xf6, 0xd9, 0xfc, 0x33, 0xbd,
+			0x6d, 0x7e, 0x75, 0xbc, 0x68, 0x22, 0xe1, 0xa4,
+			0xbd, 0x34, 0xd5, 0x2a, 0x97, 0x61, 0xee, 0xf6,
+			0xcf, 0x73, 0x0e, 0x22, 0x5f, 0x22, 0x54, 0x38,
+		},
+		{   /* kbar */
+			0xe6, 0x7a, 0xec, 0x6e, 0xca, 0xf2, 0xd8, 0xf7,
+			0x26, 0xd5, 0xaf, 0xf0, 0x8b, 0xc9, 0x4b, 0x2c,
+			0xa4, 0x96, 0x2a, 0xfc, 0x5e, 0x16, 0x19, 0x51,
+			0x78, 0x43, 0x8f, 0x82, 0xb2, 0xde, 0xeb, 0xc6,
+		},
+	},
+};
+
+/* d || z of vector n; mlkem768_vectors.py derives the same */
+static void vector_seed(unsigned int n, unsigned char seed[64])
+{
+	unsigned int i;
+
+	for (i = 0; i < 64; i++) {
+		seed[i] = (unsigned char)(i * (2 * n + 1) + 17 * n);
+	}
+}
+
+static int matches(const unsigned char *data, unsigned long len, const unsigned char digest[32])
+{
+	unsigned char md[32];
+
+	SHA256(data, len, md);
+	return memcmp(md, digest, 32) == 0;
+}
+
+static void from_hex(unsigned char *out, unsigned long len, const char *hex)
+{
+	unsigned int byte;
+
+	CHECK(strlen(hex) == 2 * len);
+	while (len-- && sscanf(hex, "%2x", &byte) == 1) {
+		*out++ = (unsigned char)byte;
+		hex += 2;
+	}
+}
+
+/*
+ * Key generation must give OpenSSL's ek. Decapsulating OpenSSL's c must
+ * give its K: decapsulation re-encrypts and compares, so this also holds
+ * our dk and encryption to OpenSSL's bytes. The flipped c must give
+ * OpenSSL's implicit rejection key, J(z || c).
+ */
+static void check_vectors(void)
+{
+	static unsigned char pk[crypto_kem_mlkem768_PUBLICKEYBYTES];
+	static unsigned char sk[crypto_kem_mlkem768_SECRETKEYBYTES];
+	static unsigned char c[crypto_kem_mlkem768_CIPHERTEXTBYTES];
+	unsigned char seed[64], k[32];
+	unsigned int n;
+
+	for (n = 0; n < sizeof(vectors) / sizeof(vectors[0]); n++) {
+		vector_seed(n, seed);
+		queue_random(seed, 64);
+		CHECK(crypto_kem_mlkem768_keypair(pk, sk) == 0);
+		CHECK(matches(pk, sizeof(pk), vectors[n].ek));
+
+		from_hex(c, sizeof(c), vectors[n].c);
+		CHECK(crypto_kem_mlkem768_dec(k, c, sk) == 0);
+		CHECK(memcmp(k, vectors[n].k, 32) == 0);
+		c[0] ^= 1;
+		CHECK(crypto_kem_mlkem768_dec(k, c, sk) == 0);
+		CHECK(memcmp(k, vectors[n].kbar, 32) == 0);
+	}
+	random_queued = 0;
+}
+
+/* ---- round trips and input checks ---- */
+
+static void check_kem(void)
+{
+	static unsigned char pk[crypto_kem_mlkem768_PUBLICKEYBYTES];
+	static unsigned char sk[crypto_kem_mlkem768_SECRETKEYBYTES];
+	static unsigned char c[crypto_kem_mlkem768_CIPHERTEXTBYTES];
+	unsigned char k[32], k2[32];
+	unsigned int it;
+
+	CHECK(PK_BYTES == sizeof(pk) && CT_BYTES == sizeof(c));
+	for (it = 0; it < 20; it++) {
+		CHECK(crypto_kem_mlkem768_keypair(pk, sk) == 0);
+		CHECK(crypto_kem_mlkem768_enc(c, k, pk) == 0);
+		CHECK(crypto_kem_mlkem768_dec(k2, c, sk) == 0);
+		CHECK(memcmp(k, k2, 32) == 0);
+		c[(unsigned int)rand() % sizeof(c)] ^= (unsigned char)(1 << rand() % 8);
+		CHECK(crypto_kem_mlkem768_dec(k2, c, sk) == 0);
+		CHECK(memcmp(k, k2, 32) != 0);
+	}
+
+	/* a coefficient of t equal to q: modulus check fails */
+	pk[0] = MLKEM_Q & 0xff;
+	pk[1] = (unsigned char)((pk[1] & 0xf0) | MLKEM_Q >> 8);
+	CHECK(crypto_kem_mlkem768_enc(c, k, pk) != 0);
+
+	/* ek inside dk changed: hash check fails */
+	sk[SK_PKE_BYTES + 5] ^= 1;
+	CHECK(crypto_kem_mlkem768_dec(k2, c, sk) != 0);
+}
+
+int main(void)
+{
+	check_keccak();
+	check_vectors();
+	check_kem();
+	printf("mlkem768_check: %s\n", failures ? "FAILED" : "ok");
+	return failures ? 1 : 0;
+}
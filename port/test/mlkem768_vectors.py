@@ -0,0 +1,52 @@
+#!/usr/bin/env python3
+"""
+mlkem768_vectors.py - ML-KEM-768 vectors for mlkem768_check.c, from OpenSSL.
+
+Needs the cryptography package built against OpenSSL 3.5 or later, whose
+ML-KEM is an independent FIPS 203 implementation. For each seed (d || z,
+as vector_seed() in mlkem768_check.c makes it) OpenSSL derives the key pair
+and encapsulates to it. Prints SHA-256 of ek, OpenSSL's ciphertext, its
+shared key, and the implicit rejection key OpenSSL's decapsulation gives
+for the ciphertext with its first bit flipped.
+"""
+import hashlib
+from cryptography.hazmat.primitives.asymmetric import mlkem
+
+VECTORS = 3
+
+
+def vector_seed(n):
+    return bytes((i * (2 * n + 1) + 17 * n) & 0xff for i in range(64))
+
+
+def c_bytes(name, data):
+    print('\t\t{   /* %s */' % name)
+    for i in range(0, len(data), 8):
+        print('\t\t\t' + ' '.join('0x%02x,' % b for b in data[i:i + 8]))
+    print('\t\t},')
+
+
+def c_hex(name, data):
+    print('\t\t/* %s */' % name)
+    h = data.hex()
+    lines = ['\t\t"%s"' % h[i:i + 64] for i in range(0, len(h), 64)]
+    print('\n'.join(lines) + ',')
+
+
+def main():
+    for n in range(VECTORS):
+        dk = mlkem.MLKEM768PrivateKey.from_seed_bytes(vector_seed(n))
+        ek = dk.public_key()
+        k, c = ek.encapsulate()
+        flipped = bytes([c[0] ^ 1]) + c[1:]
+        assert dk.decapsulate(c) == k
+        print('\t{')
+        c_bytes('ek', hashlib.sha256(ek.public_bytes_raw()).digest())
+        c_hex('c', c)
+        c_bytes('k', k)
+        c_bytes('kbar', dk.decapsulate(flipped))
+        print('\t},')
+
+
+if __name__ == '__main__':
+    main()
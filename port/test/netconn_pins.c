@@ -0,0 +1,459 @@
+/*
+ * netconn_pins.c - port/netconn_lwip.c against a stand-in TCP send queue.
+ *
+ * The stand-in netconn keeps what a NETCONN_NOCOPY write hands it as lwIP
+ * does: a pointer into the packet buffer, read again when the segment is
+ * retransmitted and once more when it is acked. It also keeps a copy of
+ * the bytes as written, and every read is compared with it, so a buffer
+ * freed or reused too early fails the comparison or trips ASan. The write
+ * queue is drained as packet.c's write_packet() does it: writev(), then
+ * buf_free() for every packet that went out in full.
+ *
+ * Checks that buffers are held until acked, over short writes and sequence
+ * number wraparound, that a write without room for its pins is copied, that
+ * close waits for the last acks or resets the connection, and that other
+ * descriptors get plain write()s.
+ */
+
+#include <fcntl.h>
+#include <sys/uio.h>
+
+#include "includes.h"
+#include "dbutil.h"
+#include "buffer.h"
+#include "lwip/api.h"
+#include "lwip/tcp.h"
+#include "lwip/priv/sockets_priv.h"
+#include "lwip/priv/tcpip_priv.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "netconn_lwip.h"
+
+#define LWIP_FD         60
+#define REFS_MAX        256
+#define QUEUE_MAX       64
+#define ISS             0xfffff000u     /* wraps after 4 KB */
+
+static unsigned int failures;
+
+#define CHECK(cond) do { \
+	if (!(cond)) { \
+		fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond); \
+		failures++; \
+	} \
+} while (0)
+
+ssize_t __wrap_writev(int fd, const struct iovec *iov, int iovcnt);
+void __wrap_buf_free(buffer *buf);
+
+/* ---- Dropbear ---- */
+
+static unsigned int freed;
+
+void *m_malloc(size_t size)
+{
+	void *p = calloc(1, size);
+
+	if (p == NULL) {
+		dropbear_exit("m_malloc failed");
+	}
+	return p;
+}
+
+void *m_realloc(void *ptr, size_t size)
+{
+	void *p = realloc(ptr, size);
+
+	if (p == NULL) {
+		dropbear_exit("m_realloc failed");
+	}
+	return p;
+}
+
+void __real_buf_free(buffer *buf)
+{
+	freed++;
+	buf_free(buf);
+}
+
+/* ---- the TCP send queue ---- */
+
+struct ref {
+	const unsigned char *data;      /* what the queue points at */
+	unsigned char *copy;            /* the bytes as written */
+	unsigned int len;
+	u32_t end;
+};
+
+static struct tcp_pcb pcb;
+static struct netconn conn;
+static struct lwip_sock sock = { &conn };
+static struct ref refs[REFS_MAX];
+static unsigned int nrefs, nocopy_writes, copy_writes;
+static size_t room;                     /* what the send buffer takes */
+
+static void connect_new(u32_t iss)
+{
+	pcb.snd_lbb = pcb.lastack = iss;
+	conn.pcb.tcp = &pcb;
+	room = SIZE_MAX;
+}
+
+static void drop_refs(unsigned int n)
+{
+	unsigned int i;
+
+	for (i = 0; i < n; i++) {
+		free(refs[i].copy);
+	}
+	nrefs -= n;
+	memmove(refs, refs + n, nrefs * sizeof(refs[0]));
+}
+
+/* Everything unacked goes out again. */
+static void retransmit(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < nrefs; i++) {
+		CHECK(memcmp(refs[i].data, refs[i].copy, refs[i].len) == 0);
+	}
+}
+
+static void ack(u32_t bytes)
+{
+	unsigned int n = 0;
+
+	retransmit();
+	pcb.lastack += bytes;
+	while (n < nrefs && (s32_t)(pcb.lastack - refs[n].end) >= 0) {
+		n++;
+	}
+	drop_refs(n);
+}
+
+static void ack_all(void)
+{
+	ack(pcb.snd_lbb - pcb.lastack);
+}
+
+err_t netconn_write_vectors_partly(struct netconn *c, struct netvector *vectors,
+	u16_t vectorcnt, u8_t apiflags, size_t *bytes_written)
+{
+	size_t total = 0, requested = 0, n;
+	unsigned int i;
+
+	CHECK(apiflags & NETCONN_DONTBLOCK);
+	if (c->pcb.tcp == NULL) {
+		return ERR_CONN;
+	}
+	for (i = 0; i < vectorcnt; i++) {
+		requested += vectors[i].len;
+	}
+	for (i = 0; i < vectorcnt && room > 0 && nrefs < REFS_MAX; i++) {
+		struct ref *r = &refs[nrefs++];
+
+		n = MIN(vectors[i].len, room);
+		r->copy = m_malloc(n);
+		memcpy(r->copy, vectors[i].ptr, n);
+		r->data = (apiflags & NETCONN_COPY) ? r->copy : vectors[i].ptr;
+		r->len = (unsigned int)n;
+		pcb.snd_lbb += (u32_t)n;
+		r->end = pcb.snd_lbb;
+		room -= n;
+		total += n;
+		if (n < vectors[i].len) {
+			break;
+		}
+	}
+	*bytes_written = total;
+	if (total > 0) {
+		nocopy_writes += !(apiflags & NETCONN_COPY);
+		copy_writes += !!(apiflags & NETCONN_COPY);
+	}
+	return total > 0 || requested == 0 ? ERR_OK : ERR_WOULDBLOCK;
+}
+
+void tcp_abort(struct tcp_pcb *p)
+{
+	CHECK(p == &pcb);
+	/* the segments go without another read; err_tcp() detaches the pcb */
+	drop_refs(nrefs);
+	conn.pcb.tcp = NULL;
+}
+
+int err_to_errno(err_t err)
+{
+	return err == ERR_WOULDBLOCK ? EWOULDBLOCK : err == ERR_CONN ? ENOTCONN : EIO;
+}
+
+err_t tcpip_api_call(tcpip_api_call_fn fn, struct tcpip_api_call_data *call)
+{
+	return fn(call);
+}
+
+struct lwip_sock *lwip_socket_dbg_get_socket(int fd)
+{
+	return fd == LWIP_FD ? &sock : NULL;
+}
+
+/* ---- FreeRTOS ---- */
+
+static int task_a, task_b;
+static TaskHandle_t current = &task_a;
+static unsigned int slept_ms, ack_at_ms;
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+	return current;
+}
+
+/* netconn_lwip_close() polling; the client acks at ack_at_ms, if set */
+void vTaskDelay(TickType_t ticks)
+{
+	slept_ms += ticks;
+	if (ack_at_ms != 0 && slept_ms >= ack_at_ms) {
+		ack_all();
+	}
+}
+
+/* ---- the write queue, as packet.c drains it ---- */
+
+static buffer *queue[QUEUE_MAX];
+static unsigned int queued;
+
+static void enqueue(unsigned int len)
+{
+	static unsigned char fill;
+	buffer *buf = buf_new(len);
+
+	memset(buf->data, ++fill, len);
+	buf->len = len;
+	queue[queued++] = buf;
+}
+
+static ssize_t write_queue(int fd)
+{
+	struct iovec iov[16];
+	unsigned int i, n = MIN(queued, 16), len;
+	ssize_t written, left;
+
+	for (i = 0; i < n; i++) {
+		iov[i].iov_base = queue[i]->data + queue[i]->pos;
+		iov[i].iov_len = queue[i]->len - queue[i]->pos;
+	}
+	written = left = __wrap_writev(fd, iov, (int)n);
+	while (left > 0) {
+		len = queue[0]->len - queue[0]->pos;
+		if (len > left) {
+			queue[0]->pos += (unsigned int)left;
+			break;
+		}
+		left -= len;
+		__wrap_buf_free(queue[0]);
+		memmove(queue, queue + 1, --queued * sizeof(queue[0]));
+	}
+	return written;
+}
+
+/* ---- checks ---- */
+
+static void held_until_acked(void)
+{
+	unsigned long nocopy, copied, resets;
+	unsigned int i;
+
+	connect_new(ISS);
+	freed = 0;
+	for (i = 0; i < 6; i++) {
+		enqueue(100 + 500 * i);
+	}
+	CHECK(write_queue(LWIP_FD) == 6 * 100 + 500 * 15);
+	CHECK(queued == 0 && nocopy_writes == 1 && copy_writes == 0);
+	/* Dropbear has freed all six; lwIP still points into them */
+	CHECK(freed == 0);
+	retransmit();
+
+	/* the first three acked: released by the next write */
+	ack(100 + 600 + 1100);
+	enqueue(64);
+	CHECK(write_queue(LWIP_FD) == 64);
+	CHECK(freed == 3);
+	ack_all();
+	enqueue(64);
+	CHECK(write_queue(LWIP_FD) == 64);
+	CHECK(freed == 7);
+
+	ack_all();
+	netconn_lwip_close(LWIP_FD);
+	CHECK(freed == 8 && conn.pcb.tcp != NULL);
+	netconn_lwip_get_stats(&nocopy, &copied, &resets);
+	printf("  6 packets, 8100 B: freed as acked, %lu B without copy, %lu B copied\n",
+		nocopy, copied);
+}
+
+static void short_writes(void)
+{
+	/* wraps in the middle of the second packet */
+	connect_new(0xffffff00u);
+	freed = 0;
+	enqueue(200);
+	enqueue(200);
+	enqueue(200);
+
+	/* the send buffer takes 250 B: all of the first, 50 B of the second */
+	room = 250;
+	CHECK(write_queue(LWIP_FD) == 250);
+	CHECK(queued == 2 && queue[0]->pos == 50 && freed == 0);
+
+	errno = 0;
+	CHECK(write_queue(LWIP_FD) == -1 && errno == EWOULDBLOCK);
+
+	room = SIZE_MAX;
+	CHECK(write_queue(LWIP_FD) == 350 && queued == 0);
+	CHECK(freed == 0);
+
+	/* 100 B acked: nothing; 250 B: the first, but the second is still out */
+	ack(100);
+	CHECK(write_queue(LWIP_FD) == 0 && freed == 0);
+	ack(150);
+	CHECK(write_queue(LWIP_FD) == 0 && freed == 1);
+	retransmit();
+	ack(149);
+	CHECK(write_queue(LWIP_FD) == 0 && freed == 1);
+	ack_all();
+	CHECK(write_queue(LWIP_FD) == 0 && freed == 3);
+	printf("  short writes and sequence wraparound: the half-sent packet held "
+		"until its last byte is acked\n");
+	netconn_lwip_close(LWIP_FD);
+}
+
+static void pins_full(void)
+{
+	unsigned int i, copies;
+
+	connect_new(ISS);
+	freed = 0;
+	nocopy_writes = copy_writes = 0;
+	for (i = 0; i < 32; i++) {
+		enqueue(300);
+	}
+	CHECK(write_queue(LWIP_FD) == 16 * 300);
+	CHECK(write_queue(LWIP_FD) == 16 * 300);
+	CHECK(nocopy_writes == 2 && freed == 0);
+
+	/* 32 pins unacked: the next batch is copied, and freed right away */
+	for (i = 0; i < 4; i++) {
+		enqueue(300);
+	}
+	CHECK(write_queue(LWIP_FD) == 4 * 300);
+	CHECK(copy_writes == 1 && freed == 4);
+	copies = copy_writes;
+
+	ack_all();
+	enqueue(300);
+	CHECK(write_queue(LWIP_FD) == 300);
+	CHECK(nocopy_writes == 3 && copy_writes == copies && freed == 36);
+	ack_all();
+	netconn_lwip_close(LWIP_FD);
+	CHECK(freed == 37);
+	printf("  32 packets unacked: the next write copied, NOCOPY again after the ack\n");
+}
+
+static void close_waits(void)
+{
+	unsigned long nocopy, copied, resets, before;
+
+	netconn_lwip_get_stats(&nocopy, &copied, &before);
+
+	/* acked 300 ms into the close */
+	connect_new(ISS);
+	freed = 0;
+	enqueue(1000);
+	enqueue(1000);
+	CHECK(write_queue(LWIP_FD) == 2000 && freed == 0);
+	slept_ms = 0;
+	ack_at_ms = 300;
+	netconn_lwip_close(LWIP_FD);
+	netconn_lwip_get_stats(&nocopy, &copied, &resets);
+	CHECK(freed == 2 && resets == before && conn.pcb.tcp != NULL);
+	CHECK(slept_ms >= 300 && slept_ms < 400);
+	printf("  close, acked after 300 ms: waited %u ms, no reset\n", slept_ms);
+
+	/* never acked */
+	connect_new(ISS);
+	freed = 0;
+	enqueue(1000);
+	CHECK(write_queue(LWIP_FD) == 1000);
+	slept_ms = 0;
+	ack_at_ms = 0;
+	netconn_lwip_close(LWIP_FD);
+	netconn_lwip_get_stats(&nocopy, &copied, &resets);
+	CHECK(freed == 1 && resets == before + 1 && conn.pcb.tcp == NULL && nrefs == 0);
+	printf("  close, never acked: reset after %u ms, buffer freed\n", slept_ms);
+
+	/* the client reset the connection: nothing to wait for */
+	connect_new(ISS);
+	freed = 0;
+	enqueue(1000);
+	CHECK(write_queue(LWIP_FD) == 1000);
+	drop_refs(nrefs);
+	conn.pcb.tcp = NULL;
+	enqueue(1000);
+	errno = 0;
+	CHECK(write_queue(LWIP_FD) == -1 && errno == ENOTCONN && freed == 1);
+	slept_ms = 0;
+	netconn_lwip_close(LWIP_FD);
+	CHECK(slept_ms == 0);
+	__wrap_buf_free(queue[--queued]);
+	CHECK(freed == 2);
+}
+
+static void two_tasks(void)
+{
+	connect_new(ISS);
+	freed = 0;
+	current = &task_a;
+	enqueue(500);
+	CHECK(write_queue(LWIP_FD) == 500 && freed == 0);
+
+	/* another task's buffers are not this connection's */
+	current = &task_b;
+	enqueue(500);
+	__wrap_buf_free(queue[--queued]);
+	CHECK(freed == 1);
+
+	current = &task_a;
+	ack_all();
+	netconn_lwip_close(LWIP_FD);
+	CHECK(freed == 2);
+}
+
+static void plain_fd(void)
+{
+	char out[16];
+	int fds[2];
+
+	CHECK(pipe(fds) == 0);
+	freed = 0;
+	enqueue(5);
+	enqueue(7);
+	CHECK(write_queue(fds[1]) == 12 && freed == 2);
+	CHECK(read(fds[0], out, sizeof(out)) == 12);
+	close(fds[0]);
+	close(fds[1]);
+	printf("  not an lwIP socket: plain write()s\n");
+}
+
+int main(void)
+{
+	held_until_acked();
+	short_writes();
+	pins_full();
+	close_waits();
+	two_tasks();
+	plain_fd();
+	drop_refs(nrefs);
+	printf("netconn_pins: %s\n", failures ? "FAILED" : "ok");
+	return failures ? 1 : 0;
+}
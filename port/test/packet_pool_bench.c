@@ -0,0 +1,116 @@
+/*
+ * packet_pool_bench.c - Allocator cost per packet, arena only vs. packet slots.
+ *
+ * Replays the buffers of a read/decrypt/encrypt/write round trip (readbuf
+ * grown to the packet length, payload copy, encrypted copy) two million
+ * times on a 40 KB arena holding 20 long-lived session objects that are
+ * reallocated now and then. The first pass uses plain buf_new() on the
+ * arena, the second the packet slots. Heap calls after warm-up are counted
+ * through -Wl,--wrap=malloc. Numbers are in examples/server/footprint.md.
+ *
+ *   make -C port/test bench
+ */
+
+#include <time.h>
+
+#include "includes.h"
+#include "dbutil.h"
+#include "buffer.h"
+#include "dbmalloc_arena.h"
+
+#define ARENA_SIZE        40960
+#define PACKETS           2000000
+#define STATE_OBJECTS     20
+
+buffer *__real_buf_new(unsigned int size);
+void *__real_malloc(size_t size);
+
+static unsigned long heap_calls;
+
+void *__wrap_malloc(size_t size)
+{
+	heap_calls++;
+	return __real_malloc(size);
+}
+
+void dropbear_exit(const char *format, ...)
+{
+	fprintf(stderr, "dropbear_exit: %s\n", format);
+	abort();
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void run(const char *name, buffer *(*new_buf)(unsigned int), unsigned int bulk_pct)
+{
+	session_arena_t *arena = session_arena_create(ARENA_SIZE);
+	session_arena_stats_t st;
+	void *state[STATE_OBJECTS];
+	unsigned long warm = 0;
+	unsigned int i, n;
+	buffer *rb, *pl, *wb;
+	double t;
+
+	session_arena_attach(arena);
+	for (i = 0; i < STATE_OBJECTS; i++) {
+		state[i] = m_malloc(100 + i * 37);
+	}
+	srand(2);
+
+	t = now();
+	for (i = 0; i < PACKETS; i++) {
+		if (i == 1000) {
+			warm = heap_calls;
+		}
+		n = (unsigned int)rand() % 100 < bulk_pct ? 1000 + rand() % 7000 : 16 + rand() % 200;
+
+		/* read: readbuf grown to the packet length, then the payload copy */
+		rb = new_buf(128);
+		rb = buf_resize(rb, n + 64);
+		memset(rb->data, 0xab, n);
+		pl = new_buf(n);
+		memcpy(pl->data, rb->data, n);
+		buf_free(rb);
+
+		/* write: encrypted copy queued, then both freed */
+		wb = new_buf(n + 64);
+		memcpy(wb->data, pl->data, n);
+		buf_free(pl);
+		buf_free(wb);
+
+		if (i % 5000 == 0) {
+			unsigned int k = (unsigned int)rand() % STATE_OBJECTS;
+
+			free(state[k]);
+			state[k] = m_malloc(50 + rand() % 300);
+		}
+	}
+	t = now() - t;
+
+	session_arena_get_stats(arena, &st);
+	printf("%-13s %2u%% bulk: %4.0f ns/packet, heap calls after warm-up %lu, "
+		"slot hits %.1f%%, peak %zu\n", name, bulk_pct, t / PACKETS * 1e9,
+		heap_calls - warm,
+		st.pool_hits ? 100.0 * st.pool_hits / (st.pool_hits + st.pool_misses) : 0.0,
+		st.high_water);
+
+	for (i = 0; i < STATE_OBJECTS; i++) {
+		free(state[i]);
+	}
+	session_arena_attach(NULL);
+}
+
+int main(void)
+{
+	run("arena only", __real_buf_new, 2);
+	run("packet slots", buf_new, 2);
+	run("arena only", __real_buf_new, 25);
+	run("packet slots", buf_new, 25);
+	return 0;
+}
@@ -0,0 +1,94 @@
+/*
+ * packet_slots.c - buf_new() from the arena's packet slots (port/packet_pool.c).
+ *
+ * A slot that comes back from free() must be handed out zeroed, like any
+ * m_malloc() block, and must not carry the previous packet's bytes. Packets
+ * too large for a slot, or arriving while every fitting slot is busy, fall
+ * back to m_malloc().
+ */
+
+#include "includes.h"
+#include "dbutil.h"
+#include "sdkconfig.h"
+#include "buffer.h"
+#include "dbmalloc_arena.h"
+
+static unsigned int failures;
+
+#define CHECK(cond) do { \
+	if (!(cond)) { \
+		fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond); \
+		failures++; \
+	} \
+} while (0)
+
+void dropbear_exit(const char *format, ...)
+{
+	fprintf(stderr, "dropbear_exit: %s\n", format);
+	abort();
+}
+
+static int all_zero(const buffer *buf)
+{
+	unsigned int i;
+
+	for (i = 0; i < buf->size; i++) {
+		if (buf->data[i] != 0) {
+			return 0;
+		}
+	}
+	return buf->len == 0 && buf->pos == 0;
+}
+
+int main(void)
+{
+	session_arena_t *arena = session_arena_create(CONFIG_DROPBEAR_SESSION_ARENA_SIZE);
+	session_arena_stats_t st;
+	buffer *a, *b, *held[4];
+	unsigned int i;
+
+	CHECK(arena != NULL);
+	session_arena_attach(arena);
+
+	/* a freed slot comes back zeroed, not with the previous packet */
+	a = buf_new(200);
+	memset(a->data, 0xab, a->size);
+	a->len = a->pos = a->size;
+	buf_free(a);
+	b = buf_new(200);
+	CHECK(all_zero(b));
+	buf_free(b);
+
+	/* the same for the largest class */
+	a = buf_new(4000);
+	memset(a->data, 0x5a, a->size);
+	buf_free(a);
+	b = buf_new(4000);
+	CHECK(all_zero(b));
+	buf_free(b);
+
+	/* with every 256-byte slot busy the next one moves up a class */
+	for (i = 0; i < 4; i++) {
+		held[i] = buf_new(100);
+	}
+	a = buf_new(100);
+	CHECK(all_zero(a));
+	buf_free(a);
+	for (i = 0; i < 4; i++) {
+		buf_free(held[i]);
+	}
+
+	/* too large for any slot */
+	a = buf_new(8000);
+	CHECK(all_zero(a));
+	buf_free(a);
+
+	session_arena_get_stats(arena, &st);
+	CHECK(st.used == 0);
+	CHECK(st.pool_misses == 1);
+	session_arena_attach(NULL);
+
+	printf("packet_slots: %u hits, %u misses: %s\n", st.pool_hits,
+		st.pool_misses, failures ? "FAILED" : "ok");
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,340 @@
+/*
+ * session_pool_check.c - session_pool.c's supervision.
+ *
+ * Includes ../session_pool.c for its slots and pool_supervise(). The pool
+ * is created with the Kconfig defaults but its tasks are never run: the
+ * test puts sessions in the slots and makes the supervision calls itself,
+ * as the session tasks would on waking from select(). Checks that heap is
+ * looked at once per check interval, that below the threshold the session
+ * idle the longest is marked and only one at a time, that the victim sends
+ * SSH_MSG_DISCONNECT and unwinds when it runs, and that the select()
+ * wrapper caps the timeout and keeps errno.
+ */
+
+#include "../session_pool.c"
+
+#define SESSIONS     3
+#define EVICT_BELOW  24576      /* CONFIG_DROPBEAR_EVICT_FREE_HEAP     */
+#define CHECK_SECS   5          /* CONFIG_DROPBEAR_SUPERVISOR_PERIOD   */
+
+static unsigned int failures;
+
+#define CHECK(cond) do { \
+	if (!(cond)) { \
+		fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond); \
+		failures++; \
+	} \
+} while (0)
+
+struct sshsession ses;
+struct serversession svr_ses;
+
+static time_t now;
+static size_t free_heap;
+static unsigned int tasks, cleanups, writes;
+static char task_name[configMAX_TASK_NAME_LEN];  /* the last task created */
+static buffer *sent;                    /* the last packet sent */
+static struct timeval select_timeout;
+static int select_unlocked;
+
+/* ---- FreeRTOS and ESP-IDF ---- */
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack,
+	void *arg, unsigned int priority, TaskHandle_t *handle)
+{
+	(void)fn;
+	(void)stack;
+	snprintf(task_name, sizeof(task_name), "%s", name);
+	(void)priority;
+	*handle = arg;
+	tasks++;
+	return pdPASS;
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(unsigned int max, unsigned int initial)
+{
+	static pthread_mutex_t idle;
+
+	(void)max;
+	(void)initial;
+	return &idle;
+}
+
+unsigned int uxSemaphoreGetCount(SemaphoreHandle_t sem)
+{
+	(void)sem;
+	return 0;
+}
+
+QueueHandle_t xQueueCreate(unsigned int length, unsigned int item_size)
+{
+	(void)length;
+	(void)item_size;
+	return &tasks;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t wait)
+{
+	(void)queue;
+	(void)item;
+	(void)wait;
+	return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t wait)
+{
+	(void)queue;
+	(void)item;
+	(void)wait;
+	abort();
+}
+
+size_t esp_get_free_heap_size(void)
+{
+	return free_heap;
+}
+
+/* ---- Dropbear ---- */
+
+time_t monotonic_now(void)
+{
+	return now;
+}
+
+void seedrandom(void)
+{
+}
+
+void svr_session(int sock, int childpipe)
+{
+	(void)sock;
+	(void)childpipe;
+	abort();
+}
+
+void svr_dropbear_exit(int exitcode, const char *format, va_list param)
+{
+	(void)exitcode;
+	(void)format;
+	(void)param;
+	abort();
+}
+
+void session_cleanup(void)
+{
+	cleanups++;
+}
+
+int isempty(struct Queue *queue)
+{
+	return queue->count == 0;
+}
+
+void encrypt_packet(void)
+{
+	buffer *tmp = sent;
+
+	sent = ses.writepayload;
+	ses.writepayload = tmp;
+	ses.writepayload->len = ses.writepayload->pos = 0;
+	ses.writequeue.count++;
+}
+
+void write_packet(void)
+{
+	ses.writequeue.count--;
+	writes++;
+}
+
+int __real_select(int nfds, fd_set *readfds, fd_set *writefds,
+	fd_set *exceptfds, struct timeval *timeout)
+{
+	(void)nfds;
+	(void)readfds;
+	(void)writefds;
+	(void)exceptfds;
+	select_timeout = *timeout;
+	select_unlocked = pthread_mutex_trylock(pool.lock) == 0;
+	if (select_unlocked) {
+		pthread_mutex_unlock(pool.lock);
+	}
+	errno = EINTR;
+	return -1;
+}
+
+/* ---- test ---- */
+
+/* a new session in slot `i` */
+static void start(unsigned int i, time_t started, time_t last_idle)
+{
+	struct pool_slot *slot = &pool.slots[i];
+
+	cur_slot = slot;
+	pool_switch_to(slot, 1);
+	slot->exiting = 0;
+	slot->running = 1;
+	slot->evict = 0;
+	slot->started = started;
+	ses.last_packet_time_idle = last_idle;
+	ses.writepayload = buf_new(256);
+}
+
+/* the task of slot `i` wakes; 1 if its session exited */
+static int run(unsigned int i)
+{
+	struct pool_slot *slot = &pool.slots[i];
+
+	/* as after its select() */
+	cur_slot = slot;
+	pool_switch_to(slot, 0);
+	if (setjmp(slot->exit_jmp) == 0) {
+		pool_supervise(slot);
+		return 0;
+	}
+	/* as session_task() after an exit */
+	pool.owner = NULL;
+	slot->running = 0;
+	buf_free(ses.writepayload);
+	return 1;
+}
+
+static void check_disconnect(void)
+{
+	static const unsigned char expect[] = {
+		SSH_MSG_DISCONNECT,
+		0, 0, 0, SSH_DISCONNECT_BY_APPLICATION,
+		0, 0, 0, 20, 'S', 'e', 'r', 'v', 'e', 'r', ' ', 'l', 'o', 'w', ' ',
+		'o', 'n', ' ', 'm', 'e', 'm', 'o', 'r', 'y',
+		0, 0, 0, 0,
+	};
+
+	CHECK(sent != NULL && sent->len == sizeof(expect));
+	CHECK(sent != NULL && memcmp(sent->data, expect, sizeof(expect)) == 0);
+}
+
+static void check_eviction(void)
+{
+	session_pool_stats_t stats;
+
+	now = 1000;
+	start(0, 900, 990);
+	start(1, 100, 500);             /* idle the longest */
+	start(2, 950, 0);               /* no packet yet: counts from its start */
+
+	free_heap = 60000;
+	CHECK(run(0) == 0);
+	free_heap = 20000;
+	now = 1002;                     /* within the check interval */
+	CHECK(run(0) == 0);
+	session_pool_get_stats(&stats);
+	CHECK(stats.min_free_heap == 60000);
+	CHECK(!pool.slots[1].evict);
+
+	now = 1005;
+	CHECK(run(2) == 0);
+	CHECK(pool.slots[1].evict && !pool.slots[0].evict && !pool.slots[2].evict);
+	now = 1010;                     /* the victim has not run yet */
+	CHECK(run(0) == 0);
+	CHECK(!pool.slots[0].evict && !pool.slots[2].evict);
+	session_pool_get_stats(&stats);
+	CHECK(stats.evicted == 0 && stats.min_free_heap == 20000);
+
+	/* the victim says goodbye when its own task wakes */
+	pool.slots[1].ses.authstate.authdone = 1;
+	pool.slots[1].ses.authstate.failcount = 2;
+	writes = 0;
+	CHECK(run(1) == 1);
+	CHECK(cleanups == 1 && writes == 1);
+	CHECK(pool.slots[1].authenticated == 1 && pool.slots[1].auth_failures == 2);
+	check_disconnect();
+	session_pool_get_stats(&stats);
+	CHECK(stats.evicted == 1);
+
+	/* next check: slot 2 started before slot 0's last packet */
+	now = 1015;
+	CHECK(run(0) == 0);
+	CHECK(pool.slots[2].evict && !pool.slots[0].evict);
+	CHECK(run(2) == 1);
+
+	/* a session that is its own victim goes at once */
+	now = 1020;
+	CHECK(run(0) == 1);
+	session_pool_get_stats(&stats);
+	CHECK(stats.evicted == 3 && cleanups == 3);
+}
+
+static void check_timeouts(void)
+{
+	session_pool_stats_t stats;
+	struct pool_slot *slot = &pool.slots[0];
+
+	start(0, now, now);
+	if (setjmp(slot->exit_jmp) == 0) {
+		dropbear_exit("Keepalive timeout");
+	}
+	buf_free(ses.writepayload);
+	start(0, now, now);
+	if (setjmp(slot->exit_jmp) == 0) {
+		dropbear_exit("Idle timeout");
+	}
+	buf_free(ses.writepayload);
+	session_pool_get_stats(&stats);
+	CHECK(stats.keepalive_timeouts == 1 && stats.idle_timeouts == 1);
+	CHECK(stats.evicted == 3);
+	slot->running = 0;
+}
+
+static void check_select(void)
+{
+	struct timeval tv;
+	int ret;
+
+	free_heap = 60000;
+	now += CHECK_SECS;
+	start(0, now, now);
+	xSemaphoreTake(pool.lock, portMAX_DELAY);
+
+	ret = __wrap_select(0, NULL, NULL, NULL, NULL);
+	CHECK(ret == -1 && errno == EINTR);
+	CHECK(select_unlocked && select_timeout.tv_sec == CHECK_SECS);
+	tv.tv_sec = 60;
+	tv.tv_usec = 0;
+	__wrap_select(0, NULL, NULL, NULL, &tv);
+	CHECK(select_timeout.tv_sec == CHECK_SECS && tv.tv_sec == 60);
+	tv.tv_sec = 2;
+	tv.tv_usec = 500000;
+	__wrap_select(0, NULL, NULL, NULL, &tv);
+	CHECK(select_timeout.tv_sec == 2 && select_timeout.tv_usec == 500000);
+	/* back with the lock */
+	CHECK(pthread_mutex_trylock(pool.lock) != 0);
+
+	xSemaphoreGive(pool.lock);
+	buf_free(ses.writepayload);
+	pool.slots[0].running = 0;
+	cur_slot = NULL;
+	tv.tv_sec = 60;
+	__wrap_select(0, NULL, NULL, NULL, &tv);
+	CHECK(select_timeout.tv_sec == 60);
+}
+
+int main(void)
+{
+	session_pool_config_t config = {
+		.max_sessions = SESSIONS,
+		.stack_size = 8192,
+		.priority = 5,
+		.evict_below = EVICT_BELOW,
+		.check_secs = CHECK_SECS,
+	};
+
+	sent = buf_new(256);
+	CHECK(session_pool_init(&config) == DROPBEAR_SUCCESS);
+	CHECK(tasks == SESSIONS && _dropbear_exit == pool_dropbear_exit);
+	CHECK(strcmp(task_name, "ssh_sess2") == 0);
+	check_eviction();
+	check_timeouts();
+	check_select();
+	buf_free(sent);
+	printf("session_pool_check: %s\n", failures ? "FAILED" : "ok");
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,105 @@
+/*
+ * sntrup761_bench.c - CPU cycles per sntrup761 operation: the ring
+ * multiplication as Dropbear's sntrup761.c does it (reduce mod q after
+ * every term) vs. port/sntrup761_fast.c, and the KEM operations. Best of
+ * RUNS runs (KEYGEN_RUNS for key generation), x86-64 rdtsc.
+ *
+ *   make -C port/test bench
+ */
+
+#include <x86intrin.h>
+
+#include "../sntrup761_fast.c"
+
+#define RUNS         200
+#define KEYGEN_RUNS  5
+
+#define BENCH(name, runs, expr) do { \
+	unsigned long long best = ~0ULL, t; \
+	int _i; \
+	for (_i = 0; _i < (runs); _i++) { \
+		t = __rdtsc(); \
+		expr; \
+		t = __rdtsc() - t; \
+		if (t < best) { \
+			best = t; \
+		} \
+	} \
+	printf("%-36s %10llu\n", name, best); \
+} while (0)
+
+/* the reference's Fq_freeze(), by division */
+static Fq ref_freeze(int32_t x)
+{
+	uint32_t quot;
+	uint16_t rem, rem2, mask;
+
+	x += NTRU_Q12;
+	uint32_divmod_uint14(&quot, &rem, 0x80000000u + (uint32_t)x, NTRU_Q);
+	uint32_divmod_uint14(&quot, &rem2, 0x80000000u, NTRU_Q);
+	rem = (uint16_t)(rem - rem2);
+	mask = (uint16_t)(0u - (rem >> 15));
+	return (Fq)((uint16_t)(rem + (mask & NTRU_Q)) - NTRU_Q12);
+}
+
+/* the reference's Rq_mult_small() */
+static void ref_mult(Fq *h, const Fq *f, const small *g)
+{
+	Fq fg[2 * NTRU_P - 1], result;
+	int i, j;
+
+	for (i = 0; i < NTRU_P; i++) {
+		result = 0;
+		for (j = 0; j <= i; j++) {
+			result = ref_freeze(result + f[j] * (int32_t)g[i - j]);
+		}
+		fg[i] = result;
+	}
+	for (i = NTRU_P; i < 2 * NTRU_P - 1; i++) {
+		result = 0;
+		for (j = i - NTRU_P + 1; j < NTRU_P; j++) {
+			result = ref_freeze(result + f[j] * (int32_t)g[i - j]);
+		}
+		fg[i] = result;
+	}
+	for (i = 2 * NTRU_P - 2; i >= NTRU_P; i--) {
+		fg[i - NTRU_P] = ref_freeze(fg[i - NTRU_P] + fg[i]);
+		fg[i - NTRU_P + 1] = ref_freeze(fg[i - NTRU_P + 1] + fg[i]);
+	}
+	memcpy(h, fg, NTRU_P * sizeof(Fq));
+}
+
+int main(void)
+{
+	static unsigned char pk[crypto_kem_sntrup761_PUBLICKEYBYTES];
+	static unsigned char sk[crypto_kem_sntrup761_SECRETKEYBYTES];
+	static unsigned char c[crypto_kem_sntrup761_CIPHERTEXTBYTES];
+	unsigned char k[crypto_kem_sntrup761_BYTES], ge[SMALL_BYTES];
+	Fq f[NTRU_P], h[NTRU_P], ref[NTRU_P];
+	small g[NTRU_P];
+	int i;
+
+	for (i = 0; i < NTRU_P; i++) {
+		f[i] = (Fq)(rand() % NTRU_Q - NTRU_Q12);
+		g[i] = (small)(rand() % 3 - 1);
+	}
+	small_encode(ge, g);
+
+	/* the two must agree before their times mean anything */
+	mult_small(h, f, ge, 0);
+	ref_mult(ref, f, g);
+	if (memcmp(h, ref, sizeof(h)) != 0) {
+		printf("sntrup761_bench: results differ\n");
+		return 1;
+	}
+	crypto_kem_sntrup761_keypair(pk, sk);
+	crypto_kem_sntrup761_enc(c, k, pk);
+
+	printf("cycles:\n");
+	BENCH("R/q multiplication, reference", RUNS, ref_mult(h, f, g));
+	BENCH("R/q multiplication, fast", RUNS, mult_small(h, f, ge, 0));
+	BENCH("encapsulation (server)", RUNS, crypto_kem_sntrup761_enc(c, k, pk));
+	BENCH("key generation", KEYGEN_RUNS, crypto_kem_sntrup761_keypair(pk, sk));
+	BENCH("decapsulation", RUNS, crypto_kem_sntrup761_dec(k, c, sk));
+	return 0;
+}
@@ -0,0 +1,618 @@
+/*
+ * sntrup761_check.c - sntrup761_fast.c against the NTRU Prime round 3
+ * specification and against OpenSSH.
+ *
+ * Includes ../sntrup761_fast.c for its internal functions. Checks the
+ * constant-time division, reductions and sort, Encode against the
+ * recursive Encode of the specification byte for byte and Decode back,
+ * the ring multiplication against a plain product in R/q and R/3, both
+ * reciprocals, the shape of generated key pairs, and KEM round trips with
+ * implicit rejection of tampered ciphertexts.
+ *
+ * Then the server side against the upstream reference code, as built into
+ * the OpenSSH client: run as "serve", this is just enough of an SSH server
+ * on stdin/stdout to answer an sntrup761x25519-sha512 key exchange with
+ * crypto_kem_sntrup761_enc(). ssh generates the key pair and decapsulates;
+ * it sends SSH_MSG_NEWKEYS only if the exchange hash signed with both
+ * halves of the shared secret verifies. Without an ssh client that offers
+ * the key exchange, that part is skipped.
+ */
+
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/wait.h>
+
+#include <openssl/evp.h>
+
+#include "../sntrup761_fast.c"
+
+static unsigned int failures;
+
+#define CHECK(cond) do { \
+	if (!(cond)) { \
+		fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond); \
+		failures++; \
+	} \
+} while (0)
+
+static uint32_t rnd(void)
+{
+	return (uint32_t)rand() << 16 ^ (uint32_t)rand();
+}
+
+/* Encode from the specification: pairs merged level by level, recursively */
+static void spec_encode(unsigned char **out, const uint16_t *R, const uint16_t *M, long len)
+{
+	uint16_t R2[(NTRU_P + 1) / 2], M2[(NTRU_P + 1) / 2];
+	uint32_t r, m;
+	long i;
+
+	if (len == 1) {
+		r = R[0];
+		m = M[0];
+		while (m > 1) {
+			*(*out)++ = (unsigned char)r;
+			r >>= 8;
+			m = (m + 255) >> 8;
+		}
+		return;
+	}
+	for (i = 0; i < len - 1; i += 2) {
+		r = R[i] + R[i + 1] * (uint32_t)M[i];
+		m = M[i + 1] * (uint32_t)M[i];
+		while (m >= 16384) {
+			*(*out)++ = (unsigned char)r;
+			r >>= 8;
+			m = (m + 255) >> 8;
+		}
+		R2[i / 2] = (uint16_t)r;
+		M2[i / 2] = (uint16_t)m;
+	}
+	if (i < len) {
+		R2[i / 2] = R[i];
+		M2[i / 2] = M[i];
+	}
+	spec_encode(out, R2, M2, (len + 1) / 2);
+}
+
+/* f * g in Z[x]/(x^761 - x - 1), centered mod `mod` */
+static void schoolbook(int32_t *h, const int16_t *f, const small *g, int mod)
+{
+	static int32_t fg[2 * NTRU_P - 1];
+	int32_t v;
+	int i, j;
+
+	memset(fg, 0, sizeof(fg));
+	for (i = 0; i < NTRU_P; i++) {
+		for (j = 0; j < NTRU_P; j++) {
+			fg[i + j] += f[i] * (int32_t)g[j];
+		}
+	}
+	for (i = 2 * NTRU_P - 2; i >= NTRU_P; i--) {
+		fg[i - NTRU_P] += fg[i];
+		fg[i - NTRU_P + 1] += fg[i];
+	}
+	for (i = 0; i < NTRU_P; i++) {
+		v = (fg[i] % mod + mod) % mod;
+		h[i] = v > mod / 2 ? v - mod : v;
+	}
+}
+
+static int cmp_u32(const void *a, const void *b)
+{
+	uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void check_arith(void)
+{
+	static uint32_t a[NTRU_P], b[NTRU_P];
+	unsigned int it;
+	uint32_t x, quot;
+	uint16_t m, rem;
+	int32_t y;
+	int n, i;
+
+	for (it = 0; it < 200000; it++) {
+		x = rnd();
+		if (it & 1) {
+			x %= 5000000;
+		}
+		m = (uint16_t)(1 + rnd() % 16383);
+		uint32_divmod_uint14(&quot, &rem, x, m);
+		CHECK(quot == x / m && rem == x % m);
+	}
+	/* every input the reductions are documented for */
+	for (y = -(1 << 24) + 1; y < 1 << 24; y++) {
+		int32_t r = (y % NTRU_Q + NTRU_Q) % NTRU_Q;
+
+		if (Fq_freeze(y) != (r > NTRU_Q12 ? r - NTRU_Q : r)) {
+			CHECK(Fq_freeze(y) == (r > NTRU_Q12 ? r - NTRU_Q : r));
+			break;
+		}
+	}
+	for (y = -(1 << 13) + 1; y < 1 << 13; y++) {
+		int32_t r = (y % 3 + 3) % 3;
+
+		CHECK(F3_freeze(y) == (r == 2 ? -1 : r));
+	}
+	for (it = 0; it < 300; it++) {
+		uint32_t mask = it % 3 == 0 ? 3 : it % 3 == 1 ? 0xff : ~0u;
+
+		n = 1 + (int)(rnd() % NTRU_P);
+		for (i = 0; i < n; i++) {
+			a[i] = b[i] = rnd() & mask;
+		}
+		sort_uint32(a, n);
+		qsort(b, (size_t)n, sizeof(b[0]), cmp_u32);
+		CHECK(memcmp(a, b, (size_t)n * sizeof(a[0])) == 0);
+	}
+}
+
+static void check_encoding(void)
+{
+	uint16_t R[NTRU_P], M[NTRU_P], R2[NTRU_P];
+	unsigned char s1[RQ_BYTES], s2[RQ_BYTES], *o;
+	unsigned int it;
+	uint16_t m0;
+	int i;
+
+	for (it = 0; it < 400; it++) {
+		m0 = it & 1 ? NTRU_Q : ROUNDED_M;
+		for (i = 0; i < NTRU_P; i++) {
+			R[i] = it < 2 ? m0 - 1 : (uint16_t)(rnd() % m0);
+			M[i] = m0;
+			R2[i] = R[i];
+		}
+		o = s2;
+		spec_encode(&o, R, M, NTRU_P);
+		encode(s1, R2, m0);
+		CHECK(o - s2 == (m0 == NTRU_Q ? RQ_BYTES : ROUNDED_BYTES));
+		CHECK(memcmp(s1, s2, (size_t)(o - s2)) == 0);
+		decode(R2, s1, m0);
+		CHECK(memcmp(R2, R, sizeof(R)) == 0);
+	}
+	/* a key that is not a valid encoding still decodes into range */
+	for (it = 0; it < 100; it++) {
+		genrandom(s1, sizeof(s1));
+		decode(R, s1, NTRU_Q);
+		for (i = 0; i < NTRU_P; i++) {
+			CHECK(R[i] < NTRU_Q);
+		}
+	}
+}
+
+static void check_mult(void)
+{
+	Fq f[NTRU_P], h[NTRU_P];
+	small g[NTRU_P];
+	unsigned char ge[SMALL_BYTES];
+	int32_t ref[NTRU_P];
+	unsigned int it;
+	int i, mod3;
+
+	for (it = 0; it < 100; it++) {
+		mod3 = it % 4 == 3;
+		for (i = 0; i < NTRU_P; i++) {
+			f[i] = mod3 ? (Fq)(rnd() % 3) - 1 : (Fq)(rnd() % NTRU_Q) - NTRU_Q12;
+			g[i] = (small)(rnd() % 3) - 1;
+			/* the largest sums, either sign */
+			if (it < 2) {
+				f[i] = it == 0 ? NTRU_Q12 : -NTRU_Q12;
+				g[i] = 1;
+			}
+		}
+		small_encode(ge, g);
+		mult_small(h, f, ge, mod3);
+		schoolbook(ref, f, g, mod3 ? 3 : NTRU_Q);
+		for (i = 0; i < NTRU_P; i++) {
+			CHECK(h[i] == ref[i]);
+		}
+	}
+}
+
+/* in * 1/in = 1 in R/3 and 3 * in * 1/(3 * in) = 1 in R/q */
+static void check_recip(void)
+{
+	small in[NTRU_P], out[NTRU_P];
+	Fq f[NTRU_P];
+	int32_t ref[NTRU_P];
+	unsigned int it, invertible = 0;
+	int i;
+
+	for (it = 0; it < 20; it++) {
+		for (i = 0; i < NTRU_P; i++) {
+			in[i] = (small)(rnd() % 3) - 1;
+		}
+		if (R3_recip(out, in) == 0) {
+			invertible++;
+			for (i = 0; i < NTRU_P; i++) {
+				f[i] = out[i];
+			}
+			schoolbook(ref, f, in, 3);
+			for (i = 0; i < NTRU_P; i++) {
+				CHECK(ref[i] == (i == 0));
+			}
+		}
+
+		Rq_recip3(f, in);
+		schoolbook(ref, f, in, NTRU_Q);
+		for (i = 0; i < NTRU_P; i++) {
+			CHECK(Fq_freeze(3 * ref[i]) == (i == 0));
+		}
+	}
+	CHECK(invertible > 0);
+
+	memset(in, 0, sizeof(in));
+	CHECK(R3_recip(out, in) != 0);
+}
+
+static void check_kem(void)
+{
+	static unsigned char pk[crypto_kem_sntrup761_PUBLICKEYBYTES];
+	static unsigned char sk[crypto_kem_sntrup761_SECRETKEYBYTES];
+	static unsigned char c[crypto_kem_sntrup761_CIPHERTEXTBYTES];
+	unsigned char k1[crypto_kem_sntrup761_BYTES], k2[crypto_kem_sntrup761_BYTES];
+	small f[NTRU_P], g[NTRU_P];
+	Fq h[NTRU_P], t[NTRU_P];
+	unsigned char ge[SMALL_BYTES];
+	unsigned int it, j;
+	int i, weight;
+
+	CHECK(CT_BYTES == crypto_kem_sntrup761_CIPHERTEXTBYTES);
+	for (it = 0; it < 5; it++) {
+		CHECK(crypto_kem_sntrup761_keypair(pk, sk) == 0);
+
+		/* pk = g / 3f: 3 * h * f is small, and that g has 1/g in sk */
+		rq_decode(h, pk);
+		mult_small(t, h, sk, 0);
+		for (i = 0; i < NTRU_P; i++) {
+			t[i] = Fq_freeze(3 * t[i]);
+			CHECK(t[i] >= -1 && t[i] <= 1);
+			g[i] = (small)t[i];
+		}
+		small_encode(ge, g);
+		small_decode(f, sk + SMALL_BYTES, 0, NTRU_P);
+		for (i = 0; i < NTRU_P; i++) {
+			h[i] = f[i];
+		}
+		mult_small(t, h, ge, 1);
+		for (i = 0; i < NTRU_P; i++) {
+			CHECK(t[i] == (i == 0));
+		}
+		small_decode(f, sk, 0, NTRU_P);
+		for (i = 0, weight = 0; i < NTRU_P; i++) {
+			weight += f[i] != 0;
+		}
+		CHECK(weight == NTRU_W);
+
+		for (j = 0; j < 5; j++) {
+			CHECK(crypto_kem_sntrup761_enc(c, k1, pk) == 0);
+			crypto_kem_sntrup761_dec(k2, c, sk);
+			CHECK(memcmp(k1, k2, sizeof(k1)) == 0);
+			/* implicit rejection: a different key, no error */
+			c[rnd() % sizeof(c)] ^= (unsigned char)(1 << (rnd() % 8));
+			crypto_kem_sntrup761_dec(k2, c, sk);
+			CHECK(memcmp(k1, k2, sizeof(k1)) != 0);
+		}
+	}
+}
+
+/* ---- against OpenSSH ---- */
+
+#define OPENSSH_RUNS    10
+#define SSH_KEX_NAME    "sntrup761x25519-sha512@openssh.com"
+#define SSH_PACKET_MAX  35000
+
+#define SSH_MSG_KEXINIT         20
+#define SSH_MSG_NEWKEYS         21
+#define SSH_MSG_KEX_ECDH_INIT   30
+#define SSH_MSG_KEX_ECDH_REPLY  31
+
+static unsigned char *put32(unsigned char *p, uint32_t v)
+{
+	p[0] = (unsigned char)(v >> 24);
+	p[1] = (unsigned char)(v >> 16);
+	p[2] = (unsigned char)(v >> 8);
+	p[3] = (unsigned char)v;
+	return p + 4;
+}
+
+static unsigned char *put_string(unsigned char *p, const void *data, unsigned int len)
+{
+	p = put32(p, len);
+	memcpy(p, data, len);
+	return p + len;
+}
+
+static unsigned char *put_cstring(unsigned char *p, const char *str)
+{
+	return put_string(p, str, (unsigned int)strlen(str));
+}
+
+static void hash_string(hash_state *hs, const void *data, unsigned int len)
+{
+	unsigned char n[4];
+
+	put32(n, len);
+	sha512_process(hs, n, 4);
+	sha512_process(hs, data, len);
+}
+
+static int read_full(void *buf, size_t len)
+{
+	unsigned char *p = buf;
+	ssize_t n;
+
+	while (len > 0) {
+		n = read(STDIN_FILENO, p, len);
+		if (n <= 0) {
+			return -1;
+		}
+		p += n;
+		len -= (size_t)n;
+	}
+	return 0;
+}
+
+static void write_full(const void *buf, size_t len)
+{
+	const unsigned char *p = buf;
+	ssize_t n;
+
+	while (len > 0) {
+		n = write(STDOUT_FILENO, p, len);
+		if (n <= 0) {
+			dropbear_exit("stdout: %s", strerror(errno));
+		}
+		p += n;
+		len -= (size_t)n;
+	}
+}
+
+/* RFC 4253 binary packet, before any keys: length, padding length, payload, padding */
+static void send_packet(const unsigned char *payload, unsigned int len)
+{
+	unsigned char head[5], pad[16] = { 0 };
+	unsigned int padlen = 8 - (5 + len) % 8;
+
+	if (padlen < 4) {
+		padlen += 8;
+	}
+	put32(head, 1 + len + padlen);
+	head[4] = (unsigned char)padlen;
+	write_full(head, sizeof(head));
+	write_full(payload, len);
+	write_full(pad, padlen);
+}
+
+/* payload length, or -1 at the end of input */
+static long recv_packet(unsigned char *payload)
+{
+	unsigned char head[5];
+	uint32_t len;
+
+	if (read_full(head, sizeof(head)) != 0) {
+		return -1;
+	}
+	len = (uint32_t)head[0] << 24 | head[1] << 16 | head[2] << 8 | head[3];
+	if (len < 1u + head[4] || len > SSH_PACKET_MAX || read_full(payload, len - 1) != 0) {
+		return -1;
+	}
+	return (long)(len - 1 - head[4]);
+}
+
+static int recv_version(char *line, size_t size)
+{
+	size_t n;
+
+	do {
+		for (n = 0; n + 1 < size; n++) {
+			if (read_full(&line[n], 1) != 0) {
+				return -1;
+			}
+			if (line[n] == '\n') {
+				break;
+			}
+		}
+		line[n] = '\0';
+		if (n > 0 && line[n - 1] == '\r') {
+			line[n - 1] = '\0';
+		}
+	} while (strncmp(line, "SSH-", 4) != 0);
+	return 0;
+}
+
+/* The server end of one key exchange; writes "agreed" to stats_path if ssh accepts it. */
+static int serve(const char *stats_path)
+{
+	static const char version[] = "SSH-2.0-sntrup761_check";
+	static unsigned char in[SSH_PACKET_MAX], kexinit_c[SSH_PACKET_MAX], out[4096];
+	unsigned char kexinit_s[512], qs[CT_BYTES + 32], kem_key[32], xkey[32], secret[64];
+	unsigned char host_pub[32], key_blob[51], sig[64], exchange_hash[64], *p;
+	char version_c[256];
+	size_t len, qs_len = 32;
+	long kexinit_c_len, n;
+	EVP_PKEY *host, *eph, *peer = NULL;
+	EVP_PKEY_CTX *dctx;
+	EVP_MD_CTX *mctx;
+	hash_state hs;
+	FILE *stats;
+	int agreed = 0;
+
+	srand((unsigned int)getpid());
+	host = EVP_PKEY_Q_keygen(NULL, NULL, "ED25519");
+	eph = EVP_PKEY_Q_keygen(NULL, NULL, "X25519");
+	len = sizeof(host_pub);
+	EVP_PKEY_get_raw_public_key(host, host_pub, &len);
+	p = put_cstring(key_blob, "ssh-ed25519");
+	put_string(p, host_pub, sizeof(host_pub));
+
+	write_full(version, strlen(version));
+	write_full("\r\n", 2);
+
+	p = kexinit_s;
+	*p++ = SSH_MSG_KEXINIT;
+	genrandom(p, 16);
+	p += 16;
+	p = put_cstring(p, SSH_KEX_NAME);
+	p = put_cstring(p, "ssh-ed25519");
+	p = put_cstring(p, "aes128-ctr");
+	p = put_cstring(p, "aes128-ctr");
+	p = put_cstring(p, "hmac-sha2-256");
+	p = put_cstring(p, "hmac-sha2-256");
+	p = put_cstring(p, "none");
+	p = put_cstring(p, "none");
+	p = put_cstring(p, "");
+	p = put_cstring(p, "");
+	*p++ = 0;
+	p = put32(p, 0);
+	send_packet(kexinit_s, (unsigned int)(p - kexinit_s));
+
+	if (recv_version(version_c, sizeof(version_c)) != 0) {
+		goto out;
+	}
+	do {
+		kexinit_c_len = recv_packet(kexinit_c);
+	} while (kexinit_c_len > 0 && kexinit_c[0] != SSH_MSG_KEXINIT);
+	n = recv_packet(in);
+	if (kexinit_c_len <= 0 || n != 1 + 4 + RQ_BYTES + 32 || in[0] != SSH_MSG_KEX_ECDH_INIT) {
+		goto out;
+	}
+
+	/* client's Q: sntrup761 public key || X25519 public key */
+	crypto_kem_sntrup761_enc(qs, kem_key, in + 5);
+	EVP_PKEY_get_raw_public_key(eph, qs + CT_BYTES, &qs_len);
+	peer = EVP_PKEY_new_raw_public_key(EVP_PKEY_X25519, NULL, in + 5 + RQ_BYTES, 32);
+	dctx = EVP_PKEY_CTX_new(eph, NULL);
+	len = sizeof(xkey);
+	if (peer == NULL || EVP_PKEY_derive_init(dctx) <= 0 || EVP_PKEY_derive_set_peer(dctx, peer) <= 0
+			|| EVP_PKEY_derive(dctx, xkey, &len) <= 0) {
+		EVP_PKEY_CTX_free(dctx);
+		goto out;
+	}
+	EVP_PKEY_CTX_free(dctx);
+
+	/* K = SHA-512(sntrup761 key || X25519 key), hashed as a string */
+	sha512_init(&hs);
+	sha512_process(&hs, kem_key, sizeof(kem_key));
+	sha512_process(&hs, xkey, sizeof(xkey));
+	sha512_done(&hs, secret);
+
+	sha512_init(&hs);
+	hash_string(&hs, version_c, (unsigned int)strlen(version_c));
+	hash_string(&hs, version, (unsigned int)strlen(version));
+	hash_string(&hs, kexinit_c, (unsigned int)kexinit_c_len);
+	hash_string(&hs, kexinit_s, (unsigned int)(p - kexinit_s));
+	hash_string(&hs, key_blob, sizeof(key_blob));
+	hash_string(&hs, in + 5, RQ_BYTES + 32);
+	hash_string(&hs, qs, sizeof(qs));
+	hash_string(&hs, secret, sizeof(secret));
+	sha512_done(&hs, exchange_hash);
+
+	mctx = EVP_MD_CTX_new();
+	len = sizeof(sig);
+	if (EVP_DigestSignInit(mctx, NULL, NULL, NULL, host) <= 0
+			|| EVP_DigestSign(mctx, sig, &len, exchange_hash, sizeof(exchange_hash)) <= 0) {
+		EVP_MD_CTX_free(mctx);
+		goto out;
+	}
+	EVP_MD_CTX_free(mctx);
+
+	p = out;
+	*p++ = SSH_MSG_KEX_ECDH_REPLY;
+	p = put_string(p, key_blob, sizeof(key_blob));
+	p = put_string(p, qs, sizeof(qs));
+	p = put32(p, 4 + 11 + 4 + sizeof(sig));
+	p = put_cstring(p, "ssh-ed25519");
+	p = put_string(p, sig, sizeof(sig));
+	send_packet(out, (unsigned int)(p - out));
+	out[0] = SSH_MSG_NEWKEYS;
+	send_packet(out, 1);
+
+	/* ssh disconnects instead if the signature did not verify */
+	n = recv_packet(in);
+	agreed = n == 1 && in[0] == SSH_MSG_NEWKEYS;
+
+out:
+	stats = fopen(stats_path, "w");
+	if (stats != NULL) {
+		fputs(agreed ? "agreed\n" : "failed\n", stats);
+		fclose(stats);
+	}
+	EVP_PKEY_free(peer);
+	EVP_PKEY_free(eph);
+	EVP_PKEY_free(host);
+	return agreed ? 0 : 1;
+}
+
+static void check_openssh(void)
+{
+	char self[PATH_MAX], stats_path[] = "/tmp/sntrup761_check.XXXXXX";
+	char proxy[2 * PATH_MAX + 32], result[16];
+	unsigned int run, agreed = 0;
+	FILE *f;
+	pid_t pid;
+	int fd, status;
+
+	if (system("ssh -Q kex 2>/dev/null | grep -qx " SSH_KEX_NAME) != 0) {
+		printf("  no ssh client with " SSH_KEX_NAME ": OpenSSH check skipped\n");
+		return;
+	}
+	fd = mkstemp(stats_path);
+	if (realpath("/proc/self/exe", self) == NULL || fd < 0) {
+		CHECK(0);
+		return;
+	}
+	close(fd);
+	snprintf(proxy, sizeof(proxy), "ProxyCommand=%s serve %s", self, stats_path);
+
+	for (run = 0; run < OPENSSH_RUNS; run++) {
+		unlink(stats_path);
+		pid = fork();
+		if (pid == 0) {
+			/* ssh fails once the keys are in use: nothing serves the connection */
+			fd = open("/dev/null", O_RDWR);
+			if (fd < 0 || dup2(fd, STDIN_FILENO) < 0 || dup2(fd, STDOUT_FILENO) < 0
+					|| dup2(fd, STDERR_FILENO) < 0) {
+				_exit(126);
+			}
+			execlp("ssh", "ssh", "-F", "/dev/null", "-o", "BatchMode=yes",
+				"-o", "StrictHostKeyChecking=no", "-o", "UserKnownHostsFile=/dev/null",
+				"-o", "KexAlgorithms=" SSH_KEX_NAME, "-o", "HostKeyAlgorithms=ssh-ed25519",
+				"-o", proxy, "sntrup761_check", "true", (char *)NULL);
+			_exit(127);
+		}
+		if (pid < 0 || waitpid(pid, &status, 0) != pid) {
+			break;
+		}
+		f = fopen(stats_path, "r");
+		if (f != NULL) {
+			if (fgets(result, sizeof(result), f) != NULL && strcmp(result, "agreed\n") == 0) {
+				agreed++;
+			}
+			fclose(f);
+		}
+	}
+	unlink(stats_path);
+	CHECK(agreed == OPENSSH_RUNS);
+	printf("  OpenSSH client: %u of %u sntrup761x25519 key exchanges agreed\n",
+		agreed, OPENSSH_RUNS);
+}
+
+int main(int argc, char **argv)
+{
+	if (argc == 3 && strcmp(argv[1], "serve") == 0) {
+		return serve(argv[2]);
+	}
+
+	check_arith();
+	check_encoding();
+	check_mult();
+	check_recip();
+	check_kem();
+	check_openssh();
+	printf("sntrup761_check: %s\n", failures ? "FAILED" : "ok");
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,47 @@
+/*
+ * tweetnacl_ref.c - The TweetNaCl field and group code that Dropbear's
+ * curve25519.c is built on (public domain), as the baseline for
+ * curve25519_bench.c. Only X25519 and the Ed25519 base point
+ * multiplication plus encoding are kept; formatting is TweetNaCl's.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+/* TweetNaCl's one-line loops */
+#pragma GCC diagnostic ignored "-Wmisleading-indentation"
+
+typedef unsigned char u8; typedef int64_t i64; typedef uint64_t u64; typedef i64 gf[16];
+#define FOR(i,n) for (i = 0;i < n;++i)
+#define sv static void
+static const gf gf0, gf1 = {1}, _121665 = {0xDB41,1},
+ D2 = {0xf159, 0x26b2, 0x9b94, 0xebd6, 0xb156, 0x8283, 0x149a, 0x00e0, 0xd130, 0xeef3, 0x80f2, 0x198e, 0xfce7, 0x56df, 0xd9dc, 0x2406},
+ X = {0xd51a, 0x8f25, 0x2d60, 0xc956, 0xa7b2, 0x9525, 0xc760, 0x692c, 0xdc5c, 0xfdd6, 0xe231, 0xc0a4, 0x53fe, 0xcd6e, 0x36d3, 0x2169},
+ Y = {0x6658, 0x6666, 0x6666, 0x6666, 0x6666, 0x6666, 0x6666, 0x6666, 0x6666, 0x6666, 0x6666, 0x6666, 0x6666, 0x6666, 0x6666, 0x6666};
+sv set25519(gf r, const gf a){int i;FOR(i,16) r[i]=a[i];}
+sv car25519(gf o){int i;i64 c;FOR(i,16){o[i]+=(1LL<<16);c=o[i]>>16;o[(i+1)*(i<15)]+=c-1+37*(c-1)*(i==15);o[i]-=c<<16;}}
+sv sel25519(gf p,gf q,int b){i64 t,i,c=~(b-1);FOR(i,16){t=c&(p[i]^q[i]);p[i]^=t;q[i]^=t;}}
+sv pack25519(u8 *o,const gf n){int i,j,b;gf m,t;FOR(i,16)t[i]=n[i];car25519(t);car25519(t);car25519(t);
+ FOR(j,2){m[0]=t[0]-0xffed;for(i=1;i<15;i++){m[i]=t[i]-0xffff-((m[i-1]>>16)&1);m[i-1]&=0xffff;}
+ m[15]=t[15]-0x7fff-((m[14]>>16)&1);b=(m[15]>>16)&1;m[14]&=0xffff;sel25519(t,m,1-b);}
+ FOR(i,16){o[2*i]=t[i]&0xff;o[2*i+1]=t[i]>>8;}}
+static u8 par25519(const gf a){u8 d[32];pack25519(d,a);return d[0]&1;}
+sv unpack25519(gf o, const u8 *n){int i;FOR(i,16) o[i]=n[2*i]+((i64)n[2*i+1]<<8);o[15]&=0x7fff;}
+sv A(gf o,const gf a,const gf b){int i;FOR(i,16) o[i]=a[i]+b[i];}
+sv Z(gf o,const gf a,const gf b){int i;FOR(i,16) o[i]=a[i]-b[i];}
+sv M(gf o,const gf a,const gf b){i64 i,j,t[31];FOR(i,31)t[i]=0;FOR(i,16)FOR(j,16)t[i+j]+=a[i]*b[j];FOR(i,15)t[i]+=38*t[i+16];FOR(i,16)o[i]=t[i];car25519(o);car25519(o);}
+sv S(gf o,const gf a){M(o,a,a);}
+sv inv25519(gf o,const gf i){gf c;int a;FOR(a,16)c[a]=i[a];for(a=253;a>=0;a--){S(c,c);if(a!=2&&a!=4)M(c,c,i);}FOR(a,16)o[a]=c[a];}
+void tweet_scalarmult(u8 *q,const u8 *n,const u8 *p){u8 z[32];i64 x[80],r,i;gf a,b,c,d,e,f;
+ FOR(i,31)z[i]=n[i];z[31]=(n[31]&127)|64;z[0]&=248;unpack25519(x,p);
+ FOR(i,16){b[i]=x[i];d[i]=a[i]=c[i]=0;}a[0]=d[0]=1;
+ for(i=254;i>=0;--i){r=(z[i>>3]>>(i&7))&1;sel25519(a,b,r);sel25519(c,d,r);A(e,a,c);Z(a,a,c);A(c,b,d);Z(b,b,d);S(d,e);S(f,a);M(a,c,a);M(c,b,e);A(e,a,c);Z(a,a,c);S(b,a);Z(c,d,f);M(a,c,_121665);A(a,a,d);M(c,c,a);M(a,d,f);M(d,b,x);S(b,e);sel25519(a,b,r);sel25519(c,d,r);}
+ FOR(i,16){x[i+16]=a[i];x[i+32]=c[i];x[i+48]=b[i];x[i+64]=d[i];}
+ inv25519(x+32,x+32);M(x+16,x+16,x+32);pack25519(q,x+16);}
+sv add(gf p[4],gf q[4]){gf a,b,c,d,t,e,f,g,h;Z(a,p[1],p[0]);Z(t,q[1],q[0]);M(a,a,t);A(b,p[0],p[1]);A(t,q[0],q[1]);M(b,b,t);M(c,p[3],q[3]);M(c,c,D2);M(d,p[2],q[2]);A(d,d,d);Z(e,b,a);Z(f,d,c);A(g,d,c);A(h,b,a);M(p[0],e,f);M(p[1],h,g);M(p[2],g,f);M(p[3],e,h);}
+sv cswap(gf p[4],gf q[4],u8 b){int i;FOR(i,4)sel25519(p[i],q[i],b);}
+sv pack(u8 *r,gf p[4]){gf tx,ty,zi;inv25519(zi,p[2]);M(tx,p[0],zi);M(ty,p[1],zi);pack25519(r,ty);r[31]^=par25519(tx)<<7;}
+sv scalarmult(gf p[4],gf q[4],const u8 *s){int i;set25519(p[0],gf0);set25519(p[1],gf1);set25519(p[2],gf1);set25519(p[3],gf0);
+ for(i=255;i>=0;--i){u8 b=(s[i/8]>>(i&7))&1;cswap(p,q,b);add(q,p);add(p,p);cswap(p,q,b);}}
+sv scalarbase(gf p[4],const u8 *s){gf q[4];set25519(q[0],X);set25519(q[1],Y);set25519(q[2],gf1);M(q[3],X,Y);scalarmult(p,q,s);}
+void tweet_ed25519_sign_core(u8 *R, const u8 *r){gf p[4];scalarbase(p,r);pack(R,p);}
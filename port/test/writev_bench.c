@@ -0,0 +1,134 @@
+/*
+ * writev_bench.c - Socket calls and TCP segments per MB, one write() per
+ * packet vs. port/writev_lwip.c.
+ *
+ * A loopback TCP socket with MSS 1460 and TCP_NODELAY is fed by the same
+ * queue/short-write loop as write_packet() in packet.c, 8 MB per case.
+ * Segments are counted as lwIP would emit them, tcp_output() once per call;
+ * Linux's own counters are skewed by loopback GSO. Numbers are in
+ * examples/server/footprint.md.
+ *
+ *   make -C port/test bench
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "writev_lwip.h"
+
+#define MSS     1460
+#define TOTAL   (8UL << 20)
+#define QUEUE   16
+
+ssize_t __wrap_writev(int fd, const struct iovec *iov, int iovcnt);
+
+static unsigned char pkt[QUEUE][16500];
+
+static void *sink(void *arg)
+{
+	static char buf[65536];
+	int fd = accept(*(int *)arg, NULL, NULL);
+
+	while (read(fd, buf, sizeof(buf)) > 0) {
+	}
+	close(fd);
+	return NULL;
+}
+
+static void run(const char *name, unsigned int len, unsigned int burst, int vectored)
+{
+	struct sockaddr_in addr = { .sin_family = AF_INET };
+	socklen_t addrlen = sizeof(addr);
+	unsigned long sent = 0, calls = 0, segments = 0;
+	int lfd, fd, one = 1, mss = MSS;
+	struct iovec iov[QUEUE];
+	pthread_t thread;
+	double mb;
+
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	lfd = socket(AF_INET, SOCK_STREAM, 0);
+	setsockopt(lfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+	bind(lfd, (struct sockaddr *)&addr, sizeof(addr));
+	getsockname(lfd, (struct sockaddr *)&addr, &addrlen);
+	listen(lfd, 1);
+	pthread_create(&thread, NULL, sink, &lfd);
+
+	fd = socket(AF_INET, SOCK_STREAM, 0);
+	setsockopt(fd, IPPROTO_TCP, TCP_MAXSEG, &mss, sizeof(mss));
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+	if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		perror("writev_bench: connect");
+		exit(1);
+	}
+
+	/* each round: `burst` packets queued, then written until the queue is empty */
+	while (sent < TOTAL) {
+		unsigned int i = 0;
+		size_t off = 0;
+
+		while (i < burst) {
+			ssize_t n;
+			unsigned int k;
+
+			if (vectored) {
+				for (k = i; k < burst; k++) {
+					iov[k].iov_base = pkt[k];
+					iov[k].iov_len = len;
+				}
+				iov[i].iov_base = pkt[i] + off;
+				iov[i].iov_len = len - off;
+				n = __wrap_writev(fd, iov + i, (int)(burst - i));
+			} else {
+				n = write(fd, pkt[i] + off, len - off);
+			}
+			if (n < 0) {
+				perror("writev_bench: write");
+				exit(1);
+			}
+			calls++;
+			segments += ((unsigned long)n + MSS - 1) / MSS;
+			off += (size_t)n;
+			while (i < burst && off >= len) {
+				off -= len;
+				i++;
+			}
+		}
+		sent += (unsigned long)burst * len;
+	}
+
+	mb = sent / 1048576.0;
+	printf("%-14s %5u B x%u  %-7s %7.0f calls/MB %7.0f segments/MB\n", name, len, burst,
+		vectored ? "writev" : "write", calls / mb, segments / mb);
+	close(fd);
+	pthread_join(thread, NULL);
+	close(lfd);
+}
+
+int main(void)
+{
+	static const struct {
+		const char *name;
+		unsigned int len, burst;
+	} cases[] = {
+		{ "shell output", 100, 8 },
+		{ "log/bulk", 1060, 8 },
+		{ "scp/sftp", 16428, 4 },
+	};
+	unsigned long calls, buffers;
+	unsigned int i;
+
+	for (i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+		run(cases[i].name, cases[i].len, cases[i].burst, 0);
+		run(cases[i].name, cases[i].len, cases[i].burst, 1);
+	}
+	writev_get_stats(&calls, &buffers);
+	printf("writev_get_stats: %lu calls, %lu buffers\n", calls, buffers);
+	return 0;
+}
@@ -0,0 +1,59 @@
+/*
+ * writev_lwip.c - writev() on top of lwip_writev().
+ *
+ * Dropbear only calls writev() from write_packet(), on the session socket.
+ * lwip_writev() hands all vectors to the TCP/IP task in one message, which
+ * appends them to the send queue and runs tcp_output() once. The socket is
+ * non-blocking, so a full send buffer ends in a short write and packet.c
+ * keeps the rest queued.
+ *
+ * Anything that is not an lwIP socket gets one write() per buffer.
+ */
+
+#include <errno.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <sys/socket.h>
+#include "lwip/sockets.h"
+#include "writev_lwip.h"
+
+static unsigned long writev_calls, writev_buffers;
+
+static ssize_t writev_plain(int fd, const struct iovec *iov, int iovcnt)
+{
+	ssize_t total = 0;
+	int i;
+
+	for (i = 0; i < iovcnt; i++) {
+		ssize_t n = write(fd, iov[i].iov_base, iov[i].iov_len);
+
+		if (n < 0) {
+			return total > 0 ? total : n;
+		}
+		total += n;
+		if ((size_t)n < iov[i].iov_len) {
+			break;
+		}
+	}
+	return total;
+}
+
+ssize_t __wrap_writev(int fd, const struct iovec *iov, int iovcnt)
+{
+	ssize_t ret;
+
+	ret = lwip_writev(fd, iov, iovcnt);
+	if (ret < 0 && errno == EBADF) {
+		ret = writev_plain(fd, iov, iovcnt);
+	}
+
+	writev_calls++;
+	writev_buffers += iovcnt;
+	return ret;
+}
+
+void writev_get_stats(unsigned long *calls, unsigned long *buffers)
+{
+	*calls = writev_calls;
+	*buffers = writev_buffers;
+}
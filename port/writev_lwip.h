@@ -0,0 +1,15 @@
+#pragma once
+
+/*
+ * writev_lwip - writev() for Dropbear's outgoing packet queue.
+ *
+ * port/config.h sets HAVE_WRITEV, so packet.c's write_packet() gathers all
+ * queued encrypted packets into one writev() call. The component links with
+ * -Wl,--wrap=writev and port/writev_lwip.c passes the call to lwip_writev():
+ * one trip into the TCP/IP task per batch, and the packets are packed into
+ * full-MSS segments instead of one segment per packet. With
+ * CONFIG_DROPBEAR_NETCONN_NOCOPY, port/netconn_lwip.c takes its place.
+ */
+
+/* writev() calls and buffers (queued packets) sent by them since boot. */
+void writev_get_stats(unsigned long *calls, unsigned long *buffers);